@@ -217,6 +217,10 @@ export function MoteHardwareProvider({ children }: { children: React.ReactNode }
           }
           break;
 
+        case 'device.metrics':
+          // Diagnostics only - nothing in the UI shows them yet
+          break;
+
         default:
           console.warn('[MoteHardware] Unknown message type:', message);
       }
@@ -0,0 +1,142 @@
+/**
+ * Mote BLE TLV Protocol Tests
+ *
+ * Frames here are byte-for-byte what firmware/src/ble_protocol.cpp produces
+ */
+
+import { describe, it, expect } from 'vitest';
+import {
+  BLE_FLAG_FULL,
+  BLE_FLAG_MORE,
+  BleMessageType,
+  applyMetricsFrame,
+  applyStatusFrame,
+  base64ToBytes,
+  bytesToBase64,
+  decodeAck,
+  decodeFrame,
+  encodeConfig,
+  encodeHello,
+  encodeVolume,
+  isJsonValue,
+} from '../mote-ble-protocol';
+
+function frame(bytes: number[]) {
+  const decoded = decodeFrame(Uint8Array.from(bytes));
+  if (!decoded) {
+    throw new Error('frame did not decode');
+  }
+  return decoded;
+}
+
+describe('mote-ble-protocol', () => {
+  describe('Framing', () => {
+    it('should round-trip base64', () => {
+      const bytes = Uint8Array.from([1, 2, 0, 0xff, 0x80]);
+      expect(base64ToBytes(bytesToBase64(bytes))).toEqual(bytes);
+    });
+
+    it('should tell legacy JSON from frames', () => {
+      expect(isJsonValue(base64ToBytes(btoa('{"type":"status"}')))).toBe(true);
+      expect(isJsonValue(encodeHello())).toBe(false);
+    });
+
+    it('should reject other versions and overrunning TLVs', () => {
+      expect(decodeFrame(Uint8Array.from([2, BleMessageType.STATUS, 0]))).toBeNull();
+      expect(decodeFrame(Uint8Array.from([1, BleMessageType.STATUS]))).toBeNull();
+      expect(decodeFrame(Uint8Array.from([1, BleMessageType.STATUS, 0, 0x05, 3, 1]))).toBeNull();
+    });
+  });
+
+  describe('Encoding', () => {
+    it('should encode HELLO as a bare header', () => {
+      expect(Array.from(encodeHello())).toEqual([1, BleMessageType.HELLO, 0]);
+    });
+
+    it('should encode volume', () => {
+      expect(Array.from(encodeVolume(40))).toEqual([1, BleMessageType.CONFIG, 0, 0x06, 1, 40]);
+    });
+
+    it('should encode config with UTF-8 strings and a little-endian port', () => {
+      const bytes = encodeConfig({
+        wifiSsid: 'Café',
+        wifiPassword: 'pw',
+        websocketServer: 'gw',
+        websocketPort: 3000,
+        gatewayToken: '',
+      });
+      expect(Array.from(bytes)).toEqual([
+        1, BleMessageType.CONFIG, 0,
+        0x01, 5, 0x43, 0x61, 0x66, 0xc3, 0xa9,
+        0x02, 2, 0x70, 0x77,
+        0x03, 2, 0x67, 0x77,
+        0x04, 2, 0xb8, 0x0b,
+        0x05, 0,
+      ]);
+    });
+
+    it('should refuse strings longer than a TLV', () => {
+      expect(() =>
+        encodeConfig({
+          wifiSsid: 'x'.repeat(256),
+          wifiPassword: '',
+          websocketServer: '',
+          websocketPort: 1,
+          gatewayToken: '',
+        })
+      ).toThrow();
+    });
+  });
+
+  describe('Status', () => {
+    it('should build a status from a full snapshot and merge deltas', () => {
+      let status = applyStatusFrame({}, frame([
+        1, BleMessageType.STATUS, BLE_FLAG_FULL,
+        0x01, 6, 0xaa, 0xbb, 0xcc, 0x01, 0x02, 0x03,
+        0x02, 5, 0x31, 0x2e, 0x30, 0x2e, 0x30,
+        0x04, 2, 0x78, 0x0f,
+        0x05, 1, 70,
+        0x0c, 1, 0,
+      ]));
+      expect(status).toMatchObject({
+        type: 'status',
+        deviceId: 'AA:BB:CC:01:02:03',
+        firmwareVersion: '1.0.0',
+        batteryVoltage: 3.96,
+        volume: 70,
+        gatewayConnected: false,
+      });
+
+      status = applyStatusFrame(status, frame([1, BleMessageType.STATUS, 0, 0x05, 1, 55, 0x0c, 1, 1, 0x7e, 1, 9]));
+      expect(status.volume).toBe(55);
+      expect(status.gatewayConnected).toBe(true);
+      expect(status.deviceId).toBe('AA:BB:CC:01:02:03');
+    });
+  });
+
+  describe('Metrics', () => {
+    it('should name counters and gauges by tag', () => {
+      const metrics = applyMetricsFrame(
+        { type: 'device.metrics', counters: { wsTextRx: 1 }, gauges: {} },
+        frame([
+          1, BleMessageType.METRICS, BLE_FLAG_MORE,
+          0x01, 4, 5, 0, 0, 0,
+          0x84, 4, 0x70, 0x11, 0x01, 0x00,
+        ])
+      );
+      expect(metrics.counters).toEqual({ wsTextRx: 1, wsBinaryRx: 5 });
+      expect(metrics.gauges).toEqual({ heapFree: 70000 });
+    });
+  });
+
+  describe('Ack', () => {
+    it('should report success and reboots', () => {
+      expect(decodeAck(frame([1, BleMessageType.ACK, 0, 0x01, 1, 0, 0x02, 1, 1]))).toEqual({
+        type: 'ack',
+        success: true,
+        message: 'Configuration applied, rebooting',
+      });
+      expect(decodeAck(frame([1, BleMessageType.ACK, 0, 0x01, 1, 2, 0x02, 1, 0])).success).toBe(false);
+    });
+  });
+});
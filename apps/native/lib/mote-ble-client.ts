@@ -7,7 +7,24 @@
 
 import { BleManager, Device, Characteristic } from 'react-native-ble-plx';
 import { Platform, PermissionsAndroid } from 'react-native';
-import type { MoteStatusMessage } from './mote-protocol';
+import type { MoteMetricsMessage, MoteStatusMessage } from './mote-protocol';
+import {
+  BLE_FLAG_FULL,
+  BLE_FLAG_MORE,
+  BLE_FLAG_READ_FULL,
+  BLE_MTU_MAX,
+  BleMessageType,
+  applyMetricsFrame,
+  applyStatusFrame,
+  base64ToBytes,
+  bytesToBase64,
+  decodeAck,
+  decodeFrame,
+  encodeConfig,
+  encodeHello,
+  encodeVolume,
+  isJsonValue,
+} from './mote-ble-protocol';
 
 // BLE Service and Characteristic UUIDs (must match firmware)
 const MOTE_SERVICE_UUID = '4fafc201-1fb5-459e-8fcc-c5c9c331914b';
@@ -23,6 +40,12 @@ export class MoteBleClient {
   private disconnectListeners: Array<() => void> = [];
   private disconnectSubscription: { remove: () => void } | null = null;
 
+  // TLV protocol state (mote-ble-protocol.ts), reset per connection
+  private binaryProtocol = false;
+  private status: Partial<MoteStatusMessage> = {};
+  private metrics: MoteMetricsMessage = { type: 'device.metrics', counters: {}, gauges: {} };
+  private statusInProgress = false; // Previous STATUS frame had MORE set
+
   constructor() {
     this.manager = new BleManager();
   }
@@ -112,8 +135,8 @@ export class MoteBleClient {
       // Stop any ongoing scans
       this.manager.stopDeviceScan();
 
-      // Connect to device
-      this.device = await this.manager.connectToDevice(deviceId);
+      // Connect to device (MTU request is Android-only; iOS negotiates on its own)
+      this.device = await this.manager.connectToDevice(deviceId, { requestMTU: BLE_MTU_MAX });
       console.log('[MoteBLE] Device connected:', this.device.name);
 
       // Discover services and characteristics
@@ -136,6 +159,8 @@ export class MoteBleClient {
 
       console.log('[MoteBLE] Characteristics found');
 
+      this.resetProtocolState();
+
       // Subscribe to status updates
       this.device.monitorCharacteristicForService(
         MOTE_SERVICE_UUID,
@@ -147,30 +172,25 @@ export class MoteBleClient {
           }
 
           if (characteristic?.value) {
-            try {
-              // Decode base64 value
-              const decoded = atob(characteristic.value);
-              const message = JSON.parse(decoded);
-              console.log('[MoteBLE] Received status:', message);
-
-              // Notify listeners
-              this.messageListeners.forEach((listener) => listener(message));
-            } catch (error) {
-              console.error('[MoteBLE] Failed to parse status message:', error);
-            }
+            this.handleValue(characteristic.value);
           }
         }
       );
 
       console.log('[MoteBLE] Status monitoring started');
 
-      // Read initial status
+      // Read initial status - always JSON until we send HELLO
       const initialStatus = await this.statusCharacteristic.read();
       if (initialStatus.value) {
-        const decoded = atob(initialStatus.value);
-        const message = JSON.parse(decoded);
+        const message = this.handleValue(initialStatus.value);
         console.log('[MoteBLE] Initial status:', message);
-        this.messageListeners.forEach((listener) => listener(message));
+
+        // Older firmware treats any write as config, so only greet one that asks
+        if (message?.bleProtocol) {
+          await this.configCharacteristic.writeWithResponse(bytesToBase64(encodeHello()));
+          this.binaryProtocol = true;
+          console.log('[MoteBLE] Switched to TLV protocol');
+        }
       }
 
       // Set up disconnect listener
@@ -193,6 +213,96 @@ export class MoteBleClient {
     }
   }
 
+  /**
+   * Reset per-connection protocol state (every connection starts in JSON)
+   */
+  private resetProtocolState(): void {
+    this.binaryProtocol = false;
+    this.status = {};
+    this.metrics = { type: 'device.metrics', counters: {}, gauges: {} };
+    this.statusInProgress = false;
+  }
+
+  /**
+   * Decode a status characteristic value (notification or read) and notify
+   * listeners once a complete update has arrived
+   * @returns The parsed JSON message, for legacy values
+   */
+  private handleValue(base64: string): any | null {
+    const bytes = base64ToBytes(base64);
+
+    if (isJsonValue(bytes)) {
+      try {
+        const message = JSON.parse(atob(base64));
+        console.log('[MoteBLE] Received status:', message);
+        this.messageListeners.forEach((listener) => listener(message));
+        return message;
+      } catch (error) {
+        console.error('[MoteBLE] Failed to parse status message:', error);
+        return null;
+      }
+    }
+
+    const frame = decodeFrame(bytes);
+    if (!frame) {
+      console.error('[MoteBLE] Malformed frame:', bytes.length, 'bytes');
+      return null;
+    }
+    const more = (frame.flags & BLE_FLAG_MORE) !== 0;
+
+    switch (frame.type) {
+      case BleMessageType.STATUS:
+        if (frame.flags & BLE_FLAG_FULL && !this.statusInProgress) {
+          this.status = {};
+        }
+        this.status = applyStatusFrame(this.status, frame);
+        this.statusInProgress = more;
+        if (!more) {
+          const message = { ...this.status } as MoteStatusMessage;
+          this.messageListeners.forEach((listener) => listener(message));
+          if (frame.flags & BLE_FLAG_READ_FULL) {
+            this.readFullStatus();
+          }
+        }
+        break;
+
+      case BleMessageType.METRICS:
+        this.metrics = applyMetricsFrame(this.metrics, frame);
+        if (!more) {
+          const message = this.metrics;
+          this.messageListeners.forEach((listener) => listener(message));
+        }
+        break;
+
+      case BleMessageType.ACK: {
+        const message = decodeAck(frame);
+        this.messageListeners.forEach((listener) => listener(message));
+        break;
+      }
+
+      default:
+        console.warn('[MoteBLE] Unknown frame type:', frame.type);
+    }
+    return null;
+  }
+
+  /**
+   * A value didn't fit the MTU - the read value always has the full status
+   */
+  private async readFullStatus(): Promise<void> {
+    if (!this.statusCharacteristic) {
+      return;
+    }
+    try {
+      const characteristic = await this.statusCharacteristic.read();
+      if (characteristic.value) {
+        this.handleValue(characteristic.value);
+      }
+    } catch (error) {
+      console.error('[MoteBLE] Failed to read full status:', error);
+    }
+  }
+
   /**
    * Send WiFi configuration to device
    */
@@ -207,19 +317,21 @@ export class MoteBleClient {
       throw new Error('Not connected to device');
     }
 
-    const configJson = JSON.stringify({
-      ssid: config.wifiSsid,
-      password: config.wifiPassword,
-      server: config.websocketServer,
-      port: config.websocketPort,
-      token: config.gatewayToken,
-    });
-
-    console.log('[MoteBLE] Sending config:', configJson);
+    console.log('[MoteBLE] Sending config for SSID:', config.wifiSsid);
 
     try {
       // Write configuration to characteristic (encode as base64)
-      const encoded = btoa(configJson);
+      const encoded = this.binaryProtocol
+        ? bytesToBase64(encodeConfig(config))
+        : btoa(
+            JSON.stringify({
+              ssid: config.wifiSsid,
+              password: config.wifiPassword,
+              server: config.websocketServer,
+              port: config.websocketPort,
+              token: config.gatewayToken,
+            })
+          );
       await this.configCharacteristic.writeWithResponse(encoded);
       console.log('[MoteBLE] Configuration sent successfully');
     } catch (error) {
@@ -239,12 +351,13 @@ export class MoteBleClient {
 
     // Clamp volume to valid range
     const clampedVolume = Math.max(0, Math.min(100, Math.round(volume)));
-    const volumeJson = JSON.stringify({ volume: clampedVolume });
 
     console.log('[MoteBLE] Sending volume:', clampedVolume);
 
     try {
-      const encoded = btoa(volumeJson);
+      const encoded = this.binaryProtocol
+        ? bytesToBase64(encodeVolume(clampedVolume))
+        : btoa(JSON.stringify({ volume: clampedVolume }));
       await this.configCharacteristic.writeWithResponse(encoded);
       console.log('[MoteBLE] Volume sent successfully');
     } catch (error) {
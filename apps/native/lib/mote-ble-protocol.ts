@@ -0,0 +1,385 @@
+/**
+ * Mote BLE TLV Protocol
+ *
+ * Binary framing for the BLE config service (must match firmware
+ * include/ble_protocol.h). Every characteristic value is one frame:
+ *
+ *   [version][type][flags] then TLVs [tag][length][value...]
+ *
+ * Integers are little-endian, strings UTF-8. Unknown tags are skipped, so
+ * newer firmware can add fields without breaking this app.
+ *
+ * Firmware that speaks it advertises `bleProtocol` in its JSON status; the
+ * app switches the connection over by writing a HELLO frame. After that,
+ * STATUS and METRICS notifications carry only what changed.
+ */
+
+import type { MoteAckMessage, MoteMetricsMessage, MoteStatusMessage } from './mote-protocol';
+
+export const BLE_PROTOCOL_VERSION = 1;
+export const BLE_MTU_MAX = 517;
+
+export const BleMessageType = {
+  HELLO: 0x01,
+  STATUS: 0x02,
+  METRICS: 0x03,
+  CONFIG: 0x04,
+  ACK: 0x05,
+} as const;
+
+export const BLE_FLAG_FULL = 0x01;       // Snapshot - every field is present
+export const BLE_FLAG_MORE = 0x02;       // More notifications of this update follow
+export const BLE_FLAG_READ_FULL = 0x04;  // A value didn't fit the MTU - read the characteristic
+
+const StatusTag = {
+  DEVICE_ID: 0x01,
+  FIRMWARE: 0x02,
+  BATTERY_PERCENT: 0x03,
+  BATTERY_MV: 0x04,
+  VOLUME: 0x05,
+  WAKE_MODE: 0x06,
+  LOCAL_WAKE_ACTIVE: 0x07,
+  WIFI_CONFIGURED: 0x08,
+  WIFI_CONNECTED: 0x09,
+  WIFI_SSID: 0x0a,
+  GATEWAY_CONFIGURED: 0x0b,
+  GATEWAY_CONNECTED: 0x0c,
+  GATEWAY_SERVER: 0x0d,
+  GATEWAY_PORT: 0x0e,
+  IP_MODE: 0x0f,
+  VOICE_STATE: 0x10,
+} as const;
+
+const ConfigTag = {
+  WIFI_SSID: 0x01,
+  WIFI_PASSWORD: 0x02,
+  GATEWAY_SERVER: 0x03,
+  GATEWAY_PORT: 0x04,
+  GATEWAY_TOKEN: 0x05,
+  VOLUME: 0x06,
+} as const;
+
+const AckTag = {
+  RESULT: 0x01,
+  REBOOTING: 0x02,
+} as const;
+
+const ACK_MESSAGES = ['Configuration applied', 'Malformed write', 'Invalid value', 'Device busy'];
+
+// Metric names in firmware MetricId order (src/metrics.cpp). Counters are
+// tagged by index, gauges by 0x80 + index.
+const METRIC_GAUGE_TAG = 0x80;
+const COUNTER_NAMES = [
+  'wsTextRx',
+  'wsBinaryRx',
+  'wsBinaryRxBytes',
+  'wsDisconnects',
+  'uplinkFrames',
+  'uplinkSendFailures',
+  'uplinkPacketDrops',
+  'downlinkErrors',
+  'playbackUnderruns',
+  'playbackDroppedSamples',
+  'captureOverrunSamples',
+  'poolAllocFailures',
+];
+const GAUGE_NAMES = [
+  'voiceState',
+  'playbackBuffered',
+  'playbackBufferedPeak',
+  'captureBacklogPeak',
+  'heapFree',
+  'heapMinFree',
+  'psramFree',
+  'psramMinFree',
+  'powerLevel',
+  'cpuMhz',
+  'poolInternalBlocks',
+  'poolInternalPeak',
+  'poolPsramBlocks',
+  'poolPsramPeak',
+];
+
+export interface BleTlv {
+  tag: number;
+  value: Uint8Array;
+}
+
+export interface BleFrame {
+  type: number;
+  flags: number;
+  tlvs: BleTlv[];
+}
+
+/**
+ * Decode a base64 characteristic value to bytes
+ */
+export function base64ToBytes(base64: string): Uint8Array {
+  const binary = atob(base64);
+  const bytes = new Uint8Array(binary.length);
+  for (let i = 0; i < binary.length; i++) {
+    bytes[i] = binary.charCodeAt(i);
+  }
+  return bytes;
+}
+
+/**
+ * Encode bytes as a base64 characteristic value
+ */
+export function bytesToBase64(bytes: Uint8Array): string {
+  let binary = '';
+  for (let i = 0; i < bytes.length; i++) {
+    binary += String.fromCharCode(bytes[i]);
+  }
+  return btoa(binary);
+}
+
+/**
+ * True if the value is legacy JSON rather than a TLV frame
+ */
+export function isJsonValue(bytes: Uint8Array): boolean {
+  return bytes.length > 0 && bytes[0] === 0x7b; // '{'
+}
+
+function utf8Encode(text: string): number[] {
+  const bytes: number[] = [];
+  for (const char of text) {
+    const code = char.codePointAt(0)!;
+    if (code < 0x80) {
+      bytes.push(code);
+    } else if (code < 0x800) {
+      bytes.push(0xc0 | (code >> 6), 0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+      bytes.push(0xe0 | (code >> 12), 0x80 | ((code >> 6) & 0x3f), 0x80 | (code & 0x3f));
+    } else {
+      bytes.push(
+        0xf0 | (code >> 18),
+        0x80 | ((code >> 12) & 0x3f),
+        0x80 | ((code >> 6) & 0x3f),
+        0x80 | (code & 0x3f)
+      );
+    }
+  }
+  return bytes;
+}
+
+function utf8Decode(bytes: Uint8Array): string {
+  let binary = '';
+  for (let i = 0; i < bytes.length; i++) {
+    binary += String.fromCharCode(bytes[i]);
+  }
+  try {
+    return decodeURIComponent(escape(binary));
+  } catch {
+    return binary; // Not valid UTF-8 - show the raw bytes rather than nothing
+  }
+}
+
+function readU16(value: Uint8Array): number {
+  return value[0] | (value[1] << 8);
+}
+
+function readU32(value: Uint8Array): number {
+  return (value[0] | (value[1] << 8) | (value[2] << 16) | (value[3] << 24)) >>> 0;
+}
+
+/**
+ * Parse one frame
+ * @returns null if the header is short, from another version, or a TLV overruns
+ */
+export function decodeFrame(bytes: Uint8Array): BleFrame | null {
+  if (bytes.length < 3 || bytes[0] !== BLE_PROTOCOL_VERSION) {
+    return null;
+  }
+
+  const tlvs: BleTlv[] = [];
+  let pos = 3;
+  while (pos < bytes.length) {
+    if (pos + 2 > bytes.length || pos + 2 + bytes[pos + 1] > bytes.length) {
+      return null;
+    }
+    const length = bytes[pos + 1];
+    tlvs.push({ tag: bytes[pos], value: bytes.subarray(pos + 2, pos + 2 + length) });
+    pos += 2 + length;
+  }
+
+  return { type: bytes[1], flags: bytes[2], tlvs };
+}
+
+class FrameBuilder {
+  private bytes: number[];
+
+  constructor(type: number) {
+    this.bytes = [BLE_PROTOCOL_VERSION, type, 0];
+  }
+
+  u8(tag: number, value: number): this {
+    this.bytes.push(tag, 1, value & 0xff);
+    return this;
+  }
+
+  u16(tag: number, value: number): this {
+    this.bytes.push(tag, 2, value & 0xff, (value >> 8) & 0xff);
+    return this;
+  }
+
+  string(tag: number, value: string): this {
+    const encoded = utf8Encode(value);
+    if (encoded.length > 255) {
+      throw new Error(`Value too long (${encoded.length} bytes)`);
+    }
+    this.bytes.push(tag, encoded.length, ...encoded);
+    return this;
+  }
+
+  build(): Uint8Array {
+    return Uint8Array.from(this.bytes);
+  }
+}
+
+/**
+ * HELLO: switch this connection to the TLV protocol
+ */
+export function encodeHello(): Uint8Array {
+  return new FrameBuilder(BleMessageType.HELLO).build();
+}
+
+/**
+ * CONFIG with the network settings (saved and applied live by the device)
+ */
+export function encodeConfig(config: {
+  wifiSsid: string;
+  wifiPassword: string;
+  websocketServer: string;
+  websocketPort: number;
+  gatewayToken: string;
+}): Uint8Array {
+  return new FrameBuilder(BleMessageType.CONFIG)
+    .string(ConfigTag.WIFI_SSID, config.wifiSsid)
+    .string(ConfigTag.WIFI_PASSWORD, config.wifiPassword)
+    .string(ConfigTag.GATEWAY_SERVER, config.websocketServer)
+    .u16(ConfigTag.GATEWAY_PORT, config.websocketPort)
+    .string(ConfigTag.GATEWAY_TOKEN, config.gatewayToken)
+    .build();
+}
+
+/**
+ * CONFIG with just the volume (0-100)
+ */
+export function encodeVolume(volume: number): Uint8Array {
+  return new FrameBuilder(BleMessageType.CONFIG).u8(ConfigTag.VOLUME, volume).build();
+}
+
+function formatDeviceId(value: Uint8Array): string {
+  return Array.from(value, (b) => b.toString(16).padStart(2, '0').toUpperCase()).join(':');
+}
+
+/**
+ * Merge a STATUS frame into the status built so far
+ *
+ * A FULL frame's fields replace everything; a delta only touches the
+ * fields it carries.
+ */
+export function applyStatusFrame(
+  status: Partial<MoteStatusMessage>,
+  frame: BleFrame
+): Partial<MoteStatusMessage> {
+  const next: Partial<MoteStatusMessage> = { ...status, type: 'status' };
+  for (const { tag, value } of frame.tlvs) {
+    switch (tag) {
+      case StatusTag.DEVICE_ID:
+        next.deviceId = formatDeviceId(value);
+        break;
+      case StatusTag.FIRMWARE:
+        next.firmwareVersion = utf8Decode(value);
+        break;
+      case StatusTag.BATTERY_PERCENT:
+        next.batteryPercent = value[0];
+        break;
+      case StatusTag.BATTERY_MV:
+        next.batteryVoltage = Math.round(readU16(value) / 10) / 100;
+        break;
+      case StatusTag.VOLUME:
+        next.volume = value[0];
+        break;
+      case StatusTag.WAKE_MODE:
+        next.wakeMode = value[0] === 1 ? 'local' : 'server';
+        break;
+      case StatusTag.LOCAL_WAKE_ACTIVE:
+        next.localWakeActive = value[0] !== 0;
+        break;
+      case StatusTag.WIFI_CONFIGURED:
+        next.wifiConfigured = value[0] !== 0;
+        break;
+      case StatusTag.WIFI_CONNECTED:
+        next.wifiConnected = value[0] !== 0;
+        break;
+      case StatusTag.WIFI_SSID:
+        next.wifiSsid = utf8Decode(value);
+        break;
+      case StatusTag.GATEWAY_CONFIGURED:
+        next.gatewayConfigured = value[0] !== 0;
+        break;
+      case StatusTag.GATEWAY_CONNECTED:
+        next.gatewayConnected = value[0] !== 0;
+        break;
+      case StatusTag.GATEWAY_SERVER:
+        next.gatewayServer = utf8Decode(value);
+        break;
+      case StatusTag.GATEWAY_PORT:
+        next.gatewayPort = readU16(value);
+        break;
+      case StatusTag.VOICE_STATE:
+        next.voiceState = value[0];
+        break;
+      default:
+        break; // IP mode and anything from newer firmware
+    }
+  }
+  return next;
+}
+
+/**
+ * Merge a METRICS frame into the metrics built so far
+ */
+export function applyMetricsFrame(metrics: MoteMetricsMessage, frame: BleFrame): MoteMetricsMessage {
+  const next: MoteMetricsMessage = {
+    type: 'device.metrics',
+    counters: { ...metrics.counters },
+    gauges: { ...metrics.gauges },
+  };
+  for (const { tag, value } of frame.tlvs) {
+    if (value.length !== 4) {
+      continue;
+    }
+    if (tag >= METRIC_GAUGE_TAG) {
+      const name = GAUGE_NAMES[tag - METRIC_GAUGE_TAG] ?? `gauge${tag - METRIC_GAUGE_TAG}`;
+      next.gauges[name] = readU32(value);
+    } else {
+      const name = COUNTER_NAMES[tag] ?? `counter${tag}`;
+      next.counters[name] = readU32(value);
+    }
+  }
+  return next;
+}
+
+/**
+ * Turn an ACK frame into the app's ack message
+ */
+export function decodeAck(frame: BleFrame): MoteAckMessage {
+  let result = 1;
+  let rebooting = false;
+  for (const { tag, value } of frame.tlvs) {
+    if (tag === AckTag.RESULT && value.length === 1) {
+      result = value[0];
+    } else if (tag === AckTag.REBOOTING && value.length === 1) {
+      rebooting = value[0] !== 0;
+    }
+  }
+
+  let message = ACK_MESSAGES[result] ?? `Error ${result}`;
+  if (rebooting) {
+    message += ', rebooting';
+  }
+  return { type: 'ack', success: result === 0, message };
+}
@@ -15,7 +15,8 @@ export type MoteMessage =
   | MoteVolumeMessage
   | MoteStatusMessage
   | MoteAckMessage
-  | MoteErrorMessage;
+  | MoteErrorMessage
+  | MoteMetricsMessage;
 
 /**
  * Configuration message sent from app to Mote device
@@ -57,9 +58,26 @@ export interface MoteStatusMessage {
   wifiConnected: boolean;      // true if WiFi is currently connected
   wifiSsid?: string;           // Configured WiFi SSID (for prefilling forms)
   gatewayConfigured: boolean;  // true if Gateway server has been configured
-  gatewayConnected?: boolean;  // true if Gateway WebSocket is connected (optional, future)
+  gatewayConnected?: boolean;  // true if Gateway WebSocket is connected
   gatewayServer?: string;      // Configured gateway server URL (for prefilling forms)
   gatewayPort?: number;        // Configured gateway port (for prefilling forms)
+  wakeMode?: 'server' | 'local';  // Where wake words are detected
+  localWakeActive?: boolean;   // true if the on-device wake word detector is running
+  voiceState?: number;         // Firmware VoiceState (TLV protocol only)
+}
+
+/**
+ * Metrics message sent from Mote device to app
+ *
+ * Counters and gauges from the firmware metrics registry, keyed by name.
+ * Over the TLV protocol only changed values are sent; the client merges
+ * them so listeners always see the full set.
+ */
+export interface MoteMetricsMessage {
+  type: 'device.metrics';
+  uptimeMs?: number;                 // Legacy JSON only
+  counters: Record<string, number>;
+  gauges: Record<string, number>;
 }
 
 /**
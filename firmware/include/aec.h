@@ -0,0 +1,79 @@
+#ifndef AEC_H
+#define AEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Acoustic echo canceller
+ *
+ * NLMS adaptive filter that models the speaker -> mic path from the far-end
+ * reference (what was sent to the amp) and subtracts the estimated echo from
+ * the mic signal. The caller aligns the reference so that ref[i] is the
+ * sample that was leaving the speaker when mic[i] was captured; the filter
+ * then covers the acoustic path from there (AEC_FILTER_TAPS long).
+ *
+ * Adaptation freezes during double talk so the near-end talker doesn't
+ * drag the filter off the echo path. Double talk is a Geigel detector,
+ * normalized by the measured speaker -> mic coupling since the amp gain on
+ * this board makes the echo louder than the reference. Onsets the peak
+ * test misses show up as a sudden ERLE drop, and that block's adaptation
+ * is rolled back.
+ *
+ * Portable C++ - no Arduino calls.
+ */
+
+#define AEC_FILTER_TAPS         256     // 16ms of echo path at 16kHz
+#define AEC_STEP_SIZE           0.25f   // NLMS step (0-1): higher converges faster, misadjusts more
+#define AEC_REGULARIZATION      (AEC_FILTER_TAPS * 256.0f)  // Keeps quiet references from blowing up the step
+#define AEC_REF_ACTIVE_PEAK     64      // Far-end peak below this - nothing worth cancelling
+#define AEC_DTD_THRESHOLD       2.0f    // Mic peak this far above the expected echo peak = double talk
+#define AEC_DTD_HANGOVER_MS     80      // Keep adaptation frozen after double talk ends
+#define AEC_NLP_GAIN            0.5f    // Residual echo attenuation while only the far end talks
+
+struct AecStats {
+    float erleDb;           // Echo return loss enhancement (far-end only, smoothed)
+    float couplingGain;     // Speaker -> mic peak ratio estimate
+    bool farEndActive;      // Last block had a reference worth cancelling
+    bool doubleTalk;        // Adaptation currently frozen
+    uint32_t resets;        // Filter resets after divergence
+};
+
+class EchoCanceller {
+public:
+    explicit EchoCanceller(uint32_t sampleRate);
+
+    /**
+     * Cancel echo in place
+     * @param mic Mic samples, replaced with the echo-cancelled signal
+     * @param ref Aligned far-end reference, same length (consecutive blocks
+     *            must continue from each other)
+     * @param count Block length
+     */
+    void process(int16_t* mic, const int16_t* ref, size_t count);
+
+    /** Forget the echo path and reference history */
+    void reset();
+
+    void getStats(AecStats* stats) const;
+
+private:
+    void resetFilter();
+
+    float weights[AEC_FILTER_TAPS];
+    float savedWeights[AEC_FILTER_TAPS];  // Before the current block's adaptation
+    float history[2 * AEC_FILTER_TAPS];   // Mirrored so the window is always contiguous
+    size_t historyPos;
+
+    uint32_t dtdHangoverSamples;
+    uint32_t dtdHangoverLeft;
+    uint32_t lastRefPeak;       // Previous block's reference peak (echo tail spans blocks)
+
+    float couplingGain;
+    float erleDb;
+    bool farEndActive;
+    bool doubleTalk;
+    uint32_t resets;
+};
+
+#endif // AEC_H
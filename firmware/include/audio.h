@@ -2,7 +2,7 @@
 #define AUDIO_H
 
 #include <Arduino.h>
-#include <driver/i2s.h>
+#include "aec.h"
 
 // Microphone pins (INMP441)
 // NOTE: GPIO 33-37 are reserved for PSRAM on ESP32-S3!
@@ -21,12 +21,36 @@
 #define AUDIO_SAMPLE_RATE     16000
 #define AUDIO_BITS_PER_SAMPLE 16
 #define AUDIO_BUFFER_SIZE     1024
-#define AUDIO_DMA_BUF_COUNT   8
+#define AUDIO_DMA_BUF_COUNT   8      // Speaker DMA (the AEC reference spans this queue)
 #define AUDIO_DMA_BUF_LEN     1024
 
-// Voice Activity Detection threshold
-#define VAD_THRESHOLD         50.0f   // Lowered from 500 - mic RMS max ~200 during speech
-#define VAD_HOLDOFF_MS        2000  // Keep streaming for this long after speech stops (2s for natural pauses)
+// Mic DMA geometry per capture mode (see audio_i2s.h). The capture task
+// wakes once per frame, so a frame is both its latency and its wakeup period
+#define AUDIO_RX_LOW_LATENCY_DESC   6
+#define AUDIO_RX_LOW_LATENCY_FRAMES 128    // 8ms frames, 125 wakeups/s - a conversation
+#define AUDIO_RX_POWER_SAVE_DESC    4
+#define AUDIO_RX_POWER_SAVE_FRAMES  512    // 32ms frames, 31 wakeups/s - waiting for a wake word
+
+// Capture pipeline (dedicated I2S reader task feeding a lock-free ring)
+#define AUDIO_CAPTURE_RING_SIZE     16384  // ~1 second at 16kHz (must be a power of two)
+#define AUDIO_CAPTURE_CHUNK         AUDIO_RX_POWER_SAVE_FRAMES  // Largest mic read (one frame)
+#define AUDIO_CAPTURE_TASK_CORE     0      // Keep off the core running loop()/WebSocket
+#define AUDIO_CAPTURE_TASK_PRIORITY 12
+#define AUDIO_PREROLL_HISTORY_SIZE  65536  // ~4 seconds of mic history (must be a power of two)
+#define AUDIO_PREROLL_DEFAULT_MS    500    // Audio kept from before a wake/VAD trigger
+#define AUDIO_PREROLL_MAX_MS        2000   // History also has to cover capture ring lag
+
+// Echo cancellation (mic stays live while the speaker plays, see aec.h)
+#define AUDIO_AEC_DEFAULT_ENABLED   true
+#define AUDIO_AEC_REF_SIZE          16384  // Speaker history (power of two, > TX DMA depth + playback chunk)
+#define AUDIO_AEC_ALIGN_LEAD        32     // Reference runs 2ms early so timing error stays inside the filter
+#define AUDIO_AEC_RESYNC_SAMPLES    48     // Re-align the reference when the clocks disagree by more
+#define AUDIO_ENVELOPE_BLOCK        320    // Playback envelope resolution (20ms)
+#define AUDIO_ENVELOPE_SLOTS        64     // Envelope history in blocks (power of two, > TX DMA depth + playback chunk)
+#define AUDIO_ARRIVAL_STAMPS        64     // Downlink arrival times awaiting playback (power of two)
+
+// Voice Activity Detection (spectral VAD, see vad.h for tuning)
+#define VAD_HOLDOFF_MS        600   // Silence after the VAD's own 240ms hangover before voice.silence
 
 /**
  * Initialize the audio subsystem (microphone and speaker)
@@ -35,13 +59,80 @@
 bool setupAudio();
 
 /**
- * Read audio samples from microphone
+ * Read audio samples from microphone (blocks on I2S DMA)
+ * Used by the capture task - don't call directly once startAudioCaptureTask() has run
  * @param buffer Buffer to store 16-bit samples
  * @param maxSamples Maximum number of samples to read
  * @return Number of samples actually read
  */
 size_t readMicrophoneData(int16_t* buffer, size_t maxSamples);
 
+/**
+ * Start the microphone capture task
+ * Drains I2S continuously into a ring of internal-SRAM pool blocks so mic
+ * samples are never lost while loop() is busy with the network or display.
+ * Call once after setupAudio().
+ */
+void startAudioCaptureTask();
+
+/**
+ * Get number of captured samples waiting to be read
+ * @return Samples available in the capture ring
+ */
+size_t getCapturedSampleCount();
+
+/**
+ * Read captured microphone samples (non-blocking)
+ * Single consumer only - call from one task (loop())
+ * @param buffer Buffer to store 16-bit samples
+ * @param maxSamples Maximum number of samples to read
+ * @return Number of samples actually read (0 if none available)
+ */
+size_t readCapturedAudio(int16_t* buffer, size_t maxSamples);
+
+/**
+ * Discard all captured samples not yet read
+ * Call from the same task that reads captured audio
+ */
+void flushCapturedAudio();
+
+/**
+ * Set how much audio before a trigger readPreRollAudio() returns
+ * @param ms Pre-roll length (clamped to AUDIO_PREROLL_MAX_MS)
+ */
+void setPreRollLength(uint32_t ms);
+
+/**
+ * Get pre-roll length
+ * @return Pre-roll in milliseconds
+ */
+uint32_t getPreRollLength();
+
+/**
+ * Get when the next sample readCapturedAudio() will return was captured
+ * Derived from the mic DMA clock, so it includes time spent in DMA and the
+ * capture ring. Accurate to about one mic DMA frame (8ms, or 32ms in the
+ * power-save geometry - AUDIO_CAPTURE_CHUNK).
+ * @return millis() at capture
+ */
+uint32_t getCaptureTimestampMs();
+
+/**
+ * Copy the pre-roll: the audio just before the next sample readCapturedAudio()
+ * will return, so sending it and then continuing with live reads gives one
+ * gapless stream. Call from the capture reader's task.
+ * @param buffer Buffer of at least maxSamples
+ * @param maxSamples Maximum number of samples to copy
+ * @return Samples copied (less than the pre-roll right after boot/restart)
+ */
+size_t readPreRollAudio(int16_t* buffer, size_t maxSamples);
+
+/**
+ * Get number of samples dropped because the capture ring was full
+ * @return Total samples lost since boot
+ */
+uint32_t getCaptureOverruns();
+
 /**
  * Play audio samples through speaker (immediate, no buffering)
  * @param samples 16-bit PCM samples
@@ -59,6 +150,17 @@ size_t playAudioData(const int16_t* samples, size_t count);
  */
 size_t queueAudioData(const int16_t* samples, size_t count);
 
+/**
+ * Note when the audio about to be queued arrived from the network
+ * Call from the queueAudioData() producer, right before queueing it. The
+ * playback task records arrival -> audible once the first of those samples
+ * goes out (LATENCY_RECEIVE_TO_PLAY, and LATENCY_FIRST_BYTE_TO_SPEAKER for
+ * the first frame of a response).
+ * @param receivedMs millis() when the frame arrived
+ * @param firstOfResponse true for the first frame of a response
+ */
+void markPlaybackArrival(uint32_t receivedMs, bool firstOfResponse);
+
 /**
  * Start buffered audio playback task
  * Call this once after setting up audio
@@ -71,11 +173,46 @@ void startAudioPlaybackTask();
  */
 void finishAudioStream();
 
+/**
+ * Stop buffered playback and drop what is queued, leaving captured audio alone
+ * Call from the task that writes playback audio
+ */
+void clearPlaybackBuffer();
+
 /**
  * Clear audio buffer and stop buffered playback
+ * Also flushes captured audio - call from the task that reads it (loop())
  */
 void clearAudioBuffer();
 
+// Playback jitter buffer statistics
+struct PlaybackStats {
+    uint32_t underruns;          // Underruns since boot
+    uint32_t responseUnderruns;  // Underruns in the current/last response
+    size_t startThreshold;       // Samples buffered before the speaker starts
+    size_t targetLead;           // Samples rebuilt after an underrun
+    size_t buffered;             // Samples currently queued
+    uint32_t lastStartDelayMs;   // First sample queued -> speaker start, last response
+};
+
+/**
+ * Set how many samples must be buffered before playback starts
+ * @param samples Start threshold in samples
+ */
+void setPlaybackStartThreshold(size_t samples);
+
+/**
+ * Set how many samples to rebuild after an underrun before resuming
+ * @param samples Target lead in samples
+ */
+void setPlaybackTargetLead(size_t samples);
+
+/**
+ * Get playback jitter buffer statistics
+ * @param stats Filled with current values
+ */
+void getPlaybackStats(PlaybackStats* stats);
+
 /**
  * Check if buffered audio is currently playing
  * @return true if playing from buffer
@@ -84,12 +221,55 @@ bool isBufferedAudioPlaying();
 
 /**
  * Check if voice activity is detected in audio buffer
+ * Stateful: feed consecutive mic blocks from one task so the noise floor and
+ * hangover track the stream
  * @param samples Audio samples to analyze
  * @param count Number of samples
  * @return true if voice activity detected
  */
 bool detectVoiceActivity(const int16_t* samples, size_t count);
 
+// Echo canceller statistics
+struct EchoStats {
+    bool enabled;            // Cancellation switched on
+    bool aligned;            // Mic and speaker clocks both known (speaker running)
+    float erleDb;            // Echo return loss enhancement (smoothed)
+    float couplingGain;      // Speaker -> mic peak ratio
+    bool doubleTalk;         // Near-end speech over playback
+    uint32_t filterResets;   // Echo path model restarted after divergence
+    uint32_t resyncs;        // Reference re-aligned because the clocks drifted
+};
+
+/**
+ * Enable or disable echo cancellation on the captured audio
+ * The reference comes from the playback task, aligned to the mic using the
+ * I2S DMA timing of both ports.
+ * @param enabled true to cancel speaker echo
+ */
+void setEchoCancellation(bool enabled);
+
+/**
+ * Check if echo cancellation is running
+ * When true the mic can stay live during playback (full duplex)
+ * @return true if enabled and the speaker reference buffer exists
+ */
+bool isEchoCancellationActive();
+
+/**
+ * Get echo canceller statistics
+ * @param stats Filled with current values
+ */
+void getEchoStats(EchoStats* stats);
+
+/**
+ * Get the loudness of the audio leaving the speaker right now
+ * Peak of the 20ms block currently playing, measured after volume/gain
+ * during the gain pass of the playback task. Lock-free, callable from any
+ * task (the face render task polls it for lip-sync).
+ * @return Peak sample magnitude (0-32768), 0 when nothing is playing
+ */
+uint16_t getPlaybackEnvelope();
+
 /**
  * Set speaker volume (0-100)
  * @param volume Volume level
@@ -121,10 +301,17 @@ void stopAudioPlayback();
 bool isAudioPlaying();
 
 /**
- * Restart microphone I2S driver (call after playback to ensure fresh audio)
+ * Start capture afresh (call after playback): drops captured audio and
+ * pre-roll history. The I2S port itself keeps running.
  */
 void restartMicrophone();
 
+/**
+ * Pick the mic DMA geometry: small frames for a conversation, large ones
+ * (fewer wakeups) while idle. Applied by the capture task between reads.
+ */
+void setCaptureLowLatency(bool lowLatency);
+
 /**
  * Enable speaker I2S output (called automatically before playback)
  * Call this manually if you need to pre-enable for immediate playback
@@ -0,0 +1,155 @@
+#ifndef AUDIO_CODEC_H
+#define AUDIO_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Voice audio codecs
+ *
+ * PCM16 is the original raw 16kHz/16-bit stream. IMA-ADPCM is always built in
+ * (4:1, ~66 kbit/s with block headers). Opus is optional: build with
+ * -DMOTE_CODEC_OPUS and the libopus dependency (see the *-opus env in
+ * platformio.ini) for 16-24 kbit/s.
+ *
+ * Compressed streams are carried as length-prefixed packets so a WebSocket
+ * frame may hold any number of whole packets:
+ *   [u16 little-endian payload length][payload]...
+ *
+ * ADPCM payload: [i16 LE predictor][u8 step index][u8 reserved][nibbles...]
+ * (low nibble first). Each block carries its own decoder state, so a lost
+ * frame never corrupts the ones after it.
+ */
+
+enum AudioCodec : uint8_t {
+    AUDIO_CODEC_PCM16 = 0,
+    AUDIO_CODEC_ADPCM = 1,
+    AUDIO_CODEC_OPUS  = 2
+};
+
+#define AUDIO_CODEC_FRAME_SAMPLES   320   // 20ms at 16kHz (one encoder frame)
+#define AUDIO_CODEC_MAX_PACKET      256   // Largest encoded frame we emit
+#define AUDIO_CODEC_MAX_DECODED     1920  // 120ms - largest Opus frame / ADPCM block we accept
+#define AUDIO_CODEC_MAX_RX_PACKET   ADPCM_BLOCK_BYTES(AUDIO_CODEC_MAX_DECODED)
+#define ADPCM_HEADER_BYTES          4
+#define ADPCM_BLOCK_BYTES(samples)  (ADPCM_HEADER_BYTES + ((samples) + 1) / 2)
+
+#ifndef MOTE_OPUS_BITRATE
+#define MOTE_OPUS_BITRATE           16000 // bits/s (16-24k is plenty for ASR)
+#endif
+#ifndef MOTE_OPUS_COMPLEXITY
+#define MOTE_OPUS_COMPLEXITY        3     // Keep encode well under real-time on one core
+#endif
+
+/**
+ * Get the protocol name of a codec ("pcm", "adpcm", "opus")
+ */
+const char* audioCodecName(AudioCodec codec);
+
+/**
+ * Look up a codec by protocol name
+ * @return true if the name is known and the codec is built in
+ */
+bool audioCodecFromName(const char* name, AudioCodec* codec);
+
+/**
+ * Check whether a codec is compiled into this firmware
+ */
+bool audioCodecAvailable(AudioCodec codec);
+
+// ============================================================================
+// IMA-ADPCM
+// ============================================================================
+
+struct AdpcmState {
+    int16_t predictor;
+    uint8_t index;
+};
+
+void adpcmReset(AdpcmState* state);
+
+/**
+ * Encode one block (header + nibbles)
+ * @param state Encoder state, carried across blocks
+ * @param pcm Input samples
+ * @param samples Number of samples
+ * @param out Output buffer of at least ADPCM_BLOCK_BYTES(samples)
+ * @return Bytes written
+ */
+size_t adpcmEncodeBlock(AdpcmState* state, const int16_t* pcm, size_t samples, uint8_t* out);
+
+/**
+ * Decode one block produced by adpcmEncodeBlock()
+ * @param in Block bytes (header + nibbles)
+ * @param bytes Block length
+ * @param out Output buffer of at least (bytes - ADPCM_HEADER_BYTES) * 2 samples
+ * @return Samples written
+ */
+size_t adpcmDecodeBlock(const uint8_t* in, size_t bytes, int16_t* out);
+
+// ============================================================================
+// Frame encoder (codec-independent front end)
+// ============================================================================
+
+struct AudioEncoder {
+    AudioCodec codec;
+    AdpcmState adpcm;
+    void* opus;         // OpusEncoder*, allocated in PSRAM when Opus is used
+};
+
+/**
+ * Prepare an encoder for a codec
+ * @return false if the codec isn't available or allocation failed
+ */
+bool audioEncoderInit(AudioEncoder* encoder, AudioCodec codec);
+
+/**
+ * Reset encoder state (start of a new stream)
+ */
+void audioEncoderReset(AudioEncoder* encoder);
+
+/**
+ * Encode exactly AUDIO_CODEC_FRAME_SAMPLES samples into one packet payload
+ * @param out Output buffer
+ * @param maxOut Size of out (AUDIO_CODEC_MAX_PACKET is always enough)
+ * @return Payload bytes, or 0 on error
+ */
+size_t audioEncoderEncode(AudioEncoder* encoder, const int16_t* frame, uint8_t* out, size_t maxOut);
+
+// ============================================================================
+// Packet decoder (codec-independent front end)
+// ============================================================================
+
+struct AudioDecoder {
+    AudioCodec codec;
+    void* opus;         // OpusDecoder*, allocated in PSRAM when Opus is used
+};
+
+/**
+ * Prepare a decoder for a codec
+ * @return false if the codec isn't available or allocation failed
+ */
+bool audioDecoderInit(AudioDecoder* decoder, AudioCodec codec);
+
+/**
+ * Reset decoder state (start of a new stream)
+ */
+void audioDecoderReset(AudioDecoder* decoder);
+
+/**
+ * Decode one packet payload into PCM
+ * @param out Output buffer
+ * @param maxSamples Size of out (AUDIO_CODEC_MAX_DECODED is always enough)
+ * @return Samples decoded, or 0 on error
+ */
+size_t audioDecoderDecode(AudioDecoder* decoder, const uint8_t* packet, size_t len,
+                          int16_t* out, size_t maxSamples);
+
+/**
+ * Rough media duration of compressed bytes, for arrival-time bookkeeping
+ * before the packets are actually decoded
+ * @return Estimated samples
+ */
+size_t audioCodecEstimateSamples(AudioCodec codec, size_t bytes);
+
+#endif // AUDIO_CODEC_H
@@ -0,0 +1,69 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * PCM kernels for the audio hot loops
+ *
+ * Each kernel has a plain scalar reference (*Ref) that defines its exact
+ * output, and an optimized version that must match it bit for bit (see
+ * test/test_audio_dsp). The optimized versions work two samples per 32-bit
+ * word and unroll by four so the Xtensa core keeps its load/multiply slots
+ * busy. Any alignment and any length are accepted.
+ *
+ * Gain is Q12 fixed point: 4096 = 1.0x, so no divide in the loop.
+ *
+ * Portable C++ - no Arduino calls.
+ */
+
+#define AUDIO_DSP_GAIN_SHIFT    12
+#define AUDIO_DSP_GAIN_UNITY    (1 << AUDIO_DSP_GAIN_SHIFT)
+
+/**
+ * Convert 32-bit I2S samples to 16-bit (keep the upper half, i.e. >> 16)
+ * in and out may not overlap
+ */
+void audioDspS32ToS16(const int32_t* in, int16_t* out, size_t count);
+void audioDspS32ToS16Ref(const int32_t* in, int16_t* out, size_t count);
+
+/**
+ * Saturating gain: out = clamp((in * gainQ12) >> 12)
+ * in and out may be the same buffer
+ */
+void audioDspGain(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12);
+void audioDspGainRef(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12);
+
+/**
+ * audioDspGain() that also returns the peak of the output, in the same pass
+ * (playback envelope for lip-sync at no extra read of the buffer)
+ * in and out may be the same buffer
+ */
+uint32_t audioDspGainPeak(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12);
+uint32_t audioDspGainPeakRef(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12);
+
+/**
+ * Sum of squares
+ */
+uint64_t audioDspEnergy(const int16_t* samples, size_t count);
+uint64_t audioDspEnergyRef(const int16_t* samples, size_t count);
+
+/**
+ * Dot product (cross-correlation tap)
+ */
+int64_t audioDspDot(const int16_t* a, const int16_t* b, size_t count);
+int64_t audioDspDotRef(const int16_t* a, const int16_t* b, size_t count);
+
+/**
+ * Largest absolute sample value (32768 for -32768)
+ */
+uint32_t audioDspPeak(const int16_t* samples, size_t count);
+uint32_t audioDspPeakRef(const int16_t* samples, size_t count);
+
+/**
+ * Convert a 0-100 volume and a x100 software gain to a Q12 gain
+ */
+int32_t audioDspGainFromVolume(uint8_t volume, uint16_t softwareGain);
+
+#endif // AUDIO_DSP_H
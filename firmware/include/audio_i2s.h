@@ -0,0 +1,88 @@
+#ifndef AUDIO_I2S_H
+#define AUDIO_I2S_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * I2S ports for the mic (I2S0, INMP441) and the amp (I2S1, MAX98357A)
+ *
+ * Built on the ESP-IDF i2s_std channel API (IDF 5.1+, Arduino core 3.x),
+ * with the legacy driver/i2s.h driver as a fallback for older cores. The
+ * rest of the audio code only sees this interface:
+ *
+ * - Mic reads are one DMA frame each: the read wakes when that frame
+ *   completes (the i2s_std on_recv callback stamps the completion time;
+ *   the legacy driver's DMA-done queue behaves the same way). A frame is
+ *   both the capture latency and the wakeup period, so the DMA geometry
+ *   can be swapped at runtime (audioI2sMicReconfigure) to trade one
+ *   against the other
+ * - Both ports run off one clock source - the APLL where the chip has one,
+ *   otherwise the 160MHz PLL through the same fractional divider - so the
+ *   mic and speaker frame clocks can't drift apart
+ * - Nothing is torn down between turns: the mic runs continuously and the
+ *   speaker is only started and stopped
+ *
+ * Mic functions belong to the capture task once it runs; speaker writes
+ * belong to the playback task.
+ */
+
+/**
+ * Install the mic port and start it
+ * @param descCount DMA descriptors (frames of history before overrun)
+ * @param frameSamples Samples per DMA frame (per read / per wakeup)
+ */
+bool audioI2sMicBegin(uint16_t descCount, uint16_t frameSamples);
+
+/**
+ * Replace the mic DMA geometry (the port restarts, ~1 frame is lost)
+ */
+bool audioI2sMicReconfigure(uint16_t descCount, uint16_t frameSamples);
+
+/**
+ * Samples per mic DMA frame in the current geometry
+ */
+uint16_t audioI2sMicFrameSamples();
+
+/**
+ * Read the next mic DMA frame (blocks until it completes)
+ * @param out Raw 32-bit INMP441 samples
+ * @param maxSamples Room in out (a smaller read takes part of a frame)
+ * @param doneUs esp_timer time the newest sample arrived if the read had
+ *               to wait for it, 0 if it returned data that was already
+ *               queued (arrival time unknown)
+ * @return Samples read, 0 on error
+ */
+size_t audioI2sMicRead(int32_t* out, size_t maxSamples, int64_t* doneUs);
+
+/**
+ * Drop mic frames already queued (non-blocking)
+ */
+void audioI2sMicDiscard();
+
+/**
+ * Install the amp port, stopped and silent
+ */
+bool audioI2sSpeakerBegin(uint16_t descCount, uint16_t frameSamples);
+
+void audioI2sSpeakerStart();
+
+void audioI2sSpeakerStop();
+
+/**
+ * Replace whatever is queued for the amp with silence
+ */
+void audioI2sSpeakerSilence();
+
+/**
+ * Queue samples for the amp (blocks while the DMA queue is full)
+ * @return Samples written, 0 on error
+ */
+size_t audioI2sSpeakerWrite(const int16_t* samples, size_t count);
+
+/**
+ * "std/apll", "legacy/pll", ... for the boot log
+ */
+const char* audioI2sDescribe();
+
+#endif // AUDIO_I2S_H
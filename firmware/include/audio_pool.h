@@ -0,0 +1,64 @@
+#ifndef AUDIO_POOL_H
+#define AUDIO_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Audio block pool
+ *
+ * Every streaming audio buffer (playback, capture, KWS, codec rings) is a
+ * BlockRing made of fixed-size blocks from here instead of one big
+ * allocation sized for the worst case. A ring only holds the blocks its
+ * current fill level needs, so a 60s response takes PSRAM while it plays and
+ * gives it back when it's done.
+ *
+ * - AUDIO_POOL_INTERNAL: DMA-capable internal SRAM for the hot paths that
+ *   run every few ms (mic capture, KWS feed). Falls back to PSRAM when it
+ *   reaches its cap or internal RAM runs out
+ * - AUDIO_POOL_PSRAM: bulk buffering (playback lead, downlink packets,
+ *   uplink encoder queue)
+ *
+ * Pools grow on demand with heap_caps_malloc(). A released block goes on a
+ * free list; past AUDIO_POOL_*_SPARE spare blocks it goes back to the heap.
+ * Blocks in use and their high-water marks are published as metrics.
+ *
+ * Any task may allocate and release. The free list is a spinlock-guarded
+ * push/pop; the heap is only touched outside the lock.
+ */
+
+#define AUDIO_POOL_BLOCK_BYTES        4096   // 2048 samples (128ms), power of two
+#define AUDIO_POOL_INTERNAL_MAX       16     // 64KB internal SRAM at most
+#define AUDIO_POOL_INTERNAL_SPARE     4
+#define AUDIO_POOL_PSRAM_MAX          768    // 3MB - every ring at its ceiling at once
+#define AUDIO_POOL_PSRAM_SPARE        16     // Keep 64KB warm between responses
+
+enum AudioPoolKind : uint8_t {
+    AUDIO_POOL_INTERNAL,
+    AUDIO_POOL_PSRAM,
+    AUDIO_POOL_KIND_COUNT
+};
+
+struct AudioPoolStats {
+    uint32_t inUse;          // Blocks handed out
+    uint32_t spare;          // Allocated, on the free list
+    uint32_t peakInUse;      // High-water mark since boot
+    uint32_t allocFailures;  // Requests refused (cap reached or heap exhausted)
+};
+
+/**
+ * Take a block (AUDIO_POOL_BLOCK_BYTES, word aligned, not zeroed)
+ * @return nullptr if the pool is at its cap and the heap can't help
+ */
+void* audioPoolAlloc(AudioPoolKind kind);
+
+/**
+ * Return a block to the pool it came from (nullptr is ignored)
+ */
+void audioPoolFree(void* block);
+
+void getAudioPoolStats(AudioPoolKind kind, AudioPoolStats* stats);
+
+const char* audioPoolName(AudioPoolKind kind);
+
+#endif // AUDIO_POOL_H
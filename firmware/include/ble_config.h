@@ -2,18 +2,27 @@
 #define BLE_CONFIG_H
 
 #include <Arduino.h>
-#include <BLEDevice.h>
-#include <BLEServer.h>
-#include <BLEUtils.h>
-#include <BLE2902.h>
+#include <NimBLEDevice.h>
 
 /**
  * BLE Configuration Service
  *
  * Provides BLE characteristics for device configuration via mobile app:
- * - Status characteristic: Device info, battery level (read + notify)
+ * - Status characteristic: Device info, battery level, metrics (read + notify)
  * - Config characteristic: WiFi credentials, gateway settings (write)
  *
+ * Apps that write a HELLO frame get the binary TLV protocol (ble_protocol.h):
+ * status and metrics notified on change, only the fields that changed, split
+ * to the negotiated MTU. Other apps get the original JSON messages.
+ *
+ * Runs on NimBLE (peripheral role only, one connection) and stays up next to
+ * Wi-Fi for the whole session. During a conversation (listening, processing,
+ * speaking) setBleVoiceSessionActive() hands the radio to Wi-Fi: coexistence
+ * prefers Wi-Fi (IDF 4.x), the app's connection interval is stretched and
+ * advertising slows to about once a second. Config writes are applied live - volume and
+ * wake mode locally, network settings through the BleNetworkConfigCallback;
+ * only without a callback does a network change still reboot.
+ *
  * Service UUID: 4fafc201-1fb5-459e-8fcc-c5c9c331914b
  * Status UUID:  beb5483e-36e1-4688-b7f5-ea07361b26a8
  * Config UUID:  beb5483e-36e1-4688-b7f5-ea07361b26a9
@@ -27,18 +36,63 @@
 // BLE device name
 #define BLE_DEVICE_NAME         "Mote"
 
+#define BLE_STATUS_POLL_MS      100     // Change check; changes inside one poll share a notification
+#define BLE_METRICS_POLL_MS     1000    // Binary peers - changed metrics only
+#define BLE_BATTERY_POLL_MS     10000   // Battery ADC read
+#define BLE_BATTERY_MV_STEP     20      // Smaller moves aren't reported (ADC noise)
+
+// Connection interval (1.25ms units) and supervision timeout (10ms units),
+// within Apple's accessory limits
+#define BLE_CONN_FAST_MIN       12      // 15ms - app open, nothing streaming
+#define BLE_CONN_FAST_MAX       24      // 30ms
+#define BLE_CONN_VOICE_MIN      96      // 120ms - voice session, Wi-Fi gets the air time
+#define BLE_CONN_VOICE_MAX      128     // 160ms
+#define BLE_CONN_TIMEOUT        400     // 4s
+
+// Advertising interval (0.625ms units)
+#define BLE_ADV_FAST_MIN        160     // 100ms
+#define BLE_ADV_FAST_MAX        240     // 150ms
+#define BLE_ADV_VOICE_MIN       1636    // 1022.5ms (an Apple-recommended interval)
+#define BLE_ADV_VOICE_MAX       1800    // 1125ms
+
+/**
+ * Network settings after a config write changed them (already saved to NVS).
+ * The strings stay valid until the next write.
+ */
+struct BleNetworkConfig {
+    const char* wifiSsid;
+    const char* wifiPassword;
+    const char* gatewayServer;
+    uint16_t gatewayPort;
+    const char* gatewayToken;
+    const char* gatewayList;    // Fallback gateways, comma-separated
+    bool wifiChanged;       // SSID or password
+    bool gatewayChanged;    // Server, port, token or fallback list
+};
+
+typedef void (*BleNetworkConfigCallback)(const BleNetworkConfig& config);
+
 // Initialize BLE config service
 void setupBleConfig();
 
 // Handle BLE events in loop()
 void handleBleConfig();
 
-// Send device status update via BLE notification
+// Notify status changes now instead of at the next poll
 void sendBleStatus();
 
+// Notify counters and gauges (binary: the changed ones; legacy: device.metrics JSON)
+void sendBleMetrics();
+
 // Check if BLE client is connected
 bool isBleConnected();
 
+// Apply network config writes live (loop task) instead of rebooting
+void setBleNetworkConfigCallback(BleNetworkConfigCallback callback);
+
+// Favor Wi-Fi on the shared radio while a voice session is active (loop task)
+void setBleVoiceSessionActive(bool active);
+
 // Battery monitoring (forward declarations)
 extern float getMoteBatteryVoltage();
 extern int getMoteBatteryPercent();
@@ -0,0 +1,240 @@
+#ifndef BLE_PROTOCOL_H
+#define BLE_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gateway_select.h"
+
+/**
+ * Binary status/config protocol for the BLE config service
+ *
+ * Every characteristic value is one frame:
+ *   [version u8][type u8][flags u8] then TLVs [tag u8][length u8][value]
+ * Integers are little-endian, strings UTF-8 without a terminator. Readers
+ * skip tags they don't know, so either side can add fields without a
+ * version bump; BLE_PROTOCOL_VERSION changes only when a tag's meaning does.
+ *
+ * The app opts in by writing a HELLO frame to the config characteristic;
+ * until then the connection speaks the legacy JSON (older apps keep working).
+ * After HELLO the device notifies STATUS and METRICS frames carrying only
+ * the values that changed since the last notification. One update that
+ * doesn't fit the negotiated MTU is split across notifications on TLV
+ * boundaries - every notification parses on its own, BLE_FLAG_MORE marks
+ * all but the last. The status characteristic's read value is always the
+ * full STATUS snapshot.
+ *
+ * Portable C++ - no Arduino or BLE calls, so it also builds on the host.
+ */
+
+#define BLE_PROTOCOL_VERSION  1
+#define BLE_MTU_MAX           517     // ATT MTU offered to the phone
+#define BLE_MTU_DEFAULT       23      // Until the phone negotiates
+#define BLE_ATT_OVERHEAD      3       // Notification payload is MTU - 3
+#define BLE_VALUE_MAX         512     // Largest attribute value (read / long write)
+#define BLE_FRAME_HEADER      3
+#define BLE_TLV_HEADER        2
+
+enum BleMessageType : uint8_t {
+    BLE_MSG_HELLO   = 0x01,     // App -> device: switch this connection to TLV
+    BLE_MSG_STATUS  = 0x02,     // Device -> app
+    BLE_MSG_METRICS = 0x03,     // Device -> app
+    BLE_MSG_CONFIG  = 0x04,     // App -> device
+    BLE_MSG_ACK     = 0x05      // Device -> app: result of a CONFIG write
+};
+
+#define BLE_FLAG_FULL         0x01    // Snapshot - every field is present
+#define BLE_FLAG_MORE         0x02    // More notifications of this update follow
+#define BLE_FLAG_READ_FULL    0x04    // A value didn't fit the MTU - read the characteristic
+
+enum BleStatusTag : uint8_t {
+    BLE_STATUS_DEVICE_ID          = 0x01,   // 6 bytes, Wi-Fi STA MAC
+    BLE_STATUS_FIRMWARE           = 0x02,   // String
+    BLE_STATUS_BATTERY_PERCENT    = 0x03,   // u8
+    BLE_STATUS_BATTERY_MV         = 0x04,   // u16
+    BLE_STATUS_VOLUME             = 0x05,   // u8, 0-100
+    BLE_STATUS_WAKE_MODE          = 0x06,   // u8 WakeMode
+    BLE_STATUS_LOCAL_WAKE_ACTIVE  = 0x07,   // u8 bool
+    BLE_STATUS_WIFI_CONFIGURED    = 0x08,   // u8 bool
+    BLE_STATUS_WIFI_CONNECTED     = 0x09,   // u8 bool
+    BLE_STATUS_WIFI_SSID          = 0x0A,   // String
+    BLE_STATUS_GATEWAY_CONFIGURED = 0x0B,   // u8 bool
+    BLE_STATUS_GATEWAY_CONNECTED  = 0x0C,   // u8 bool
+    BLE_STATUS_GATEWAY_SERVER     = 0x0D,   // String
+    BLE_STATUS_GATEWAY_PORT       = 0x0E,   // u16
+    BLE_STATUS_IP_MODE            = 0x0F,   // u8 IpMode
+    BLE_STATUS_VOICE_STATE        = 0x10    // u8 VoiceState
+};
+
+enum BleConfigTag : uint8_t {
+    BLE_CONFIG_WIFI_SSID          = 0x01,   // String - any of the first five
+    BLE_CONFIG_WIFI_PASSWORD      = 0x02,   // String   saves the network config
+    BLE_CONFIG_GATEWAY_SERVER     = 0x03,   // String   and applies it live
+    BLE_CONFIG_GATEWAY_PORT       = 0x04,   // u16
+    BLE_CONFIG_GATEWAY_TOKEN      = 0x05,   // String
+    BLE_CONFIG_VOLUME             = 0x06,   // u8, 0-100
+    BLE_CONFIG_WAKE_MODE          = 0x07,   // u8 WakeMode
+    BLE_CONFIG_IP_MODE            = 0x08,   // u8 IpMode, next boot
+    BLE_CONFIG_GATEWAY_LIST       = 0x09    // String, fallback gateways (network config)
+};
+
+enum BleAckTag : uint8_t {
+    BLE_ACK_RESULT                = 0x01,   // u8 BleAckResult
+    BLE_ACK_REBOOTING             = 0x02    // u8 bool
+};
+
+enum BleAckResult : uint8_t {
+    BLE_ACK_OK                    = 0,
+    BLE_ACK_MALFORMED             = 1,      // Bad header, version or TLV framing
+    BLE_ACK_BAD_VALUE             = 2,      // A value out of range or too long
+    BLE_ACK_BUSY                  = 3       // Previous write still being applied
+};
+
+// METRICS tags: counters are their MetricId, gauges 0x80 + (id - METRIC_FIRST_GAUGE),
+// values u32 - so a metric appended to either section never renumbers the other
+#define BLE_METRIC_GAUGE_TAG  0x80
+
+/**
+ * Everything the STATUS frame reports, compared field by field for deltas
+ */
+struct BleStatus {
+    uint8_t deviceId[6];
+    char firmware[16];
+    uint8_t batteryPercent;
+    uint16_t batteryMv;
+    uint8_t volume;
+    uint8_t wakeMode;
+    bool localWakeActive;
+    bool wifiConfigured;
+    bool wifiConnected;
+    char wifiSsid[33];
+    bool gatewayConfigured;
+    bool gatewayConnected;
+    char gatewayServer[128];
+    uint16_t gatewayPort;
+    uint8_t ipMode;
+    uint8_t voiceState;
+};
+
+#define BLE_CONFIG_HAS_WIFI_SSID       (1u << BLE_CONFIG_WIFI_SSID)
+#define BLE_CONFIG_HAS_WIFI_PASSWORD   (1u << BLE_CONFIG_WIFI_PASSWORD)
+#define BLE_CONFIG_HAS_GATEWAY_SERVER  (1u << BLE_CONFIG_GATEWAY_SERVER)
+#define BLE_CONFIG_HAS_GATEWAY_PORT    (1u << BLE_CONFIG_GATEWAY_PORT)
+#define BLE_CONFIG_HAS_GATEWAY_TOKEN   (1u << BLE_CONFIG_GATEWAY_TOKEN)
+#define BLE_CONFIG_HAS_VOLUME          (1u << BLE_CONFIG_VOLUME)
+#define BLE_CONFIG_HAS_WAKE_MODE       (1u << BLE_CONFIG_WAKE_MODE)
+#define BLE_CONFIG_HAS_IP_MODE         (1u << BLE_CONFIG_IP_MODE)
+#define BLE_CONFIG_HAS_GATEWAY_LIST    (1u << BLE_CONFIG_GATEWAY_LIST)
+#define BLE_CONFIG_NETWORK_MASK        (BLE_CONFIG_HAS_WIFI_SSID | BLE_CONFIG_HAS_WIFI_PASSWORD | \
+                                        BLE_CONFIG_HAS_GATEWAY_SERVER | BLE_CONFIG_HAS_GATEWAY_PORT | \
+                                        BLE_CONFIG_HAS_GATEWAY_TOKEN | BLE_CONFIG_HAS_GATEWAY_LIST)
+
+/**
+ * A CONFIG write, decoded. Only fields flagged in `present` were sent;
+ * buffer sizes match the ones ble_config stores them in.
+ */
+struct BleConfig {
+    uint32_t present;           // BLE_CONFIG_HAS_* bits
+    char wifiSsid[32];
+    char wifiPassword[64];
+    char gatewayServer[128];
+    uint16_t gatewayPort;
+    char gatewayToken[128];
+    char gatewayList[GATEWAY_LIST_SIZE];
+    uint8_t volume;
+    uint8_t wakeMode;
+    uint8_t ipMode;
+};
+
+/**
+ * Receives each finished frame
+ */
+typedef void (*BleFrameSink)(const uint8_t* frame, size_t length, void* context);
+
+/**
+ * Packs TLVs into frames of at most `payloadLimit` bytes, handing each to
+ * the sink as it fills. Nothing is sent if nothing was added.
+ */
+class BleFrameWriter {
+public:
+    /**
+     * @param payloadLimit Bytes per frame (MTU - 3 for notifications,
+     *                     BLE_VALUE_MAX for a characteristic value)
+     */
+    BleFrameWriter(BleMessageType type, uint8_t flags, size_t payloadLimit, BleFrameSink sink, void* context);
+
+    void addU8(uint8_t tag, uint8_t value);
+    void addU16(uint8_t tag, uint16_t value);
+    void addU32(uint8_t tag, uint32_t value);
+    void addString(uint8_t tag, const char* value);
+    void addBytes(uint8_t tag, const void* value, size_t length);
+
+    /**
+     * Send the last frame
+     * @return Frames sent for this update
+     */
+    size_t finish();
+
+    /** A TLV was dropped for not fitting an empty frame (BLE_FLAG_READ_FULL sent) */
+    bool dropped() const { return droppedAny; }
+
+private:
+    void flush(bool more);
+
+    uint8_t frame[BLE_VALUE_MAX];
+    size_t used;
+    size_t limit;
+    uint8_t type;
+    uint8_t flags;
+    BleFrameSink sink;
+    void* context;
+    size_t framesSent;
+    bool droppedAny;
+};
+
+/**
+ * Iterates the TLVs of one received frame
+ */
+class BleFrameReader {
+public:
+    /**
+     * @return false if the header is short or from another protocol version
+     */
+    bool begin(const uint8_t* data, size_t length);
+
+    BleMessageType type() const { return (BleMessageType)data[1]; }
+    uint8_t flags() const { return data[2]; }
+
+    /**
+     * Step to the next TLV
+     * @return false at the end, or if a TLV runs past the frame (malformed())
+     */
+    bool next(uint8_t* tag, const uint8_t** value, uint8_t* length);
+
+    bool malformed() const { return bad; }
+
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+    bool bad;
+};
+
+/**
+ * Write the STATUS fields that differ from `previous` (all of them if null)
+ */
+void bleEncodeStatus(const BleStatus& status, const BleStatus* previous, BleFrameWriter* writer);
+
+/**
+ * Write the METRICS values that differ from `previous` (all if null)
+ * @param firstGauge METRIC_FIRST_GAUGE
+ */
+void bleEncodeMetrics(const uint32_t* values, const uint32_t* previous, size_t count, size_t firstGauge,
+                      BleFrameWriter* writer);
+
+/**
+ * Decode a CONFIG frame
+ * @return BLE_ACK_OK, or why the write was refused (nothing is applied then)
+ */
+BleAckResult bleDecodeConfig(const uint8_t* data, size_t length, BleConfig* config);
+
+#endif // BLE_PROTOCOL_H
@@ -0,0 +1,234 @@
+#ifndef BLOCK_RING_H
+#define BLOCK_RING_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "audio_pool.h"
+
+/**
+ * Single-producer / single-consumer ring backed by audio pool blocks
+ *
+ * Same contract and API as SpscRing (free-running counters, one writer task,
+ * one reader task, no mutex), but the storage is a table of
+ * AUDIO_POOL_BLOCK_BYTES blocks taken from the pool as the producer reaches
+ * them and handed back as the consumer finishes them. The capacity is only
+ * a ceiling: an idle ring holds a single block.
+ *
+ * The block table has twice as many slots as the capacity needs, so the
+ * slot the producer fills is never one the consumer still owns. A write
+ * that can't get a block returns short, just like a full ring.
+ */
+template <typename T>
+class BlockRing {
+public:
+    static const size_t BLOCK_ELEMENTS = AUDIO_POOL_BLOCK_BYTES / sizeof(T);
+
+    BlockRing() : blocks(nullptr), slotMask(0), capacity(0), kind(AUDIO_POOL_PSRAM),
+                  head(0), tail(0) {}
+
+    /**
+     * Set the ceiling and pool. Not thread-safe - call before either side
+     * starts. Re-initialising releases whatever the ring still holds.
+     * @param size Capacity in elements (a power of two, at least one block)
+     * @return false if size is invalid or the block table can't be allocated
+     */
+    bool init(AudioPoolKind pool, size_t size) {
+        static_assert((BLOCK_ELEMENTS & (BLOCK_ELEMENTS - 1)) == 0,
+                      "block must hold a power-of-two number of elements");
+        if (size < BLOCK_ELEMENTS || (size & (size - 1)) != 0) {
+            return false;
+        }
+
+        size_t slots = 2 * size / BLOCK_ELEMENTS;
+        if (blocks != nullptr && slotMask + 1 != slots) {
+            releaseAll();
+            free(blocks);
+            blocks = nullptr;
+        }
+        if (blocks == nullptr) {
+            blocks = (T**)calloc(slots, sizeof(T*));
+            if (blocks == nullptr) return false;
+        } else {
+            releaseAll();
+        }
+
+        kind = pool;
+        capacity = size;
+        slotMask = slots - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool isReady() const { return blocks != nullptr; }
+    size_t size() const { return capacity; }
+
+    /** Elements available to read (safe from either side) */
+    size_t available() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /** Free space for writing (safe from either side) */
+    size_t freeSpace() const {
+        return capacity - available();
+    }
+
+    /**
+     * Producer: copy up to `count` elements in, taking blocks as needed
+     * @return Number of elements actually written (short if full or the
+     *         pool is exhausted)
+     */
+    size_t write(const T* data, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t space = capacity - (h - t);
+        if (count > space) count = space;
+
+        size_t written = 0;
+        while (written < count) {
+            T*& block = blocks[slotOf(h)];
+            if (block == nullptr) {
+                block = (T*)audioPoolAlloc(kind);
+                if (block == nullptr) break;
+            }
+            size_t offset = h & (BLOCK_ELEMENTS - 1);
+            size_t span = BLOCK_ELEMENTS - offset;
+            if (span > count - written) span = count - written;
+            memcpy(block + offset, data + written, span * sizeof(T));
+            written += span;
+            h += span;
+        }
+
+        head.store(h, std::memory_order_release);
+        return written;
+    }
+
+    /**
+     * Producer: write all `count` elements or none (whole packets, so the
+     * consumer never sees a partial one)
+     * @return false if there isn't room or the pool can't supply the blocks
+     */
+    bool writeAll(const T* data, size_t count) {
+        if (freeSpace() < count) return false;
+
+        // Take every block first; any already taken stay for the next write
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t needed = ((h & (BLOCK_ELEMENTS - 1)) + count + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS;
+        for (size_t i = 0; i < needed; i++) {
+            T*& block = blocks[slotOf(h + i * BLOCK_ELEMENTS)];
+            if (block == nullptr) {
+                block = (T*)audioPoolAlloc(kind);
+                if (block == nullptr) return false;
+            }
+        }
+        return write(data, count) == count;
+    }
+
+    /**
+     * Consumer: copy up to `count` elements out, releasing finished blocks
+     * @return Number of elements actually read
+     */
+    size_t read(T* out, size_t count) {
+        size_t n = peek(out, count);
+        advance(n);
+        return n;
+    }
+
+    /**
+     * Consumer: copy up to `count` elements out without consuming them
+     * @return Number of elements copied
+     */
+    size_t peek(T* out, size_t count) const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t avail = h - t;
+        if (count > avail) count = avail;
+
+        size_t copied = 0;
+        while (copied < count) {
+            const T* block = blocks[slotOf(t)];
+            size_t offset = t & (BLOCK_ELEMENTS - 1);
+            size_t span = BLOCK_ELEMENTS - offset;
+            if (span > count - copied) span = count - copied;
+            memcpy(out + copied, block + offset, span * sizeof(T));
+            copied += span;
+            t += span;
+        }
+        return count;
+    }
+
+    /**
+     * Consumer: drop up to `count` elements without copying
+     * @return Number of elements dropped
+     */
+    size_t skip(size_t count) {
+        size_t avail = available();
+        if (count > avail) count = avail;
+        advance(count);
+        return count;
+    }
+
+    /** Consumer: drop everything currently buffered */
+    void discardAll() {
+        advance(available());
+    }
+
+    /**
+     * Consumer: drop everything written before `mark` (a value previously
+     * returned by writeIndex() on the producer side). Data written after the
+     * mark is kept, so a producer can request a flush without racing itself.
+     */
+    void discardTo(size_t mark) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if ((ptrdiff_t)(mark - t) > 0) {
+            advance(mark - t);
+        }
+    }
+
+    /** Free-running write counter (total elements ever written) */
+    size_t writeIndex() const { return head.load(std::memory_order_acquire); }
+
+    /** Free-running read counter (total elements ever read) */
+    size_t readIndex() const { return tail.load(std::memory_order_acquire); }
+
+private:
+    size_t slotOf(size_t index) const {
+        return (index / BLOCK_ELEMENTS) & slotMask;
+    }
+
+    /**
+     * Consumer: move the tail on by n, handing back every block it leaves.
+     * Blocks are released before the tail is published, so the producer
+     * can only reach their slots again once they are empty.
+     */
+    void advance(size_t n) {
+        if (n == 0) return;
+        size_t t = tail.load(std::memory_order_relaxed);
+        // Block boundaries crossed (counted this way so index wrap is harmless)
+        size_t finished = ((t & (BLOCK_ELEMENTS - 1)) + n) / BLOCK_ELEMENTS;
+        for (size_t i = 0; i < finished; i++) {
+            T*& block = blocks[slotOf(t + i * BLOCK_ELEMENTS)];
+            audioPoolFree(block);
+            block = nullptr;
+        }
+        tail.store(t + n, std::memory_order_release);
+    }
+
+    void releaseAll() {
+        for (size_t i = 0; i <= slotMask; i++) {
+            audioPoolFree(blocks[i]);
+            blocks[i] = nullptr;
+        }
+    }
+
+    T** blocks;
+    size_t slotMask;
+    size_t capacity;
+    AudioPoolKind kind;
+    std::atomic<size_t> head;   // Written only by the producer
+    std::atomic<size_t> tail;   // Written only by the consumer
+};
+
+#endif // BLOCK_RING_H
@@ -0,0 +1,101 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <Arduino.h>
+
+/**
+ * ST7789V display backend (ESP-IDF spi_master, DMA)
+ *
+ * Pixels go out in line "bands" held in DMA-capable RAM. There are two band
+ * buffers, so the caller fills one while the other is still being clocked
+ * out, and every transfer is queued with spi_device_queue_trans() - nothing
+ * here busy-waits on the bus. DC is driven from the transaction pre-callback
+ * and CS by the SPI peripheral.
+ *
+ * Band pixels are RGB565 already byte-swapped for the wire (see
+ * displaySwap()), so no per-pixel work happens at transfer time.
+ *
+ * Single writer: only one task may draw.
+ */
+
+// Pin definitions (from docs/display.md)
+#define TFT_MOSI  11
+#define TFT_SCLK  13
+#define TFT_CS    10
+#define TFT_DC    9
+#define TFT_RST   14
+#define TFT_BL    8
+
+// Display dimensions (landscape mode: 320x240)
+#define DISPLAY_WIDTH         320
+#define DISPLAY_HEIGHT        240
+
+#define DISPLAY_SPI_HOST      SPI3_HOST   // Same bus the Arduino HSPI instance used
+#define DISPLAY_SPI_HZ        40000000    // GPIO-matrix pins (SCLK isn't on the IOMUX pin) - 40MHz max
+#define DISPLAY_BAND_LINES    20          // Full-width lines per band buffer (12.8KB each)
+#define DISPLAY_BAND_PIXELS   (DISPLAY_WIDTH * DISPLAY_BAND_LINES)
+#define DISPLAY_QUEUE_DEPTH   16          // Transactions in flight (window setup + band chunks)
+
+// Backlight PWM (LEDC) - high enough that the dimmed panel doesn't whine or flicker
+#define DISPLAY_BL_TIMER      LEDC_TIMER_0
+#define DISPLAY_BL_CHANNEL    LEDC_CHANNEL_0
+#define DISPLAY_BL_HZ         20000
+
+/**
+ * RGB565 -> wire order (the panel takes the high byte first)
+ */
+static inline uint16_t displaySwap(uint16_t color) {
+  return (uint16_t)((color << 8) | (color >> 8));
+}
+
+/**
+ * Reset and initialize the panel
+ * @return true if the SPI bus and band buffers were set up
+ */
+bool displayInit();
+
+/**
+ * Queue a command with up to 4 parameter bytes
+ */
+void displayCommand(uint8_t cmd, const uint8_t* data = nullptr, size_t len = 0);
+
+/**
+ * Open a window for pixel data (CASET/RASET/RAMWR)
+ * The next w*h pixels submitted fill it left to right, top to bottom.
+ */
+void displaySetWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+/**
+ * Get a band buffer to render into (DISPLAY_BAND_PIXELS long)
+ * Waits only if the buffer's previous transfer hasn't finished yet.
+ */
+uint16_t* displayAcquireBand();
+
+/**
+ * Queue the first `pixels` pixels of an acquired band for transfer
+ * The buffer must not be touched again until it's acquired again.
+ */
+void displaySubmitBand(uint16_t* band, size_t pixels);
+
+/**
+ * Fill a rectangle with one color (clipped to the screen)
+ */
+void displayFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+/**
+ * Wait until every queued transfer has completed
+ */
+void displayWait();
+
+/**
+ * Set the backlight
+ */
+void displayBacklight(bool on);
+
+/**
+ * Dim the backlight
+ * @param percent 0 (off) to 100; perceptual, duty is percent squared
+ */
+void displayBrightness(uint8_t percent);
+
+#endif // DISPLAY_H
@@ -0,0 +1,80 @@
+#ifndef FACE_SCENE_H
+#define FACE_SCENE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Retained scene for the face display
+ *
+ * The screen is described as a fixed set of elements (eyes, pupils, mouth,
+ * status glyphs), each a short list of solid rectangles painted in element
+ * order over a background color. Drawing code edits a scene and hands it
+ * to sceneCompose() with the scene currently on the panel. Only elements
+ * that changed are redrawn: the old and new bounding box of each one is
+ * marked dirty, overlapping dirty rects are merged, and each merged rect is
+ * rendered once, background and all overlapping elements together, into
+ * display bands. No pixel is cleared and then painted again, so nothing
+ * flickers.
+ */
+
+#define SCENE_MAX_RECTS   12   // Rectangles per element (the GW glyph needs 10)
+#define SCENE_MAX_DIRTY   8    // Merged dirty rects per compose
+
+enum SceneElementId {
+  // Paint order: later elements cover earlier ones
+  SCENE_LEFT_EYE,
+  SCENE_RIGHT_EYE,
+  SCENE_LEFT_PUPIL,
+  SCENE_RIGHT_PUPIL,
+  SCENE_MOUTH,
+  SCENE_WIFI,
+  SCENE_GATEWAY,
+  SCENE_BATTERY,
+  SCENE_ELEMENT_COUNT
+};
+
+struct SceneRect {
+  int16_t x, y, w, h;
+  uint16_t color;   // RGB565
+};
+
+struct SceneElement {
+  uint8_t count;
+  SceneRect rects[SCENE_MAX_RECTS];
+};
+
+struct FaceScene {
+  uint16_t background;
+  SceneElement elements[SCENE_ELEMENT_COUNT];
+};
+
+/**
+ * Empty scene (every element hidden)
+ */
+void sceneInit(FaceScene* scene, uint16_t background);
+
+/**
+ * Remove all rectangles from an element
+ */
+void sceneClearElement(FaceScene* scene, SceneElementId id);
+
+/**
+ * Append a rectangle to an element (ignored once it's full)
+ */
+void sceneAddRect(FaceScene* scene, SceneElementId id, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+/**
+ * Make an element a single rectangle
+ */
+void sceneSetRect(FaceScene* scene, SceneElementId id, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+/**
+ * Redraw what differs between the scene on the panel and the next one
+ * @param shown Scene currently on the panel (nullptr = unknown, redraw all)
+ * @param next Scene to show
+ * @return Pixels sent
+ */
+uint32_t sceneCompose(const FaceScene* shown, const FaceScene* next);
+
+#endif // FACE_SCENE_H
@@ -0,0 +1,56 @@
+#ifndef FAST_CONNECT_H
+#define FAST_CONNECT_H
+
+#include <Arduino.h>
+
+/**
+ * Fast Wi-Fi reconnect
+ *
+ * A full connect scans every channel for the SSID and then waits on DHCP.
+ * Neither is needed on the usual boot, which goes back to the network it
+ * was on last time. On every successful connect, the AP's BSSID and channel
+ * and the IP lease are cached in NVS. The next boot then:
+ *
+ * - joins that BSSID on that channel directly (no scan)
+ * - with IP_MODE_CACHED, also reuses the cached address as a static
+ *   config (no DHCP round trips). Only for networks where the address is
+ *   reserved for the device - nothing here checks the lease is still ours
+ *
+ * If the cached AP doesn't answer within FAST_CONNECT_TIMEOUT_MS (moved,
+ * switched off, different channel), the cache is dropped and a normal
+ * scan + DHCP connect follows. WiFi.begin() never blocks: association runs
+ * in the Wi-Fi task while setup() brings up the display and audio.
+ */
+
+#define FAST_CONNECT_TIMEOUT_MS   3000   // Cached AP attempt before a full scan
+
+// NVS keys (namespace "mote")
+#define FAST_CONNECT_PREF_IP_MODE "ip_mode"
+
+enum IpMode : uint8_t {
+    IP_MODE_DHCP = 0,       // Always ask DHCP
+    IP_MODE_CACHED = 1      // Reuse the last lease as a static address
+};
+
+/**
+ * Start connecting (non-blocking)
+ */
+void startFastConnect(const char* ssid, const char* password, IpMode ipMode);
+
+/**
+ * Fall back to a full connect if the cached AP is gone; cache a new
+ * connection (loop())
+ */
+void handleFastConnect();
+
+/**
+ * Forget the cached AP and lease (the network config changed)
+ */
+void clearFastConnectCache();
+
+/**
+ * ms from boot to the first WL_CONNECTED (0 until then)
+ */
+uint32_t getFastConnectTimeMs();
+
+#endif // FAST_CONNECT_H
@@ -0,0 +1,137 @@
+#ifndef GATEWAY_SELECT_H
+#define GATEWAY_SELECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Gateway endpoint list, ranking and reconnect backoff
+ *
+ * The device knows its primary gateway (gw_server/gw_port) plus an optional
+ * comma-separated list of others (gw_list), each "[ws://|wss://]host[:port]".
+ * Endpoints are ranked by measured round trip time (the lowest RTT wins,
+ * unmeasured ones follow in list order, unreachable ones come last) and
+ * every endpoint carries its own exponential backoff:
+ *
+ * - A failed attempt, or a session shorter than GATEWAY_STABLE_MS, doubles
+ *   that endpoint's delay from GATEWAY_BACKOFF_BASE_MS up to
+ *   GATEWAY_BACKOFF_MAX_MS, drawn from its upper half (equal jitter)
+ * - After any loss, nothing is tried for a random 0..GATEWAY_FAILOVER_JITTER_MS,
+ *   so a fleet dropped by a restarting gateway spreads over the others
+ *   instead of arriving at once
+ *
+ * Without a scheme, ws:// is used for local addresses (RFC1918, loopback,
+ * link-local, "localhost") and wss:// for everything else.
+ *
+ * Pure arithmetic on caller-supplied times and random numbers - no timers
+ * or Arduino calls.
+ */
+
+#define GATEWAY_MAX_ENDPOINTS       4
+#define GATEWAY_HOST_SIZE           128
+#define GATEWAY_LIST_SIZE           256     // Provisioned list (one BLE TLV)
+#define GATEWAY_BACKOFF_BASE_MS     2000
+#define GATEWAY_BACKOFF_MAX_MS      60000
+#define GATEWAY_FAILOVER_JITTER_MS  2000    // Spread before any attempt after a loss
+#define GATEWAY_STABLE_MS           30000   // A session this long clears the endpoint's backoff
+#define GATEWAY_SWITCH_MARGIN_MS    20      // RTT gain worth moving an idle session for
+#define GATEWAY_RTT_UNKNOWN         0xFFFFFFFEu
+#define GATEWAY_RTT_FAILED          0xFFFFFFFFu
+
+struct GatewayEndpoint {
+    char host[GATEWAY_HOST_SIZE];
+    uint16_t port;
+    bool tls;
+};
+
+/**
+ * Check for an address that never leaves the LAN: RFC1918 (10/8,
+ * 172.16/12, 192.168/16), loopback (127/8), link-local (169.254/16) or
+ * "localhost". Hostnames other than "localhost" are not local.
+ */
+bool isLocalNetworkHost(const char* host);
+
+/**
+ * Parse one "[ws://|wss://]host[:port][/]" entry
+ * @param text Entry (need not be NUL-terminated; surrounding spaces are skipped)
+ * @param length Entry length
+ * @param defaultPort Port when the entry has none
+ * @return false if the entry is malformed
+ */
+bool parseGatewayEndpoint(const char* text, size_t length, uint16_t defaultPort, GatewayEndpoint* endpoint);
+
+/**
+ * Check a comma-separated list (empty is valid)
+ */
+bool isValidGatewayList(const char* list);
+
+/**
+ * Backoff after `failures` consecutive failures (>= 1)
+ * @param random Any 32-bit random number
+ */
+uint32_t gatewayBackoffMs(uint8_t failures, uint32_t random);
+
+class GatewaySelector {
+public:
+    GatewaySelector();
+
+    /**
+     * Replace the endpoints: primary first, then the list. Malformed and
+     * duplicate entries are skipped, the rest capped at GATEWAY_MAX_ENDPOINTS.
+     * RTTs and backoff start over.
+     * @return Number of endpoints
+     */
+    size_t configure(const char* primary, uint16_t primaryPort, const char* list);
+
+    size_t count() const { return endpointCount; }
+    const GatewayEndpoint& endpoint(size_t index) const { return endpoints[index]; }
+
+    /** Record a probe: RTT in ms, or GATEWAY_RTT_FAILED */
+    void setRtt(size_t index, uint32_t rttMs);
+    uint32_t rtt(size_t index) const { return rtts[index]; }
+
+    /**
+     * Endpoint to try now: the best ranked one out of backoff
+     * @return Index, or -1 while everything is backing off
+     */
+    int select(uint32_t nowMs) const;
+
+    /**
+     * A faster endpoint an idle session could move to
+     * @return Index, or -1 if none beats `current` by GATEWAY_SWITCH_MARGIN_MS
+     */
+    int fasterThan(size_t current, uint32_t nowMs) const;
+
+    /**
+     * An attempt on `index` failed
+     * @param random 32-bit random number (low half: backoff jitter, high half: failover spread)
+     */
+    void onFailure(size_t index, uint32_t nowMs, uint32_t random);
+
+    /** A session came up */
+    void onConnected(uint32_t nowMs);
+
+    /**
+     * A session on `index` ended - backs off unless it lasted GATEWAY_STABLE_MS
+     * @param random As for onFailure()
+     */
+    void onDisconnected(size_t index, uint32_t nowMs, uint32_t random);
+
+    uint8_t failures(size_t index) const { return failureCounts[index]; }
+
+private:
+    bool add(const char* text, size_t length, uint16_t defaultPort);
+    bool available(size_t index, uint32_t nowMs) const;
+    void backOff(size_t index, uint32_t nowMs, uint32_t random);
+
+    GatewayEndpoint endpoints[GATEWAY_MAX_ENDPOINTS];
+    uint32_t rtts[GATEWAY_MAX_ENDPOINTS];
+    uint8_t failureCounts[GATEWAY_MAX_ENDPOINTS];
+    uint32_t retryAtMs[GATEWAY_MAX_ENDPOINTS];
+    size_t endpointCount;
+    uint32_t holdUntilMs;       // Failover spread after the last loss
+    bool holding;
+    uint32_t connectedAtMs;
+};
+
+#endif // GATEWAY_SELECT_H
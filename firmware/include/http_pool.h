@@ -0,0 +1,77 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+
+/**
+ * Keep-alive connection pool for iot.http
+ *
+ * Automations tend to hit the same few hubs over and over. Rather than a
+ * new TCP connection (and for https a full TLS handshake, hundreds of ms
+ * and ~40KB of heap) per call, each origin - scheme, host and port - keeps
+ * its connection open in a pool slot between requests, so a repeat call
+ * costs one round trip.
+ *
+ * - A slot is leased to one worker at a time; a second concurrent request
+ *   to the same origin gets its own slot
+ * - A connection unused for HTTP_POOL_IDLE_MS is closed; when all slots
+ *   are taken the least recently used idle one is recycled
+ * - A connection is only parked if its response was read to the end and
+ *   the server allowed keep-alive; anything else is closed on release
+ * - lease.reused tells the caller a failure may just be a connection the
+ *   server dropped while it was parked, worth one retry on a fresh one
+ *
+ * https certificates are not verified: the targets are LAN hubs with
+ * self-signed certificates, the same trust as plain http to them.
+ *
+ * Thread-safe; used by the IoT worker tasks.
+ */
+
+#define HTTP_POOL_SLOTS           4
+#define HTTP_POOL_IDLE_MS         30000   // Close a parked connection unused this long
+#define HTTP_POOL_HOST_SIZE       64
+#define HTTP_POOL_MIN_INTERNAL    49152   // Don't park a connection with less internal heap free
+
+// A pooled HTTPClient, begun on the request URL
+struct HttpLease {
+    HTTPClient* http;
+    bool reused;         // Rides on a parked connection - no connect/handshake
+    int8_t slot;
+};
+
+/**
+ * Create the pool lock (before the first acquire)
+ */
+bool setupHttpPool();
+
+/**
+ * Lease a client for url and begin() it
+ * @param timeoutMs Connect, TLS handshake and read timeout
+ * @return false if the URL is invalid or every slot is leased
+ */
+bool httpPoolAcquire(const String& url, uint32_t timeoutMs, HttpLease* lease);
+
+/**
+ * Return a leased client
+ * @param reusable true if the response body was read completely
+ */
+void httpPoolRelease(HttpLease* lease, bool reusable);
+
+/**
+ * Close parked connections idle for longer than HTTP_POOL_IDLE_MS
+ */
+void httpPoolEvictIdle();
+
+// Pool statistics
+struct HttpPoolStats {
+    uint8_t leased;          // Slots in use now
+    uint8_t parked;          // Idle connections kept open
+    uint32_t reused;         // Requests that skipped connect/handshake
+    uint32_t opened;         // Requests that needed a new connection
+    uint32_t evicted;        // Parked connections closed (idle or recycled)
+};
+
+void getHttpPoolStats(HttpPoolStats* stats);
+
+#endif // HTTP_POOL_H
@@ -0,0 +1,99 @@
+#ifndef IOT_EXECUTOR_H
+#define IOT_EXECUTOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/**
+ * Asynchronous executor for iot.request commands
+ *
+ * The WebSocket handler only validates a request and queues it; a small
+ * pool of worker tasks runs the slow part (HTTP calls, WiFi scans) and
+ * hands the iot.response back through the send callback, which must be
+ * safe to call from any task. webSocket.loop() never waits on an IoT call,
+ * so audio and heartbeats keep flowing while requests are in flight.
+ *
+ * - At most IOT_WORKER_COUNT requests run at once and IOT_MAX_JOBS are
+ *   accepted (queued + running); beyond that the request is answered with
+ *   an error right away
+ * - Every request has a deadline (params.timeoutMs, capped): it bounds the
+ *   HTTP timeouts, and a request still queued when it expires is failed
+ *   without running
+ * - iot.cancel (by requestId) drops a queued request and suppresses the
+ *   response of a running one; a disconnect cancels everything
+ *
+ * iot.http bodies are copied from the socket in fixed pieces, never read
+ * whole. By default a body of up to IOT_INLINE_BODY_MAX goes in the
+ * iot.response (longer ones are cut there and flagged "truncated"). With
+ * params.stream = true the iot.response carries only status and headers and
+ * the body follows in sequenced iot.chunk frames:
+ *
+ *   {"type":"iot.chunk","requestId":"..","seq":0,"data":"<base64>"}
+ *   ...
+ *   {"type":"iot.chunk","requestId":"..","seq":7,"data":"..","done":true,"bytes":7310}
+ *
+ * A failed stream ends with "error" in the last chunk instead of "bytes". The
+ * worker waits for room in the send queue, so at most one send queue of
+ * chunks is in memory however large the body is.
+ */
+
+#define IOT_WORKER_COUNT          2
+#define IOT_MAX_JOBS              8       // Queued + running
+#define IOT_WORKER_CORE           0       // Away from loop()/WebSocket
+#define IOT_WORKER_PRIORITY       1       // Below every audio task - TLS handshakes are CPU heavy
+#define IOT_WORKER_STACK          12288   // HTTPClient + mbedTLS handshake
+#define IOT_DEFAULT_TIMEOUT_MS    10000
+#define IOT_MAX_TIMEOUT_MS        30000
+#define IOT_REQUEST_ID_SIZE       48
+#define IOT_INLINE_BODY_MAX       4096    // Body bytes kept in a non-streamed iot.response
+#define IOT_CHUNK_BYTES           1024    // Body bytes per iot.chunk (base64 on the wire)
+#define IOT_RESPONSE_WAIT_MS      1000    // Wait for send queue room (single responses)
+
+/**
+ * Sends one text frame to the server; called from worker tasks
+ * @param frame malloc()ed frame - the callee owns it (freed on failure too)
+ * @param length Frame length
+ * @param waitMs How long to wait for room in the send queue
+ * @return false if it couldn't be queued in time
+ */
+typedef bool (*IotSendCallback)(char* frame, size_t length, uint32_t waitMs);
+
+/**
+ * Start the worker pool (idempotent)
+ * @param send Thread-safe text frame sender
+ * @return true if the workers are running
+ */
+bool setupIotExecutor(IotSendCallback send);
+
+/**
+ * Accept an iot.request (WebSocket handler only)
+ * Everything needed is copied out of msg before returning.
+ * @param msg Parsed request (requestId, command, params)
+ */
+void submitIotRequest(JsonVariantConst msg);
+
+/**
+ * Cancel a queued or running request
+ * @return true if a request with that id was found
+ */
+bool cancelIotRequest(const char* requestId);
+
+/**
+ * Cancel everything (connection lost - responses couldn't be delivered)
+ */
+void cancelAllIotRequests();
+
+// Executor statistics
+struct IotExecutorStats {
+    uint8_t queued;          // Waiting for a worker
+    uint8_t running;         // In a worker now
+    uint32_t completed;      // Responses sent
+    uint32_t rejected;       // Turned away: executor full
+    uint32_t expired;        // Deadline passed while queued
+    uint32_t cancelled;      // Cancelled (queued or running)
+    uint32_t chunksSent;     // iot.chunk frames of streamed bodies
+};
+
+void getIotExecutorStats(IotExecutorStats* stats);
+
+#endif // IOT_EXECUTOR_H
@@ -0,0 +1,83 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Adaptive jitter buffer estimator for TTS playback
+ *
+ * Watches inter-arrival times of downlink audio frames and picks how much
+ * audio to buffer before the speaker starts (start threshold) and how much to
+ * rebuild after an underrun (target lead). On a fast LAN this settles around
+ * JITTER_MIN_START_MS; on lossy Wi-Fi it grows with measured jitter, late
+ * arrivals, and underruns reported back from the playback task.
+ *
+ * Pure arithmetic on caller-supplied timestamps - no timers or Arduino calls.
+ */
+
+#define JITTER_MIN_START_MS      150    // Never start with less than this buffered
+#define JITTER_MAX_START_MS      1000   // Cap (the old fixed AUDIO_START_THRESHOLD)
+#define JITTER_INITIAL_START_MS  250    // Until we've seen a response
+#define JITTER_UNDERRUN_PENALTY_MS 100  // Added per underrun in a response
+#define JITTER_MAX_PENALTY_MS    500
+
+struct JitterBufferStats {
+    uint32_t jitterMs;          // Smoothed inter-arrival jitter (RFC 3550 style)
+    uint32_t peakLateMs;        // Smoothed worst lateness vs. real-time per response
+    uint32_t penaltyMs;         // Extra margin learned from underruns
+    uint32_t startThresholdMs;  // Current pick for start threshold
+    uint32_t targetLeadMs;      // Current pick for rebuffer target
+    uint32_t frames;            // Frames seen in current response
+    uint32_t responses;         // Responses measured since boot
+    uint32_t underruns;         // Underruns reported since boot
+};
+
+class JitterBuffer {
+public:
+    explicit JitterBuffer(uint32_t sampleRate);
+
+    /** Forget the current response (call at response boundaries) */
+    void beginResponse();
+
+    /**
+     * Record arrival of one downlink audio frame
+     * @param nowUs Monotonic arrival time in microseconds
+     * @param samples Audio samples carried by the frame
+     */
+    void onFrame(uint64_t nowUs, size_t samples);
+
+    /**
+     * Close out the current response
+     * @param underruns Underruns the playback task saw during it
+     */
+    void endResponse(uint32_t underruns);
+
+    /** Samples to buffer before the speaker starts */
+    size_t startThresholdSamples() const;
+
+    /** Samples to rebuild before resuming after an underrun */
+    size_t targetLeadSamples() const;
+
+    void getStats(JitterBufferStats* stats) const;
+
+private:
+    uint32_t computeStartMs() const;
+
+    uint32_t sampleRate;
+    bool inResponse;
+    uint64_t firstArrivalUs;
+    uint64_t lastArrivalUs;
+    uint64_t mediaUs;           // Media time received so far in this response
+    uint64_t lastFrameMediaUs;  // Duration of the previous frame
+    int64_t responsePeakLateUs;
+    uint32_t frames;
+    uint32_t responses;
+    uint32_t totalUnderruns;
+    // Smoothed values kept in microseconds
+    uint32_t jitterUs;
+    uint32_t peakLateUs;
+    uint32_t penaltyUs;
+};
+
+#endif // JITTER_BUFFER_H
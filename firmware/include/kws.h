@@ -0,0 +1,185 @@
+#ifndef KWS_H
+#define KWS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Keyword spotting engine
+ *
+ * Frontend: 30ms Hann windows every 20ms -> 512-point FFT -> 40 log-mel bands
+ * -> 10 MFCCs. The last KWS_WINDOW_FRAMES frames (~1s) form the network input.
+ *
+ * Network: small int8 CNN (DS-CNN style - one standard conv, then
+ * depthwise/pointwise pairs, global average pool, fully connected) described
+ * by a model blob. Activations are NHWC int8 with per-tensor affine
+ * quantization and TFLite-style fixed-point requantization, so the kernels
+ * line up one-to-one with ESP-NN's s8 ops.
+ *
+ * Model blob layout (little-endian, see KwsModelHeader / KwsLayerHeader):
+ *   [KwsModelHeader][KwsLayerHeader][int8 weights][int32 bias (outC)]...
+ * Weights: conv [outC][kh][kw][inC], depthwise [kh][kw][C], fc [outC][inC].
+ * The blob is used in place (it can live in memory-mapped flash).
+ *
+ * Portable C++ - no Arduino or FreeRTOS calls, so it also builds on the host.
+ */
+
+#define KWS_SAMPLE_RATE       16000
+#define KWS_FRAME_LEN         480     // 30ms analysis window
+#define KWS_FRAME_HOP         320     // 20ms between frames
+#define KWS_FFT_SIZE          512
+#define KWS_MEL_BANDS         40
+#define KWS_MFCC_COEFFS       10
+#define KWS_MEL_LOW_HZ        20
+#define KWS_MEL_HIGH_HZ       7600
+#define KWS_WINDOW_FRAMES     49      // ~1s of context per inference
+#define KWS_MAX_LAYERS        16
+#define KWS_MAX_CLASSES       8
+
+#define KWS_MODEL_MAGIC       0x3153574Bu  // "KWS1"
+
+enum KwsLayerType : uint8_t {
+    KWS_LAYER_CONV      = 1,    // Standard 2D conv (also 1x1 pointwise)
+    KWS_LAYER_DWCONV    = 2,    // Depthwise 2D conv, multiplier 1
+    KWS_LAYER_AVGPOOL   = 3,    // Global average pool to 1x1xC
+    KWS_LAYER_FC        = 4     // Fully connected over the flattened input
+};
+
+#pragma pack(push, 1)
+struct KwsModelHeader {
+    uint32_t magic;             // KWS_MODEL_MAGIC
+    uint16_t version;           // 1
+    uint8_t numLayers;
+    uint8_t numClasses;         // Output logits
+    uint8_t keywordClass;       // Index of the wake word in the output
+    uint8_t inputFrames;        // Must be KWS_WINDOW_FRAMES
+    uint8_t inputCoeffs;        // Must be KWS_MFCC_COEFFS
+    int8_t inputZeroPoint;
+    float inputScale;           // MFCC value = (q - zero) * scale
+    float outputScale;          // Logit = (q - zero) * scale
+    int8_t outputZeroPoint;
+    uint8_t reserved[3];
+    uint32_t arenaBytes;        // Largest activation tensor
+};
+
+struct KwsLayerHeader {
+    uint8_t type;               // KwsLayerType
+    uint8_t kernelH, kernelW;
+    uint8_t strideH, strideW;
+    uint8_t relu;               // Clamp at the output zero point
+    uint16_t outChannels;       // Ignored for DWCONV / AVGPOOL
+    int8_t inputZeroPoint;
+    int8_t outputZeroPoint;
+    int8_t outputShift;         // Requant: (acc * multiplier) >> (31 - shift)
+    uint8_t reserved;
+    int32_t outputMultiplier;   // Q31
+};
+#pragma pack(pop)
+
+/**
+ * MFCC frontend - consumes 16kHz PCM, produces one feature frame per hop
+ */
+class KwsFrontend {
+public:
+    KwsFrontend();
+
+    /**
+     * Push samples
+     * @return Number of new feature frames completed
+     */
+    size_t push(const int16_t* samples, size_t count);
+
+    /**
+     * Copy the last KWS_WINDOW_FRAMES frames, oldest first, quantized
+     * @param out KWS_WINDOW_FRAMES * KWS_MFCC_COEFFS values
+     */
+    void window(int8_t* out, float scale, int8_t zeroPoint) const;
+
+    /** Frames produced since reset (saturates) */
+    uint32_t frameCount() const { return frames; }
+
+    void reset();
+
+private:
+    void computeFrame();
+
+    int16_t pending[KWS_FRAME_LEN];
+    size_t pendingCount;
+    float features[KWS_WINDOW_FRAMES][KWS_MFCC_COEFFS];
+    size_t featureHead;         // Next row to overwrite
+    uint32_t frames;
+};
+
+/**
+ * Network interpreter for a model blob
+ */
+class KwsModel {
+public:
+    KwsModel();
+
+    /**
+     * Validate and bind a model blob (not copied - must outlive the model)
+     * @return false if the blob is malformed
+     */
+    bool load(const uint8_t* blob, size_t length);
+
+    bool loaded() const { return header != nullptr; }
+
+    /** Bytes of scratch needed by run() (valid after load) */
+    size_t arenaBytes() const;
+
+    /**
+     * Run one inference
+     * @param input KWS_WINDOW_FRAMES * KWS_MFCC_COEFFS quantized features
+     * @param arena Scratch of arenaBytes()
+     * @return Softmax probability of the keyword class
+     */
+    float run(const int8_t* input, int8_t* arena);
+
+    float inputScale() const;
+    int8_t inputZeroPoint() const;
+
+private:
+    struct Shape {
+        uint16_t h, w, c;
+    };
+
+    const KwsModelHeader* header;
+    const KwsLayerHeader* layers[KWS_MAX_LAYERS];
+    Shape inShape[KWS_MAX_LAYERS];
+    Shape outShape[KWS_MAX_LAYERS];
+    const int8_t* weights[KWS_MAX_LAYERS];
+    const uint8_t* biases[KWS_MAX_LAYERS];  // int32, may be unaligned in the blob
+};
+
+/**
+ * Posterior smoothing and trigger logic over successive inferences
+ */
+class KwsDetector {
+public:
+    /**
+     * @param threshold Smoothed probability needed to trigger (0..1)
+     * @param smoothing Inferences averaged
+     * @param refractory Inferences ignored after a trigger
+     */
+    KwsDetector(float threshold, uint8_t smoothing, uint8_t refractory);
+
+    /** @return true when this score completes a detection */
+    bool update(float score);
+
+    void reset();
+
+    float smoothedScore() const { return smoothed; }
+
+private:
+    float history[8];
+    uint8_t historyLen;
+    uint8_t historyPos;
+    uint8_t hold;
+    float threshold;
+    uint8_t smoothing;
+    uint8_t refractory;
+    float smoothed;
+};
+
+#endif // KWS_H
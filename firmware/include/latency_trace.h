@@ -0,0 +1,63 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Per-stage latency histograms for the audio path
+ *
+ * Each stage is measured on the device clock (millis()) between two points
+ * the firmware can see:
+ *
+ * - capture-to-send: mic sample captured (DMA) -> its frame handed to the
+ *   WebSocket; covers the capture ring, loop(), encoder and uplink batching
+ * - receive-to-play: downlink frame received -> its first sample audible;
+ *   covers the jitter buffer, decoder lead, playback ring and TX DMA
+ * - first-byte-to-speaker: the same for the first frame of each response,
+ *   i.e. what the user waits for once the server starts talking
+ *
+ * Buckets are powers of two in ms (bucket 0 is < 1ms, bucket n is
+ * [2^(n-1), 2^n), the last is open-ended). One writer per stage; readers get
+ * a snapshot that may be one sample behind. Pure arithmetic - no Arduino calls.
+ */
+
+#define LATENCY_BUCKETS   14   // Last bucket holds >= 4096ms
+
+enum LatencyStage : uint8_t {
+    LATENCY_CAPTURE_TO_SEND,
+    LATENCY_RECEIVE_TO_PLAY,
+    LATENCY_FIRST_BYTE_TO_SPEAKER,
+    LATENCY_STAGE_COUNT
+};
+
+struct LatencyStats {
+    uint32_t count;
+    uint32_t meanMs;
+    uint32_t maxMs;
+    uint32_t p50Ms;          // Upper edge of the bucket holding the median
+    uint32_t p95Ms;
+    uint32_t buckets[LATENCY_BUCKETS];
+};
+
+/**
+ * Add one measurement
+ */
+void latencyRecord(LatencyStage stage, uint32_t ms);
+
+/**
+ * Snapshot a stage's histogram
+ */
+void getLatencyStats(LatencyStage stage, LatencyStats* stats);
+
+/**
+ * Short name for logs and reports ("captureToSend", ...)
+ */
+const char* latencyStageName(LatencyStage stage);
+
+/**
+ * Upper edge of a bucket in ms (UINT32_MAX for the last one)
+ */
+uint32_t latencyBucketLimitMs(int bucket);
+
+#endif // LATENCY_TRACE_H
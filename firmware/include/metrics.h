@@ -0,0 +1,109 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * Device metrics registry
+ *
+ * A fixed table of counters and gauges that the audio, voice and BLE code
+ * update where things happen, instead of printing them every few seconds.
+ * An update is one relaxed atomic op - safe from any task, no locks, no
+ * formatting - so it can sit on the capture and playback paths.
+ *
+ * - Counters only go up (events, bytes, dropped samples since boot)
+ * - Gauges hold the latest value, or a high-water mark via metricMax()
+ * - Heap/PSRAM free and their low-water marks, per-task CPU share and stack
+ *   headroom, and the latency_trace histograms are sampled when a report is
+ *   built rather than tracked continuously
+ *
+ * The report goes to the server as a "device.metrics" text frame every
+ * METRICS_REPORT_MS, and (counters and gauges only) to the BLE status
+ * characteristic for the app. The BLE TLV protocol tags metrics by id within
+ * their section (ble_protocol.h), so add new ones at the end of a section.
+ */
+
+#define METRICS_REPORT_MS     30000
+#define METRICS_MAX_TASKS     24      // uxTaskGetSystemState() snapshot size
+
+enum MetricId : uint8_t {
+    // Counters
+    METRIC_WS_TEXT_RX,               // Text frames received
+    METRIC_WS_BINARY_RX,             // Binary (audio) frames received
+    METRIC_WS_BINARY_RX_BYTES,
+    METRIC_WS_DISCONNECTS,
+    METRIC_UPLINK_FRAMES,            // Binary frames sent
+    METRIC_UPLINK_SEND_FAILURES,     // sendBIN() refused a frame
+    METRIC_UPLINK_PACKET_DROPS,      // Encoded packets lost to a full ring
+    METRIC_DOWNLINK_ERRORS,          // Corrupt/undecodable packets, ring overflow
+    METRIC_PLAYBACK_UNDERRUNS,
+    METRIC_PLAYBACK_DROPPED_SAMPLES, // Playback ring full
+    METRIC_CAPTURE_OVERRUN_SAMPLES,  // Capture ring full
+    METRIC_POOL_ALLOC_FAILURES,      // Audio pool blocks refused (audio_pool.h)
+
+    // Gauges
+    METRIC_VOICE_STATE,
+    METRIC_PLAYBACK_BUFFERED,        // Samples queued for the speaker
+    METRIC_PLAYBACK_BUFFERED_PEAK,
+    METRIC_CAPTURE_BACKLOG_PEAK,     // Most samples waiting in the capture ring
+    METRIC_HEAP_FREE,                // Internal RAM, sampled per report
+    METRIC_HEAP_MIN_FREE,            // Low-water mark since boot
+    METRIC_PSRAM_FREE,
+    METRIC_PSRAM_MIN_FREE,
+    METRIC_POWER_LEVEL,              // PowerLevel (power_manager.h)
+    METRIC_CPU_MHZ,                  // Clock for that level (DFS: the ceiling)
+    METRIC_POOL_INTERNAL_BLOCKS,     // Audio pool blocks in use
+    METRIC_POOL_INTERNAL_PEAK,
+    METRIC_POOL_PSRAM_BLOCKS,
+    METRIC_POOL_PSRAM_PEAK,
+
+    METRIC_COUNT
+};
+
+#define METRIC_FIRST_GAUGE    METRIC_VOICE_STATE
+
+extern std::atomic<uint32_t> metricValues[METRIC_COUNT];
+
+inline void metricAdd(MetricId id, uint32_t delta = 1) {
+    metricValues[id].fetch_add(delta, std::memory_order_relaxed);
+}
+
+inline void metricSet(MetricId id, uint32_t value) {
+    metricValues[id].store(value, std::memory_order_relaxed);
+}
+
+/**
+ * Raise a high-water gauge to value (no-op if already higher)
+ */
+inline void metricMax(MetricId id, uint32_t value) {
+    uint32_t current = metricValues[id].load(std::memory_order_relaxed);
+    while (value > current &&
+           !metricValues[id].compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+inline uint32_t metricGet(MetricId id) {
+    return metricValues[id].load(std::memory_order_relaxed);
+}
+
+/**
+ * Report key of a metric ("wsTextRx", ...)
+ */
+const char* metricName(MetricId id);
+
+/**
+ * Refresh the gauges that are read from the system rather than pushed
+ * (heap and PSRAM free) - buildMetricsReport() does this itself
+ */
+void sampleSystemMetrics();
+
+/**
+ * Fill doc with a device.metrics report
+ * @param detailed Also latency histograms and per-task CPU/stack (the
+ *                 WebSocket report); false keeps it small enough for BLE
+ */
+void buildMetricsReport(JsonDocument& doc, bool detailed);
+
+#endif // METRICS_H
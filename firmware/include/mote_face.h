@@ -2,15 +2,38 @@
 #define MOTE_FACE_H
 
 #include <Arduino.h>
-#include <SPI.h>
 
 /**
  * Mote Face Display System
  *
  * Animated mascot face for 2" IPS LCD (240x320 ST7789V)
  * Features expressive eyes, mouth animations, and battery indicator
+ *
+ * All drawing happens in a render task that owns the display. The public
+ * functions below only post a command to it and return immediately, so no
+ * caller (loop(), voice callbacks) ever waits on SPI or an animation.
+ * Blinks and glances are keyframe tracks the task samples once per frame;
+ * while speaking the mouth follows the playback envelope (lip-sync).
  */
 
+// Render task
+#define FACE_TASK_CORE        0      // Away from loop()/WebSocket; lowest priority there
+#define FACE_TASK_PRIORITY    2      // Below capture (12), codecs (5/6) and KWS (4)
+#define FACE_TASK_STACK       4096
+#define FACE_FRAME_MS         33     // ~30 FPS (fastest; idle runs slower)
+#define FACE_QUEUE_DEPTH      16     // Commands between frames
+
+// Animation timing
+#define FACE_BLINK_MIN_MS     2500   // Random gap between idle blinks
+#define FACE_BLINK_MAX_MS     5000
+#define FACE_LOOK_OFFSET      10     // Pupil shift for lookLeft()/lookRight()
+#define FACE_LOOK_MS          120    // Glance tween duration
+
+// Lip-sync (envelope is the post-gain peak of the 20ms block playing now)
+#define FACE_MOUTH_MAX_OPEN   24     // Extra mouth height in pixels
+#define FACE_LIPSYNC_FLOOR    600    // Peak below this keeps the mouth shut
+#define FACE_LIPSYNC_FULL     14000  // Peak that opens it all the way
+
 // Display dimensions (landscape mode: 320x240)
 #define SCREEN_WIDTH  320
 #define SCREEN_HEIGHT 240
@@ -43,15 +66,12 @@ enum EyeExpression {
 #define BATTERY_LOW    TFT_RED
 #define BATTERY_CHARGE TFT_CYAN
 
-// Initialize face display system
+// Initialize face display and start the render task
 void setupFaceDisplay();
 
 // Update face state (smooth transition)
 void setFaceState(FaceState state);
 
-// Animate the face (call in loop)
-void updateFaceAnimation();
-
 // Draw battery indicator in corner
 void drawBatteryIndicator(int percent, bool charging);
 
@@ -61,10 +81,16 @@ void drawWifiStatus(bool connected);
 // Draw Gateway status indicator (top right, next to battery)
 void drawGatewayStatus(bool connected);
 
-// Quick expressions
+// Quick expressions (queued, non-blocking)
 void blinkEyes();
 void lookLeft();
 void lookRight();
 void waveAnimation();
 
+// Backlight level, 0-100 (queued, applied by the render task)
+void setFaceBrightness(uint8_t percent);
+
+// Time between frames (at least FACE_FRAME_MS); commands still show at once
+void setFaceFrameInterval(uint16_t ms);
+
 #endif // MOTE_FACE_H
@@ -0,0 +1,62 @@
+#ifndef MOTE_LOG_H
+#define MOTE_LOG_H
+
+#include <Arduino.h>
+
+/**
+ * Compile-time log levels
+ *
+ * Messages above MOTE_LOG_LEVEL compile to nothing - the format string, the
+ * arguments and the Serial call are all gone - so per-frame and periodic
+ * debug output costs nothing in a normal build. Set the level with a build
+ * flag (-DMOTE_LOG_LEVEL=4 for debug, see the -debug env in platformio.ini).
+ *
+ * Counts and levels that were once logged every few seconds live in the
+ * metrics registry instead (metrics.h).
+ */
+
+#define MOTE_LOG_NONE    0
+#define MOTE_LOG_ERROR   1
+#define MOTE_LOG_WARN    2
+#define MOTE_LOG_INFO    3
+#define MOTE_LOG_DEBUG   4
+
+#ifndef MOTE_LOG_LEVEL
+#define MOTE_LOG_LEVEL   MOTE_LOG_INFO
+#endif
+
+#if MOTE_LOG_LEVEL >= MOTE_LOG_ERROR
+#define LOG_ERROR(...)   Serial.printf(__VA_ARGS__)
+#else
+#define LOG_ERROR(...)   do {} while (0)
+#endif
+
+#if MOTE_LOG_LEVEL >= MOTE_LOG_WARN
+#define LOG_WARN(...)    Serial.printf(__VA_ARGS__)
+#else
+#define LOG_WARN(...)    do {} while (0)
+#endif
+
+#if MOTE_LOG_LEVEL >= MOTE_LOG_INFO
+#define LOG_INFO(...)    Serial.printf(__VA_ARGS__)
+#else
+#define LOG_INFO(...)    do {} while (0)
+#endif
+
+#if MOTE_LOG_LEVEL >= MOTE_LOG_DEBUG
+#define LOG_DEBUG(...)   Serial.printf(__VA_ARGS__)
+
+// At most one message per intervalMs from this call site
+#define LOG_DEBUG_EVERY(intervalMs, ...) do {               \
+        static unsigned long lastLog_ = 0;                  \
+        if (millis() - lastLog_ >= (intervalMs)) {          \
+            lastLog_ = millis();                            \
+            Serial.printf(__VA_ARGS__);                     \
+        }                                                   \
+    } while (0)
+#else
+#define LOG_DEBUG(...)   do {} while (0)
+#define LOG_DEBUG_EVERY(intervalMs, ...) do {} while (0)
+#endif
+
+#endif // MOTE_LOG_H
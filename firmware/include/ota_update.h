@@ -0,0 +1,89 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "voice_protocol.h"
+
+/**
+ * Firmware and KWS model updates over the voice WebSocket
+ *
+ * The device pulls the image one chunk at a time, so the transfer never
+ * competes with a conversation: a request only goes out while the voice
+ * state is IDLE, at most one is in flight, and a chunk that arrives after
+ * a conversation started is held until it ends before touching flash.
+ * Binary frames stay audio; chunks are base64 in text frames.
+ *
+ *   <- {"type":"ota.offer","target":"firmware","version":"1.1.0","size":1234567,"sha256":"<hex>"}
+ *   -> {"type":"ota.request","target":"firmware","version":"1.1.0","offset":0,"length":4096}
+ *   <- {"type":"ota.chunk","offset":0,"data":"<base64>"}
+ *   ...
+ *   -> {"type":"ota.result","target":"firmware","version":"1.1.0","ok":true,"rebooting":true}
+ *
+ * Targets:
+ * - "firmware": written raw into the next OTA app slot, which becomes the
+ *   boot partition once verified. The reboot waits for the device to be
+ *   idle (no conversation, power level not ACTIVE). The new build confirms
+ *   itself on its first gateway connection (rollback, if the bootloader has
+ *   it enabled, covers builds that never get that far)
+ * - "model": written into the standby KWS slot (wake_word.h) and activated
+ *   live, or at the next boot while local wake is running. Its version is
+ *   kept in NVS ("kws_ver")
+ *
+ * The SHA-256 is computed by reading the slot back after the last chunk, so
+ * it covers what is actually in flash. Progress is checkpointed to NVS every
+ * OTA_CHECKPOINT_BYTES and on disconnect; a matching offer after a reconnect
+ * or reboot resumes from there. ota.status, sent after voice.start, reports
+ * the installed versions and any transfer to resume. ota.cancel drops it.
+ *
+ * Single user: the loop task (voice_client.cpp).
+ */
+
+#define MOTE_FIRMWARE_VERSION     "1.0.0"
+
+#define OTA_CHUNK_BYTES           4096    // One flash sector; base64 on the wire fits the parse arena
+#define OTA_REQUEST_INTERVAL_MS   50      // Gap between chunks (~80KB/s ceiling)
+#define OTA_REQUEST_TIMEOUT_MS    10000   // Ask again if a chunk doesn't arrive
+#define OTA_CHECKPOINT_BYTES      65536   // NVS write interval (wear)
+#define OTA_VERIFY_STEP_BYTES     16384   // Read back and hashed per loop pass
+#define OTA_VERSION_SIZE          24
+
+enum OtaTarget : uint8_t {
+    OTA_TARGET_FIRMWARE = 0,
+    OTA_TARGET_MODEL = 1
+};
+
+/**
+ * Sends one text frame (voice_client's send queue)
+ * @param frame malloc()ed frame - the callee owns it (freed on failure too)
+ */
+typedef bool (*OtaSendCallback)(char* frame, size_t length, uint32_t waitMs);
+
+/**
+ * Load a checkpointed transfer from NVS
+ * @param send Text frame sender
+ */
+void setupOtaUpdate(OtaSendCallback send);
+
+/**
+ * Handle ota.offer / ota.chunk / ota.cancel (WebSocket handler)
+ */
+void handleOtaMessage(VoiceMessageType type, JsonVariantConst msg);
+
+/**
+ * WebSocket connected (after voice.start): confirm this build, send ota.status
+ */
+void onOtaConnected();
+
+/**
+ * WebSocket lost: checkpoint progress, forget the chunk in flight
+ */
+void onOtaDisconnected();
+
+/**
+ * Pace requests, write held chunks, verify, reboot into staged firmware
+ * @param conversationActive Voice state is past IDLE - stay off flash and the link
+ */
+void handleOtaUpdate(bool conversationActive);
+
+#endif // OTA_UPDATE_H
@@ -0,0 +1,94 @@
+#ifndef PLAYBACK_CONTROL_H
+#define PLAYBACK_CONTROL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Playback task state machine
+ *
+ * Decides, one poll at a time, when the speaker starts (start threshold
+ * buffered, or the stream finished with anything left), how much of the
+ * ring to hand it next, when to hold off and rebuild the target lead after
+ * an underrun, and when a finished stream has played out. audioPlaybackTask
+ * runs it against the real ring and amp; the replay harness runs the same
+ * code against the host shims.
+ *
+ * It also keeps an estimate of the speaker's TX queue - what has been
+ * written and not yet played - from the write sizes and the clock: a write
+ * that had to wait for DMA leaves the queue full, any other write adds to
+ * whatever is still queued. The estimate ignores the DMA frame being played
+ * out, so the speaker only counts as drained a frame after it says so.
+ * An underrun is the speaker starving, not the ring being empty: the ring
+ * empties between every downlink frame once its lead has moved into DMA.
+ *
+ * Pure arithmetic on caller-supplied times - no timers or Arduino calls.
+ */
+
+#define PLAYBACK_CHUNK_SAMPLES        2048    // Largest speaker write (128ms)
+#define PLAYBACK_UNDERRUN_TIMEOUT_MS  5000    // Give up if starved this long
+
+enum PlaybackAction : uint8_t {
+    PLAYBACK_IDLE,          // Speaker off, not enough buffered to start - poll again
+    PLAYBACK_START,         // Turn the speaker on, then write `samples`
+    PLAYBACK_WRITE,         // Write `samples` from the ring
+    PLAYBACK_WAIT,          // Speaker on, nothing to write yet - poll again
+    PLAYBACK_UNDERRUN,      // Ring and speaker queue ran dry - holding off until the target lead is back
+    PLAYBACK_FINISHED,      // Stream played out - speaker off
+    PLAYBACK_TIMEOUT        // Starved for PLAYBACK_UNDERRUN_TIMEOUT_MS - speaker off
+};
+
+struct PlaybackInput {
+    size_t buffered;            // Samples in the playback ring
+    bool streamFinished;        // No more audio is coming for this response
+    size_t startThreshold;      // Samples to buffer before the speaker starts
+    size_t targetLead;          // Samples to rebuild after an underrun
+    uint64_t nowUs;             // Monotonic clock
+};
+
+class PlaybackControl {
+public:
+    /**
+     * @param queueSamples Speaker TX queue (DMA buffers x frame)
+     * @param frameSamples One speaker DMA frame
+     */
+    PlaybackControl(uint32_t sampleRate, size_t queueSamples, size_t frameSamples);
+
+    /**
+     * Decide the next step
+     * @param samples Samples to read from the ring and write (START / WRITE)
+     */
+    PlaybackAction step(const PlaybackInput& input, size_t* samples);
+
+    /**
+     * Record one speaker write
+     * @param blocked The write waited for DMA (the queue is full again)
+     */
+    void onSpeakerWrite(size_t samples, uint64_t nowUs, bool blocked);
+
+    /** Speaker turned off from outside (flush, interrupt) */
+    void stop();
+
+    bool playing() const { return isPlaying; }
+    bool rebuffering() const { return isRebuffering; }
+
+    /** The ring is done and the speaker is playing out its queue */
+    bool draining() const { return isDraining; }
+
+    /** Estimated samples written to the speaker and not yet played */
+    size_t speakerQueued(uint64_t nowUs) const;
+
+private:
+    bool speakerDrained(uint64_t nowUs) const;
+
+    uint32_t sampleRate;
+    uint64_t queueUs;           // Full TX queue
+    uint64_t frameUs;           // One DMA frame
+    bool isPlaying;
+    bool isRebuffering;
+    bool isDraining;
+    uint64_t underrunStartUs;
+    uint64_t playedOutUs;       // When the last written sample leaves the queue
+};
+
+#endif // PLAYBACK_CONTROL_H
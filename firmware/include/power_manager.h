@@ -0,0 +1,84 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include "voice_client.h"
+
+/**
+ * Power levels driven by the voice state
+ *
+ * - POWER_ACTIVE: a conversation (LISTENING/PROCESSING/SPEAKING), or within
+ *   POWER_ACTIVE_HOLD_MS of other activity. Full CPU clock, radio awake
+ *   (no modem sleep), full backlight, 30 FPS, 10ms loop(), 8ms mic frames
+ * - POWER_IDLE: waiting for the wake word. CPU scaled down, Wi-Fi modem
+ *   sleep waking for every DTIM beacon, dimmed backlight, slow frames,
+ *   32ms mic frames
+ * - POWER_STANDBY: idle for POWER_STANDBY_AFTER_MS with nothing streamed
+ *   (local wake mode, uplink closed, or no connection at all). Modem sleep
+ *   waking only every listen interval (3 beacons), backlight nearly off,
+ *   sleeping face
+ *
+ * Nothing waits to wake up: powerWake() - from the KWS task on a local
+ * trigger, or any server message - cuts loop()'s sleep short, and the very
+ * next handlePowerManager() goes to POWER_ACTIVE. Standby is only used when
+ * the wake word is spotted on the device, so the slower listen interval
+ * never delays a server-side wake.
+ *
+ * With CONFIG_PM_ENABLE the CPU clock is ESP-IDF dynamic frequency scaling
+ * (a CPU_FREQ_MAX lock held while active, the driver locks raising it while
+ * the radio works); otherwise it is switched with setCpuFrequencyMhz().
+ * Automatic light sleep stays off: mic capture never stops.
+ *
+ * Single user: loop(), except powerWake().
+ */
+
+#define POWER_ACTIVE_HOLD_MS       5000    // Full power after the last activity
+#define POWER_STANDBY_AFTER_MS     60000   // Idle this long before standby
+#define POWER_ACTIVE_CPU_MHZ       240
+#define POWER_IDLE_CPU_MHZ         80      // Nothing heavier than PCM/ADPCM streaming
+#define POWER_BUSY_IDLE_CPU_MHZ    160     // Idle with the KWS model or Opus encoder running
+#define POWER_ACTIVE_BRIGHTNESS    100     // Backlight percent
+#define POWER_IDLE_BRIGHTNESS      40
+#define POWER_STANDBY_BRIGHTNESS   5
+#define POWER_IDLE_FRAME_MS        66      // ~15 FPS, still enough for a blink
+#define POWER_STANDBY_FRAME_MS     250     // Eyes are shut
+#define POWER_ACTIVE_LOOP_MS       10
+#define POWER_IDLE_LOOP_MS         20      // Well inside the capture and KWS rings
+#define POWER_STANDBY_LOOP_MS      40
+
+enum PowerLevel : uint8_t {
+    POWER_ACTIVE,
+    POWER_IDLE,
+    POWER_STANDBY
+};
+
+/**
+ * Start at POWER_ACTIVE (call from setup(), i.e. on the loop() task)
+ */
+void setupPowerManager();
+
+/**
+ * Voice state changed (state callback)
+ */
+void setPowerVoiceState(VoiceState state);
+
+/**
+ * Something happened - go to full power now (any task)
+ */
+void powerWake();
+
+/**
+ * Move between levels (loop())
+ */
+void handlePowerManager();
+
+/**
+ * End of loop(): sleep for the level's loop period, cut short by powerWake()
+ */
+void powerIdleDelay();
+
+PowerLevel getPowerLevel();
+
+const char* powerLevelName(PowerLevel level);
+
+#endif // POWER_MANAGER_H
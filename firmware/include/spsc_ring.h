@@ -0,0 +1,152 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+/**
+ * Single-producer / single-consumer lock-free ring buffer
+ *
+ * One task writes, one task reads, no mutex. Capacity must be a power of two
+ * so indices wrap with a mask instead of a modulo. Head and tail are free-running
+ * counters: (head - tail) is the fill level, and the buffer is full when it
+ * equals the capacity (no wasted slot).
+ *
+ * Storage is supplied by the caller so it can live in PSRAM (ps_malloc) or
+ * DMA-capable internal RAM as needed.
+ */
+template <typename T>
+class SpscRing {
+public:
+    SpscRing() : buffer(nullptr), capacity(0), mask(0), head(0), tail(0) {}
+
+    /**
+     * Attach storage. Not thread-safe - call before either side starts.
+     * @param storage Buffer of `size` elements
+     * @param size Capacity in elements (must be a power of two)
+     * @return false if size is not a power of two
+     */
+    bool init(T* storage, size_t size) {
+        if (storage == nullptr || size == 0 || (size & (size - 1)) != 0) {
+            return false;
+        }
+        buffer = storage;
+        capacity = size;
+        mask = size - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool isReady() const { return buffer != nullptr; }
+    size_t size() const { return capacity; }
+
+    /** Elements available to read (safe from either side) */
+    size_t available() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    /** Free space for writing (safe from either side) */
+    size_t freeSpace() const {
+        return capacity - available();
+    }
+
+    /**
+     * Producer: copy up to `count` elements in (at most two memcpy spans)
+     * @return Number of elements actually written
+     */
+    size_t write(const T* data, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t space = capacity - (h - t);
+        if (count > space) count = space;
+        if (count == 0) return 0;
+
+        size_t start = h & mask;
+        size_t first = capacity - start;
+        if (first > count) first = count;
+        memcpy(buffer + start, data, first * sizeof(T));
+        if (count > first) {
+            memcpy(buffer, data + first, (count - first) * sizeof(T));
+        }
+
+        head.store(h + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Consumer: copy up to `count` elements out (at most two memcpy spans)
+     * @return Number of elements actually read
+     */
+    size_t read(T* out, size_t count) {
+        size_t n = peek(out, count);
+        tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+        return n;
+    }
+
+    /**
+     * Consumer: copy up to `count` elements out without consuming them
+     * @return Number of elements copied
+     */
+    size_t peek(T* out, size_t count) const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t avail = h - t;
+        if (count > avail) count = avail;
+        if (count == 0) return 0;
+
+        size_t start = t & mask;
+        size_t first = capacity - start;
+        if (first > count) first = count;
+        memcpy(out, buffer + start, first * sizeof(T));
+        if (count > first) {
+            memcpy(out + first, buffer, (count - first) * sizeof(T));
+        }
+        return count;
+    }
+
+    /**
+     * Consumer: drop up to `count` elements without copying
+     * @return Number of elements dropped
+     */
+    size_t skip(size_t count) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t avail = head.load(std::memory_order_acquire) - t;
+        if (count > avail) count = avail;
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    /** Consumer: drop everything currently buffered */
+    void discardAll() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    /**
+     * Consumer: drop everything written before `mark` (a value previously
+     * returned by writeIndex() on the producer side). Data written after the
+     * mark is kept, so a producer can request a flush without racing itself.
+     */
+    void discardTo(size_t mark) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if ((ptrdiff_t)(mark - t) > 0) {
+            tail.store(mark, std::memory_order_release);
+        }
+    }
+
+    /** Free-running write counter (total elements ever written) */
+    size_t writeIndex() const { return head.load(std::memory_order_acquire); }
+
+    /** Free-running read counter (total elements ever read) */
+    size_t readIndex() const { return tail.load(std::memory_order_acquire); }
+
+private:
+    T* buffer;
+    size_t capacity;
+    size_t mask;
+    std::atomic<size_t> head;   // Written only by the producer
+    std::atomic<size_t> tail;   // Written only by the consumer
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,86 @@
+#ifndef VAD_H
+#define VAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Spectral voice activity detector
+ *
+ * Works on 10ms frames. Each frame is band-passed to the speech band
+ * (300-3400Hz), and its band energy is compared against a noise floor that
+ * tracks the room: it falls quickly and rises slowly, and only rises while
+ * nobody is talking. Zero-crossing rate rejects hiss-like noise that happens
+ * to be loud in band. A short onset requirement stops clicks from
+ * triggering, and a short hangover bridges gaps between words.
+ *
+ * Levels are in dB relative to 1 LSB RMS, so nothing depends on the
+ * absolute mic gain.
+ *
+ * Portable C++ - no Arduino calls.
+ */
+
+#define VAD_FRAME_MS            10
+#define VAD_SPEECH_MARGIN_DB    9.0f    // Band energy above the noise floor for speech
+#define VAD_STRONG_MARGIN_DB    15.0f   // Above this, ZCR is ignored (loud fricatives)
+#define VAD_MIN_ENERGY_DB       14.0f   // Absolute gate (~5 LSB RMS) for a dead-quiet room
+#define VAD_ZCR_MAX             0.35f   // Crossings per sample above which quiet frames are noise
+#define VAD_ONSET_FRAMES        3       // 30ms of consecutive speech frames to start
+#define VAD_HANGOVER_MS         240     // Keep reporting speech this long after the last frame
+#define VAD_INIT_FRAMES         20      // Frames averaged to seed the noise floor
+
+struct VadStats {
+    float energyDb;         // Band energy of the last frame
+    float noiseFloorDb;     // Current noise floor estimate
+    float zcr;              // Zero-crossing rate of the last frame
+    bool speech;            // Current decision (including hangover)
+};
+
+class Vad {
+public:
+    explicit Vad(uint32_t sampleRate);
+
+    /**
+     * Run the detector over a block of any length
+     * @return true if speech is active at the end of the block
+     */
+    bool process(const int16_t* samples, size_t count);
+
+    /** Forget the noise floor and decision state */
+    void reset();
+
+    void getStats(VadStats* stats) const;
+
+private:
+    struct Biquad {
+        float b0, b1, b2, a1, a2;
+        float z1, z2;
+    };
+
+    void processFrame();
+    static float runBiquad(Biquad* f, float x);
+
+    uint32_t sampleRate;
+    size_t frameSamples;
+    uint32_t hangoverFrames;
+
+    Biquad highPass;
+    Biquad lowPass;
+
+    // Accumulators for the frame being filled
+    size_t frameFill;
+    float bandEnergy;
+    uint32_t crossings;
+    int16_t lastSample;
+
+    float noiseFloorDb;
+    uint32_t initFrames;
+    uint32_t onsetCount;
+    uint32_t hangoverLeft;
+    bool active;
+
+    float lastEnergyDb;
+    float lastZcr;
+};
+
+#endif // VAD_H
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include <WebSocketsClient.h>
+#include "jitter_buffer.h"
+#include "audio_codec.h"
 
 // Voice state machine
 enum VoiceState {
@@ -20,12 +22,17 @@ typedef void (*VoiceAudioCallback)(const uint8_t* data, size_t length);
 
 /**
  * Initialize the voice WebSocket client
- * @param server WebSocket server hostname (without protocol)
- * @param port Server port
+ *
+ * The primary server and the fallback list are ranked by RTT and the
+ * fastest reachable one is used; on loss the client fails over with
+ * jittered backoff (gateway_select.h).
+ * @param server Primary gateway, "[ws://|wss://]host[:port]"
+ * @param port Port for entries without one
+ * @param gatewayList Fallback gateways, comma-separated (may be empty)
  * @param token Gateway authentication token
- * @return true if initialization successful
+ * @return false if no gateway entry is valid
  */
-bool setupVoiceClient(const char* server, uint16_t port, const char* token);
+bool setupVoiceClient(const char* server, uint16_t port, const char* gatewayList, const char* token);
 
 /**
  * Handle voice client events in main loop
@@ -49,9 +56,10 @@ VoiceState getVoiceState();
  * Send audio data to server
  * @param samples PCM 16-bit samples
  * @param count Number of samples
+ * @param capturedMs Capture time of samples[0] (getCaptureTimestampMs())
  * @return true if sent successfully
  */
-bool sendVoiceAudio(const int16_t* samples, size_t count);
+bool sendVoiceAudio(const int16_t* samples, size_t count, uint32_t capturedMs);
 
 /**
  * Notify server that speech has stopped
@@ -59,10 +67,85 @@ bool sendVoiceAudio(const int16_t* samples, size_t count);
 void sendVoiceSilence();
 
 /**
- * Disconnect voice WebSocket
+ * Notify server that the on-device detector heard the wake word
+ * Audio that follows (pre-roll, then live) carries the utterance
+ * @param score Detector confidence (0..1)
+ */
+void sendVoiceWake(float score);
+
+/**
+ * Stop TTS playback right away (barge-in detected on the device)
+ * Audio still arriving for the current response is dropped; the server
+ * interrupts its side once it hears the wake word.
+ */
+void interruptVoicePlayback();
+
+/**
+ * Disconnect voice WebSocket (stays down until reconnectVoiceClient())
  */
 void disconnectVoice();
 
+/**
+ * Drop the current session and connect to another gateway
+ * Callbacks, send queue and IoT executor from setupVoiceClient() are kept
+ * @param server Primary gateway, as for setupVoiceClient()
+ * @param port Port for entries without one
+ * @param gatewayList Fallback gateways, comma-separated (may be empty)
+ * @param token Gateway authentication token
+ */
+void reconnectVoiceClient(const char* server, uint16_t port, const char* gatewayList, const char* token);
+
+/**
+ * Get the uplink codec negotiated for the current session
+ * @return AUDIO_CODEC_PCM16 unless the server selected another via voice.config
+ */
+AudioCodec getUplinkCodec();
+
+/**
+ * Get total compressed uplink bytes sent (for bitrate logging)
+ * @return Bytes sent through the encoder path since boot
+ */
+uint32_t getUplinkBytesSent();
+
+/**
+ * Get binary frames sent (one per uplink batch, for packet rate logging)
+ * @return Frames sent since boot
+ */
+uint32_t getUplinkFramesSent();
+
+/**
+ * Set how long uplink audio may collect before it is sent, per state
+ * Longer means fewer, larger frames (fewer packets and TLS records) at the
+ * cost of latency; 0 sends on the next handleVoiceClient()
+ * @param state State the interval applies in
+ * @param ms Batching interval
+ */
+void setUplinkBatchInterval(VoiceState state, uint16_t ms);
+
+/**
+ * Get the downlink (TTS) codec negotiated for the current session
+ * @return AUDIO_CODEC_PCM16 unless the server selected another via voice.config
+ */
+AudioCodec getDownlinkCodec();
+
+/**
+ * Get total compressed downlink bytes received (for bitrate logging)
+ * @return Bytes queued for the decoder since boot
+ */
+uint32_t getDownlinkBytesReceived();
+
+/**
+ * Get downlink decode errors (corrupt packets, ring overflows)
+ * @return Errors since boot
+ */
+uint32_t getDownlinkErrors();
+
+/**
+ * Get adaptive jitter buffer statistics (TTS playback start threshold tuning)
+ * @param stats Filled with current values
+ */
+void getVoiceJitterStats(JitterBufferStats* stats);
+
 /**
  * Set callback for voice state changes
  * @param callback Function to call on state change
@@ -77,6 +160,8 @@ void setVoiceTranscriptCallback(VoiceTranscriptCallback callback);
 
 /**
  * Set callback for incoming audio data
+ * Always 16kHz 16-bit PCM. With a compressed downlink codec it is called
+ * from the decoder task (core 0) instead of handleVoiceClient().
  * @param callback Function to call with audio data
  */
 void setVoiceAudioCallback(VoiceAudioCallback callback);
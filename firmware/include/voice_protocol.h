@@ -0,0 +1,65 @@
+#ifndef VOICE_PROTOCOL_H
+#define VOICE_PROTOCOL_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Control-plane parser for gateway text frames
+ *
+ * Each frame is deserialized exactly once, through a filter that keeps only
+ * the fields the client reads, into a fixed arena that is rewound before
+ * the next frame. Nothing on this path touches the heap, so a long uptime
+ * with thousands of control frames per hour doesn't fragment it. The
+ * message type is interned to an enum so dispatch is a switch, not a chain
+ * of string compares.
+ *
+ * Single user: the WebSocket event handler (loop()).
+ */
+
+#define VOICE_JSON_ARENA_SIZE     8192   // Parsed message incl. IoT params/body, OTA chunk data
+#define VOICE_JSON_NESTING_LIMIT  8
+
+enum VoiceMessageType : uint8_t {
+    VOICE_MSG_UNKNOWN,
+    VOICE_MSG_LISTENING,        // voice.listening
+    VOICE_MSG_TRANSCRIPTION,    // voice.transcription
+    VOICE_MSG_PROCESSING,       // voice.processing
+    VOICE_MSG_RESPONSE,         // voice.response
+    VOICE_MSG_DONE,             // voice.done
+    VOICE_MSG_INTERRUPT,        // voice.interrupt
+    VOICE_MSG_ERROR,            // voice.error
+    VOICE_MSG_CONFIG,           // voice.config
+    VOICE_MSG_IOT_REQUEST,      // iot.request
+    VOICE_MSG_IOT_CANCEL,       // iot.cancel
+    VOICE_MSG_OTA_OFFER,        // ota.offer
+    VOICE_MSG_OTA_CHUNK,        // ota.chunk
+    VOICE_MSG_OTA_CANCEL        // ota.cancel
+};
+
+/**
+ * Map a "type" string to its enum (VOICE_MSG_UNKNOWN if not ours)
+ */
+VoiceMessageType voiceMessageTypeFromName(const char* name);
+
+/**
+ * Wire name of a message type
+ */
+const char* voiceMessageTypeName(VoiceMessageType type);
+
+/**
+ * Parse one text frame
+ * @param payload Frame bytes (not necessarily NUL-terminated)
+ * @param length Frame length
+ * @param type Set to the interned message type
+ * @return Message root, valid until the next call; null on a parse error
+ */
+JsonVariantConst voiceProtocolParse(const uint8_t* payload, size_t length, VoiceMessageType* type);
+
+/**
+ * Largest arena use seen so far (bytes) - for sizing VOICE_JSON_ARENA_SIZE
+ */
+size_t voiceProtocolArenaPeak();
+
+#endif // VOICE_PROTOCOL_H
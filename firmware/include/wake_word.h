@@ -0,0 +1,122 @@
+#ifndef WAKE_WORD_H
+#define WAKE_WORD_H
+
+#include <Arduino.h>
+
+/**
+ * On-device wake word detection
+ *
+ * Runs the KWS engine (kws.h) in its own task so idle devices don't have to
+ * stream every mic sample to the gateway. Two modes:
+ *
+ * - WAKE_MODE_SERVER: original behavior, audio is always streamed and the
+ *   server spots the wake word in the transcript
+ * - WAKE_MODE_LOCAL: in VOICE_IDLE audio goes to the local detector only; a
+ *   trigger opens the uplink (see main.cpp) and sends voice.wake
+ *
+ * Local mode needs a model blob in a KWS data partition. There are two slots
+ * ("kws" and "kws_b"); NVS "kws_slot" names the active one and OTA writes the
+ * other. The blob is mapped from flash and used in place, never copied to
+ * RAM. Without a valid model in either slot the device quietly stays in
+ * server mode.
+ */
+
+// Configuration
+#define WAKE_RING_SIZE            4096   // Samples (256ms) between loop() and the KWS task
+#define WAKE_TASK_CORE            0      // Away from loop() and the playback task
+#define WAKE_TASK_PRIORITY        4      // Below capture (12) and the codec tasks
+#define WAKE_TASK_STACK           8192
+#define WAKE_INFERENCE_STRIDE     5      // Frames (20ms each) between inferences
+#define WAKE_THRESHOLD            0.80f  // Smoothed keyword probability to trigger
+#define WAKE_SMOOTHING            3      // Inferences averaged
+#define WAKE_REFRACTORY           10     // Inferences (~1s) ignored after a trigger
+#define WAKE_MODEL_PARTITION      "kws"      // Slot 0
+#define WAKE_MODEL_PARTITION_B    "kws_b"    // Slot 1
+
+enum WakeMode : uint8_t {
+    WAKE_MODE_SERVER = 0,
+    WAKE_MODE_LOCAL = 1
+};
+
+struct WakeWordStats {
+    uint32_t inferences;
+    uint32_t detections;
+    uint32_t lastInferenceUs;
+    uint32_t maxInferenceUs;
+    uint32_t droppedSamples;     // loop() fed faster than the task kept up
+    float lastScore;             // Smoothed keyword probability
+};
+
+/**
+ * Load the model from flash and start the KWS task
+ * Call once after the capture task is running
+ * @return true if a valid model was found
+ */
+bool setupWakeWord();
+
+/**
+ * Bind a model blob (used in place - must stay mapped)
+ * Only call while local mode isn't running inference (boot, or mode server)
+ * @return true if the blob is valid
+ */
+bool loadWakeWordModel(const uint8_t* blob, size_t length);
+
+/**
+ * Label of the model slot not in use (OTA target)
+ */
+const char* getWakeModelStandbyPartition();
+
+/**
+ * Label of the model slot whose weights are bound
+ */
+const char* getWakeModelActivePartition();
+
+/**
+ * Make a freshly written slot the active one (loop task)
+ * The blob is validated first; a bad one leaves the current model alone.
+ * While local detection is running the switch waits for the next boot.
+ * @param label Slot partition label
+ * @param deferred Set to true if the new model loads at the next boot
+ * @return true if the slot holds a valid model and was selected
+ */
+bool activateWakeWordModel(const char* label, bool* deferred);
+
+/**
+ * Select wake mode (takes effect immediately)
+ */
+void setWakeMode(WakeMode mode);
+
+/**
+ * Get selected wake mode
+ */
+WakeMode getWakeMode();
+
+/**
+ * Check whether local detection is actually in use
+ * @return true if mode is local and a model is loaded
+ */
+bool isLocalWakeActive();
+
+/**
+ * Feed mic samples to the detector (non-blocking, drops on overflow)
+ */
+void feedWakeWord(const int16_t* samples, size_t count);
+
+/**
+ * Consume a pending trigger
+ * @param score Set to the smoothed keyword probability, if not null
+ * @return true once per detection
+ */
+bool takeWakeWordTrigger(float* score);
+
+/**
+ * Drop buffered audio and detector history (e.g. when the uplink closes)
+ */
+void resetWakeWord();
+
+/**
+ * Get detector statistics
+ */
+void getWakeWordStats(WakeWordStats* stats);
+
+#endif // WAKE_WORD_H
@@ -0,0 +1,145 @@
+#include "aec.h"
+#include "audio_dsp.h"
+#include <math.h>
+#include <string.h>
+
+#define AEC_COUPLING_INITIAL    4.0f     // Start high (no double talk) and learn down
+#define AEC_COUPLING_SMOOTHING  0.05f    // Per block, only while the far end talks alone
+#define AEC_ERLE_SMOOTHING      0.05f
+#define AEC_DIVERGENCE_RATIO    4        // Output energy this far above input = filter blew up
+#define AEC_ROLLBACK_MIN_ERLE   6.0f     // Filter counts as converged above this
+#define AEC_ROLLBACK_DROP_DB    10.0f    // Block ERLE this far under the average = missed double talk
+
+EchoCanceller::EchoCanceller(uint32_t sampleRate)
+    : dtdHangoverSamples(sampleRate * AEC_DTD_HANGOVER_MS / 1000),
+      resets(0) {
+    reset();
+}
+
+void EchoCanceller::resetFilter() {
+    memset(weights, 0, sizeof(weights));
+    erleDb = 0.0f;
+}
+
+void EchoCanceller::reset() {
+    resetFilter();
+    memset(history, 0, sizeof(history));
+    historyPos = 0;
+    dtdHangoverLeft = 0;
+    lastRefPeak = 0;
+    couplingGain = AEC_COUPLING_INITIAL;
+    farEndActive = false;
+    doubleTalk = false;
+}
+
+void EchoCanceller::process(int16_t* mic, const int16_t* ref, size_t count) {
+    if (count == 0) return;
+
+    // The echo of the previous block's reference is still arriving, so the
+    // far end counts as active over both
+    uint32_t refPeak = audioDspPeak(ref, count);
+    uint32_t windowPeak = refPeak > lastRefPeak ? refPeak : lastRefPeak;
+    lastRefPeak = refPeak;
+    uint32_t micPeak = audioDspPeak(mic, count);
+
+    farEndActive = windowPeak >= AEC_REF_ACTIVE_PEAK;
+
+    if (farEndActive) {
+        // Geigel: near-end speech makes the mic louder than the echo alone could be
+        float expectedEcho = couplingGain * (float)windowPeak;
+        if ((float)micPeak > AEC_DTD_THRESHOLD * expectedEcho) {
+            dtdHangoverLeft = dtdHangoverSamples;
+        }
+    }
+    doubleTalk = dtdHangoverLeft > 0;
+
+    if (farEndActive && !doubleTalk) {
+        // Learn the coupling only from echo-only blocks, so near-end speech
+        // can't raise the bar it's detected against
+        float ratio = (float)micPeak / (float)windowPeak;
+        couplingGain += (ratio - couplingGain) * AEC_COUPLING_SMOOTHING;
+    }
+    dtdHangoverLeft = dtdHangoverLeft > count ? dtdHangoverLeft - count : 0;
+
+    const bool adapt = farEndActive && !doubleTalk;
+    const uint64_t energyIn = audioDspEnergy(mic, count);
+    if (adapt) {
+        memcpy(savedWeights, weights, sizeof(weights));
+    }
+
+    // Window power, recomputed each block so the running update can't drift
+    float power = 0.0f;
+    for (size_t k = 0; k < AEC_FILTER_TAPS; k++) {
+        power += history[historyPos + k] * history[historyPos + k];
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        // Newest sample goes in front of the window (and its mirror)
+        historyPos = (historyPos == 0 ? AEC_FILTER_TAPS : historyPos) - 1;
+        float x = (float)ref[i];
+        float leaving = history[historyPos];
+        history[historyPos] = x;
+        history[historyPos + AEC_FILTER_TAPS] = x;
+        power += x * x - leaving * leaving;
+
+        if (!farEndActive) {
+            continue;  // Keep the reference history going, but there's nothing to cancel
+        }
+
+        const float* window = history + historyPos;
+        float echo = 0.0f;
+        for (size_t k = 0; k < AEC_FILTER_TAPS; k++) {
+            echo += weights[k] * window[k];
+        }
+
+        float error = (float)mic[i] - echo;
+
+        if (adapt) {
+            float step = AEC_STEP_SIZE * error / (power + AEC_REGULARIZATION);
+            for (size_t k = 0; k < AEC_FILTER_TAPS; k++) {
+                weights[k] += step * window[k];
+            }
+        }
+
+        error = error > 32767.0f ? 32767.0f : error;
+        error = error < -32768.0f ? -32768.0f : error;
+        mic[i] = (int16_t)lrintf(error);
+    }
+
+    if (!farEndActive) return;
+
+    uint64_t energyOut = audioDspEnergy(mic, count);
+    if (energyOut > energyIn * AEC_DIVERGENCE_RATIO + (uint64_t)count * AEC_REF_ACTIVE_PEAK) {
+        // Adding echo instead of removing it - start the path model over
+        resetFilter();
+        resets++;
+        return;
+    }
+
+    if (adapt) {
+        float erle = 10.0f * log10f((float)(energyIn + 1) / (float)(energyOut + 1));
+
+        if (erleDb > AEC_ROLLBACK_MIN_ERLE && erle < erleDb - AEC_ROLLBACK_DROP_DB) {
+            // A converged filter suddenly cancelling far less means someone
+            // started talking that the peak detector missed. Undo this block's
+            // adaptation and treat it as double talk.
+            memcpy(weights, savedWeights, sizeof(weights));
+            dtdHangoverLeft = dtdHangoverSamples;
+            doubleTalk = true;
+            return;
+        }
+        erleDb += (erle - erleDb) * AEC_ERLE_SMOOTHING;
+
+        // The filter leaves some residual echo; push it down while nobody
+        // near the device is talking
+        audioDspGain(mic, mic, count, (int32_t)(AEC_NLP_GAIN * AUDIO_DSP_GAIN_UNITY));
+    }
+}
+
+void EchoCanceller::getStats(AecStats* stats) const {
+    stats->erleDb = erleDb;
+    stats->couplingGain = couplingGain;
+    stats->farEndActive = farEndActive;
+    stats->doubleTalk = doubleTalk;
+    stats->resets = resets;
+}
@@ -1,8 +1,18 @@
 #include "audio.h"
+#include "audio_i2s.h"
+#include "spsc_ring.h"
+#include "block_ring.h"
+#include "playback_control.h"
+#include "vad.h"
+#include "audio_dsp.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "mote_log.h"
 #include <math.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <atomic>
 
 // Volume control (0-100)
 static uint8_t currentVolume = 70;
@@ -10,6 +20,9 @@ static uint8_t currentVolume = 70;
 // Software gain boost (100 = 1.0x, 200 = 2.0x, etc.)
 static uint16_t softwareGain = 300;  // 3x boost - ElevenLabs output is quiet
 
+// Combined volume * gain in Q12, recomputed only when either changes
+static volatile int32_t playbackGainQ12 = audioDspGainFromVolume(currentVolume, softwareGain);
+
 // Audio playback state
 static volatile bool audioPlaying = false;
 static volatile bool speakerEnabled = false;
@@ -18,53 +31,262 @@ static volatile bool speakerEnabled = false;
 // Ring Buffer for Buffered Audio Playback
 // ============================================================================
 
-// Buffer size: ~60 seconds of audio at 16kHz (use PSRAM for long responses)
-#define AUDIO_RING_BUFFER_SIZE  (16000 * 60) // 60 seconds worth of samples (~1MB in PSRAM)
-#define AUDIO_PLAYBACK_CHUNK    2048         // 2048 samples = 128ms
-#define AUDIO_START_THRESHOLD   (16000)      // Start playing after 1 second buffered
-#define AUDIO_TARGET_LEAD_MS    200          // Target lead time: 200ms ahead of playback
+// Ceiling: ~65 seconds of audio at 16kHz. PSRAM pool blocks are only taken
+// as the lead builds up and go back as it plays out. Must be a power of two
+#define AUDIO_RING_BUFFER_SIZE  (1u << 20)   // 1,048,576 samples (up to ~2MB of PSRAM)
+#define AUDIO_START_THRESHOLD   (4000)       // Default start: 250ms buffered (tuned at runtime)
+#define AUDIO_TARGET_LEAD_MS    200          // Default lead to rebuild after an underrun
 
-static int16_t* audioRingBuffer = nullptr;
-static volatile size_t ringBufferHead = 0;    // Write position
-static volatile size_t ringBufferTail = 0;    // Read position
+// Wait-free SPSC ring: producer is the WebSocket callback (queueAudioData),
+// consumer is the playback task. No mutex on either side.
+static BlockRing<int16_t> playbackRing;
 static volatile bool bufferPlaying = false;
 static volatile bool streamFinished = false;
 static volatile bool bufferReady = false;     // Set true ONLY after buffer is fully initialized
 static volatile uint64_t samplesPlayed = 0;   // Total samples played (for timing)
-static SemaphoreHandle_t bufferMutex = nullptr;
+static std::atomic<bool> flushRequested(false);
+static std::atomic<size_t> flushMark(0);      // Producer write index at the time of the flush
+
+// Jitter buffer thresholds (set by the voice client from measured arrival jitter)
+static std::atomic<size_t> startThreshold(AUDIO_START_THRESHOLD);
+static std::atomic<size_t> rebufferThreshold(AUDIO_SAMPLE_RATE * AUDIO_TARGET_LEAD_MS / 1000);
+static PlaybackControl playbackControl(AUDIO_SAMPLE_RATE, AUDIO_DMA_BUF_COUNT * AUDIO_DMA_BUF_LEN,
+                                       AUDIO_DMA_BUF_LEN);  // Playback task only
+static volatile uint32_t responseUnderruns = 0; // Underruns in the current response
+static volatile unsigned long bufferingSince = 0;  // First sample queued while stopped
+static volatile uint32_t lastStartDelayMs = 0;  // Time from first sample queued to speaker start
 static TaskHandle_t playbackTaskHandle = nullptr;
 
+// Arrival time of downlink audio, keyed by the playback ring index of its
+// first sample. Same producer and consumer as the playback ring.
+struct ArrivalStamp {
+    size_t index;
+    uint32_t receivedMs;
+    bool firstOfResponse;
+};
+
+static ArrivalStamp arrivalStorage[AUDIO_ARRIVAL_STAMPS];
+static SpscRing<ArrivalStamp> arrivalRing;
+
+// ============================================================================
+// Echo Reference
+// ============================================================================
+
+// The playback task copies every sample it hands to the amp into a history
+// ring indexed by a free-running count of speaker samples. Mic and speaker
+// are mapped onto one timeline (esp_timer, in samples) by "clock offsets":
+// timeline = counter + offset. An offset is only taken right after an I2S
+// call that had to wait for DMA, because that's when the DMA state is known:
+// a mic read that waited returns with the completion time of its DMA frame
+// (audio_i2s.h), and a blocked speaker write returns with the TX queue full
+// again.
+#define AEC_TX_QUEUE_SAMPLES    (AUDIO_DMA_BUF_COUNT * AUDIO_DMA_BUF_LEN)
+#define AEC_CLOCK_BLOCKED_US    1000    // A call waiting this long was paced by DMA
+
+static int16_t* echoRefStorage = nullptr;
+static std::atomic<uint32_t> echoRefWritten(0);          // Speaker samples queued (ref ring write index)
+static std::atomic<uint32_t> speakerClockOffset(0);
+static std::atomic<bool> speakerClockValid(false);
+static volatile bool echoEnabled = AUDIO_AEC_DEFAULT_ENABLED;
+static volatile uint32_t echoResyncs = 0;
+static EchoCanceller echoCanceller(AUDIO_SAMPLE_RATE);
+
+// Playback envelope: peak per AUDIO_ENVELOPE_BLOCK speaker samples, indexed
+// by block number on the same speaker counter, so a reader can look up the
+// block that is audible now instead of the one just queued (which is a
+// whole TX queue ahead). Written by the playback task only.
+static std::atomic<uint16_t> envelopeSlots[AUDIO_ENVELOPE_SLOTS];
+
 /**
- * Get number of samples available in ring buffer
+ * esp_timer microseconds in samples (wraps with the 32-bit counters)
  */
-static size_t getBufferedSamples() {
-    size_t head = ringBufferHead;
-    size_t tail = ringBufferTail;
-    if (head >= tail) {
-        return head - tail;
-    } else {
-        return AUDIO_RING_BUFFER_SIZE - tail + head;
+static uint32_t timelineAt(int64_t us) {
+    return (uint32_t)((uint64_t)us * AUDIO_SAMPLE_RATE / 1000000);
+}
+
+static uint32_t timelineNow() {
+    return timelineAt(esp_timer_get_time());
+}
+
+/**
+ * Allocate the speaker history (called from setupAudio, before either task runs)
+ */
+static void initEchoReference() {
+    if (echoRefStorage != nullptr) return;
+
+    echoRefStorage = (int16_t*)ps_malloc(AUDIO_AEC_REF_SIZE * sizeof(int16_t));
+    if (echoRefStorage == nullptr) {
+        Serial.println("[Audio] Failed to allocate echo reference - echo cancellation disabled");
+    }
+}
+
+/**
+ * Record samples about to go to the amp (playback task only)
+ */
+static void pushEchoReference(const int16_t* samples, size_t count) {
+    if (echoRefStorage == nullptr) {
+        // Still count them: the speaker clock and the envelope run on this index
+        echoRefWritten.store(echoRefWritten.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        return;
+    }
+
+    const uint32_t mask = AUDIO_AEC_REF_SIZE - 1;
+    uint32_t index = echoRefWritten.load(std::memory_order_relaxed);
+    uint32_t start = index & mask;
+    size_t first = AUDIO_AEC_REF_SIZE - start;
+    if (first > count) first = count;
+    memcpy(echoRefStorage + start, samples, first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(echoRefStorage, samples + first, (count - first) * sizeof(int16_t));
+    }
+    echoRefWritten.store(index + count, std::memory_order_release);
+}
+
+/**
+ * Write to the amp one DMA buffer at a time so each blocked write pins down
+ * which reference sample is playing
+ */
+static void writeSpeaker(const int16_t* samples, size_t count) {
+    // pushEchoReference() already counted these samples
+    uint32_t firstIndex = echoRefWritten.load(std::memory_order_relaxed) - count;
+    size_t done = 0;
+
+    while (done < count) {
+        size_t n = min(count - done, (size_t)AUDIO_DMA_BUF_LEN);
+
+        int64_t start = esp_timer_get_time();
+        audioI2sSpeakerWrite(samples + done, n);
+        int64_t end = esp_timer_get_time();
+        bool blocked = end - start > AEC_CLOCK_BLOCKED_US;
+        playbackControl.onSpeakerWrite(n, (uint64_t)end, blocked);
+        done += n;
+
+        if (blocked) {
+            // TX queue is full again: the sample playing now is a whole queue
+            // behind the one just written
+            uint32_t playing = firstIndex + done - AEC_TX_QUEUE_SAMPLES;
+            speakerClockOffset.store(timelineNow() - playing, std::memory_order_relaxed);
+            speakerClockValid.store(true, std::memory_order_release);
+        }
     }
 }
 
 /**
- * Get free space in ring buffer
+ * Remove speaker echo from a mic block (capture task only)
+ * @param firstSample Mic sample counter of samples[0]
+ * @param micClockOffset Mic counter -> timeline offset
  */
-static size_t getBufferFreeSpace() {
-    return AUDIO_RING_BUFFER_SIZE - getBufferedSamples() - 1;
+static void cancelEcho(int16_t* samples, size_t count, uint32_t firstSample, uint32_t micClockOffset) {
+    static int16_t reference[AUDIO_CAPTURE_CHUNK];
+    static uint32_t refCursor = 0;
+    static bool refCursorValid = false;
+
+    if (!speakerClockValid.load(std::memory_order_acquire)) {
+        // Speaker stopped (or just started) - realign when it's running again
+        refCursorValid = false;
+        return;
+    }
+
+    // Reference sample that was playing when this block's first sample was
+    // captured, nudged early so the echo lands inside the filter
+    uint32_t expected = firstSample + micClockOffset -
+                        speakerClockOffset.load(std::memory_order_relaxed) + AUDIO_AEC_ALIGN_LEAD;
+    int32_t drift = (int32_t)(expected - refCursor);
+    if (!refCursorValid || drift > AUDIO_AEC_RESYNC_SAMPLES || drift < -AUDIO_AEC_RESYNC_SAMPLES) {
+        // Otherwise the cursor just advances - per-block timer jitter would
+        // smear the reference the filter has learned against
+        if (refCursorValid) echoResyncs++;
+        refCursor = expected;
+        refCursorValid = true;
+    }
+
+    // Samples not written yet (speaker ran dry) or about to be overwritten
+    // by the playback task count as silence
+    const uint32_t mask = AUDIO_AEC_REF_SIZE - 1;
+    uint32_t written = echoRefWritten.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t index = refCursor + i;
+        int32_t age = (int32_t)(written - index);
+        bool valid = age > 0 && age <= (int32_t)(AUDIO_AEC_REF_SIZE - PLAYBACK_CHUNK_SAMPLES);
+        reference[i] = valid ? echoRefStorage[index & mask] : 0;
+    }
+    refCursor += count;
+
+    echoCanceller.process(samples, reference, count);
+}
+
+/**
+ * Get number of samples available in ring buffer
+ */
+static size_t getBufferedSamples() {
+    return playbackRing.isReady() ? playbackRing.available() : 0;
 }
 
 /**
  * Apply volume control and gain boost to audio samples
  */
 static void applyVolume(int16_t* samples, size_t count) {
-    for (size_t i = 0; i < count; i++) {
-        // Apply volume (0-100) and software gain
-        int32_t scaled = ((int32_t)samples[i] * currentVolume * softwareGain) / 10000;
-        // Clamp to prevent overflow/clipping
-        if (scaled > 32767) scaled = 32767;
-        if (scaled < -32768) scaled = -32768;
-        samples[i] = (int16_t)scaled;
+    audioDspGain(samples, samples, count, playbackGainQ12);
+}
+
+/**
+ * applyVolume() for the playback task: also records the output envelope,
+ * split on envelope block boundaries of the speaker counter
+ * Call before pushEchoReference() - samples[0] gets index echoRefWritten.
+ */
+static void applyVolumeWithEnvelope(int16_t* samples, size_t count) {
+    const int32_t gain = playbackGainQ12;
+    uint32_t index = echoRefWritten.load(std::memory_order_relaxed);
+    size_t done = 0;
+
+    while (done < count) {
+        uint32_t offset = index % AUDIO_ENVELOPE_BLOCK;
+        size_t n = min(count - done, (size_t)(AUDIO_ENVELOPE_BLOCK - offset));
+        uint32_t peak = audioDspGainPeak(samples + done, samples + done, n, gain);
+
+        // A block split across two chunks keeps the larger half
+        std::atomic<uint16_t>& slot = envelopeSlots[(index / AUDIO_ENVELOPE_BLOCK) % AUDIO_ENVELOPE_SLOTS];
+        if (offset != 0) {
+            uint32_t earlier = slot.load(std::memory_order_relaxed);
+            if (earlier > peak) peak = earlier;
+        }
+        slot.store((uint16_t)peak, std::memory_order_relaxed);
+
+        index += n;
+        done += n;
+    }
+}
+
+/**
+ * Record arrival -> audible for stamps inside the chunk just queued to the amp
+ * @param firstIndex Playback ring index of the chunk's first sample
+ * @param count Samples in the chunk
+ */
+static void recordPlaybackLatency(size_t firstIndex, size_t count) {
+    ArrivalStamp stamp;
+    while (arrivalRing.peek(&stamp, 1) == 1 && (ptrdiff_t)(stamp.index - (firstIndex + count)) < 0) {
+        arrivalRing.skip(1);
+        if ((ptrdiff_t)(stamp.index - firstIndex) < 0) {
+            continue;  // Its audio was flushed before it played
+        }
+
+        // How far behind the sample now playing it is queued
+        uint32_t echoIndex = echoRefWritten.load(std::memory_order_relaxed) - count + (stamp.index - firstIndex);
+        int32_t ahead;
+        if (speakerClockValid.load(std::memory_order_acquire)) {
+            uint32_t playing = timelineNow() - speakerClockOffset.load(std::memory_order_relaxed);
+            ahead = (int32_t)(echoIndex - playing);
+        } else {
+            ahead = AEC_TX_QUEUE_SAMPLES + (int32_t)(stamp.index - firstIndex);  // Queue full on the way in
+        }
+        if (ahead < 0) ahead = 0;
+
+        uint32_t audibleMs = millis() + (uint32_t)ahead * 1000 / AUDIO_SAMPLE_RATE;
+        uint32_t latency = audibleMs - stamp.receivedMs;
+        latencyRecord(LATENCY_RECEIVE_TO_PLAY, latency);
+        if (stamp.firstOfResponse) {
+            latencyRecord(LATENCY_FIRST_BYTE_TO_SPEAKER, latency);
+        }
     }
 }
 
@@ -73,7 +295,7 @@ static void applyVolume(int16_t* samples, size_t count) {
  * I2S hardware naturally paces at 16kHz, no artificial throttling needed
  */
 static void audioPlaybackTask(void* parameter) {
-    int16_t playbackChunk[AUDIO_PLAYBACK_CHUNK];
+    int16_t playbackChunk[PLAYBACK_CHUNK_SAMPLES];
 
     while (true) {
         // SAFETY: Wait until buffer is fully initialized
@@ -82,80 +304,82 @@ static void audioPlaybackTask(void* parameter) {
             continue;
         }
 
-        // Wait until we should be playing
-        if (!bufferPlaying) {
-            // Check if we have enough buffered to start (200ms lead time)
-            size_t buffered = getBufferedSamples();
-            if (buffered >= AUDIO_START_THRESHOLD && !streamFinished) {
-                Serial.printf("[Audio] Starting playback, buffered: %d samples\n", buffered);
-                enableSpeaker();  // Turn on speaker before playing
-                bufferPlaying = true;
-            } else if (streamFinished && buffered > 0) {
-                // Stream is done but we still have data to play
+        // Flush requested by clearAudioBuffer() - drop everything queued before
+        // the request (consumer side, so it can't race the producer)
+        if (flushRequested.load(std::memory_order_acquire)) {
+            playbackRing.discardTo(flushMark.load(std::memory_order_acquire));
+            flushRequested.store(false, std::memory_order_release);
+            playbackControl.stop();
+            bufferPlaying = false;
+            disableSpeaker();  // Zero DMA and stop so the interrupted audio is cut off
+            continue;
+        }
+
+        PlaybackInput input;
+        input.buffered = getBufferedSamples();
+        input.streamFinished = streamFinished;
+        input.startThreshold = startThreshold.load(std::memory_order_relaxed);
+        input.targetLead = rebufferThreshold.load(std::memory_order_relaxed);
+        input.nowUs = (uint64_t)esp_timer_get_time();
+
+        size_t toRead = 0;
+        switch (playbackControl.step(input, &toRead)) {
+            case PLAYBACK_START:
+                // Enough lead (adaptive), or stream is done but we still have data to play
+                lastStartDelayMs = millis() - bufferingSince;
+                Serial.printf("[Audio] Starting playback, buffered: %d samples (threshold %d, waited %ums)\n",
+                             input.buffered, input.startThreshold, lastStartDelayMs);
                 enableSpeaker();  // Turn on speaker before playing
                 bufferPlaying = true;
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(10));
+                responseUnderruns = 0;
+                break;
+
+            case PLAYBACK_WRITE:
+                break;
+
+            case PLAYBACK_UNDERRUN:
+                metricAdd(METRIC_PLAYBACK_UNDERRUNS);
+                responseUnderruns++;
+                LOG_DEBUG("[Audio] Buffer underrun #%u, rebuffering to %d samples\n",
+                          metricGet(METRIC_PLAYBACK_UNDERRUNS), input.targetLead);
+                vTaskDelay(pdMS_TO_TICKS(5));
                 continue;
-            }
-        }
 
-        // Read samples from ring buffer
-        static uint32_t underrunCount = 0;  // Track consecutive underruns
-        size_t available = getBufferedSamples();
-        if (available == 0) {
-            if (streamFinished) {
-                // Done playing - clear speaker buffer and disable
-                Serial.println("[Audio] Buffered playback complete");
+            case PLAYBACK_FINISHED:
+                // Done playing - the amp has played out its queue, disable it
+                Serial.printf("[Audio] Buffered playback complete (%u underruns)\n", responseUnderruns);
                 bufferPlaying = false;
                 streamFinished = false;
-                underrunCount = 0;
                 disableSpeaker();  // Turn off speaker to prevent noise
                 Serial.println("[Audio] Playback finished, microphone will be restarted");
-            } else {
-                // Buffer underrun - wait longer for more data (50ms instead of 5ms)
-                underrunCount++;
-                // Only log occasionally to avoid spam
-                if (underrunCount % 20 == 1) {
-                    Serial.printf("[Audio] Buffer underrun #%d, waiting...\n", underrunCount);
-                }
-                vTaskDelay(pdMS_TO_TICKS(50));
-
-                // Timeout: if we've been in underrun for 5+ seconds, give up
-                if (underrunCount > 100) {
-                    Serial.println("[Audio] Underrun timeout - stopping playback");
-                    bufferPlaying = false;
-                    streamFinished = false;
-                    underrunCount = 0;
-                    disableSpeaker();  // Turn off speaker to prevent noise
-                }
-            }
-            continue;
-        } else {
-            // Reset underrun counter when we have data
-            underrunCount = 0;
-        }
+                continue;
 
-        // Read up to AUDIO_PLAYBACK_CHUNK samples
-        size_t toRead = min(available, (size_t)AUDIO_PLAYBACK_CHUNK);
+            case PLAYBACK_TIMEOUT:
+                Serial.println("[Audio] Underrun timeout - stopping playback");
+                bufferPlaying = false;
+                streamFinished = false;
+                disableSpeaker();  // Turn off speaker to prevent noise
+                continue;
 
-        if (xSemaphoreTake(bufferMutex, pdMS_TO_TICKS(10)) == pdTRUE) {
-            for (size_t i = 0; i < toRead; i++) {
-                playbackChunk[i] = audioRingBuffer[ringBufferTail];
-                ringBufferTail = (ringBufferTail + 1) % AUDIO_RING_BUFFER_SIZE;
-            }
-            xSemaphoreGive(bufferMutex);
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(1));
-            continue;
+            default:
+                vTaskDelay(pdMS_TO_TICKS(5));
+                continue;
         }
 
+        metricSet(METRIC_PLAYBACK_BUFFERED, input.buffered);
+        metricMax(METRIC_PLAYBACK_BUFFERED_PEAK, input.buffered);
+
+        size_t chunkIndex = playbackRing.readIndex();
+        toRead = playbackRing.read(playbackChunk, toRead);
+
         // Apply volume and play
-        // i2s_write blocks until I2S hardware is ready, naturally pacing at 16kHz
-        applyVolume(playbackChunk, toRead);
+        // Speaker writes block until I2S hardware is ready, naturally pacing at 16kHz
+        applyVolumeWithEnvelope(playbackChunk, toRead);
 
-        size_t bytesWritten = 0;
-        i2s_write(I2S_NUM_1, playbackChunk, toRead * sizeof(int16_t), &bytesWritten, portMAX_DELAY);
+        // What actually leaves the speaker is the echo canceller's reference
+        pushEchoReference(playbackChunk, toRead);
+        recordPlaybackLatency(chunkIndex, toRead);
+        writeSpeaker(playbackChunk, toRead);
     }
 }
 
@@ -163,24 +387,15 @@ static void audioPlaybackTask(void* parameter) {
  * Initialize ring buffer (called from setupAudio)
  */
 static void initRingBuffer() {
-    if (audioRingBuffer == nullptr) {
-        audioRingBuffer = (int16_t*)ps_malloc(AUDIO_RING_BUFFER_SIZE * sizeof(int16_t));
-        if (audioRingBuffer) {
-            // CRITICAL: Zero out buffer to prevent playing garbage on startup
-            memset(audioRingBuffer, 0, AUDIO_RING_BUFFER_SIZE * sizeof(int16_t));
-            Serial.printf("[Audio] Ring buffer allocated and zeroed: %d samples (%d bytes)\n",
-                         AUDIO_RING_BUFFER_SIZE, AUDIO_RING_BUFFER_SIZE * sizeof(int16_t));
-        } else {
-            Serial.println("[Audio] Failed to allocate ring buffer!");
-        }
-    }
-
-    if (bufferMutex == nullptr) {
-        bufferMutex = xSemaphoreCreateMutex();
+    // Only samples that were written are ever read, so blocks need no zeroing
+    if (!playbackRing.init(AUDIO_POOL_PSRAM, AUDIO_RING_BUFFER_SIZE)) {
+        Serial.println("[Audio] Failed to allocate ring buffer!");
+        return;
     }
+    Serial.printf("[Audio] Ring buffer ready: up to %d samples from the PSRAM pool\n",
+                  AUDIO_RING_BUFFER_SIZE);
 
-    ringBufferHead = 0;
-    ringBufferTail = 0;
+    arrivalRing.init(arrivalStorage, AUDIO_ARRIVAL_STAMPS);
     bufferPlaying = false;
     streamFinished = false;
     samplesPlayed = 0;
@@ -189,46 +404,159 @@ static void initRingBuffer() {
     bufferReady = true;
 }
 
+// ============================================================================
+// Capture Pipeline
+// ============================================================================
+
+// Mic samples are drained from I2S by a dedicated task so a stall in loop()
+// (WebSocket send, display drawing) never backs up the I2S DMA ring.
+static BlockRing<int16_t> captureRing;
+static TaskHandle_t captureTaskHandle = nullptr;
+static volatile bool captureRestartRequested = false;
+static std::atomic<bool> captureLowLatency(true);  // Requested mic DMA geometry
+static std::atomic<uint32_t> captureStampMs(0);  // millis() when the newest ring sample was captured
+
+// Pre-roll: the capture task also keeps the last few seconds of mic audio in
+// a history buffer that always overwrites the oldest samples. It is indexed by
+// the capture ring's free-running write counter, so any range the reader has
+// consumed maps straight to a history position.
+static int16_t* historyStorage = nullptr;
+static std::atomic<size_t> historyValidFrom(0);  // Oldest index still meaningful
+static volatile uint32_t preRollSamples = (uint32_t)AUDIO_PREROLL_DEFAULT_MS * AUDIO_SAMPLE_RATE / 1000;
+
+/**
+ * Copy samples into history at absolute capture index `index`
+ * Called by the capture task *before* they're published to the capture ring
+ */
+static void appendHistory(size_t index, const int16_t* samples, size_t count) {
+    if (historyStorage == nullptr) return;
+
+    const size_t mask = AUDIO_PREROLL_HISTORY_SIZE - 1;
+    size_t start = index & mask;
+    size_t first = AUDIO_PREROLL_HISTORY_SIZE - start;
+    if (first > count) first = count;
+    memcpy(historyStorage + start, samples, first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(historyStorage, samples + first, (count - first) * sizeof(int16_t));
+    }
+}
+
+/**
+ * Read one mic DMA frame as 16-bit samples
+ * @param doneUs Arrival time of the newest sample, 0 if unknown
+ */
+static size_t readMicFrame(int16_t* buffer, size_t maxSamples, int64_t* doneUs) {
+    // INMP441 outputs 32-bit samples, we need to convert to 16-bit.
+    // Static and frame-sized: a frame of int32 on the stack would crowd
+    // the capture task.
+    static int32_t samples32[AUDIO_CAPTURE_CHUNK];
+    if (maxSamples > AUDIO_CAPTURE_CHUNK) maxSamples = AUDIO_CAPTURE_CHUNK;
+
+    size_t got = audioI2sMicRead(samples32, maxSamples, doneUs);
+    // Take the upper 16 bits
+    audioDspS32ToS16(samples32, buffer, got);
+    return got;
+}
+
+/**
+ * Audio capture task - wakes once per mic DMA frame and pushes it into the
+ * capture ring. Only this task touches the I2S RX port once it is running.
+ */
+static void audioCaptureTask(void* parameter) {
+    static int16_t chunk[AUDIO_CAPTURE_CHUNK];
+    uint32_t micSamples = 0;          // Free-running mic sample counter
+    uint32_t micClockOffset = 0;
+    bool micClockValid = false;
+    bool lowLatency = audioI2sMicFrameSamples() == AUDIO_RX_LOW_LATENCY_FRAMES;
+
+    while (true) {
+        // Geometry change requested (power level) - done here so it never
+        // races an in-flight read
+        bool wantLowLatency = captureLowLatency.load(std::memory_order_acquire);
+        if (wantLowLatency != lowLatency) {
+            bool ok = wantLowLatency
+                ? audioI2sMicReconfigure(AUDIO_RX_LOW_LATENCY_DESC, AUDIO_RX_LOW_LATENCY_FRAMES)
+                : audioI2sMicReconfigure(AUDIO_RX_POWER_SAVE_DESC, AUDIO_RX_POWER_SAVE_FRAMES);
+            if (!ok) {
+                // Port is gone - retry shortly rather than spin on failed reads
+                vTaskDelay(pdMS_TO_TICKS(100));
+                continue;
+            }
+            lowLatency = wantLowLatency;
+            micClockValid = false;  // DMA timing starts over
+            LOG_DEBUG("[Audio] Mic DMA: %u-sample frames\n", audioI2sMicFrameSamples());
+        }
+
+        if (captureRestartRequested) {
+            // Audio from before the restart shouldn't end up in a pre-roll.
+            // The port itself keeps running.
+            historyValidFrom.store(captureRing.writeIndex(), std::memory_order_release);
+            captureRestartRequested = false;
+        }
+
+        int64_t doneUs = 0;
+        size_t samplesRead = readMicFrame(chunk, AUDIO_CAPTURE_CHUNK, &doneUs);
+        if (samplesRead == 0) {
+            continue;
+        }
+        micSamples += samplesRead;
+
+        if (doneUs != 0) {
+            // Waited for DMA, so we know when the newest sample arrived
+            micClockOffset = timelineAt(doneUs) - micSamples;
+            micClockValid = true;
+        }
+
+        // Everything downstream (uplink, VAD, wake word, pre-roll) gets the
+        // echo-cancelled signal
+        if (echoEnabled && echoRefStorage != nullptr && micClockValid) {
+            cancelEcho(chunk, samplesRead, micSamples - samplesRead, micClockOffset);
+        }
+
+        // History only gets what the ring accepts so both share one index
+        size_t accepted = captureRing.freeSpace();
+        if (accepted > samplesRead) accepted = samplesRead;
+        appendHistory(captureRing.writeIndex(), chunk, accepted);
+
+        size_t written = captureRing.write(chunk, accepted);
+
+        // Per the DMA clock when known: a read that didn't block still
+        // returns samples that arrived a while ago
+        uint32_t capturedMs = millis();
+        if (micClockValid) {
+            uint32_t age = timelineNow() - (micSamples - (samplesRead - written) + micClockOffset);
+            capturedMs -= age * 1000 / AUDIO_SAMPLE_RATE;
+        }
+        captureStampMs.store(capturedMs, std::memory_order_release);
+        metricMax(METRIC_CAPTURE_BACKLOG_PEAK, captureRing.available());
+
+        if (written < samplesRead) {
+            // Consumer fell more than a ring behind - drop the newest samples
+            uint32_t dropped = metricGet(METRIC_CAPTURE_OVERRUN_SAMPLES);
+            metricAdd(METRIC_CAPTURE_OVERRUN_SAMPLES, samplesRead - written);
+            if (dropped == 0) {
+                Serial.println("[Audio] Capture ring overrun, dropping samples");
+            }
+        }
+    }
+}
+
 /**
  * Initialize I2S for microphone (input)
  */
 static bool setupMicrophone() {
     Serial.println("[Audio] Initializing microphone...");
 
-    i2s_config_t i2s_config = {
-        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
-        .sample_rate = AUDIO_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,  // INMP441 outputs 32-bit
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = AUDIO_DMA_BUF_COUNT,
-        .dma_buf_len = AUDIO_DMA_BUF_LEN,
-        .use_apll = false,
-        .tx_desc_auto_clear = false,
-        .fixed_mclk = 0
-    };
-
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = I2S_MIC_SCK,
-        .ws_io_num = I2S_MIC_WS,
-        .data_out_num = I2S_PIN_NO_CHANGE,
-        .data_in_num = I2S_MIC_SD
-    };
-
-    esp_err_t err = i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to install I2S driver for mic: %d\n", err);
+    bool lowLatency = captureLowLatency.load(std::memory_order_relaxed);
+    bool ok = lowLatency
+        ? audioI2sMicBegin(AUDIO_RX_LOW_LATENCY_DESC, AUDIO_RX_LOW_LATENCY_FRAMES)
+        : audioI2sMicBegin(AUDIO_RX_POWER_SAVE_DESC, AUDIO_RX_POWER_SAVE_FRAMES);
+    if (!ok) {
         return false;
     }
 
-    err = i2s_set_pin(I2S_NUM_0, &pin_config);
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to set I2S pins for mic: %d\n", err);
-        return false;
-    }
-
-    Serial.println("[Audio] Microphone initialized successfully");
+    Serial.printf("[Audio] Microphone initialized successfully (I2S %s, %u-sample frames)\n",
+                  audioI2sDescribe(), audioI2sMicFrameSamples());
     return true;
 }
 
@@ -245,46 +573,12 @@ static bool setupAmplifier() {
     Serial.println("[Audio] Hardware gain set to 15dB");
     #endif
 
-    i2s_config_t i2s_config = {
-        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
-        .sample_rate = AUDIO_SAMPLE_RATE,
-        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
-        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-        .dma_buf_count = AUDIO_DMA_BUF_COUNT,
-        .dma_buf_len = AUDIO_DMA_BUF_LEN,
-        .use_apll = false,
-        .tx_desc_auto_clear = true,
-        .fixed_mclk = 0
-    };
-
-    i2s_pin_config_t pin_config = {
-        .bck_io_num = I2S_AMP_BCLK,
-        .ws_io_num = I2S_AMP_LRC,
-        .data_out_num = I2S_AMP_DIN,
-        .data_in_num = I2S_PIN_NO_CHANGE
-    };
-
-    esp_err_t err = i2s_driver_install(I2S_NUM_1, &i2s_config, 0, NULL);
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to install I2S driver for amp: %d\n", err);
-        return false;
-    }
-
-    err = i2s_set_pin(I2S_NUM_1, &pin_config);
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to set I2S pins for amp: %d\n", err);
+    // Comes up silent and stopped to prevent noise
+    if (!audioI2sSpeakerBegin(AUDIO_DMA_BUF_COUNT, AUDIO_DMA_BUF_LEN)) {
         return false;
     }
 
-    // Clear DMA buffer to prevent playing garbage on startup
-    i2s_zero_dma_buffer(I2S_NUM_1);
-
     Serial.println("[Audio] Amplifier initialized successfully");
-
-    // Start with speaker disabled to prevent noise
-    i2s_stop(I2S_NUM_1);
     speakerEnabled = false;
     Serial.println("[Audio] Speaker initially disabled");
 
@@ -296,8 +590,8 @@ static bool setupAmplifier() {
  */
 void enableSpeaker() {
     if (!speakerEnabled) {
-        i2s_start(I2S_NUM_1);
-        i2s_zero_dma_buffer(I2S_NUM_1);  // Clear any garbage
+        audioI2sSpeakerStart();  // Starts from silence, never stale DMA
+        speakerClockValid.store(false, std::memory_order_release);  // Until the TX queue fills
         speakerEnabled = true;
         Serial.println("[Audio] Speaker enabled");
     }
@@ -308,8 +602,8 @@ void enableSpeaker() {
  */
 void disableSpeaker() {
     if (speakerEnabled) {
-        i2s_zero_dma_buffer(I2S_NUM_1);  // Clear buffer first
-        i2s_stop(I2S_NUM_1);
+        audioI2sSpeakerStop();
+        speakerClockValid.store(false, std::memory_order_release);
         speakerEnabled = false;
         Serial.println("[Audio] Speaker disabled");
     }
@@ -324,6 +618,7 @@ bool setupAudio() {
     if (micOk && ampOk) {
         // Initialize ring buffer for buffered playback
         initRingBuffer();
+        initEchoReference();
         Serial.println("[Audio] Audio subsystem ready");
         return true;
     }
@@ -333,52 +628,159 @@ bool setupAudio() {
 }
 
 size_t readMicrophoneData(int16_t* buffer, size_t maxSamples) {
-    // INMP441 outputs 32-bit samples, we need to convert to 16-bit
-    int32_t samples32[AUDIO_BUFFER_SIZE];
-    size_t bytesToRead = min(maxSamples, (size_t)AUDIO_BUFFER_SIZE) * sizeof(int32_t);
-    size_t bytesRead = 0;
-
-    esp_err_t err = i2s_read(I2S_NUM_0, samples32, bytesToRead, &bytesRead, portMAX_DELAY);
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to read from mic: %d\n", err);
+    size_t samplesRead = 0;
+
+    while (samplesRead < maxSamples) {
+        int64_t doneUs;
+        size_t got = readMicFrame(buffer + samplesRead, maxSamples - samplesRead, &doneUs);
+        if (got == 0) break;
+        samplesRead += got;
+    }
+
+    return samplesRead;
+}
+
+void startAudioCaptureTask() {
+    if (captureTaskHandle != nullptr) {
+        Serial.println("[Audio] Capture task already running");
+        return;
+    }
+
+    // Written every DMA frame by the capture task - internal pool, usually 1-2 blocks
+    if (!captureRing.isReady()) {
+        if (!captureRing.init(AUDIO_POOL_INTERNAL, AUDIO_CAPTURE_RING_SIZE)) {
+            Serial.println("[Audio] Failed to allocate capture ring!");
+            return;
+        }
+        Serial.printf("[Audio] Capture ring ready: up to %d samples from the internal pool\n",
+                     AUDIO_CAPTURE_RING_SIZE);
+    }
+
+    if (historyStorage == nullptr) {
+        historyStorage = (int16_t*)ps_malloc(AUDIO_PREROLL_HISTORY_SIZE * sizeof(int16_t));
+        if (historyStorage == nullptr) {
+            Serial.println("[Audio] Failed to allocate pre-roll history - pre-roll disabled");
+        }
+    }
+
+    xTaskCreatePinnedToCore(
+        audioCaptureTask,
+        "AudioCapture",
+        4096,
+        nullptr,
+        AUDIO_CAPTURE_TASK_PRIORITY,
+        &captureTaskHandle,
+        AUDIO_CAPTURE_TASK_CORE
+    );
+
+    Serial.println("[Audio] Capture task started");
+}
+
+size_t getCapturedSampleCount() {
+    return captureRing.isReady() ? captureRing.available() : 0;
+}
+
+size_t readCapturedAudio(int16_t* buffer, size_t maxSamples) {
+    if (!captureRing.isReady()) {
         return 0;
     }
+    return captureRing.read(buffer, maxSamples);
+}
 
-    size_t samplesRead = bytesRead / sizeof(int32_t);
+uint32_t getCaptureTimestampMs() {
+    if (!captureRing.isReady()) {
+        return millis();
+    }
+    size_t backlog = captureRing.available();
+    uint32_t newest = captureStampMs.load(std::memory_order_acquire);
+    return newest - (uint32_t)(backlog * 1000 / AUDIO_SAMPLE_RATE);
+}
 
-    // Convert 32-bit to 16-bit (take upper 16 bits)
-    for (size_t i = 0; i < samplesRead; i++) {
-        buffer[i] = (int16_t)(samples32[i] >> 16);
+void flushCapturedAudio() {
+    if (captureRing.isReady()) {
+        captureRing.discardAll();
     }
+}
 
-    return samplesRead;
+void setPreRollLength(uint32_t ms) {
+    if (ms > AUDIO_PREROLL_MAX_MS) ms = AUDIO_PREROLL_MAX_MS;
+    preRollSamples = ms * AUDIO_SAMPLE_RATE / 1000;
+}
+
+uint32_t getPreRollLength() {
+    return preRollSamples * 1000 / AUDIO_SAMPLE_RATE;
+}
+
+size_t readPreRollAudio(int16_t* buffer, size_t maxSamples) {
+    if (historyStorage == nullptr || !captureRing.isReady()) {
+        return 0;
+    }
+
+    // Pre-roll ends where the reader's next live sample begins
+    size_t end = captureRing.readIndex();
+    size_t count = preRollSamples;
+    if (count > maxSamples) count = maxSamples;
+
+    size_t validFrom = historyValidFrom.load(std::memory_order_acquire);
+    if ((ptrdiff_t)(end - validFrom) < (ptrdiff_t)count) {
+        count = (ptrdiff_t)(end - validFrom) > 0 ? end - validFrom : 0;
+    }
+    if (count == 0) return 0;
+
+    size_t start = end - count;
+    const size_t mask = AUDIO_PREROLL_HISTORY_SIZE - 1;
+    size_t first = AUDIO_PREROLL_HISTORY_SIZE - (start & mask);
+    if (first > count) first = count;
+    memcpy(buffer, historyStorage + (start & mask), first * sizeof(int16_t));
+    if (count > first) {
+        memcpy(buffer + first, historyStorage, (count - first) * sizeof(int16_t));
+    }
+
+    // The capture task may have lapped the oldest samples while we copied;
+    // drop whatever it overwrote rather than send torn audio
+    size_t newest = captureRing.writeIndex() + AUDIO_CAPTURE_CHUNK;
+    if (newest - start > AUDIO_PREROLL_HISTORY_SIZE) {
+        size_t torn = newest - start - AUDIO_PREROLL_HISTORY_SIZE;
+        if (torn >= count) return 0;
+        memmove(buffer, buffer + torn, (count - torn) * sizeof(int16_t));
+        count -= torn;
+    }
+
+    return count;
+}
+
+uint32_t getCaptureOverruns() {
+    return metricGet(METRIC_CAPTURE_OVERRUN_SAMPLES);
 }
 
 size_t playAudioData(const int16_t* samples, size_t count) {
-    // Create a copy to apply volume (don't modify original)
-    int16_t* volumeAdjusted = (int16_t*)malloc(count * sizeof(int16_t));
+    // Volume is applied to a copy (don't modify original), one pool block at a time
+    int16_t* volumeAdjusted = (int16_t*)audioPoolAlloc(AUDIO_POOL_INTERNAL);
     if (!volumeAdjusted) {
         Serial.println("[Audio] Failed to allocate volume buffer");
         return 0;
     }
 
-    memcpy(volumeAdjusted, samples, count * sizeof(int16_t));
-    applyVolume(volumeAdjusted, count);
-
-    size_t bytesWritten = 0;
+    const size_t blockSamples = AUDIO_POOL_BLOCK_BYTES / sizeof(int16_t);
+    size_t played = 0;
     audioPlaying = true;
 
-    esp_err_t err = i2s_write(I2S_NUM_1, volumeAdjusted, count * sizeof(int16_t), &bytesWritten, portMAX_DELAY);
-
-    free(volumeAdjusted);
+    while (played < count) {
+        size_t n = min(count - played, blockSamples);
+        memcpy(volumeAdjusted, samples + played, n * sizeof(int16_t));
+        applyVolume(volumeAdjusted, n);
 
-    if (err != ESP_OK) {
-        Serial.printf("[Audio] Failed to write to amp: %d\n", err);
-        audioPlaying = false;
-        return 0;
+        size_t written = audioI2sSpeakerWrite(volumeAdjusted, n);
+        if (written == 0) {
+            audioPlaying = false;
+            audioPoolFree(volumeAdjusted);
+            return 0;
+        }
+        played += written;
     }
 
-    return bytesWritten / sizeof(int16_t);
+    audioPoolFree(volumeAdjusted);
+    return played;
 }
 
 // ============================================================================
@@ -386,31 +788,30 @@ size_t playAudioData(const int16_t* samples, size_t count) {
 // ============================================================================
 
 size_t queueAudioData(const int16_t* samples, size_t count) {
-    if (audioRingBuffer == nullptr || bufferMutex == nullptr) {
+    if (!bufferReady) {
         Serial.println("[Audio] Ring buffer not initialized!");
         return 0;
     }
 
-    if (xSemaphoreTake(bufferMutex, pdMS_TO_TICKS(50)) != pdTRUE) {
-        Serial.println("[Audio] Failed to acquire buffer mutex");
-        return 0;
+    if (!bufferPlaying && playbackRing.available() == 0) {
+        bufferingSince = millis();  // Start of time-to-first-audio
     }
 
-    size_t freeSpace = getBufferFreeSpace();
-    size_t toWrite = min(count, freeSpace);
+    size_t written = playbackRing.write(samples, count);
 
-    if (toWrite < count) {
-        Serial.printf("[Audio] Buffer full, dropping %d samples\n", count - toWrite);
+    if (written < count) {
+        metricAdd(METRIC_PLAYBACK_DROPPED_SAMPLES, count - written);
+        LOG_DEBUG("[Audio] Buffer full, dropping %d samples\n", count - written);
     }
 
-    for (size_t i = 0; i < toWrite; i++) {
-        audioRingBuffer[ringBufferHead] = samples[i];
-        ringBufferHead = (ringBufferHead + 1) % AUDIO_RING_BUFFER_SIZE;
-    }
+    return written;
+}
 
-    xSemaphoreGive(bufferMutex);
+void markPlaybackArrival(uint32_t receivedMs, bool firstOfResponse) {
+    if (!bufferReady) return;
 
-    return toWrite;
+    ArrivalStamp stamp = {playbackRing.writeIndex(), receivedMs, firstOfResponse};
+    arrivalRing.write(&stamp, 1);  // Full: this frame just goes unmeasured
 }
 
 void startAudioPlaybackTask() {
@@ -437,52 +838,109 @@ void finishAudioStream() {
     streamFinished = true;
 }
 
+void clearPlaybackBuffer() {
+    // Called from the producer side: record how far we've written and let the
+    // playback task discard up to that point and turn the speaker off
+    streamFinished = false;
+    if (playbackTaskHandle != nullptr && bufferReady) {
+        flushMark.store(playbackRing.writeIndex(), std::memory_order_release);
+        flushRequested.store(true, std::memory_order_release);
+    } else {
+        disableSpeaker();  // Turn off speaker to stop any noise
+    }
+}
+
 void clearAudioBuffer() {
-    if (xSemaphoreTake(bufferMutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-        ringBufferHead = 0;
-        ringBufferTail = 0;
-        bufferPlaying = false;
-        streamFinished = false;
-        xSemaphoreGive(bufferMutex);
-    }
-    disableSpeaker();  // Turn off speaker to stop any noise
+    clearPlaybackBuffer();
     // Also clear microphone buffer to ensure fresh start
-    i2s_zero_dma_buffer(I2S_NUM_0);
+    if (captureTaskHandle != nullptr) {
+        flushCapturedAudio();
+    } else {
+        audioI2sMicDiscard();
+    }
     Serial.println("[Audio] Audio buffer cleared");
 }
 
+void setPlaybackStartThreshold(size_t samples) {
+    startThreshold.store(samples, std::memory_order_relaxed);
+}
+
+void setPlaybackTargetLead(size_t samples) {
+    rebufferThreshold.store(samples, std::memory_order_relaxed);
+}
+
+void getPlaybackStats(PlaybackStats* stats) {
+    stats->underruns = metricGet(METRIC_PLAYBACK_UNDERRUNS);
+    stats->responseUnderruns = responseUnderruns;
+    stats->startThreshold = startThreshold.load(std::memory_order_relaxed);
+    stats->targetLead = rebufferThreshold.load(std::memory_order_relaxed);
+    stats->buffered = getBufferedSamples();
+    stats->lastStartDelayMs = lastStartDelayMs;
+}
+
 bool isBufferedAudioPlaying() {
     return bufferPlaying || getBufferedSamples() > 0;
 }
 
+static Vad vad(AUDIO_SAMPLE_RATE);
+
 bool detectVoiceActivity(const int16_t* samples, size_t count) {
     if (count == 0) return false;
 
-    // Calculate RMS energy
-    int64_t sum = 0;
-    for (size_t i = 0; i < count; i++) {
-        int64_t sample = samples[i];
-        sum += sample * sample;
+    bool speech = vad.process(samples, count);
+
+#if MOTE_LOG_LEVEL >= MOTE_LOG_DEBUG
+    // Log levels periodically to check the floor tracks the room
+    static unsigned long lastVadLog = 0;
+    if (millis() - lastVadLog > 2000) {
+        VadStats stats;
+        vad.getStats(&stats);
+        Serial.printf("[VAD] energy: %.1fdB, floor: %.1fdB, zcr: %.2f, speech: %d\n",
+                      stats.energyDb, stats.noiseFloorDb, stats.zcr, stats.speech);
+        lastVadLog = millis();
     }
+#endif
 
-    float rms = sqrtf((float)sum / count);
+    return speech;
+}
+
+void setEchoCancellation(bool enabled) {
+    echoEnabled = enabled;
+    Serial.printf("[Audio] Echo cancellation %s\n", enabled ? "enabled" : "disabled");
+}
+
+bool isEchoCancellationActive() {
+    return echoEnabled && echoRefStorage != nullptr && captureTaskHandle != nullptr;
+}
+
+void getEchoStats(EchoStats* stats) {
+    AecStats aec;
+    echoCanceller.getStats(&aec);
+    stats->enabled = isEchoCancellationActive();
+    stats->aligned = speakerClockValid.load(std::memory_order_relaxed);
+    stats->erleDb = aec.erleDb;
+    stats->couplingGain = aec.couplingGain;
+    stats->doubleTalk = aec.doubleTalk;
+    stats->filterResets = aec.resets;
+    stats->resyncs = echoResyncs;
+}
 
-    // Debug: Log RMS periodically to calibrate threshold
-    static unsigned long lastRmsLog = 0;
-    static float maxRms = 0;
-    if (rms > maxRms) maxRms = rms;
-    if (millis() - lastRmsLog > 2000) {
-        Serial.printf("[VAD] RMS: %.1f, max: %.1f, threshold: %.1f\n", rms, maxRms, VAD_THRESHOLD);
-        maxRms = 0;
-        lastRmsLog = millis();
+uint16_t getPlaybackEnvelope() {
+    if (!bufferPlaying || !speakerClockValid.load(std::memory_order_acquire)) return 0;
+
+    uint32_t playing = timelineNow() - speakerClockOffset.load(std::memory_order_relaxed);
+    int32_t queued = (int32_t)(echoRefWritten.load(std::memory_order_acquire) - playing);
+    if (queued <= 0 || queued > (int32_t)((AUDIO_ENVELOPE_SLOTS - 1) * AUDIO_ENVELOPE_BLOCK)) {
+        return 0;  // Ran dry, or the clock is stale
     }
 
-    return rms > VAD_THRESHOLD;
+    return envelopeSlots[(playing / AUDIO_ENVELOPE_BLOCK) % AUDIO_ENVELOPE_SLOTS].load(std::memory_order_relaxed);
 }
 
 void setVolume(uint8_t volume) {
     if (volume > 100) volume = 100;
     currentVolume = volume;
+    playbackGainQ12 = audioDspGainFromVolume(currentVolume, softwareGain);
     Serial.printf("[Audio] Volume set to %d%%\n", currentVolume);
 }
 
@@ -494,11 +952,12 @@ void setGain(uint16_t gain) {
     if (gain < 100) gain = 100;  // Minimum 1.0x
     if (gain > 400) gain = 400;  // Maximum 4.0x to prevent extreme clipping
     softwareGain = gain;
+    playbackGainQ12 = audioDspGainFromVolume(currentVolume, softwareGain);
     Serial.printf("[Audio] Software gain set to %.1fx\n", gain / 100.0);
 }
 
 void stopAudioPlayback() {
-    i2s_zero_dma_buffer(I2S_NUM_1);
+    audioI2sSpeakerSilence();
     audioPlaying = false;
 }
 
@@ -507,13 +966,20 @@ bool isAudioPlaying() {
 }
 
 void restartMicrophone() {
-    Serial.println("[Audio] Restarting microphone I2S...");
-    
-    // Stop and restart the I2S driver to clear any stale state
-    i2s_stop(I2S_NUM_0);
-    i2s_zero_dma_buffer(I2S_NUM_0);
-    delay(10);  // Brief pause to let hardware settle
-    i2s_start(I2S_NUM_0);
-    
-    Serial.println("[Audio] Microphone I2S restarted");
+    LOG_DEBUG("[Audio] Restarting microphone capture\n");
+
+    if (captureTaskHandle != nullptr) {
+        // The port keeps running (no DMA restart, the mic clock stays
+        // aligned) - just drop what was captured before now, ring and
+        // pre-roll history alike
+        captureRestartRequested = true;
+        flushCapturedAudio();
+        return;
+    }
+
+    audioI2sMicDiscard();
+}
+
+void setCaptureLowLatency(bool lowLatency) {
+    captureLowLatency.store(lowLatency, std::memory_order_release);
 }
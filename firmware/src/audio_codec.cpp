@@ -0,0 +1,284 @@
+#include "audio_codec.h"
+#include <string.h>
+
+#ifdef MOTE_CODEC_OPUS
+#include <opus.h>
+#include <esp_heap_caps.h>
+#endif
+
+// ============================================================================
+// Codec names
+// ============================================================================
+
+const char* audioCodecName(AudioCodec codec) {
+    switch (codec) {
+        case AUDIO_CODEC_ADPCM: return "adpcm";
+        case AUDIO_CODEC_OPUS:  return "opus";
+        default:                return "pcm";
+    }
+}
+
+bool audioCodecFromName(const char* name, AudioCodec* codec) {
+    if (name == nullptr) return false;
+
+    AudioCodec found;
+    if (strcmp(name, "pcm") == 0 || strcmp(name, "pcm_16000") == 0) {
+        found = AUDIO_CODEC_PCM16;
+    } else if (strcmp(name, "adpcm") == 0) {
+        found = AUDIO_CODEC_ADPCM;
+    } else if (strcmp(name, "opus") == 0) {
+        found = AUDIO_CODEC_OPUS;
+    } else {
+        return false;
+    }
+
+    if (!audioCodecAvailable(found)) return false;
+    *codec = found;
+    return true;
+}
+
+bool audioCodecAvailable(AudioCodec codec) {
+    switch (codec) {
+        case AUDIO_CODEC_PCM16:
+        case AUDIO_CODEC_ADPCM:
+            return true;
+        case AUDIO_CODEC_OPUS:
+#ifdef MOTE_CODEC_OPUS
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+// ============================================================================
+// IMA-ADPCM
+// ============================================================================
+
+static const int16_t adpcmStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int8_t adpcmIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * Apply one 4-bit code to the predictor (shared by encoder and decoder so
+ * both sides track exactly the same state)
+ */
+static inline void adpcmStep(AdpcmState* state, uint8_t code) {
+    int step = adpcmStepTable[state->index];
+    int diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+
+    int predictor = state->predictor;
+    predictor += (code & 8) ? -diff : diff;
+    if (predictor > 32767) predictor = 32767;
+    if (predictor < -32768) predictor = -32768;
+    state->predictor = (int16_t)predictor;
+
+    int index = state->index + adpcmIndexTable[code];
+    if (index < 0) index = 0;
+    if (index > 88) index = 88;
+    state->index = (uint8_t)index;
+}
+
+static inline uint8_t adpcmEncodeSample(AdpcmState* state, int16_t sample) {
+    int step = adpcmStepTable[state->index];
+    int diff = (int)sample - state->predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; }
+
+    adpcmStep(state, code);
+    return code;
+}
+
+void adpcmReset(AdpcmState* state) {
+    state->predictor = 0;
+    state->index = 0;
+}
+
+size_t adpcmEncodeBlock(AdpcmState* state, const int16_t* pcm, size_t samples, uint8_t* out) {
+    // Header: state *before* this block so the decoder can start cold
+    out[0] = (uint8_t)(state->predictor & 0xFF);
+    out[1] = (uint8_t)((uint16_t)state->predictor >> 8);
+    out[2] = state->index;
+    out[3] = 0;
+
+    uint8_t* p = out + ADPCM_HEADER_BYTES;
+    for (size_t i = 0; i < samples; i += 2) {
+        uint8_t lo = adpcmEncodeSample(state, pcm[i]);
+        uint8_t hi = (i + 1 < samples) ? adpcmEncodeSample(state, pcm[i + 1]) : 0;
+        *p++ = (uint8_t)(lo | (hi << 4));
+    }
+
+    return ADPCM_BLOCK_BYTES(samples);
+}
+
+size_t adpcmDecodeBlock(const uint8_t* in, size_t bytes, int16_t* out) {
+    if (bytes < ADPCM_HEADER_BYTES) return 0;
+
+    AdpcmState state;
+    state.predictor = (int16_t)((uint16_t)in[0] | ((uint16_t)in[1] << 8));
+    state.index = in[2] > 88 ? 88 : in[2];
+
+    size_t count = 0;
+    for (size_t i = ADPCM_HEADER_BYTES; i < bytes; i++) {
+        adpcmStep(&state, in[i] & 0x0F);
+        out[count++] = state.predictor;
+        adpcmStep(&state, in[i] >> 4);
+        out[count++] = state.predictor;
+    }
+    return count;
+}
+
+// ============================================================================
+// Frame encoder
+// ============================================================================
+
+bool audioEncoderInit(AudioEncoder* encoder, AudioCodec codec) {
+    if (!audioCodecAvailable(codec)) return false;
+
+    encoder->codec = codec;
+    adpcmReset(&encoder->adpcm);
+
+#ifdef MOTE_CODEC_OPUS
+    if (codec == AUDIO_CODEC_OPUS && encoder->opus == nullptr) {
+        // ~20KB of encoder state - keep it in PSRAM, it's touched once per frame
+        int size = opus_encoder_get_size(1);
+        OpusEncoder* enc = (OpusEncoder*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (enc == nullptr) return false;
+        if (opus_encoder_init(enc, 16000, 1, OPUS_APPLICATION_VOIP) != OPUS_OK) {
+            heap_caps_free(enc);
+            return false;
+        }
+        opus_encoder_ctl(enc, OPUS_SET_BITRATE(MOTE_OPUS_BITRATE));
+        opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(MOTE_OPUS_COMPLEXITY));
+        opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+        opus_encoder_ctl(enc, OPUS_SET_VBR(1));
+        encoder->opus = enc;
+    }
+#endif
+
+    return true;
+}
+
+void audioEncoderReset(AudioEncoder* encoder) {
+    adpcmReset(&encoder->adpcm);
+#ifdef MOTE_CODEC_OPUS
+    if (encoder->opus != nullptr) {
+        opus_encoder_ctl((OpusEncoder*)encoder->opus, OPUS_RESET_STATE);
+    }
+#endif
+}
+
+size_t audioEncoderEncode(AudioEncoder* encoder, const int16_t* frame, uint8_t* out, size_t maxOut) {
+    switch (encoder->codec) {
+        case AUDIO_CODEC_ADPCM:
+            if (maxOut < ADPCM_BLOCK_BYTES(AUDIO_CODEC_FRAME_SAMPLES)) return 0;
+            return adpcmEncodeBlock(&encoder->adpcm, frame, AUDIO_CODEC_FRAME_SAMPLES, out);
+
+#ifdef MOTE_CODEC_OPUS
+        case AUDIO_CODEC_OPUS: {
+            if (encoder->opus == nullptr) return 0;
+            opus_int32 len = opus_encode((OpusEncoder*)encoder->opus, frame,
+                                         AUDIO_CODEC_FRAME_SAMPLES, out, (opus_int32)maxOut);
+            return len > 0 ? (size_t)len : 0;
+        }
+#endif
+
+        default:
+            // PCM is sent as-is and never goes through the encoder
+            return 0;
+    }
+}
+
+// ============================================================================
+// Packet decoder
+// ============================================================================
+
+bool audioDecoderInit(AudioDecoder* decoder, AudioCodec codec) {
+    if (!audioCodecAvailable(codec)) return false;
+
+    decoder->codec = codec;
+
+#ifdef MOTE_CODEC_OPUS
+    if (codec == AUDIO_CODEC_OPUS && decoder->opus == nullptr) {
+        int size = opus_decoder_get_size(1);
+        OpusDecoder* dec = (OpusDecoder*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        if (dec == nullptr) return false;
+        if (opus_decoder_init(dec, 16000, 1) != OPUS_OK) {
+            heap_caps_free(dec);
+            return false;
+        }
+        decoder->opus = dec;
+    }
+#endif
+
+    return true;
+}
+
+void audioDecoderReset(AudioDecoder* decoder) {
+#ifdef MOTE_CODEC_OPUS
+    if (decoder->opus != nullptr) {
+        opus_decoder_ctl((OpusDecoder*)decoder->opus, OPUS_RESET_STATE);
+    }
+#else
+    (void)decoder;      // ADPCM blocks are self-contained - nothing to reset
+#endif
+}
+
+size_t audioDecoderDecode(AudioDecoder* decoder, const uint8_t* packet, size_t len,
+                          int16_t* out, size_t maxSamples) {
+    switch (decoder->codec) {
+        case AUDIO_CODEC_ADPCM:
+            if (len < ADPCM_HEADER_BYTES || (len - ADPCM_HEADER_BYTES) * 2 > maxSamples) return 0;
+            return adpcmDecodeBlock(packet, len, out);
+
+#ifdef MOTE_CODEC_OPUS
+        case AUDIO_CODEC_OPUS: {
+            if (decoder->opus == nullptr) return 0;
+            int n = opus_decode((OpusDecoder*)decoder->opus, packet, (opus_int32)len,
+                                out, (int)maxSamples, 0);
+            return n > 0 ? (size_t)n : 0;
+        }
+#endif
+
+        case AUDIO_CODEC_PCM16: {
+            size_t n = len / sizeof(int16_t);
+            if (n > maxSamples) n = maxSamples;
+            memcpy(out, packet, n * sizeof(int16_t));
+            return n;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+size_t audioCodecEstimateSamples(AudioCodec codec, size_t bytes) {
+    switch (codec) {
+        case AUDIO_CODEC_ADPCM: return bytes * 2;                          // 4 bits/sample
+        case AUDIO_CODEC_OPUS:  return bytes * 8 * 16000 / MOTE_OPUS_BITRATE;
+        default:                return bytes / sizeof(int16_t);
+    }
+}
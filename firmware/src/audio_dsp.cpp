@@ -0,0 +1,233 @@
+#include "audio_dsp.h"
+#include <string.h>
+
+static inline int16_t saturate16(int32_t v) {
+    // Branchless on Xtensa: min/max compile to single instructions
+    v = v > 32767 ? 32767 : v;
+    v = v < -32768 ? -32768 : v;
+    return (int16_t)v;
+}
+
+// ============================================================================
+// Scalar references
+// ============================================================================
+
+void audioDspS32ToS16Ref(const int32_t* in, int16_t* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (int16_t)(in[i] >> 16);
+    }
+}
+
+void audioDspGainRef(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t scaled = ((int32_t)in[i] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT;
+        if (scaled > 32767) scaled = 32767;
+        if (scaled < -32768) scaled = -32768;
+        out[i] = (int16_t)scaled;
+    }
+}
+
+uint32_t audioDspGainPeakRef(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12) {
+    audioDspGainRef(in, out, count, gainQ12);
+    return audioDspPeakRef(out, count);
+}
+
+uint64_t audioDspEnergyRef(const int16_t* samples, size_t count) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        int64_t s = samples[i];
+        sum += (uint64_t)(s * s);
+    }
+    return sum;
+}
+
+int64_t audioDspDotRef(const int16_t* a, const int16_t* b, size_t count) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += (int64_t)a[i] * b[i];
+    }
+    return sum;
+}
+
+uint32_t audioDspPeakRef(const int16_t* samples, size_t count) {
+    uint32_t peak = 0;
+    for (size_t i = 0; i < count; i++) {
+        int32_t s = samples[i];
+        uint32_t mag = (uint32_t)(s < 0 ? -s : s);
+        if (mag > peak) peak = mag;
+    }
+    return peak;
+}
+
+// ============================================================================
+// Optimized kernels
+// ============================================================================
+
+void audioDspS32ToS16(const int32_t* in, int16_t* out, size_t count) {
+    size_t i = 0;
+
+    // Align the output to a word so pairs can be stored with one write
+    if (((uintptr_t)out & 3) != 0 && count > 0) {
+        out[0] = (int16_t)(in[0] >> 16);
+        i = 1;
+    }
+
+    // Little-endian: the upper halfword of each input is the result, so two
+    // samples pack into one output word with a shift and a mask
+    for (; i + 4 <= count; i += 4) {
+        uint32_t a = (uint32_t)in[i], b = (uint32_t)in[i + 1];
+        uint32_t c = (uint32_t)in[i + 2], d = (uint32_t)in[i + 3];
+        uint32_t pair[2] = {(a >> 16) | (b & 0xFFFF0000u), (c >> 16) | (d & 0xFFFF0000u)};
+        memcpy(out + i, pair, sizeof(pair));  // Aligned, becomes two word stores
+    }
+
+    for (; i < count; i++) {
+        out[i] = (int16_t)(in[i] >> 16);
+    }
+}
+
+void audioDspGain(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12) {
+    if (gainQ12 == AUDIO_DSP_GAIN_UNITY) {
+        if (in != out) memmove(out, in, count * sizeof(int16_t));
+        return;
+    }
+
+    size_t i = 0;
+
+    if (gainQ12 >= 0 && gainQ12 <= AUDIO_DSP_GAIN_UNITY) {
+        // Attenuation can't overflow - skip the clamp entirely
+        for (; i + 4 <= count; i += 4) {
+            int32_t a = in[i], b = in[i + 1], c = in[i + 2], d = in[i + 3];
+            out[i]     = (int16_t)((a * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 1] = (int16_t)((b * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 2] = (int16_t)((c * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 3] = (int16_t)((d * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+        }
+    } else {
+        for (; i + 4 <= count; i += 4) {
+            int32_t a = in[i], b = in[i + 1], c = in[i + 2], d = in[i + 3];
+            out[i]     = saturate16((a * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 1] = saturate16((b * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 2] = saturate16((c * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i + 3] = saturate16((d * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+        }
+    }
+
+    for (; i < count; i++) {
+        out[i] = saturate16(((int32_t)in[i] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+    }
+}
+
+uint32_t audioDspGainPeak(const int16_t* in, int16_t* out, size_t count, int32_t gainQ12) {
+    // Same structure as audioDspGain(); max/min ride along on the results
+    // while they're still in registers
+    int32_t hi = 0, lo = 0;
+    size_t i = 0;
+
+    if (gainQ12 >= 0 && gainQ12 <= AUDIO_DSP_GAIN_UNITY) {
+        for (; i + 4 <= count; i += 4) {
+            int32_t a = (in[i] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT;
+            int32_t b = (in[i + 1] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT;
+            int32_t c = (in[i + 2] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT;
+            int32_t d = (in[i + 3] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT;
+            out[i] = (int16_t)a; out[i + 1] = (int16_t)b;
+            out[i + 2] = (int16_t)c; out[i + 3] = (int16_t)d;
+            int32_t mx0 = a > b ? a : b, mx1 = c > d ? c : d;
+            int32_t mn0 = a < b ? a : b, mn1 = c < d ? c : d;
+            hi = mx0 > hi ? mx0 : hi; hi = mx1 > hi ? mx1 : hi;
+            lo = mn0 < lo ? mn0 : lo; lo = mn1 < lo ? mn1 : lo;
+        }
+    } else {
+        for (; i + 4 <= count; i += 4) {
+            int32_t a = saturate16((in[i] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            int32_t b = saturate16((in[i + 1] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            int32_t c = saturate16((in[i + 2] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            int32_t d = saturate16((in[i + 3] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+            out[i] = (int16_t)a; out[i + 1] = (int16_t)b;
+            out[i + 2] = (int16_t)c; out[i + 3] = (int16_t)d;
+            int32_t mx0 = a > b ? a : b, mx1 = c > d ? c : d;
+            int32_t mn0 = a < b ? a : b, mn1 = c < d ? c : d;
+            hi = mx0 > hi ? mx0 : hi; hi = mx1 > hi ? mx1 : hi;
+            lo = mn0 < lo ? mn0 : lo; lo = mn1 < lo ? mn1 : lo;
+        }
+    }
+
+    for (; i < count; i++) {
+        int32_t s = saturate16(((int32_t)in[i] * gainQ12) >> AUDIO_DSP_GAIN_SHIFT);
+        out[i] = (int16_t)s;
+        hi = s > hi ? s : hi;
+        lo = s < lo ? s : lo;
+    }
+
+    uint32_t neg = (uint32_t)(-lo);
+    return neg > (uint32_t)hi ? neg : (uint32_t)hi;
+}
+
+uint64_t audioDspEnergy(const int16_t* samples, size_t count) {
+    uint64_t sum = 0;
+    size_t i = 0;
+
+    // Each square is at most 2^30, so two fit in 32 bits: one 64-bit add per pair
+    for (; i + 4 <= count; i += 4) {
+        int32_t a = samples[i], b = samples[i + 1], c = samples[i + 2], d = samples[i + 3];
+        sum += (uint32_t)(a * a) + (uint32_t)(b * b);
+        sum += (uint32_t)(c * c) + (uint32_t)(d * d);
+    }
+
+    for (; i < count; i++) {
+        int32_t s = samples[i];
+        sum += (uint32_t)(s * s);
+    }
+    return sum;
+}
+
+int64_t audioDspDot(const int16_t* a, const int16_t* b, size_t count) {
+    int64_t sum = 0;
+    size_t i = 0;
+
+    // Each product fits in an int32 (at most 2^30); a pair may not, so
+    // pairs are summed in 64 bits
+    for (; i + 4 <= count; i += 4) {
+        int32_t p0 = (int32_t)a[i] * b[i];
+        int32_t p1 = (int32_t)a[i + 1] * b[i + 1];
+        int32_t p2 = (int32_t)a[i + 2] * b[i + 2];
+        int32_t p3 = (int32_t)a[i + 3] * b[i + 3];
+        sum += (int64_t)p0 + p1;
+        sum += (int64_t)p2 + p3;
+    }
+
+    for (; i < count; i++) {
+        sum += (int32_t)a[i] * b[i];
+    }
+    return sum;
+}
+
+uint32_t audioDspPeak(const int16_t* samples, size_t count) {
+    // Track max and min separately - no abs() per sample
+    int32_t hi = 0, lo = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        int32_t a = samples[i], b = samples[i + 1], c = samples[i + 2], d = samples[i + 3];
+        int32_t mx0 = a > b ? a : b, mx1 = c > d ? c : d;
+        int32_t mn0 = a < b ? a : b, mn1 = c < d ? c : d;
+        int32_t mx = mx0 > mx1 ? mx0 : mx1;
+        int32_t mn = mn0 < mn1 ? mn0 : mn1;
+        hi = mx > hi ? mx : hi;
+        lo = mn < lo ? mn : lo;
+    }
+
+    for (; i < count; i++) {
+        int32_t s = samples[i];
+        hi = s > hi ? s : hi;
+        lo = s < lo ? s : lo;
+    }
+
+    uint32_t neg = (uint32_t)(-lo);
+    return neg > (uint32_t)hi ? neg : (uint32_t)hi;
+}
+
+int32_t audioDspGainFromVolume(uint8_t volume, uint16_t softwareGain) {
+    // volume% * gain/100, rounded to Q12
+    return ((int32_t)volume * softwareGain * AUDIO_DSP_GAIN_UNITY + 5000) / 10000;
+}
@@ -0,0 +1,362 @@
+#include "audio_i2s.h"
+#include "audio.h"
+#include <esp_idf_version.h>
+#include <esp_timer.h>
+#include <soc/soc_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <atomic>
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+#define AUDIO_I2S_STD 1
+#include <driver/i2s_std.h>
+#else
+#define AUDIO_I2S_STD 0
+#include <driver/i2s.h>
+#endif
+
+#define AUDIO_I2S_BLOCKED_US    1000    // A read waiting this long was paced by DMA
+
+#if SOC_I2S_SUPPORTS_APLL
+#define AUDIO_I2S_USE_APLL      true
+#define AUDIO_I2S_CLOCK_NAME    "apll"
+#else
+#define AUDIO_I2S_USE_APLL      false   // ESP32-S3: no APLL, PLL_160M with a fractional divider
+#define AUDIO_I2S_CLOCK_NAME    "pll"
+#endif
+
+static uint16_t micFrameSamples = 0;
+
+uint16_t audioI2sMicFrameSamples() {
+    return micFrameSamples;
+}
+
+#if AUDIO_I2S_STD
+
+static i2s_chan_handle_t micChannel = nullptr;
+static i2s_chan_handle_t speakerChannel = nullptr;
+static bool speakerRunning = false;
+static std::atomic<int64_t> micFrameDoneUs(0);   // Set by the on_recv callback
+
+#if SOC_I2S_SUPPORTS_APLL
+#define AUDIO_I2S_CLK_SRC       I2S_CLK_SRC_APLL
+#else
+#define AUDIO_I2S_CLK_SRC       I2S_CLK_SRC_DEFAULT
+#endif
+
+/**
+ * DMA frame complete (ISR) - only the timestamp; the reader is woken by the
+ * driver's own queue
+ */
+static bool IRAM_ATTR onMicFrame(i2s_chan_handle_t handle, i2s_event_data_t* event, void* context) {
+    micFrameDoneUs.store(esp_timer_get_time(), std::memory_order_release);
+    return false;
+}
+
+static i2s_std_config_t stdConfig(i2s_data_bit_width_t bits, int bclk, int ws, int dout, int din) {
+    i2s_std_config_t config = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(AUDIO_SAMPLE_RATE),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(bits, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = (gpio_num_t)bclk,
+            .ws = (gpio_num_t)ws,
+            .dout = (gpio_num_t)dout,
+            .din = (gpio_num_t)din,
+            .invert_flags = {false, false, false},
+        },
+    };
+    config.clk_cfg.clk_src = AUDIO_I2S_CLK_SRC;
+    config.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;   // L/R pin low (mic), left channel (amp)
+    return config;
+}
+
+bool audioI2sMicBegin(uint16_t descCount, uint16_t frameSamples) {
+    i2s_chan_config_t chan = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan.dma_desc_num = descCount;
+    chan.dma_frame_num = frameSamples;
+
+    esp_err_t err = i2s_new_channel(&chan, nullptr, &micChannel);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to create I2S channel for mic: %d\n", err);
+        return false;
+    }
+
+    // INMP441 sends 24 bits in a 32-bit slot
+    i2s_std_config_t config = stdConfig(I2S_DATA_BIT_WIDTH_32BIT, I2S_MIC_SCK, I2S_MIC_WS,
+                                        I2S_GPIO_UNUSED, I2S_MIC_SD);
+    i2s_event_callbacks_t callbacks = {};
+    callbacks.on_recv = onMicFrame;
+
+    err = i2s_channel_init_std_mode(micChannel, &config);
+    if (err == ESP_OK) err = i2s_channel_register_event_callback(micChannel, &callbacks, nullptr);
+    if (err == ESP_OK) err = i2s_channel_enable(micChannel);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to start I2S mic: %d\n", err);
+        i2s_del_channel(micChannel);
+        micChannel = nullptr;
+        return false;
+    }
+
+    micFrameSamples = frameSamples;
+    return true;
+}
+
+bool audioI2sMicReconfigure(uint16_t descCount, uint16_t frameSamples) {
+    if (micChannel != nullptr) {
+        i2s_channel_disable(micChannel);
+        i2s_del_channel(micChannel);
+        micChannel = nullptr;
+    }
+    return audioI2sMicBegin(descCount, frameSamples);
+}
+
+size_t audioI2sMicRead(int32_t* out, size_t maxSamples, int64_t* doneUs) {
+    size_t want = maxSamples < micFrameSamples ? maxSamples : micFrameSamples;
+    size_t bytesRead = 0;
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = i2s_channel_read(micChannel, out, want * sizeof(int32_t), &bytesRead, portMAX_DELAY);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to read from mic: %d\n", err);
+        return 0;
+    }
+
+    // Waited for the frame, so the callback just stamped its completion
+    *doneUs = esp_timer_get_time() - start > AUDIO_I2S_BLOCKED_US
+                  ? micFrameDoneUs.load(std::memory_order_acquire) : 0;
+    return bytesRead / sizeof(int32_t);
+}
+
+void audioI2sMicDiscard() {
+    static int32_t scratch[64];
+    size_t bytesRead = 0;
+    while (micChannel != nullptr &&
+           i2s_channel_read(micChannel, scratch, sizeof(scratch), &bytesRead, 0) == ESP_OK &&
+           bytesRead > 0) {
+    }
+}
+
+/**
+ * Fill the (disabled) TX DMA with zeros so enabling it starts silent
+ */
+static void preloadSilence() {
+    static const int16_t zeros[256] = {};
+    size_t loaded = sizeof(zeros);
+    while (loaded == sizeof(zeros)) {
+        if (i2s_channel_preload_data(speakerChannel, zeros, sizeof(zeros), &loaded) != ESP_OK) break;
+    }
+}
+
+bool audioI2sSpeakerBegin(uint16_t descCount, uint16_t frameSamples) {
+    i2s_chan_config_t chan = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_1, I2S_ROLE_MASTER);
+    chan.dma_desc_num = descCount;
+    chan.dma_frame_num = frameSamples;
+    chan.auto_clear = true;      // Underrun plays silence, not the last buffer again
+
+    esp_err_t err = i2s_new_channel(&chan, &speakerChannel, nullptr);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to create I2S channel for amp: %d\n", err);
+        return false;
+    }
+
+    i2s_std_config_t config = stdConfig(I2S_DATA_BIT_WIDTH_16BIT, I2S_AMP_BCLK, I2S_AMP_LRC,
+                                        I2S_AMP_DIN, I2S_GPIO_UNUSED);
+    err = i2s_channel_init_std_mode(speakerChannel, &config);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to configure I2S amp: %d\n", err);
+        i2s_del_channel(speakerChannel);
+        speakerChannel = nullptr;
+        return false;
+    }
+
+    speakerRunning = false;  // Channel stays disabled until the first playback
+    return true;
+}
+
+void audioI2sSpeakerStart() {
+    if (speakerChannel == nullptr || speakerRunning) return;
+    preloadSilence();
+    i2s_channel_enable(speakerChannel);
+    speakerRunning = true;
+}
+
+void audioI2sSpeakerStop() {
+    if (speakerChannel == nullptr || !speakerRunning) return;
+    i2s_channel_disable(speakerChannel);
+    speakerRunning = false;
+}
+
+void audioI2sSpeakerSilence() {
+    if (speakerChannel == nullptr) return;
+    bool running = speakerRunning;
+    audioI2sSpeakerStop();
+    if (running) {
+        audioI2sSpeakerStart();  // Preloads silence
+    }
+}
+
+size_t audioI2sSpeakerWrite(const int16_t* samples, size_t count) {
+    size_t bytesWritten = 0;
+    esp_err_t err = i2s_channel_write(speakerChannel, samples, count * sizeof(int16_t), &bytesWritten, portMAX_DELAY);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to write to amp: %d\n", err);
+        return 0;
+    }
+    return bytesWritten / sizeof(int16_t);
+}
+
+const char* audioI2sDescribe() {
+    return "std/" AUDIO_I2S_CLOCK_NAME;
+}
+
+#else // Legacy driver
+
+static i2s_config_t micConfig(uint16_t descCount, uint16_t frameSamples) {
+    i2s_config_t config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+        .sample_rate = AUDIO_SAMPLE_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,  // INMP441 outputs 32-bit
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = descCount,
+        .dma_buf_len = frameSamples,
+        .use_apll = AUDIO_I2S_USE_APLL,
+        .tx_desc_auto_clear = false,
+        .fixed_mclk = 0
+    };
+    return config;
+}
+
+bool audioI2sMicBegin(uint16_t descCount, uint16_t frameSamples) {
+    i2s_config_t config = micConfig(descCount, frameSamples);
+    i2s_pin_config_t pins = {
+        .bck_io_num = I2S_MIC_SCK,
+        .ws_io_num = I2S_MIC_WS,
+        .data_out_num = I2S_PIN_NO_CHANGE,
+        .data_in_num = I2S_MIC_SD
+    };
+
+    esp_err_t err = i2s_driver_install(I2S_NUM_0, &config, 0, NULL);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to install I2S driver for mic: %d\n", err);
+        return false;
+    }
+
+    err = i2s_set_pin(I2S_NUM_0, &pins);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to set I2S pins for mic: %d\n", err);
+        i2s_driver_uninstall(I2S_NUM_0);
+        return false;
+    }
+
+    micFrameSamples = frameSamples;
+    return true;
+}
+
+bool audioI2sMicReconfigure(uint16_t descCount, uint16_t frameSamples) {
+    if (micFrameSamples != 0) {
+        i2s_driver_uninstall(I2S_NUM_0);
+        micFrameSamples = 0;
+    }
+    return audioI2sMicBegin(descCount, frameSamples);
+}
+
+size_t audioI2sMicRead(int32_t* out, size_t maxSamples, int64_t* doneUs) {
+    size_t want = maxSamples < micFrameSamples ? maxSamples : micFrameSamples;
+    size_t bytesRead = 0;
+
+    // Blocks on the driver's DMA-done queue, one frame per wakeup
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = i2s_read(I2S_NUM_0, out, want * sizeof(int32_t), &bytesRead, portMAX_DELAY);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to read from mic: %d\n", err);
+        return 0;
+    }
+
+    int64_t now = esp_timer_get_time();
+    *doneUs = now - start > AUDIO_I2S_BLOCKED_US ? now : 0;
+    return bytesRead / sizeof(int32_t);
+}
+
+void audioI2sMicDiscard() {
+    i2s_zero_dma_buffer(I2S_NUM_0);
+}
+
+static bool speakerRunning = false;
+
+bool audioI2sSpeakerBegin(uint16_t descCount, uint16_t frameSamples) {
+    i2s_config_t config = {
+        .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX),
+        .sample_rate = AUDIO_SAMPLE_RATE,
+        .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+        .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+        .communication_format = I2S_COMM_FORMAT_STAND_I2S,
+        .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+        .dma_buf_count = descCount,
+        .dma_buf_len = frameSamples,
+        .use_apll = AUDIO_I2S_USE_APLL,
+        .tx_desc_auto_clear = true,
+        .fixed_mclk = 0
+    };
+    i2s_pin_config_t pins = {
+        .bck_io_num = I2S_AMP_BCLK,
+        .ws_io_num = I2S_AMP_LRC,
+        .data_out_num = I2S_AMP_DIN,
+        .data_in_num = I2S_PIN_NO_CHANGE
+    };
+
+    esp_err_t err = i2s_driver_install(I2S_NUM_1, &config, 0, NULL);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to install I2S driver for amp: %d\n", err);
+        return false;
+    }
+
+    err = i2s_set_pin(I2S_NUM_1, &pins);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to set I2S pins for amp: %d\n", err);
+        i2s_driver_uninstall(I2S_NUM_1);
+        return false;
+    }
+
+    // Clear DMA buffer to prevent playing garbage on startup, then stop
+    // until the first playback
+    i2s_zero_dma_buffer(I2S_NUM_1);
+    i2s_stop(I2S_NUM_1);
+    speakerRunning = false;
+    return true;
+}
+
+void audioI2sSpeakerStart() {
+    if (speakerRunning) return;
+    i2s_start(I2S_NUM_1);
+    i2s_zero_dma_buffer(I2S_NUM_1);  // Clear any garbage
+    speakerRunning = true;
+}
+
+void audioI2sSpeakerStop() {
+    if (!speakerRunning) return;
+    i2s_zero_dma_buffer(I2S_NUM_1);  // Clear buffer first
+    i2s_stop(I2S_NUM_1);
+    speakerRunning = false;
+}
+
+void audioI2sSpeakerSilence() {
+    i2s_zero_dma_buffer(I2S_NUM_1);
+}
+
+size_t audioI2sSpeakerWrite(const int16_t* samples, size_t count) {
+    size_t bytesWritten = 0;
+    esp_err_t err = i2s_write(I2S_NUM_1, samples, count * sizeof(int16_t), &bytesWritten, portMAX_DELAY);
+    if (err != ESP_OK) {
+        Serial.printf("[Audio] Failed to write to amp: %d\n", err);
+        return 0;
+    }
+    return bytesWritten / sizeof(int16_t);
+}
+
+const char* audioI2sDescribe() {
+    return "legacy/" AUDIO_I2S_CLOCK_NAME;
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "audio_pool.h"
+#include "metrics.h"
+#include <esp_heap_caps.h>
+#include <esp_idf_version.h>
+#include <freertos/FreeRTOS.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
+
+// Free blocks are chained through their own first word
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct AudioPool {
+    const char* name;
+    uint32_t caps;
+    uint32_t maxBlocks;
+    uint32_t maxSpare;
+    MetricId inUseMetric;
+    MetricId peakMetric;
+
+    FreeBlock* freeList;
+    uint32_t inUse;       // Includes blocks reserved while heap_caps_malloc() runs
+    uint32_t spare;
+    uint32_t peakInUse;
+    uint32_t allocFailures;
+};
+
+static AudioPool pools[AUDIO_POOL_KIND_COUNT] = {
+    {"internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT,
+     AUDIO_POOL_INTERNAL_MAX, AUDIO_POOL_INTERNAL_SPARE,
+     METRIC_POOL_INTERNAL_BLOCKS, METRIC_POOL_INTERNAL_PEAK, nullptr, 0, 0, 0, 0},
+    {"psram", MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+     AUDIO_POOL_PSRAM_MAX, AUDIO_POOL_PSRAM_SPARE,
+     METRIC_POOL_PSRAM_BLOCKS, METRIC_POOL_PSRAM_PEAK, nullptr, 0, 0, 0, 0},
+};
+
+static portMUX_TYPE poolLock = portMUX_INITIALIZER_UNLOCKED;
+
+const char* audioPoolName(AudioPoolKind kind) {
+    if (kind >= AUDIO_POOL_KIND_COUNT) return "unknown";
+    return pools[kind].name;
+}
+
+static void publish(AudioPool& pool, uint32_t inUse) {
+    metricSet(pool.inUseMetric, inUse);
+    metricMax(pool.peakMetric, inUse);
+}
+
+static void* allocFrom(AudioPool& pool) {
+    void* block = nullptr;
+    bool reserved = false;
+
+    portENTER_CRITICAL(&poolLock);
+    if (pool.freeList != nullptr) {
+        block = pool.freeList;
+        pool.freeList = pool.freeList->next;
+        pool.spare--;
+    } else if (pool.inUse + pool.spare < pool.maxBlocks) {
+        reserved = true;
+    }
+    if (block != nullptr || reserved) pool.inUse++;
+    if (block != nullptr && pool.inUse > pool.peakInUse) pool.peakInUse = pool.inUse;
+    uint32_t inUse = pool.inUse;
+    portEXIT_CRITICAL(&poolLock);
+
+    // Grow - outside the lock, the heap takes its own
+    if (reserved) {
+        block = heap_caps_malloc(AUDIO_POOL_BLOCK_BYTES, pool.caps);
+        portENTER_CRITICAL(&poolLock);
+        if (block == nullptr) {
+            pool.inUse--;
+        } else if (pool.inUse > pool.peakInUse) {
+            pool.peakInUse = pool.inUse;
+        }
+        inUse = pool.inUse;
+        portEXIT_CRITICAL(&poolLock);
+    }
+
+    if (block != nullptr) publish(pool, inUse);
+    return block;
+}
+
+void* audioPoolAlloc(AudioPoolKind kind) {
+    if (kind >= AUDIO_POOL_KIND_COUNT) return nullptr;
+
+    void* block = allocFrom(pools[kind]);
+
+    // Internal RAM is the scarce one - a hot ring still works from PSRAM
+    if (block == nullptr && kind == AUDIO_POOL_INTERNAL) {
+        block = allocFrom(pools[AUDIO_POOL_PSRAM]);
+    }
+
+    if (block == nullptr) {
+        portENTER_CRITICAL(&poolLock);
+        pools[kind].allocFailures++;
+        portEXIT_CRITICAL(&poolLock);
+        metricAdd(METRIC_POOL_ALLOC_FAILURES);
+    }
+    return block;
+}
+
+void audioPoolFree(void* block) {
+    if (block == nullptr) return;
+
+    AudioPool& pool = esp_ptr_external_ram(block) ? pools[AUDIO_POOL_PSRAM]
+                                                  : pools[AUDIO_POOL_INTERNAL];
+    bool keep;
+
+    portENTER_CRITICAL(&poolLock);
+    pool.inUse--;
+    keep = pool.spare < pool.maxSpare;
+    if (keep) {
+        FreeBlock* node = (FreeBlock*)block;
+        node->next = pool.freeList;
+        pool.freeList = node;
+        pool.spare++;
+    }
+    uint32_t inUse = pool.inUse;
+    portEXIT_CRITICAL(&poolLock);
+
+    if (!keep) heap_caps_free(block);
+    metricSet(pool.inUseMetric, inUse);
+}
+
+void getAudioPoolStats(AudioPoolKind kind, AudioPoolStats* stats) {
+    if (kind >= AUDIO_POOL_KIND_COUNT || stats == nullptr) return;
+
+    AudioPool& pool = pools[kind];
+    portENTER_CRITICAL(&poolLock);
+    stats->inUse = pool.inUse;
+    stats->spare = pool.spare;
+    stats->peakInUse = pool.peakInUse;
+    stats->allocFailures = pool.allocFailures;
+    portEXIT_CRITICAL(&poolLock);
+}
@@ -1,149 +1,500 @@
 #include "ble_config.h"
+#include "ble_protocol.h"
 #include "audio.h"
+#include "wake_word.h"
+#include "metrics.h"
+#include "fast_connect.h"
+#include "voice_client.h"
+#include "ota_update.h"
+#include "mote_log.h"
+#include <ArduinoJson.h>
 #include <WiFi.h>
 #include <Preferences.h>
+#include <esp_idf_version.h>
+#include <atomic>
+#if ESP_IDF_VERSION_MAJOR < 5
+#include <esp_coexist.h>
+#endif
 
-Preferences preferences;
+static Preferences preferences;
 
 // BLE Server and Characteristics
-BLEServer* bleServer = nullptr;
-BLECharacteristic* statusCharacteristic = nullptr;
-BLECharacteristic* configCharacteristic = nullptr;
-bool bleClientConnected = false;
+static NimBLEServer* bleServer = nullptr;
+static NimBLECharacteristic* statusCharacteristic = nullptr;
+static NimBLECharacteristic* configCharacteristic = nullptr;
+static std::atomic<bool> bleClientConnected(false);
+static std::atomic<uint16_t> connHandle(0);
+static BleNetworkConfigCallback networkConfigCallback = nullptr;
+
+// Radio sharing with Wi-Fi (loop task)
+static bool voiceSessionActive = false;
+static bool connParamsApplied = false;  // For this connection and session state
 
 // WiFi configuration (to be set via BLE)
-char configuredWifiSsid[32] = "";
-char configuredWifiPassword[64] = "";
-char configuredGatewayServer[128] = "";
-uint16_t configuredGatewayPort = 3000;
-char configuredGatewayToken[128] = "";
+static char configuredWifiSsid[32] = "";
+static char configuredWifiPassword[64] = "";
+static char configuredGatewayServer[128] = "";
+static uint16_t configuredGatewayPort = 3000;
+static char configuredGatewayToken[128] = "";
+static char configuredGatewayList[GATEWAY_LIST_SIZE] = "";
+static uint8_t configuredIpMode = IP_MODE_DHCP;
+
+// Set from the BLE host task, picked up by handleBleConfig() on the loop task
+static std::atomic<uint16_t> negotiatedMtu(BLE_MTU_DEFAULT);
+static std::atomic<bool> connectionStarted(false);
+static std::atomic<bool> writePending(false);
+static std::atomic<bool> writeDropped(false);
+static uint8_t pendingWrite[BLE_VALUE_MAX];
+static size_t pendingWriteLength = 0;
+
+// Per-connection protocol state (loop task only)
+static bool binaryProtocol = false;     // Peer sent HELLO
+static BleStatus lastStatus;            // What the peer has been sent
+static bool statusSent = false;
+static uint32_t lastMetrics[METRIC_COUNT];
+static bool metricsSent = false;
+static unsigned long lastStatusPoll = 0;
+static unsigned long lastMetricsPoll = 0;
+
+// Slow-changing inputs, read once or on their own schedule
+static uint8_t deviceMac[6];
+static uint16_t batteryMv = 0;
+static uint8_t batteryPercent = 0;
+static unsigned long lastBatteryPoll = 0;
 
 /**
- * BLE Server Callbacks
+ * BLE Server Callbacks (BLE host task)
  */
-class ServerCallbacks: public BLEServerCallbacks {
-    void onConnect(BLEServer* pServer) {
+class ServerCallbacks: public NimBLEServerCallbacks {
+    void onConnect(NimBLEServer* pServer, ble_gap_conn_desc* desc) {
+        negotiatedMtu = BLE_MTU_DEFAULT;
+        connHandle = desc->conn_handle;
+        connectionStarted = true;
         bleClientConnected = true;
         Serial.println("[BLE] Client connected");
     }
 
-    void onDisconnect(BLEServer* pServer) {
+    void onDisconnect(NimBLEServer* pServer) {
+        // NimBLE restarts advertising on its own (advertiseOnDisconnect)
         bleClientConnected = false;
         Serial.println("[BLE] Client disconnected");
+    }
 
-        // Restart advertising so another client can connect
-        BLEDevice::startAdvertising();
-        Serial.println("[BLE] Advertising restarted");
+    void onMTUChange(uint16_t MTU, ble_gap_conn_desc* desc) {
+        negotiatedMtu = MTU;
+        Serial.printf("[BLE] MTU %u\n", MTU);
     }
 };
 
 /**
  * Config Characteristic Callbacks
- * Handles incoming configuration from mobile app
+ * Queues the write for the loop task - applying it can touch NVS, notify
+ * and reboot, none of which belongs on the BLE host task
  */
-class ConfigCallbacks: public BLECharacteristicCallbacks {
-    void onWrite(BLECharacteristic* pCharacteristic) {
-        std::string value = pCharacteristic->getValue();
-
-        if (value.length() > 0) {
-            Serial.printf("[BLE] Received config: %s\n", value.c_str());
-
-            // Parse simple JSON manually
-            String json = String(value.c_str());
-
-            // Check if this is a volume command (format: {"volume":50})
-            int volumeStart = json.indexOf("\"volume\":");
-            if (volumeStart >= 0) {
-                volumeStart += 9;
-                String volumeStr = json.substring(volumeStart);
-                int volumeEnd = volumeStr.indexOf(",");
-                if (volumeEnd == -1) volumeEnd = volumeStr.indexOf("}");
-                if (volumeEnd > 0) {
-                    int volume = volumeStr.substring(0, volumeEnd).toInt();
-                    if (volume >= 0 && volume <= 100) {
-                        setVolume((uint8_t)volume);
-                        Serial.printf("[BLE] Volume set to %d%%\n", volume);
-                        // Send updated status with new volume
-                        sendBleStatus();
-                    }
-                }
-                return; // Volume command handled, don't process as config
-            }
-
-            // Regular WiFi/Gateway config (format: {"ssid":"...","password":"...","server":"...","port":3000})
-
-            // Extract SSID
-            int ssidStart = json.indexOf("\"ssid\":\"") + 8;
-            int ssidEnd = json.indexOf("\"", ssidStart);
-            if (ssidStart > 7 && ssidEnd > ssidStart) {
-                String ssid = json.substring(ssidStart, ssidEnd);
-                strncpy(configuredWifiSsid, ssid.c_str(), sizeof(configuredWifiSsid) - 1);
-                configuredWifiSsid[sizeof(configuredWifiSsid) - 1] = '\0';
-            }
-
-            // Extract password
-            int pwdStart = json.indexOf("\"password\":\"") + 12;
-            int pwdEnd = json.indexOf("\"", pwdStart);
-            if (pwdStart > 11 && pwdEnd > pwdStart) {
-                String password = json.substring(pwdStart, pwdEnd);
-                strncpy(configuredWifiPassword, password.c_str(), sizeof(configuredWifiPassword) - 1);
-                configuredWifiPassword[sizeof(configuredWifiPassword) - 1] = '\0';
-            }
-
-            // Extract server
-            int serverStart = json.indexOf("\"server\":\"") + 10;
-            int serverEnd = json.indexOf("\"", serverStart);
-            if (serverStart > 9 && serverEnd > serverStart) {
-                String server = json.substring(serverStart, serverEnd);
-                strncpy(configuredGatewayServer, server.c_str(), sizeof(configuredGatewayServer) - 1);
-                configuredGatewayServer[sizeof(configuredGatewayServer) - 1] = '\0';
-            }
-
-            // Extract port
-            int portStart = json.indexOf("\"port\":") + 7;
-            if (portStart > 6) {
-                String portStr = json.substring(portStart);
-                int portEnd = portStr.indexOf(",");
-                if (portEnd == -1) portEnd = portStr.indexOf("}");
-                if (portEnd > 0) {
-                    configuredGatewayPort = portStr.substring(0, portEnd).toInt();
-                }
-            }
-
-            // Extract token
-            int tokenStart = json.indexOf("\"token\":\"") + 9;
-            int tokenEnd = json.indexOf("\"", tokenStart);
-            if (tokenStart > 8 && tokenEnd > tokenStart) {
-                String token = json.substring(tokenStart, tokenEnd);
-                strncpy(configuredGatewayToken, token.c_str(), sizeof(configuredGatewayToken) - 1);
-                configuredGatewayToken[sizeof(configuredGatewayToken) - 1] = '\0';
-            }
-
-            Serial.printf("[BLE] Parsed config - SSID: %s, Server: %s:%d, Token: %s\n",
-                         configuredWifiSsid, configuredGatewayServer, configuredGatewayPort,
-                         strlen(configuredGatewayToken) > 0 ? "[SET]" : "[EMPTY]");
-
-            // Save config to NVS (persistent storage)
-            preferences.begin("mote", false);
-            preferences.putString("wifi_ssid", configuredWifiSsid);
-            preferences.putString("wifi_password", configuredWifiPassword);
-            preferences.putString("gw_server", configuredGatewayServer);
-            preferences.putUShort("gw_port", configuredGatewayPort);
-            preferences.putString("gw_token", configuredGatewayToken);
-            preferences.end();
-            Serial.println("[BLE] Config saved to flash");
-
-            // Send updated status
-            sendBleStatus();
-
-            // Reboot to WiFi mode (BLE and WiFi can't coexist)
-            Serial.println("[BLE] Rebooting to WiFi mode...");
-            delay(1000); // Give time for BLE notification to send
-            ESP.restart();
+class ConfigCallbacks: public NimBLECharacteristicCallbacks {
+    void onWrite(NimBLECharacteristic* pCharacteristic) {
+        NimBLEAttValue value = pCharacteristic->getValue();
+        if (value.length() == 0) {
+            return;
+        }
+        if (writePending || value.length() > sizeof(pendingWrite)) {
+            writeDropped = true;
+            return;
         }
+        memcpy(pendingWrite, value.data(), value.length());
+        pendingWriteLength = value.length();
+        writePending = true;
     }
 };
 
+static size_t notifyPayloadLimit() {
+    return negotiatedMtu - BLE_ATT_OVERHEAD;
+}
+
+static void notifyFrame(const uint8_t* frame, size_t length, void* context) {
+    statusCharacteristic->setValue((uint8_t*)frame, length);
+    statusCharacteristic->notify();
+}
+
+static void storeFrame(const uint8_t* frame, size_t length, void* context) {
+    statusCharacteristic->setValue((uint8_t*)frame, length);
+}
+
+/**
+ * Battery voltage, re-read every BLE_BATTERY_POLL_MS and only taken when it
+ * moves by BLE_BATTERY_MV_STEP - ADC noise shouldn't cost a notification
+ */
+static void sampleBattery(bool force) {
+    if (!force && millis() - lastBatteryPoll < BLE_BATTERY_POLL_MS) {
+        return;
+    }
+    lastBatteryPoll = millis();
+
+    uint16_t mv = (uint16_t)(getMoteBatteryVoltage() * 1000.0f);
+    if (force || abs((int)mv - (int)batteryMv) >= BLE_BATTERY_MV_STEP) {
+        batteryMv = mv;
+        batteryPercent = (uint8_t)getMoteBatteryPercent();
+    }
+}
+
+static void readStatus(BleStatus* status) {
+    memset(status, 0, sizeof(*status));     // Compared with memcmp - padding included
+    memcpy(status->deviceId, deviceMac, sizeof(deviceMac));
+    strncpy(status->firmware, MOTE_FIRMWARE_VERSION, sizeof(status->firmware) - 1);
+    status->batteryPercent = batteryPercent;
+    status->batteryMv = batteryMv;
+    status->volume = getVolume();
+    status->wakeMode = getWakeMode();
+    status->localWakeActive = isLocalWakeActive();
+    status->wifiConfigured = configuredWifiSsid[0] != '\0';
+    status->wifiConnected = WiFi.status() == WL_CONNECTED;
+    strncpy(status->wifiSsid, configuredWifiSsid, sizeof(status->wifiSsid) - 1);
+    status->gatewayConfigured = configuredGatewayServer[0] != '\0';
+    status->gatewayConnected = isVoiceConnected();
+    strncpy(status->gatewayServer, configuredGatewayServer, sizeof(status->gatewayServer) - 1);
+    status->gatewayPort = configuredGatewayPort;
+    status->ipMode = configuredIpMode;
+    status->voiceState = (uint8_t)getVoiceState();
+}
+
+/**
+ * Legacy JSON status, for apps that never send HELLO
+ */
+static size_t formatLegacyStatus(const BleStatus& s, char* out, size_t size) {
+    char mac[18];
+    snprintf(mac, sizeof(mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+             s.deviceId[0], s.deviceId[1], s.deviceId[2], s.deviceId[3], s.deviceId[4], s.deviceId[5]);
+
+    JsonDocument doc;
+    doc["type"] = "status";
+    doc["bleProtocol"] = BLE_PROTOCOL_VERSION;     // Tells a newer app it can send HELLO
+    doc["deviceId"] = mac;
+    doc["firmwareVersion"] = s.firmware;
+    doc["batteryPercent"] = s.batteryPercent;
+    doc["batteryVoltage"] = serialized(String(s.batteryMv / 1000.0f, 2));
+    doc["volume"] = s.volume;
+    doc["wakeMode"] = s.wakeMode == WAKE_MODE_LOCAL ? "local" : "server";
+    doc["localWakeActive"] = s.localWakeActive;
+    doc["wifiConfigured"] = s.wifiConfigured;
+    doc["wifiConnected"] = s.wifiConnected;
+    doc["wifiSsid"] = s.wifiSsid;
+    doc["gatewayConfigured"] = s.gatewayConfigured;
+    doc["gatewayConnected"] = s.gatewayConnected;
+    doc["gatewayServer"] = s.gatewayServer;
+    doc["gatewayPort"] = s.gatewayPort;
+    return serializeJson(doc, out, size);
+}
+
+/**
+ * Make the status characteristic's read value the full snapshot of `status`
+ */
+static void storeStatusSnapshot(const BleStatus& status) {
+    if (binaryProtocol) {
+        BleFrameWriter writer(BLE_MSG_STATUS, BLE_FLAG_FULL, BLE_VALUE_MAX, storeFrame, nullptr);
+        bleEncodeStatus(status, nullptr, &writer);
+        writer.finish();
+    } else {
+        static char json[BLE_VALUE_MAX];
+        size_t length = formatLegacyStatus(status, json, sizeof(json));
+        statusCharacteristic->setValue((uint8_t*)json, length);
+    }
+}
+
+/**
+ * Notify whatever status changed since the peer last heard (binary: just
+ * those fields; legacy: the whole JSON)
+ */
+static void pollStatus() {
+    BleStatus status;
+    readStatus(&status);
+    if (statusSent && memcmp(&status, &lastStatus, sizeof(status)) == 0) {
+        return;
+    }
+
+    if (binaryProtocol) {
+        BleFrameWriter writer(BLE_MSG_STATUS, statusSent ? 0 : BLE_FLAG_FULL, notifyPayloadLimit(),
+                              notifyFrame, nullptr);
+        bleEncodeStatus(status, statusSent ? &lastStatus : nullptr, &writer);
+        size_t frames = writer.finish();
+        (void)frames;                   // Unused when LOG_DEBUG compiles out
+        LOG_DEBUG("[BLE] Status update in %u notification(s)\n", (unsigned)frames);
+        storeStatusSnapshot(status);    // Notifying overwrote the read value
+    } else {
+        storeStatusSnapshot(status);
+        statusCharacteristic->notify();
+    }
+
+    memcpy(&lastStatus, &status, sizeof(status));
+    statusSent = true;
+}
+
+/**
+ * Binary peers: notify the counters and gauges that moved
+ */
+static void pollMetrics() {
+    uint32_t values[METRIC_COUNT];
+    sampleSystemMetrics();
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        values[i] = metricGet((MetricId)i);
+    }
+
+    BleFrameWriter writer(BLE_MSG_METRICS, metricsSent ? 0 : BLE_FLAG_FULL, notifyPayloadLimit(),
+                          notifyFrame, nullptr);
+    bleEncodeMetrics(values, metricsSent ? lastMetrics : nullptr, METRIC_COUNT, METRIC_FIRST_GAUGE, &writer);
+    if (writer.finish() > 0) {
+        storeStatusSnapshot(lastStatus);
+    }
+
+    memcpy(lastMetrics, values, sizeof(values));
+    metricsSent = true;
+}
+
+static void sendAck(BleAckResult result, bool rebooting) {
+    if (!binaryProtocol) {
+        return;     // Legacy apps never got one
+    }
+    BleFrameWriter writer(BLE_MSG_ACK, 0, notifyPayloadLimit(), notifyFrame, nullptr);
+    writer.addU8(BLE_ACK_RESULT, result);
+    writer.addU8(BLE_ACK_REBOOTING, rebooting);
+    writer.finish();
+    storeStatusSnapshot(lastStatus);
+}
+
+static bool copyLegacyString(JsonVariantConst value, char* out, size_t size, uint32_t flag, BleConfig* config) {
+    if (!value.is<const char*>()) {
+        return true;    // Not sent
+    }
+    const char* text = value.as<const char*>();
+    if (strlen(text) >= size) {
+        return false;
+    }
+    strcpy(out, text);
+    config->present |= flag;
+    return true;
+}
+
+/**
+ * Legacy JSON config writes, into the same BleConfig the TLV path decodes.
+ * As before, a volume, wakeMode or ipMode command is handled on its own.
+ */
+static BleAckResult parseLegacyConfig(const uint8_t* data, size_t length, BleConfig* config) {
+    memset(config, 0, sizeof(*config));
+    JsonDocument doc;
+    if (deserializeJson(doc, data, length) != DeserializationError::Ok) {
+        return BLE_ACK_MALFORMED;
+    }
+
+    if (!doc["volume"].isNull()) {
+        int volume = doc["volume"] | -1;
+        if (volume < 0 || volume > 100) return BLE_ACK_BAD_VALUE;
+        config->volume = (uint8_t)volume;
+        config->present = BLE_CONFIG_HAS_VOLUME;
+        return BLE_ACK_OK;
+    }
+    if (!doc["wakeMode"].isNull()) {
+        const char* mode = doc["wakeMode"] | "";
+        if (strcmp(mode, "local") != 0 && strcmp(mode, "server") != 0) return BLE_ACK_BAD_VALUE;
+        config->wakeMode = strcmp(mode, "local") == 0 ? WAKE_MODE_LOCAL : WAKE_MODE_SERVER;
+        config->present = BLE_CONFIG_HAS_WAKE_MODE;
+        return BLE_ACK_OK;
+    }
+    if (!doc["ipMode"].isNull()) {
+        const char* mode = doc["ipMode"] | "";
+        if (strcmp(mode, "cached") != 0 && strcmp(mode, "dhcp") != 0) return BLE_ACK_BAD_VALUE;
+        config->ipMode = strcmp(mode, "cached") == 0 ? IP_MODE_CACHED : IP_MODE_DHCP;
+        config->present = BLE_CONFIG_HAS_IP_MODE;
+        return BLE_ACK_OK;
+    }
+
+    // Regular WiFi/Gateway config (format: {"ssid":"...","password":"...","server":"...","port":3000,"gateways":"host:port,..."})
+    if (!copyLegacyString(doc["ssid"], config->wifiSsid, sizeof(config->wifiSsid),
+                          BLE_CONFIG_HAS_WIFI_SSID, config) ||
+        !copyLegacyString(doc["password"], config->wifiPassword, sizeof(config->wifiPassword),
+                          BLE_CONFIG_HAS_WIFI_PASSWORD, config) ||
+        !copyLegacyString(doc["server"], config->gatewayServer, sizeof(config->gatewayServer),
+                          BLE_CONFIG_HAS_GATEWAY_SERVER, config) ||
+        !copyLegacyString(doc["token"], config->gatewayToken, sizeof(config->gatewayToken),
+                          BLE_CONFIG_HAS_GATEWAY_TOKEN, config) ||
+        !copyLegacyString(doc["gateways"], config->gatewayList, sizeof(config->gatewayList),
+                          BLE_CONFIG_HAS_GATEWAY_LIST, config)) {
+        return BLE_ACK_BAD_VALUE;
+    }
+    if ((config->present & BLE_CONFIG_HAS_GATEWAY_LIST) && !isValidGatewayList(config->gatewayList)) {
+        return BLE_ACK_BAD_VALUE;
+    }
+    if (doc["port"].is<int>()) {
+        int port = doc["port"];
+        if (port <= 0 || port > 65535) return BLE_ACK_BAD_VALUE;
+        config->gatewayPort = (uint16_t)port;
+        config->present |= BLE_CONFIG_HAS_GATEWAY_PORT;
+    }
+    return BLE_ACK_OK;
+}
+
+/**
+ * Apply a decoded config write
+ * @return true if the network settings changed and, with nobody to apply
+ *         them live, the device must reboot
+ */
+static bool applyConfig(const BleConfig& config) {
+    if (config.present & BLE_CONFIG_HAS_VOLUME) {
+        setVolume(config.volume);
+        Serial.printf("[BLE] Volume set to %d%%\n", config.volume);
+    }
+
+    if (config.present & BLE_CONFIG_HAS_WAKE_MODE) {
+        setWakeMode((WakeMode)config.wakeMode);
+        preferences.begin("mote", false);
+        preferences.putUChar("wake_mode", config.wakeMode);
+        preferences.end();
+        Serial.printf("[BLE] Wake mode set to %s\n", config.wakeMode == WAKE_MODE_LOCAL ? "local" : "server");
+    }
+
+    if (config.present & BLE_CONFIG_HAS_IP_MODE) {
+        // Takes effect on the next boot
+        configuredIpMode = config.ipMode;
+        preferences.begin("mote", false);
+        preferences.putUChar(FAST_CONNECT_PREF_IP_MODE, config.ipMode);
+        preferences.end();
+        Serial.printf("[BLE] IP mode set to %s\n", config.ipMode == IP_MODE_CACHED ? "cached" : "dhcp");
+    }
+
+    if ((config.present & BLE_CONFIG_NETWORK_MASK) == 0) {
+        return false;
+    }
+
+    // Fields not sent keep their saved values
+    bool wifiChanged =
+        ((config.present & BLE_CONFIG_HAS_WIFI_SSID) && strcmp(config.wifiSsid, configuredWifiSsid) != 0) ||
+        ((config.present & BLE_CONFIG_HAS_WIFI_PASSWORD) && strcmp(config.wifiPassword, configuredWifiPassword) != 0);
+    bool gatewayChanged =
+        ((config.present & BLE_CONFIG_HAS_GATEWAY_SERVER) && strcmp(config.gatewayServer, configuredGatewayServer) != 0) ||
+        ((config.present & BLE_CONFIG_HAS_GATEWAY_PORT) && config.gatewayPort != configuredGatewayPort) ||
+        ((config.present & BLE_CONFIG_HAS_GATEWAY_TOKEN) && strcmp(config.gatewayToken, configuredGatewayToken) != 0) ||
+        ((config.present & BLE_CONFIG_HAS_GATEWAY_LIST) && strcmp(config.gatewayList, configuredGatewayList) != 0);
+    if (!wifiChanged && !gatewayChanged) {
+        Serial.println("[BLE] Network config unchanged");
+        return false;
+    }
+
+    if (config.present & BLE_CONFIG_HAS_WIFI_SSID) strcpy(configuredWifiSsid, config.wifiSsid);
+    if (config.present & BLE_CONFIG_HAS_WIFI_PASSWORD) strcpy(configuredWifiPassword, config.wifiPassword);
+    if (config.present & BLE_CONFIG_HAS_GATEWAY_SERVER) strcpy(configuredGatewayServer, config.gatewayServer);
+    if (config.present & BLE_CONFIG_HAS_GATEWAY_PORT) configuredGatewayPort = config.gatewayPort;
+    if (config.present & BLE_CONFIG_HAS_GATEWAY_TOKEN) strcpy(configuredGatewayToken, config.gatewayToken);
+    if (config.present & BLE_CONFIG_HAS_GATEWAY_LIST) strcpy(configuredGatewayList, config.gatewayList);
+
+    Serial.printf("[BLE] Parsed config - SSID: %s, Server: %s:%d, Fallbacks: %s, Token: %s\n",
+                 configuredWifiSsid, configuredGatewayServer, configuredGatewayPort,
+                 configuredGatewayList[0] != '\0' ? configuredGatewayList : "[NONE]",
+                 strlen(configuredGatewayToken) > 0 ? "[SET]" : "[EMPTY]");
+
+    // Save config to NVS (persistent storage)
+    preferences.begin("mote", false);
+    preferences.putString("wifi_ssid", configuredWifiSsid);
+    preferences.putString("wifi_password", configuredWifiPassword);
+    preferences.putString("gw_server", configuredGatewayServer);
+    preferences.putUShort("gw_port", configuredGatewayPort);
+    preferences.putString("gw_token", configuredGatewayToken);
+    preferences.putString("gw_list", configuredGatewayList);
+    preferences.end();
+    if (wifiChanged) {
+        clearFastConnectCache();  // Cached AP and lease were for the old network
+    }
+    Serial.println("[BLE] Config saved to flash");
+
+    if (networkConfigCallback == nullptr) {
+        return true;
+    }
+    BleNetworkConfig network = {
+        configuredWifiSsid, configuredWifiPassword, configuredGatewayServer,
+        configuredGatewayPort, configuredGatewayToken, configuredGatewayList, wifiChanged, gatewayChanged
+    };
+    networkConfigCallback(network);
+    return false;
+}
+
+/**
+ * Handle the write queued by ConfigCallbacks
+ */
+static void processPendingWrite() {
+    if (writeDropped.exchange(false)) {
+        Serial.println("[BLE] Config write dropped (busy or oversized)");
+        sendAck(BLE_ACK_BUSY, false);
+    }
+    if (!writePending) {
+        return;
+    }
+
+    const uint8_t* data = pendingWrite;
+    size_t length = pendingWriteLength;
+    BleConfig config;
+    BleAckResult result;
+
+    if (data[0] == '{') {
+        LOG_DEBUG("[BLE] Received JSON config: %.*s\n", (int)length, (const char*)data);
+        result = parseLegacyConfig(data, length, &config);
+    } else if (length >= BLE_FRAME_HEADER && data[0] == BLE_PROTOCOL_VERSION && data[1] == BLE_MSG_HELLO) {
+        // Switch this connection over and resend everything as a snapshot
+        binaryProtocol = true;
+        statusSent = false;
+        metricsSent = false;
+        writePending = false;
+        Serial.printf("[BLE] Peer switched to binary protocol v%d (MTU %u)\n",
+                      BLE_PROTOCOL_VERSION, (unsigned)negotiatedMtu);
+        pollStatus();
+        pollMetrics();
+        return;
+    } else {
+        result = bleDecodeConfig(data, length, &config);
+    }
+    writePending = false;
+
+    if (result != BLE_ACK_OK) {
+        Serial.printf("[BLE] Config write refused (%d)\n", result);
+        sendAck(result, false);
+        return;
+    }
+
+    bool reboot = applyConfig(config);
+    sendAck(BLE_ACK_OK, reboot);
+    pollStatus();
+
+    if (reboot) {
+        // Nobody registered to apply network settings live
+        Serial.println("[BLE] Rebooting to apply network config...");
+        delay(1000); // Give time for BLE notification to send
+        ESP.restart();
+    }
+}
+
+/**
+ * Ask the phone for the connection interval that suits the session state.
+ * It may pick anything in the range, or refuse - the link works either way.
+ */
+static void applyConnParams() {
+    if (voiceSessionActive) {
+        bleServer->updateConnParams(connHandle, BLE_CONN_VOICE_MIN, BLE_CONN_VOICE_MAX, 0, BLE_CONN_TIMEOUT);
+    } else {
+        bleServer->updateConnParams(connHandle, BLE_CONN_FAST_MIN, BLE_CONN_FAST_MAX, 0, BLE_CONN_TIMEOUT);
+    }
+    connParamsApplied = true;
+}
+
+/**
+ * Advertising interval for the session state - restarts advertising if it
+ * is running (the interval can't change while it is)
+ */
+static void applyAdvertisingInterval() {
+    NimBLEAdvertising* advertising = NimBLEDevice::getAdvertising();
+    advertising->setMinInterval(voiceSessionActive ? BLE_ADV_VOICE_MIN : BLE_ADV_FAST_MIN);
+    advertising->setMaxInterval(voiceSessionActive ? BLE_ADV_VOICE_MAX : BLE_ADV_FAST_MAX);
+    if (advertising->isAdvertising()) {
+        advertising->stop();
+        advertising->start();
+    }
+}
+
 /**
  * Initialize BLE configuration service
  */
@@ -157,6 +508,8 @@ void setupBleConfig() {
     String server = preferences.getString("gw_server", "");
     uint16_t port = preferences.getUShort("gw_port", 3000);
     String token = preferences.getString("gw_token", "");
+    String list = preferences.getString("gw_list", "");
+    configuredIpMode = preferences.getUChar(FAST_CONNECT_PREF_IP_MODE, IP_MODE_DHCP);
     preferences.end();
 
     strncpy(configuredWifiSsid, ssid.c_str(), sizeof(configuredWifiSsid) - 1);
@@ -168,44 +521,56 @@ void setupBleConfig() {
     configuredGatewayPort = port;
     strncpy(configuredGatewayToken, token.c_str(), sizeof(configuredGatewayToken) - 1);
     configuredGatewayToken[sizeof(configuredGatewayToken) - 1] = '\0';
+    strncpy(configuredGatewayList, list.c_str(), sizeof(configuredGatewayList) - 1);
+    configuredGatewayList[sizeof(configuredGatewayList) - 1] = '\0';
 
     Serial.printf("[BLE] Loaded config - SSID: %s, Server: %s:%d\n",
                   configuredWifiSsid, configuredGatewayServer, configuredGatewayPort);
 
-    // Initialize BLE FIRST (before WiFi to avoid conflicts)
-    BLEDevice::init(BLE_DEVICE_NAME);
+    // Neither changes while we run - read them once, not per status
+    WiFi.macAddress(deviceMac);
+    sampleBattery(true);
+
+    // Initialize BLE before Wi-Fi so the controller claims its memory first
+    NimBLEDevice::init(BLE_DEVICE_NAME);
+    NimBLEDevice::setMTU(BLE_MTU_MAX);  // The phone starts the exchange; this is what we accept
 
     // Create BLE Server
-    bleServer = BLEDevice::createServer();
+    bleServer = NimBLEDevice::createServer();
     bleServer->setCallbacks(new ServerCallbacks());
 
     // Create BLE Service
-    BLEService* service = bleServer->createService(BLE_SERVICE_UUID);
+    NimBLEService* service = bleServer->createService(BLE_SERVICE_UUID);
 
-    // Create Status Characteristic (Read + Notify)
+    // Create Status Characteristic (Read + Notify; NimBLE adds the CCCD)
     statusCharacteristic = service->createCharacteristic(
         BLE_STATUS_CHAR_UUID,
-        BLECharacteristic::PROPERTY_READ | BLECharacteristic::PROPERTY_NOTIFY
+        NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY
     );
-    statusCharacteristic->addDescriptor(new BLE2902());
 
     // Create Config Characteristic (Write)
     configCharacteristic = service->createCharacteristic(
         BLE_CONFIG_CHAR_UUID,
-        BLECharacteristic::PROPERTY_WRITE
+        NIMBLE_PROPERTY::WRITE
     );
     configCharacteristic->setCallbacks(new ConfigCallbacks());
 
     // Start the service
     service->start();
 
+    // Readable before anyone connects
+    readStatus(&lastStatus);
+    storeStatusSnapshot(lastStatus);
+
     // Start advertising
-    BLEAdvertising* advertising = BLEDevice::getAdvertising();
+    NimBLEAdvertising* advertising = NimBLEDevice::getAdvertising();
     advertising->addServiceUUID(BLE_SERVICE_UUID);
     advertising->setScanResponse(true);
     advertising->setMinPreferred(0x06);  // helps with iPhone connections
     advertising->setMinPreferred(0x12);
-    BLEDevice::startAdvertising();
+    advertising->setMinInterval(BLE_ADV_FAST_MIN);
+    advertising->setMaxInterval(BLE_ADV_FAST_MAX);
+    NimBLEDevice::startAdvertising();
 
     Serial.println("[BLE] BLE service started and advertising");
     Serial.printf("[BLE] Device name: %s\n", BLE_DEVICE_NAME);
@@ -216,47 +581,79 @@ void setupBleConfig() {
  * Handle BLE events in loop()
  */
 void handleBleConfig() {
-    // BLE library handles events automatically
-    // Just send periodic status updates if connected
-    static unsigned long lastStatusUpdate = 0;
+    static unsigned long lastLegacyMetrics = 0;
+
+    if (connectionStarted.exchange(false)) {
+        // Every connection starts legacy until the app says HELLO
+        binaryProtocol = false;
+        statusSent = false;
+        metricsSent = false;
+        connParamsApplied = false;
+        readStatus(&lastStatus);
+        storeStatusSnapshot(lastStatus);
+    }
+
+    if (!bleClientConnected) {
+        return;
+    }
+
+    if (!connParamsApplied) {
+        applyConnParams();
+    }
+
+    processPendingWrite();
+    sampleBattery(false);
 
-    if (bleClientConnected && millis() - lastStatusUpdate > 5000) {
-        sendBleStatus();
-        lastStatusUpdate = millis();
+    // Changes landing inside one poll go out together
+    if (millis() - lastStatusPoll >= BLE_STATUS_POLL_MS) {
+        lastStatusPoll = millis();
+        pollStatus();
+    }
+
+    if (binaryProtocol) {
+        if (millis() - lastMetricsPoll >= BLE_METRICS_POLL_MS) {
+            lastMetricsPoll = millis();
+            pollMetrics();
+        }
+    } else if (millis() - lastLegacyMetrics > METRICS_REPORT_MS) {
+        sendBleMetrics();
+        lastLegacyMetrics = millis();
     }
 }
 
 /**
- * Send device status via BLE notification
+ * Notify any status change now rather than at the next poll
  */
 void sendBleStatus() {
     if (!bleClientConnected || statusCharacteristic == nullptr) {
         return;
     }
+    pollStatus();
+}
 
-    // Build JSON status manually
-    bool wifiConnected = (WiFi.status() == WL_CONNECTED);
-    bool gatewayConnected = false; // TODO: Track actual Gateway WebSocket connection state
-    String status = "{";
-    status += "\"type\":\"status\",";
-    status += "\"deviceId\":\"" + String(WiFi.macAddress()) + "\",";
-    status += "\"firmwareVersion\":\"1.0.0\",";
-    status += "\"batteryPercent\":" + String(getMoteBatteryPercent()) + ",";
-    status += "\"batteryVoltage\":" + String(getMoteBatteryVoltage(), 2) + ",";
-    status += "\"volume\":" + String(getVolume()) + ",";
-    status += "\"wifiConfigured\":" + String(strlen(configuredWifiSsid) > 0 ? "true" : "false") + ",";
-    status += "\"wifiConnected\":" + String(wifiConnected ? "true" : "false") + ",";
-    status += "\"wifiSsid\":\"" + String(configuredWifiSsid) + "\",";
-    status += "\"gatewayConfigured\":" + String(strlen(configuredGatewayServer) > 0 ? "true" : "false") + ",";
-    status += "\"gatewayConnected\":" + String(gatewayConnected ? "true" : "false") + ",";
-    status += "\"gatewayServer\":\"" + String(configuredGatewayServer) + "\",";
-    status += "\"gatewayPort\":" + String(configuredGatewayPort);
-    status += "}";
-
-    statusCharacteristic->setValue(status.c_str());
+/**
+ * Send the metrics registry (counters and gauges) via BLE notification
+ */
+void sendBleMetrics() {
+    if (!bleClientConnected || statusCharacteristic == nullptr) {
+        return;
+    }
+
+    if (binaryProtocol) {
+        pollMetrics();
+        return;
+    }
+
+    JsonDocument doc;
+    buildMetricsReport(doc, false);
+
+    String metrics;
+    serializeJson(doc, metrics);
+    statusCharacteristic->setValue(metrics.c_str());
     statusCharacteristic->notify();
+    storeStatusSnapshot(lastStatus);
 
-    Serial.printf("[BLE] Sent status update (%d bytes)\n", status.length());
+    LOG_DEBUG("[BLE] Sent metrics (%d bytes)\n", metrics.length());
 }
 
 /**
@@ -265,3 +662,27 @@ void sendBleStatus() {
 bool isBleConnected() {
     return bleClientConnected;
 }
+
+void setBleNetworkConfigCallback(BleNetworkConfigCallback callback) {
+    networkConfigCallback = callback;
+}
+
+/**
+ * Share the radio: during a voice session Wi-Fi carries audio both ways and
+ * BLE only status, so BLE gives up air time (and gets it back afterwards)
+ */
+void setBleVoiceSessionActive(bool active) {
+    if (active == voiceSessionActive || bleServer == nullptr) {
+        return;
+    }
+    voiceSessionActive = active;
+
+#if ESP_IDF_VERSION_MAJOR < 5
+    // Gone in IDF 5 - there the connection and advertising intervals do it alone
+    esp_coex_preference_set(active ? ESP_COEX_PREFER_WIFI : ESP_COEX_PREFER_BALANCE);
+#endif
+    applyAdvertisingInterval();
+    connParamsApplied = false;  // handleBleConfig() asks the phone if one is connected
+
+    LOG_INFO("[BLE] Radio %s\n", active ? "yielding to Wi-Fi (voice session)" : "shared evenly");
+}
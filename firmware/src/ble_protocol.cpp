@@ -0,0 +1,212 @@
+#include "ble_protocol.h"
+#include <string.h>
+
+// ============================================================================
+// BleFrameWriter
+// ============================================================================
+
+BleFrameWriter::BleFrameWriter(BleMessageType type, uint8_t flags, size_t payloadLimit, BleFrameSink sink,
+                               void* context)
+    : used(BLE_FRAME_HEADER),
+      limit(payloadLimit > BLE_VALUE_MAX ? BLE_VALUE_MAX : payloadLimit),
+      type(type),
+      flags(flags),
+      sink(sink),
+      context(context),
+      framesSent(0),
+      droppedAny(false) {
+    if (limit < BLE_FRAME_HEADER + BLE_TLV_HEADER) {
+        limit = BLE_FRAME_HEADER + BLE_TLV_HEADER;
+    }
+}
+
+void BleFrameWriter::flush(bool more) {
+    frame[0] = BLE_PROTOCOL_VERSION;
+    frame[1] = type;
+    frame[2] = flags | (more ? BLE_FLAG_MORE : 0) | (droppedAny ? BLE_FLAG_READ_FULL : 0);
+    sink(frame, used, context);
+    framesSent++;
+    used = BLE_FRAME_HEADER;
+}
+
+void BleFrameWriter::addBytes(uint8_t tag, const void* value, size_t length) {
+    size_t need = BLE_TLV_HEADER + length;
+    if (length > 255 || BLE_FRAME_HEADER + need > limit) {
+        // Can't travel at this MTU; the reader picks it up from the read value
+        droppedAny = true;
+        return;
+    }
+    if (used + need > limit) {
+        flush(true);
+    }
+    frame[used++] = tag;
+    frame[used++] = (uint8_t)length;
+    memcpy(frame + used, value, length);
+    used += length;
+}
+
+void BleFrameWriter::addU8(uint8_t tag, uint8_t value) {
+    addBytes(tag, &value, 1);
+}
+
+void BleFrameWriter::addU16(uint8_t tag, uint16_t value) {
+    uint8_t le[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+    addBytes(tag, le, 2);
+}
+
+void BleFrameWriter::addU32(uint8_t tag, uint32_t value) {
+    uint8_t le[4] = {(uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+    addBytes(tag, le, 4);
+}
+
+void BleFrameWriter::addString(uint8_t tag, const char* value) {
+    addBytes(tag, value, strlen(value));
+}
+
+size_t BleFrameWriter::finish() {
+    // A drop alone still has to reach the app, or it never learns to read
+    if (used > BLE_FRAME_HEADER || (droppedAny && framesSent == 0)) {
+        flush(false);
+    }
+    size_t sent = framesSent;
+    framesSent = 0;
+    return sent;
+}
+
+// ============================================================================
+// BleFrameReader
+// ============================================================================
+
+bool BleFrameReader::begin(const uint8_t* frame, size_t frameLength) {
+    data = frame;
+    length = frameLength;
+    pos = BLE_FRAME_HEADER;
+    bad = false;
+    return frame != nullptr && frameLength >= BLE_FRAME_HEADER && frame[0] == BLE_PROTOCOL_VERSION;
+}
+
+bool BleFrameReader::next(uint8_t* tag, const uint8_t** value, uint8_t* valueLength) {
+    if (pos == length) {
+        return false;
+    }
+    if (pos + BLE_TLV_HEADER > length || pos + BLE_TLV_HEADER + data[pos + 1] > length) {
+        bad = true;
+        return false;
+    }
+    *tag = data[pos];
+    *valueLength = data[pos + 1];
+    *value = data + pos + BLE_TLV_HEADER;
+    pos += BLE_TLV_HEADER + *valueLength;
+    return true;
+}
+
+// ============================================================================
+// Status / metrics
+// ============================================================================
+
+void bleEncodeStatus(const BleStatus& s, const BleStatus* p, BleFrameWriter* w) {
+#define CHANGED(field) (p == nullptr || s.field != p->field)
+#define CHANGED_STR(field) (p == nullptr || strcmp(s.field, p->field) != 0)
+    if (p == nullptr || memcmp(s.deviceId, p->deviceId, sizeof(s.deviceId)) != 0) {
+        w->addBytes(BLE_STATUS_DEVICE_ID, s.deviceId, sizeof(s.deviceId));
+    }
+    if (CHANGED_STR(firmware)) w->addString(BLE_STATUS_FIRMWARE, s.firmware);
+    if (CHANGED(batteryPercent)) w->addU8(BLE_STATUS_BATTERY_PERCENT, s.batteryPercent);
+    if (CHANGED(batteryMv)) w->addU16(BLE_STATUS_BATTERY_MV, s.batteryMv);
+    if (CHANGED(volume)) w->addU8(BLE_STATUS_VOLUME, s.volume);
+    if (CHANGED(wakeMode)) w->addU8(BLE_STATUS_WAKE_MODE, s.wakeMode);
+    if (CHANGED(localWakeActive)) w->addU8(BLE_STATUS_LOCAL_WAKE_ACTIVE, s.localWakeActive);
+    if (CHANGED(wifiConfigured)) w->addU8(BLE_STATUS_WIFI_CONFIGURED, s.wifiConfigured);
+    if (CHANGED(wifiConnected)) w->addU8(BLE_STATUS_WIFI_CONNECTED, s.wifiConnected);
+    if (CHANGED_STR(wifiSsid)) w->addString(BLE_STATUS_WIFI_SSID, s.wifiSsid);
+    if (CHANGED(gatewayConfigured)) w->addU8(BLE_STATUS_GATEWAY_CONFIGURED, s.gatewayConfigured);
+    if (CHANGED(gatewayConnected)) w->addU8(BLE_STATUS_GATEWAY_CONNECTED, s.gatewayConnected);
+    if (CHANGED_STR(gatewayServer)) w->addString(BLE_STATUS_GATEWAY_SERVER, s.gatewayServer);
+    if (CHANGED(gatewayPort)) w->addU16(BLE_STATUS_GATEWAY_PORT, s.gatewayPort);
+    if (CHANGED(ipMode)) w->addU8(BLE_STATUS_IP_MODE, s.ipMode);
+    if (CHANGED(voiceState)) w->addU8(BLE_STATUS_VOICE_STATE, s.voiceState);
+#undef CHANGED
+#undef CHANGED_STR
+}
+
+void bleEncodeMetrics(const uint32_t* values, const uint32_t* previous, size_t count, size_t firstGauge,
+                      BleFrameWriter* writer) {
+    for (size_t i = 0; i < count; i++) {
+        if (previous != nullptr && values[i] == previous[i]) {
+            continue;
+        }
+        uint8_t tag = i < firstGauge ? (uint8_t)i : (uint8_t)(BLE_METRIC_GAUGE_TAG + (i - firstGauge));
+        writer->addU32(tag, values[i]);
+    }
+}
+
+// ============================================================================
+// Config
+// ============================================================================
+
+static bool copyString(char* out, size_t size, const uint8_t* value, uint8_t length) {
+    if (length >= size || memchr(value, '\0', length) != nullptr) {
+        return false;   // Refused rather than silently truncated
+    }
+    memcpy(out, value, length);
+    out[length] = '\0';
+    return true;
+}
+
+BleAckResult bleDecodeConfig(const uint8_t* data, size_t length, BleConfig* config) {
+    memset(config, 0, sizeof(*config));
+
+    BleFrameReader reader;
+    if (!reader.begin(data, length) || reader.type() != BLE_MSG_CONFIG) {
+        return BLE_ACK_MALFORMED;
+    }
+
+    uint8_t tag, len;
+    const uint8_t* value;
+    while (reader.next(&tag, &value, &len)) {
+        bool ok = true;
+        switch (tag) {
+            case BLE_CONFIG_WIFI_SSID:
+                ok = copyString(config->wifiSsid, sizeof(config->wifiSsid), value, len);
+                break;
+            case BLE_CONFIG_WIFI_PASSWORD:
+                ok = copyString(config->wifiPassword, sizeof(config->wifiPassword), value, len);
+                break;
+            case BLE_CONFIG_GATEWAY_SERVER:
+                ok = copyString(config->gatewayServer, sizeof(config->gatewayServer), value, len);
+                break;
+            case BLE_CONFIG_GATEWAY_TOKEN:
+                ok = copyString(config->gatewayToken, sizeof(config->gatewayToken), value, len);
+                break;
+            case BLE_CONFIG_GATEWAY_LIST:
+                ok = copyString(config->gatewayList, sizeof(config->gatewayList), value, len) &&
+                     isValidGatewayList(config->gatewayList);
+                break;
+            case BLE_CONFIG_GATEWAY_PORT:
+                ok = len == 2;
+                if (ok) config->gatewayPort = (uint16_t)(value[0] | value[1] << 8);
+                ok = ok && config->gatewayPort != 0;
+                break;
+            case BLE_CONFIG_VOLUME:
+                ok = len == 1 && value[0] <= 100;
+                if (ok) config->volume = value[0];
+                break;
+            case BLE_CONFIG_WAKE_MODE:
+                ok = len == 1 && value[0] <= 1;         // WAKE_MODE_SERVER / WAKE_MODE_LOCAL
+                if (ok) config->wakeMode = value[0];
+                break;
+            case BLE_CONFIG_IP_MODE:
+                ok = len == 1 && value[0] <= 1;         // IP_MODE_DHCP / IP_MODE_CACHED
+                if (ok) config->ipMode = value[0];
+                break;
+            default:
+                continue;       // From a newer app - ignore
+        }
+        if (!ok) {
+            return BLE_ACK_BAD_VALUE;
+        }
+        config->present |= 1u << tag;
+    }
+
+    return reader.malformed() ? BLE_ACK_MALFORMED : BLE_ACK_OK;
+}
@@ -0,0 +1,260 @@
+#include "display.h"
+#include <driver/spi_master.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <esp_heap_caps.h>
+
+// ST7789V commands
+#define ST7789_SWRESET  0x01
+#define ST7789_SLPOUT   0x11
+#define ST7789_INVON    0x21
+#define ST7789_DISPON   0x29
+#define ST7789_CASET    0x2A
+#define ST7789_RASET    0x2B
+#define ST7789_RAMWR    0x2C
+#define ST7789_MADCTL   0x36
+#define ST7789_COLMOD   0x3A
+
+static spi_device_handle_t panel = nullptr;
+
+// Transactions live in a ring until their result is collected. The driver
+// returns results in queue order, so "collected" is just a counter.
+static spi_transaction_t transactions[DISPLAY_QUEUE_DEPTH];
+static uint32_t queuedCount = 0;
+static uint32_t completedCount = 0;
+
+// Double-buffered bands: each remembers the queue position of the last
+// transfer reading from it
+static uint16_t* bands[2] = {nullptr, nullptr};
+static uint32_t bandBusyUntil[2] = {0, 0};
+static int nextBand = 0;
+
+/**
+ * DC for the transaction about to start: user = 0 for commands, 1 for data
+ */
+static void IRAM_ATTR displayPreTransfer(spi_transaction_t* t) {
+  gpio_set_level((gpio_num_t)TFT_DC, (uint32_t)(uintptr_t)t->user);
+}
+
+/**
+ * Collect the oldest queued transaction (blocks until it has been sent)
+ */
+static void reclaimTransaction() {
+  spi_transaction_t* done = nullptr;
+  if (spi_device_get_trans_result(panel, &done, portMAX_DELAY) == ESP_OK) {
+    completedCount++;
+  }
+}
+
+static spi_transaction_t* nextTransaction() {
+  if (queuedCount - completedCount >= DISPLAY_QUEUE_DEPTH) {
+    reclaimTransaction();  // Ring full - the oldest slot is the one we need
+  }
+  spi_transaction_t* t = &transactions[queuedCount % DISPLAY_QUEUE_DEPTH];
+  memset(t, 0, sizeof(*t));
+  return t;
+}
+
+static void queueTransaction(spi_transaction_t* t) {
+  esp_err_t err = spi_device_queue_trans(panel, t, portMAX_DELAY);
+  if (err != ESP_OK) {
+    Serial.printf("[Display] Failed to queue transfer: %d\n", err);
+    return;
+  }
+  queuedCount++;
+}
+
+void displayCommand(uint8_t cmd, const uint8_t* data, size_t len) {
+  if (panel == nullptr) return;
+
+  spi_transaction_t* t = nextTransaction();
+  t->length = 8;
+  t->flags = SPI_TRANS_USE_TXDATA;
+  t->tx_data[0] = cmd;
+  t->user = (void*)0;
+  queueTransaction(t);
+
+  if (len > 0) {
+    if (len > 4) len = 4;  // Parameters ride in tx_data, no buffer to keep alive
+    t = nextTransaction();
+    t->length = len * 8;
+    t->flags = SPI_TRANS_USE_TXDATA;
+    memcpy(t->tx_data, data, len);
+    t->user = (void*)1;
+    queueTransaction(t);
+  }
+}
+
+void displaySetWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h) {
+  uint16_t x1 = x + w - 1;
+  uint16_t y1 = y + h - 1;
+  uint8_t cols[4] = {(uint8_t)(x >> 8), (uint8_t)x, (uint8_t)(x1 >> 8), (uint8_t)x1};
+  uint8_t rows[4] = {(uint8_t)(y >> 8), (uint8_t)y, (uint8_t)(y1 >> 8), (uint8_t)y1};
+
+  displayCommand(ST7789_CASET, cols, 4);
+  displayCommand(ST7789_RASET, rows, 4);
+  displayCommand(ST7789_RAMWR);
+}
+
+uint16_t* displayAcquireBand() {
+  int index = nextBand;
+  nextBand ^= 1;
+
+  // Usually already free: the other band was being sent while we rendered
+  while ((int32_t)(completedCount - bandBusyUntil[index]) < 0) {
+    reclaimTransaction();
+  }
+  return bands[index];
+}
+
+void displaySubmitBand(uint16_t* band, size_t pixels) {
+  if (panel == nullptr || pixels == 0) return;
+  if (pixels > DISPLAY_BAND_PIXELS) pixels = DISPLAY_BAND_PIXELS;
+
+  spi_transaction_t* t = nextTransaction();
+  t->length = pixels * 16;
+  t->tx_buffer = band;
+  t->user = (void*)1;
+  queueTransaction(t);
+
+  bandBusyUntil[band == bands[0] ? 0 : 1] = queuedCount;
+}
+
+void displayFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (panel == nullptr) return;
+
+  // Clip
+  if (x < 0) { w += x; x = 0; }
+  if (y < 0) { h += y; y = 0; }
+  if (x + w > DISPLAY_WIDTH) w = DISPLAY_WIDTH - x;
+  if (y + h > DISPLAY_HEIGHT) h = DISPLAY_HEIGHT - y;
+  if (w <= 0 || h <= 0) return;
+
+  displaySetWindow(x, y, w, h);
+
+  // A solid fill needs only one band's worth of pixels: queue the same
+  // buffer as many times as it takes
+  size_t total = (size_t)w * h;
+  size_t chunk = total < DISPLAY_BAND_PIXELS ? total : DISPLAY_BAND_PIXELS;
+  uint16_t* band = displayAcquireBand();
+  uint16_t wire = displaySwap(color);
+  for (size_t i = 0; i < chunk; i++) {
+    band[i] = wire;
+  }
+
+  while (total > 0) {
+    size_t n = total < chunk ? total : chunk;
+    displaySubmitBand(band, n);
+    total -= n;
+  }
+}
+
+void displayWait() {
+  while (panel != nullptr && completedCount != queuedCount) {
+    reclaimTransaction();
+  }
+}
+
+void displayBacklight(bool on) {
+  displayBrightness(on ? 100 : 0);
+}
+
+void displayBrightness(uint8_t percent) {
+  if (percent > 100) percent = 100;
+  uint32_t duty = (uint32_t)percent * percent * 255 / 10000;
+  ledc_set_duty(LEDC_LOW_SPEED_MODE, DISPLAY_BL_CHANNEL, duty);
+  ledc_update_duty(LEDC_LOW_SPEED_MODE, DISPLAY_BL_CHANNEL);
+}
+
+/**
+ * Backlight on a PWM channel, starting at full brightness
+ */
+static void initBacklight() {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = LEDC_TIMER_8_BIT;
+  timer.timer_num = DISPLAY_BL_TIMER;
+  timer.freq_hz = DISPLAY_BL_HZ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  ledc_channel_config_t channel = {};
+  channel.gpio_num = TFT_BL;
+  channel.speed_mode = LEDC_LOW_SPEED_MODE;
+  channel.channel = DISPLAY_BL_CHANNEL;
+  channel.timer_sel = DISPLAY_BL_TIMER;
+  channel.duty = 255;  // Backlight ON
+  ledc_channel_config(&channel);
+}
+
+bool displayInit() {
+  pinMode(TFT_DC, OUTPUT);
+  pinMode(TFT_RST, OUTPUT);
+  digitalWrite(TFT_DC, HIGH);
+  initBacklight();
+
+  spi_bus_config_t bus = {};
+  bus.mosi_io_num = TFT_MOSI;
+  bus.miso_io_num = -1;
+  bus.sclk_io_num = TFT_SCLK;
+  bus.quadwp_io_num = -1;
+  bus.quadhd_io_num = -1;
+  bus.max_transfer_sz = DISPLAY_BAND_PIXELS * sizeof(uint16_t);
+
+  esp_err_t err = spi_bus_initialize(DISPLAY_SPI_HOST, &bus, SPI_DMA_CH_AUTO);
+  if (err != ESP_OK) {
+    Serial.printf("[Display] Failed to initialize SPI bus: %d\n", err);
+    return false;
+  }
+
+  spi_device_interface_config_t dev = {};
+  dev.clock_speed_hz = DISPLAY_SPI_HZ;
+  dev.mode = 0;
+  dev.spics_io_num = TFT_CS;
+  dev.queue_size = DISPLAY_QUEUE_DEPTH;
+  dev.pre_cb = displayPreTransfer;
+
+  err = spi_bus_add_device(DISPLAY_SPI_HOST, &dev, &panel);
+  if (err != ESP_OK) {
+    Serial.printf("[Display] Failed to add panel to SPI bus: %d\n", err);
+    panel = nullptr;
+    return false;
+  }
+
+  for (int i = 0; i < 2; i++) {
+    bands[i] = (uint16_t*)heap_caps_malloc(DISPLAY_BAND_PIXELS * sizeof(uint16_t),
+                                           MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (bands[i] == nullptr) {
+      Serial.println("[Display] Failed to allocate DMA band buffers!");
+      panel = nullptr;
+      return false;
+    }
+  }
+
+  Serial.printf("[Display] SPI DMA at %dMHz, %d-line bands\n", DISPLAY_SPI_HZ / 1000000, DISPLAY_BAND_LINES);
+
+  // Hardware reset
+  digitalWrite(TFT_RST, LOW);
+  delay(20);
+  digitalWrite(TFT_RST, HIGH);
+  delay(150);
+
+  displayCommand(ST7789_SWRESET);
+  displayWait();
+  delay(150);
+
+  displayCommand(ST7789_SLPOUT);
+  displayWait();
+  delay(120);
+
+  const uint8_t colorMode = 0x55;   // 16-bit RGB565
+  const uint8_t memoryAccess = 0x60; // MV=1, MX=1 for 90° rotation (landscape)
+  displayCommand(ST7789_COLMOD, &colorMode, 1);
+  displayCommand(ST7789_MADCTL, &memoryAccess, 1);
+  displayCommand(ST7789_INVON);   // Inversion on (required for ST7789)
+  displayCommand(ST7789_DISPON);
+  displayWait();
+  delay(100);
+
+  return true;
+}
@@ -0,0 +1,170 @@
+#include "face_scene.h"
+#include "display.h"
+#include <string.h>
+
+// Half-open box [x0, x1) x [y0, y1), already clipped to the screen
+struct Box {
+  int16_t x0, y0, x1, y1;
+};
+
+static bool boxEmpty(const Box& b) {
+  return b.x1 <= b.x0 || b.y1 <= b.y0;
+}
+
+static Box boxUnion(const Box& a, const Box& b) {
+  if (boxEmpty(a)) return b;
+  if (boxEmpty(b)) return a;
+  return {min(a.x0, b.x0), min(a.y0, b.y0), max(a.x1, b.x1), max(a.y1, b.y1)};
+}
+
+static Box boxIntersect(const Box& a, const Box& b) {
+  return {max(a.x0, b.x0), max(a.y0, b.y0), min(a.x1, b.x1), min(a.y1, b.y1)};
+}
+
+// Touching counts: merging neighbors saves a window setup for a few pixels
+static bool boxTouches(const Box& a, const Box& b) {
+  return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+static int32_t boxArea(const Box& b) {
+  return boxEmpty(b) ? 0 : (int32_t)(b.x1 - b.x0) * (b.y1 - b.y0);
+}
+
+static Box rectBox(const SceneRect& r) {
+  Box screen = {0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT};
+  Box b = {r.x, r.y, (int16_t)(r.x + r.w), (int16_t)(r.y + r.h)};
+  return boxIntersect(b, screen);
+}
+
+static Box elementBounds(const SceneElement& e) {
+  Box bounds = {0, 0, 0, 0};
+  for (uint8_t i = 0; i < e.count; i++) {
+    bounds = boxUnion(bounds, rectBox(e.rects[i]));
+  }
+  return bounds;
+}
+
+static bool elementsEqual(const SceneElement& a, const SceneElement& b) {
+  return a.count == b.count && memcmp(a.rects, b.rects, a.count * sizeof(SceneRect)) == 0;
+}
+
+/**
+ * Add a dirty box, merging it with any it touches
+ */
+static void addDirty(Box* dirty, int* count, Box b) {
+  if (boxEmpty(b)) return;
+
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (int i = 0; i < *count; i++) {
+      if (boxTouches(dirty[i], b)) {
+        b = boxUnion(dirty[i], b);
+        dirty[i] = dirty[--(*count)];
+        merged = true;
+        break;
+      }
+    }
+  }
+
+  if (*count < SCENE_MAX_DIRTY) {
+    dirty[(*count)++] = b;
+    return;
+  }
+
+  // List full - fold into whichever box grows least
+  int best = 0;
+  int32_t bestGrowth = INT32_MAX;
+  for (int i = 0; i < *count; i++) {
+    int32_t growth = boxArea(boxUnion(dirty[i], b)) - boxArea(dirty[i]);
+    if (growth < bestGrowth) {
+      bestGrowth = growth;
+      best = i;
+    }
+  }
+  dirty[best] = boxUnion(dirty[best], b);
+}
+
+/**
+ * Render one box of the scene band by band and queue it
+ */
+static void renderBox(const FaceScene* scene, const Box& box) {
+  const int16_t width = box.x1 - box.x0;
+  const int16_t rowsPerBand = DISPLAY_BAND_PIXELS / width;
+  const uint16_t background = displaySwap(scene->background);
+
+  displaySetWindow(box.x0, box.y0, width, box.y1 - box.y0);
+
+  for (int16_t y = box.y0; y < box.y1; y += rowsPerBand) {
+    int16_t rows = min((int16_t)(box.y1 - y), rowsPerBand);
+    Box bandBox = {box.x0, y, box.x1, (int16_t)(y + rows)};
+    size_t pixels = (size_t)width * rows;
+
+    // Fills the band the previous one is still being sent from
+    uint16_t* band = displayAcquireBand();
+    for (size_t i = 0; i < pixels; i++) {
+      band[i] = background;
+    }
+
+    for (int e = 0; e < SCENE_ELEMENT_COUNT; e++) {
+      const SceneElement& element = scene->elements[e];
+      for (uint8_t r = 0; r < element.count; r++) {
+        Box area = boxIntersect(rectBox(element.rects[r]), bandBox);
+        if (boxEmpty(area)) continue;
+
+        uint16_t color = displaySwap(element.rects[r].color);
+        for (int16_t py = area.y0; py < area.y1; py++) {
+          uint16_t* row = band + (size_t)(py - y) * width + (area.x0 - box.x0);
+          for (int16_t px = 0; px < area.x1 - area.x0; px++) {
+            row[px] = color;
+          }
+        }
+      }
+    }
+
+    displaySubmitBand(band, pixels);
+  }
+}
+
+void sceneInit(FaceScene* scene, uint16_t background) {
+  memset(scene, 0, sizeof(*scene));
+  scene->background = background;
+}
+
+void sceneClearElement(FaceScene* scene, SceneElementId id) {
+  scene->elements[id].count = 0;
+}
+
+void sceneAddRect(FaceScene* scene, SceneElementId id, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  SceneElement& element = scene->elements[id];
+  if (element.count >= SCENE_MAX_RECTS) return;
+  element.rects[element.count++] = {x, y, w, h, color};
+}
+
+void sceneSetRect(FaceScene* scene, SceneElementId id, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  sceneClearElement(scene, id);
+  sceneAddRect(scene, id, x, y, w, h, color);
+}
+
+uint32_t sceneCompose(const FaceScene* shown, const FaceScene* next) {
+  Box dirty[SCENE_MAX_DIRTY];
+  int dirtyCount = 0;
+
+  if (shown == nullptr || shown->background != next->background) {
+    dirty[dirtyCount++] = {0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT};
+  } else {
+    for (int e = 0; e < SCENE_ELEMENT_COUNT; e++) {
+      if (elementsEqual(shown->elements[e], next->elements[e])) continue;
+      // Where it was has to be repainted as well as where it is now
+      addDirty(dirty, &dirtyCount, elementBounds(shown->elements[e]));
+      addDirty(dirty, &dirtyCount, elementBounds(next->elements[e]));
+    }
+  }
+
+  uint32_t pixels = 0;
+  for (int i = 0; i < dirtyCount; i++) {
+    renderBox(next, dirty[i]);
+    pixels += boxArea(dirty[i]);
+  }
+  return pixels;
+}
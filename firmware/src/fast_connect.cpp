@@ -0,0 +1,125 @@
+#include "fast_connect.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+// Last good connection, one NVS blob next to the SSID it belongs to
+struct FastConnectCache {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t mask;
+    uint32_t dns;
+};
+
+static const char* wifiSsid = nullptr;
+static const char* wifiPassword = nullptr;
+static bool usingCache = false;       // Current attempt rides on the cache
+static bool staticIp = false;
+static bool connected = false;
+static unsigned long attemptStart = 0;
+static uint32_t connectTimeMs = 0;
+
+static bool loadCache(const char* ssid, FastConnectCache* cache) {
+    Preferences prefs;
+    prefs.begin("mote", true);
+    String savedSsid = prefs.getString("fc_ssid", "");
+    size_t length = prefs.getBytes("fc_cache", cache, sizeof(FastConnectCache));
+    prefs.end();
+
+    return length == sizeof(FastConnectCache) && savedSsid == ssid && cache->channel != 0;
+}
+
+/**
+ * Remember this connection (only written when it changed - NVS wear)
+ */
+static void saveCache() {
+    FastConnectCache cache = {};
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = (uint8_t)WiFi.channel();
+    cache.ip = (uint32_t)WiFi.localIP();
+    cache.gateway = (uint32_t)WiFi.gatewayIP();
+    cache.mask = (uint32_t)WiFi.subnetMask();
+    cache.dns = (uint32_t)WiFi.dnsIP();
+
+    FastConnectCache previous;
+    if (loadCache(wifiSsid, &previous) && memcmp(&previous, &cache, sizeof(cache)) == 0) {
+        return;
+    }
+
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.putString("fc_ssid", wifiSsid);
+    prefs.putBytes("fc_cache", &cache, sizeof(cache));
+    prefs.end();
+    Serial.printf("[WiFi] Cached AP %s on channel %u\n", WiFi.BSSIDstr().c_str(), cache.channel);
+}
+
+void clearFastConnectCache() {
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.remove("fc_ssid");
+    prefs.remove("fc_cache");
+    prefs.end();
+}
+
+void startFastConnect(const char* ssid, const char* password, IpMode ipMode) {
+    wifiSsid = ssid;
+    wifiPassword = password;
+    connected = false;
+
+    WiFi.persistent(false);      // Our own cache instead of the IDF's flash config
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(true);
+
+    FastConnectCache cache;
+    usingCache = loadCache(ssid, &cache);
+    staticIp = usingCache && ipMode == IP_MODE_CACHED && cache.ip != 0;
+
+    if (staticIp) {
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));
+    }
+
+    attemptStart = millis();
+    if (usingCache) {
+        Serial.printf("[WiFi] Fast connect: channel %u%s\n", cache.channel, staticIp ? ", cached IP" : "");
+        WiFi.begin(ssid, password, cache.channel, cache.bssid);
+    } else {
+        WiFi.begin(ssid, password);
+    }
+}
+
+void handleFastConnect() {
+    if (wifiSsid == nullptr) return;
+
+    if (WiFi.status() == WL_CONNECTED) {
+        if (!connected) {
+            connected = true;
+            if (connectTimeMs == 0) connectTimeMs = millis();
+            Serial.printf("[WiFi] Connected in %lums (%s), IP: %s\n", millis() - attemptStart,
+                          usingCache ? "cached AP" : "scan", WiFi.localIP().toString().c_str());
+            saveCache();
+        }
+        return;
+    }
+    connected = false;
+
+    // Cached AP didn't answer at boot - forget it and do a full scan + DHCP.
+    // Later drops are left to auto-reconnect.
+    if (usingCache && connectTimeMs == 0 && millis() - attemptStart > FAST_CONNECT_TIMEOUT_MS) {
+        Serial.println("[WiFi] Cached AP not answering - scanning");
+        usingCache = false;
+        clearFastConnectCache();
+        WiFi.disconnect();
+        if (staticIp) {
+            WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+            staticIp = false;
+        }
+        attemptStart = millis();
+        WiFi.begin(wifiSsid, wifiPassword);
+    }
+}
+
+uint32_t getFastConnectTimeMs() {
+    return connectTimeMs;
+}
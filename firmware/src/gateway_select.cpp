@@ -0,0 +1,251 @@
+#include "gateway_select.h"
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * Parse a dotted quad strictly (four 0-255 decimal parts, nothing else)
+ */
+static bool parseIpv4(const char* host, uint8_t* octets) {
+    const char* p = host;
+    for (int i = 0; i < 4; i++) {
+        if (!isdigit((unsigned char)*p)) return false;
+
+        uint32_t value = 0;
+        int digits = 0;
+        while (isdigit((unsigned char)*p)) {
+            value = value * 10 + (uint32_t)(*p - '0');
+            if (++digits > 3 || value > 255) return false;
+            p++;
+        }
+        octets[i] = (uint8_t)value;
+
+        if (i < 3) {
+            if (*p != '.') return false;
+            p++;
+        }
+    }
+    return *p == '\0';
+}
+
+bool isLocalNetworkHost(const char* host) {
+    if (host == nullptr) return false;
+
+    static const char localhost[] = "localhost";
+    size_t length = strlen(host);
+    if (length == sizeof(localhost) - 1) {
+        size_t i = 0;
+        while (i < length && tolower((unsigned char)host[i]) == localhost[i]) i++;
+        if (i == length) return true;
+    }
+
+    uint8_t ip[4];
+    if (!parseIpv4(host, ip)) return false;
+
+    return ip[0] == 10 ||                                   // 10.0.0.0/8
+           (ip[0] == 172 && ip[1] >= 16 && ip[1] <= 31) ||  // 172.16.0.0/12
+           (ip[0] == 192 && ip[1] == 168) ||                // 192.168.0.0/16
+           ip[0] == 127 ||                                  // Loopback
+           (ip[0] == 169 && ip[1] == 254);                  // Link-local
+}
+
+static bool startsWith(const char* text, size_t length, const char* prefix) {
+    size_t n = strlen(prefix);
+    return length >= n && strncmp(text, prefix, n) == 0;
+}
+
+bool parseGatewayEndpoint(const char* text, size_t length, uint16_t defaultPort, GatewayEndpoint* endpoint) {
+    while (length > 0 && isspace((unsigned char)text[0])) {
+        text++;
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)text[length - 1])) {
+        length--;
+    }
+
+    int scheme = -1;  // -1 none, 0 ws, 1 wss
+    if (startsWith(text, length, "wss://")) {
+        scheme = 1;
+        text += 6;
+        length -= 6;
+    } else if (startsWith(text, length, "ws://")) {
+        scheme = 0;
+        text += 5;
+        length -= 5;
+    }
+    if (length > 0 && text[length - 1] == '/') {
+        length--;
+    }
+
+    // Host runs to the port separator; the path is always /ws/voice
+    size_t hostLength = 0;
+    while (hostLength < length && text[hostLength] != ':') {
+        char c = text[hostLength];
+        if (!isalnum((unsigned char)c) && c != '.' && c != '-' && c != '_') return false;
+        hostLength++;
+    }
+    if (hostLength == 0 || hostLength >= sizeof(endpoint->host)) return false;
+
+    uint32_t port = defaultPort;
+    if (hostLength < length) {
+        const char* digits = text + hostLength + 1;
+        size_t digitCount = length - hostLength - 1;
+        if (digitCount == 0 || digitCount > 5) return false;
+
+        port = 0;
+        for (size_t i = 0; i < digitCount; i++) {
+            if (!isdigit((unsigned char)digits[i])) return false;
+            port = port * 10 + (uint32_t)(digits[i] - '0');
+        }
+    }
+    if (port == 0 || port > 65535) return false;
+
+    memcpy(endpoint->host, text, hostLength);
+    endpoint->host[hostLength] = '\0';
+    endpoint->port = (uint16_t)port;
+    endpoint->tls = scheme >= 0 ? scheme == 1 : !isLocalNetworkHost(endpoint->host);
+    return true;
+}
+
+bool isValidGatewayList(const char* list) {
+    if (list == nullptr) return true;
+
+    const char* entry = list;
+    while (true) {
+        const char* end = strchr(entry, ',');
+        size_t length = end ? (size_t)(end - entry) : strlen(entry);
+
+        // Blank entries (a trailing comma) are fine
+        bool blank = true;
+        for (size_t i = 0; i < length; i++) {
+            if (!isspace((unsigned char)entry[i])) blank = false;
+        }
+        GatewayEndpoint endpoint;
+        if (!blank && !parseGatewayEndpoint(entry, length, 1, &endpoint)) return false;
+
+        if (end == nullptr) return true;
+        entry = end + 1;
+    }
+}
+
+uint32_t gatewayBackoffMs(uint8_t failures, uint32_t random) {
+    uint32_t delay = GATEWAY_BACKOFF_BASE_MS;
+    for (uint8_t i = 1; i < failures && delay < GATEWAY_BACKOFF_MAX_MS; i++) {
+        delay *= 2;
+    }
+    if (delay > GATEWAY_BACKOFF_MAX_MS) delay = GATEWAY_BACKOFF_MAX_MS;
+
+    // Equal jitter: at least half the delay, so backoff still grows
+    uint32_t half = delay / 2;
+    return half + random % (delay - half + 1);
+}
+
+GatewaySelector::GatewaySelector() {
+    configure(nullptr, 0, nullptr);
+}
+
+bool GatewaySelector::add(const char* text, size_t length, uint16_t defaultPort) {
+    if (endpointCount >= GATEWAY_MAX_ENDPOINTS) return false;
+
+    GatewayEndpoint& candidate = endpoints[endpointCount];
+    if (!parseGatewayEndpoint(text, length, defaultPort, &candidate)) return false;
+
+    for (size_t i = 0; i < endpointCount; i++) {
+        if (endpoints[i].port == candidate.port && strcmp(endpoints[i].host, candidate.host) == 0) {
+            return false;
+        }
+    }
+    endpointCount++;
+    return true;
+}
+
+size_t GatewaySelector::configure(const char* primary, uint16_t primaryPort, const char* list) {
+    memset(endpoints, 0, sizeof(endpoints));
+    for (size_t i = 0; i < GATEWAY_MAX_ENDPOINTS; i++) {
+        rtts[i] = GATEWAY_RTT_UNKNOWN;
+        failureCounts[i] = 0;
+        retryAtMs[i] = 0;
+    }
+    endpointCount = 0;
+    holdUntilMs = 0;
+    holding = false;
+    connectedAtMs = 0;
+
+    if (primary != nullptr) {
+        add(primary, strlen(primary), primaryPort);
+    }
+
+    // List entries without a port share the primary's
+    const char* entry = list;
+    while (entry != nullptr && *entry != '\0') {
+        const char* end = strchr(entry, ',');
+        size_t length = end ? (size_t)(end - entry) : strlen(entry);
+        add(entry, length, primaryPort);
+        entry = end ? end + 1 : nullptr;
+    }
+    return endpointCount;
+}
+
+void GatewaySelector::setRtt(size_t index, uint32_t rttMs) {
+    if (index < endpointCount) rtts[index] = rttMs;
+}
+
+bool GatewaySelector::available(size_t index, uint32_t nowMs) const {
+    return failureCounts[index] == 0 || (int32_t)(nowMs - retryAtMs[index]) >= 0;
+}
+
+int GatewaySelector::select(uint32_t nowMs) const {
+    if (holding && (int32_t)(nowMs - holdUntilMs) < 0) return -1;
+
+    // RTT order puts measured first, then unknown, then unreachable; ties keep list order
+    int best = -1;
+    for (size_t i = 0; i < endpointCount; i++) {
+        if (available(i, nowMs) && (best < 0 || rtts[i] < rtts[best])) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+int GatewaySelector::fasterThan(size_t current, uint32_t nowMs) const {
+    if (current >= endpointCount) return -1;
+
+    int best = -1;
+    for (size_t i = 0; i < endpointCount; i++) {
+        if (i != current && available(i, nowMs) && rtts[i] < GATEWAY_RTT_UNKNOWN &&
+            (best < 0 || rtts[i] < rtts[best])) {
+            best = (int)i;
+        }
+    }
+    if (best < 0) return -1;
+
+    // An unmeasured or unreachable current endpoint loses to any measured one
+    if (rtts[current] >= GATEWAY_RTT_UNKNOWN) return best;
+    return rtts[best] + GATEWAY_SWITCH_MARGIN_MS < rtts[current] ? best : -1;
+}
+
+void GatewaySelector::backOff(size_t index, uint32_t nowMs, uint32_t random) {
+    if (failureCounts[index] < 255) failureCounts[index]++;
+    retryAtMs[index] = nowMs + gatewayBackoffMs(failureCounts[index], random & 0xFFFF);
+
+    holdUntilMs = nowMs + (random >> 16) % (GATEWAY_FAILOVER_JITTER_MS + 1);
+    holding = true;
+}
+
+void GatewaySelector::onFailure(size_t index, uint32_t nowMs, uint32_t random) {
+    if (index < endpointCount) backOff(index, nowMs, random);
+}
+
+void GatewaySelector::onConnected(uint32_t nowMs) {
+    connectedAtMs = nowMs;
+    holding = false;
+}
+
+void GatewaySelector::onDisconnected(size_t index, uint32_t nowMs, uint32_t random) {
+    if (index >= endpointCount) return;
+
+    // A gateway that keeps dropping sessions right away is treated as failing
+    if (nowMs - connectedAtMs >= GATEWAY_STABLE_MS) {
+        failureCounts[index] = 0;
+    }
+    backOff(index, nowMs, random);
+}
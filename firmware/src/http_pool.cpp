@@ -0,0 +1,234 @@
+#include "http_pool.h"
+#include <WiFiClientSecure.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// One origin's connection. Key and state change under poolLock; the
+// clients themselves are only touched by the worker holding the lease (or
+// under the lock while nobody does).
+struct PoolSlot {
+    bool leased;
+    bool open;               // Connection parked after the last lease
+    bool secure;
+    uint16_t port;
+    char host[HTTP_POOL_HOST_SIZE];   // Empty: never used
+    uint32_t lastUsed;       // millis() at release
+    WiFiClient plain;
+    WiFiClientSecure tls;
+    HTTPClient http;
+};
+
+static PoolSlot slots[HTTP_POOL_SLOTS];
+static SemaphoreHandle_t poolLock = nullptr;
+
+static volatile uint32_t reusedCount = 0;
+static volatile uint32_t openedCount = 0;
+static volatile uint32_t evictedCount = 0;
+
+static WiFiClient& slotClient(PoolSlot& slot) {
+    if (slot.secure) return slot.tls;
+    return slot.plain;
+}
+
+/**
+ * Split "http[s]://[user@]host[:port]/..." into the pool key
+ */
+static bool parseOrigin(const String& url, bool* secure, char* host, uint16_t* port) {
+    int start;
+    if (url.startsWith("https://")) {
+        *secure = true;
+        *port = 443;
+        start = 8;
+    } else if (url.startsWith("http://")) {
+        *secure = false;
+        *port = 80;
+        start = 7;
+    } else {
+        return false;
+    }
+
+    int end = start;
+    while (end < (int)url.length() && url[end] != '/' && url[end] != '?' && url[end] != '#') {
+        end++;
+    }
+
+    int at = url.lastIndexOf('@', end - 1);
+    if (at >= start) start = at + 1;
+
+    int colon = url.indexOf(':', start);
+    int hostEnd = (colon >= 0 && colon < end) ? colon : end;
+    if (hostEnd == start || hostEnd - start >= HTTP_POOL_HOST_SIZE) return false;
+
+    if (hostEnd < end) {
+        long value = url.substring(hostEnd + 1, end).toInt();
+        if (value <= 0 || value > 65535) return false;
+        *port = (uint16_t)value;
+    }
+
+    memcpy(host, url.c_str() + start, hostEnd - start);
+    host[hostEnd - start] = '\0';
+    return true;
+}
+
+/**
+ * Close a parked connection (poolLock held, slot not leased)
+ */
+static void closeSlot(PoolSlot& slot) {
+    if (!slot.open) return;
+    slotClient(slot).stop();
+    slot.open = false;
+    evictedCount++;
+}
+
+/**
+ * Pick a slot for an origin: its own parked connection, else an unused
+ * slot, else the least recently used idle one (poolLock held)
+ */
+static int findSlot(bool secure, const char* host, uint16_t port, bool* match) {
+    int unused = -1;
+    int oldest = -1;
+
+    for (int i = 0; i < HTTP_POOL_SLOTS; i++) {
+        PoolSlot& slot = slots[i];
+        if (slot.leased) continue;
+
+        if (slot.secure == secure && slot.port == port && strcmp(slot.host, host) == 0) {
+            *match = true;
+            return i;
+        }
+        if (!slot.open) {
+            if (unused < 0) unused = i;
+        } else if (oldest < 0 || (int32_t)(slot.lastUsed - slots[oldest].lastUsed) < 0) {
+            oldest = i;
+        }
+    }
+
+    *match = false;
+    return unused >= 0 ? unused : oldest;
+}
+
+bool setupHttpPool() {
+    if (poolLock == nullptr) {
+        poolLock = xSemaphoreCreateMutex();
+    }
+    return poolLock != nullptr;
+}
+
+bool httpPoolAcquire(const String& url, uint32_t timeoutMs, HttpLease* lease) {
+    lease->http = nullptr;
+    lease->reused = false;
+    lease->slot = -1;
+    if (poolLock == nullptr) return false;
+
+    bool secure;
+    char host[HTTP_POOL_HOST_SIZE];
+    uint16_t port;
+    if (!parseOrigin(url, &secure, host, &port)) {
+        return false;
+    }
+
+    xSemaphoreTake(poolLock, portMAX_DELAY);
+    bool match;
+    int index = findSlot(secure, host, port, &match);
+    if (index >= 0) {
+        PoolSlot& slot = slots[index];
+        if (!match) {
+            // Recycled for another origin
+            closeSlot(slot);
+            slot.secure = secure;
+            slot.port = port;
+            strcpy(slot.host, host);
+        }
+        slot.leased = true;
+    }
+    xSemaphoreGive(poolLock);
+
+    if (index < 0) {
+        Serial.println("[HTTP] Connection pool exhausted");
+        return false;
+    }
+
+    PoolSlot& slot = slots[index];
+    WiFiClient& client = slotClient(slot);
+
+    // connected() also notices a peer that closed while we were parked
+    lease->reused = slot.open && client.connected();
+    if (lease->reused) {
+        reusedCount++;
+    } else {
+        openedCount++;
+        if (slot.secure) {
+            slot.tls.setInsecure();
+            slot.tls.setHandshakeTimeout((timeoutMs + 999) / 1000);
+        }
+    }
+    slot.open = false;
+
+    slot.http.setReuse(true);
+    slot.http.setConnectTimeout(timeoutMs);
+    slot.http.setTimeout(timeoutMs > 0xFFFF ? 0xFFFF : timeoutMs);
+    if (!slot.http.begin(client, url)) {
+        client.stop();
+        xSemaphoreTake(poolLock, portMAX_DELAY);
+        slot.leased = false;
+        xSemaphoreGive(poolLock);
+        return false;
+    }
+
+    lease->http = &slot.http;
+    lease->slot = index;
+    return true;
+}
+
+void httpPoolRelease(HttpLease* lease, bool reusable) {
+    if (lease->slot < 0) return;
+
+    PoolSlot& slot = slots[lease->slot];
+    WiFiClient& client = slotClient(slot);
+
+    // end() leaves the socket open only if the server allowed keep-alive
+    slot.http.end();
+
+    bool keep = reusable && client.connected() &&
+                heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= HTTP_POOL_MIN_INTERNAL;
+    if (!keep) {
+        client.stop();
+    }
+
+    xSemaphoreTake(poolLock, portMAX_DELAY);
+    slot.open = keep;
+    slot.lastUsed = millis();
+    slot.leased = false;
+    xSemaphoreGive(poolLock);
+
+    lease->http = nullptr;
+    lease->slot = -1;
+}
+
+void httpPoolEvictIdle() {
+    if (poolLock == nullptr) return;
+
+    uint32_t now = millis();
+    xSemaphoreTake(poolLock, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SLOTS; i++) {
+        PoolSlot& slot = slots[i];
+        if (!slot.leased && slot.open && now - slot.lastUsed >= HTTP_POOL_IDLE_MS) {
+            Serial.printf("[HTTP] Closing idle connection to %s:%u\n", slot.host, slot.port);
+            closeSlot(slot);
+        }
+    }
+    xSemaphoreGive(poolLock);
+}
+
+void getHttpPoolStats(HttpPoolStats* stats) {
+    stats->leased = 0;
+    stats->parked = 0;
+    for (int i = 0; i < HTTP_POOL_SLOTS; i++) {
+        if (slots[i].leased) stats->leased++;
+        if (slots[i].open) stats->parked++;
+    }
+    stats->reused = reusedCount;
+    stats->opened = openedCount;
+    stats->evicted = evictedCount;
+}
@@ -0,0 +1,659 @@
+#include "iot_executor.h"
+#include "http_pool.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <mbedtls/base64.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+enum IotCommand : uint8_t {
+    IOT_CMD_HTTP,
+    IOT_CMD_WIFI_SCAN
+};
+
+enum IotJobState : uint8_t {
+    IOT_JOB_FREE,
+    IOT_JOB_QUEUED,
+    IOT_JOB_RUNNING
+};
+
+// One accepted request. Slots are claimed by the WebSocket handler and
+// released by the worker that ran them; state changes happen under jobLock.
+struct IotJob {
+    IotJobState state;
+    volatile bool cancelled;
+    IotCommand command;
+    char requestId[IOT_REQUEST_ID_SIZE];
+    uint32_t deadline;       // millis()
+    char* params;            // "params" re-serialized (heap, owned by the job), may be null
+};
+
+static IotJob jobs[IOT_MAX_JOBS];
+static QueueHandle_t jobQueue = nullptr;      // Slot indices, FIFO
+static SemaphoreHandle_t jobLock = nullptr;
+static SemaphoreHandle_t scanLock = nullptr;  // One WiFi scan at a time
+static TaskHandle_t workerHandles[IOT_WORKER_COUNT] = {};
+static IotSendCallback sendCallback = nullptr;
+
+static volatile uint32_t completedCount = 0;
+static volatile uint32_t rejectedCount = 0;
+static volatile uint32_t expiredCount = 0;
+static volatile uint32_t cancelledCount = 0;
+static volatile uint32_t chunksSentCount = 0;
+
+/**
+ * Milliseconds left before the job's deadline (0 once it has passed)
+ */
+static uint32_t remainingMs(const IotJob& job) {
+    int32_t left = (int32_t)(job.deadline - millis());
+    return left > 0 ? (uint32_t)left : 0;
+}
+
+/**
+ * Request ids are copied verbatim into iot.chunk frames, so they must be
+ * short and need no JSON escaping
+ */
+static bool validRequestId(const char* requestId) {
+    size_t n = strlen(requestId);
+    if (n >= IOT_REQUEST_ID_SIZE) return false;
+    for (size_t i = 0; i < n; i++) {
+        char c = requestId[i];
+        if (c == '"' || c == '\\' || (uint8_t)c < 0x20) return false;
+    }
+    return true;
+}
+
+/**
+ * Serialize straight into the frame that gets queued - no String in between
+ */
+static bool sendDocument(const JsonDocument& doc, uint32_t waitMs) {
+    size_t length = measureJson(doc);
+    char* frame = (char*)malloc(length + 1);
+    if (frame == nullptr) return false;
+    serializeJson(doc, frame, length + 1);
+    return sendCallback(frame, length, waitMs);
+}
+
+/**
+ * Send an iot.response (any task)
+ */
+static void sendIoTResponse(const char* requestId, bool ok, JsonVariantConst payload, const char* error) {
+    if (sendCallback == nullptr) return;
+
+    JsonDocument doc;
+    doc["type"] = "iot.response";
+    doc["requestId"] = requestId;
+    doc["ok"] = ok;
+
+    if (!payload.isNull()) {
+        doc["payload"] = payload;
+    }
+
+    if (!ok && error != nullptr && error[0] != '\0') {
+        doc["error"] = error;
+    }
+
+    if (!sendDocument(doc, IOT_RESPONSE_WAIT_MS)) {
+        Serial.printf("[IoT] Send queue full, response to %s dropped\n", requestId);
+        return;
+    }
+    Serial.printf("[IoT] Sent response to %s: ok=%d\n", requestId, ok);
+}
+
+static void sendIoTError(const char* requestId, const char* error) {
+    sendIoTResponse(requestId, false, JsonVariantConst(), error);
+}
+
+/**
+ * Response for a job - unless it was cancelled while running
+ */
+static void respond(IotJob& job, bool ok, JsonVariantConst payload, const char* error) {
+    if (job.cancelled) {
+        Serial.printf("[IoT] Request %s was cancelled, response dropped\n", job.requestId);
+        return;
+    }
+    sendIoTResponse(job.requestId, ok, payload, error);
+    completedCount++;
+}
+
+static void respondError(IotJob& job, const char* error) {
+    respond(job, false, JsonVariantConst(), error);
+}
+
+/**
+ * HTTP body sink for a regular iot.response: keeps the first `capacity`
+ * bytes, then refuses more, which stops HTTPClient::writeToStream()
+ */
+class BodyCapture : public Stream {
+public:
+    BodyCapture(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0), truncated(false) {}
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t* data, size_t n) override {
+        size_t room = capacity - length;
+        if (n > room) {
+            truncated = true;
+            n = room;
+        }
+        memcpy(buffer + length, data, n);
+        length += n;
+        return n;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    char* buffer;
+    size_t capacity;
+    size_t length;
+    bool truncated;
+};
+
+/**
+ * HTTP body sink for params.stream: every IOT_CHUNK_BYTES go out as one
+ * iot.chunk frame. Blocks while the send queue is full (up to the request
+ * deadline), which is what bounds memory for large bodies.
+ */
+class ChunkStreamer : public Stream {
+public:
+    explicit ChunkStreamer(IotJob& job) : job(job), fill(0), seq(0), total(0), failed(false) {}
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t* data, size_t n) override {
+        size_t done = 0;
+        while (done < n) {
+            size_t take = min(n - done, (size_t)IOT_CHUNK_BYTES - fill);
+            memcpy(raw + fill, data + done, take);
+            fill += take;
+            done += take;
+            if (fill == IOT_CHUNK_BYTES && !flush(false, nullptr)) {
+                return 0;  // Cancelled or stalled - abort the transfer
+            }
+        }
+        return n;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    /**
+     * Send the last chunk
+     * @param error Why the body ended early (nullptr if complete)
+     */
+    void finish(const char* error) {
+        if (!failed) flush(true, error);
+    }
+
+    bool hasFailed() const { return failed; }
+    uint32_t bytes() const { return total; }
+
+private:
+    bool flush(bool last, const char* error) {
+        if (job.cancelled) failed = true;
+        if (failed) return false;
+
+        // Header + base64 + largest tail; requestId and error never need escaping
+        size_t capacity = 96 + strlen(job.requestId) + 4 * ((fill + 2) / 3) + 64 + (error ? strlen(error) : 0);
+        char* frame = (char*)malloc(capacity);
+        if (frame == nullptr) {
+            failed = true;
+            return false;
+        }
+
+        int n = snprintf(frame, capacity, "{\"type\":\"iot.chunk\",\"requestId\":\"%s\",\"seq\":%u,\"data\":\"",
+                         job.requestId, (unsigned)seq);
+        size_t encoded = 0;
+        mbedtls_base64_encode((unsigned char*)frame + n, capacity - n, &encoded, raw, fill);
+        n += encoded;
+        total += fill;
+
+        if (!last) {
+            n += snprintf(frame + n, capacity - n, "\"}");
+        } else if (error != nullptr) {
+            n += snprintf(frame + n, capacity - n, "\",\"done\":true,\"error\":\"%s\"}", error);
+        } else {
+            n += snprintf(frame + n, capacity - n, "\",\"done\":true,\"bytes\":%u}", (unsigned)total);
+        }
+
+        if (!sendCallback(frame, n, remainingMs(job))) {
+            Serial.printf("[IoT] Stream %s stalled at chunk %u\n", job.requestId, (unsigned)seq);
+            failed = true;
+            return false;
+        }
+
+        chunksSentCount++;
+        seq++;
+        fill = 0;
+        return true;
+    }
+
+    IotJob& job;
+    uint8_t raw[IOT_CHUNK_BYTES];
+    size_t fill;
+    uint32_t seq;
+    uint32_t total;
+    bool failed;
+};
+
+/**
+ * Body of up to IOT_INLINE_BODY_MAX bytes in the iot.response itself
+ * @return true if the body was read to the end (connection reusable)
+ */
+static bool respondInline(IotJob& job, HTTPClient& http, int httpCode) {
+    char* body = (char*)malloc(IOT_INLINE_BODY_MAX + 1);
+    if (body == nullptr) {
+        respondError(job, "Out of memory");
+        return false;
+    }
+
+    int contentLength = http.getSize();  // writeToStream() end()s the client, which clears it
+    BodyCapture capture(body, IOT_INLINE_BODY_MAX);
+    int result = http.writeToStream(&capture);
+    body[capture.length] = '\0';
+
+    if (result < 0 && !capture.truncated) {
+        free(body);
+        String error = "HTTP read failed: " + HTTPClient::errorToString(result);
+        Serial.printf("[IoT] %s\n", error.c_str());
+        respondError(job, error.c_str());
+        return false;
+    }
+
+    Serial.printf("[IoT] HTTP response %d: %.100s\n", httpCode, body);
+
+    JsonDocument payload;
+    payload["statusCode"] = httpCode;
+    payload["body"] = (const char*)body;
+    if (capture.truncated) {
+        // Said out loud - the caller can retry with "stream": true
+        payload["truncated"] = true;
+        payload["contentLength"] = contentLength;
+        Serial.printf("[IoT] Response truncated at %d bytes\n", IOT_INLINE_BODY_MAX);
+    }
+    free(body);
+
+    respond(job, httpCode >= 200 && httpCode < 400, payload.as<JsonVariantConst>(), nullptr);
+    return !capture.truncated;
+}
+
+/**
+ * Status in the iot.response, then the body as iot.chunk frames
+ * @return true if the body was read to the end (connection reusable)
+ */
+static bool respondStreamed(IotJob& job, HTTPClient& http, int httpCode) {
+    JsonDocument head;
+    head["statusCode"] = httpCode;
+    head["contentLength"] = http.getSize();  // -1 for chunked transfer encoding
+    head["contentType"] = http.header("Content-Type");
+    head["stream"] = true;
+    respond(job, httpCode >= 200 && httpCode < 400, head.as<JsonVariantConst>(), nullptr);
+
+    ChunkStreamer streamer(job);
+    int result = http.writeToStream(&streamer);
+    if (job.cancelled) return false;
+
+    streamer.finish(result < 0 ? "HTTP read failed" : nullptr);
+    Serial.printf("[IoT] Streamed %u bytes for %s%s\n", streamer.bytes(), job.requestId,
+                  streamer.hasFailed() ? " (incomplete)" : "");
+    return result >= 0 && !streamer.hasFailed();
+}
+
+/**
+ * Headers and request on a leased client
+ * @return HTTP status, or a negative HTTPC_ERROR_*
+ */
+static int sendHttp(HTTPClient& http, const String& method, const String& body,
+                    JsonObjectConst headers, bool stream) {
+    if (stream) {
+        const char* collect[] = {"Content-Type"};
+        http.collectHeaders(collect, 1);
+    }
+
+    // Add headers if provided
+    if (headers) {
+        for (JsonPairConst kv : headers) {
+            http.addHeader(kv.key().c_str(), kv.value().as<String>());
+        }
+    }
+
+    if (method == "GET") {
+        return http.GET();
+    } else if (method == "POST") {
+        if (headers["Content-Type"].isNull()) {
+            http.addHeader("Content-Type", "application/json");
+        }
+        return http.POST(body);
+    } else if (method == "PUT") {
+        if (headers["Content-Type"].isNull()) {
+            http.addHeader("Content-Type", "application/json");
+        }
+        return http.PUT(body);
+    }
+    return http.sendRequest("DELETE", body);
+}
+
+/**
+ * Handle IoT HTTP request
+ */
+static void handleIoTHttp(IotJob& job, JsonObjectConst params) {
+    String url = params["url"] | "";
+    String method = params["method"] | "GET";
+    String body = params["body"] | "";
+    bool stream = params["stream"] | false;
+
+    if (url.length() == 0) {
+        respondError(job, "URL is required");
+        return;
+    }
+
+    Serial.printf("[IoT] HTTP %s %s%s\n", method.c_str(), url.c_str(), stream ? " (streamed)" : "");
+
+    if (method != "GET" && method != "POST" && method != "PUT" && method != "DELETE") {
+        String error = "Unsupported HTTP method: " + method;
+        respondError(job, error.c_str());
+        return;
+    }
+
+    JsonObjectConst headers = params["headers"];
+    HttpLease lease;
+    int httpCode = 0;
+
+    // A parked connection the server has since dropped fails on first use;
+    // go again on a fresh one unless the request might have been applied
+    for (int attempt = 0; attempt < 2; attempt++) {
+        // Whatever is left of the request's deadline bounds connect and read
+        if (!httpPoolAcquire(url, remainingMs(job), &lease)) {
+            respondError(job, "Invalid URL or no free connection");
+            return;
+        }
+
+        httpCode = sendHttp(*lease.http, method, body, headers, stream);
+        bool stale = lease.reused && method != "POST" &&
+                     (httpCode == HTTPC_ERROR_SEND_HEADER_FAILED || httpCode == HTTPC_ERROR_CONNECTION_LOST ||
+                      httpCode == HTTPC_ERROR_NOT_CONNECTED);
+        if (!stale || remainingMs(job) == 0) break;
+
+        Serial.printf("[IoT] Parked connection went stale (%d), reconnecting\n", httpCode);
+        httpPoolRelease(&lease, false);
+    }
+
+    bool reusable = false;
+    if (httpCode > 0) {
+        if (stream) {
+            reusable = respondStreamed(job, *lease.http, httpCode);
+        } else {
+            reusable = respondInline(job, *lease.http, httpCode);
+        }
+    } else {
+        String error = "HTTP request failed: " + HTTPClient::errorToString(httpCode);
+        Serial.printf("[IoT] %s\n", error.c_str());
+        respondError(job, error.c_str());
+    }
+
+    httpPoolRelease(&lease, reusable);
+}
+
+/**
+ * Handle IoT WiFi scan request
+ */
+static void handleWifiScan(IotJob& job) {
+    // Two scans at once would fight over the radio - wait for the other one
+    if (xSemaphoreTake(scanLock, pdMS_TO_TICKS(remainingMs(job))) != pdTRUE) {
+        respondError(job, "Deadline exceeded waiting for another scan");
+        return;
+    }
+
+    Serial.println("[IoT] Starting WiFi scan...");
+
+    int n = WiFi.scanNetworks();
+
+    JsonDocument payload;
+    JsonArray networks = payload["networks"].to<JsonArray>();
+
+    for (int i = 0; i < n && i < 20; i++) { // Limit to 20 networks
+        JsonObject net = networks.add<JsonObject>();
+        net["ssid"] = WiFi.SSID(i);
+        net["rssi"] = WiFi.RSSI(i);
+        net["channel"] = WiFi.channel(i);
+        net["encryption"] = WiFi.encryptionType(i);
+    }
+
+    payload["count"] = n;
+
+    WiFi.scanDelete(); // Clean up scan results
+    xSemaphoreGive(scanLock);
+
+    Serial.printf("[IoT] Found %d networks\n", n);
+    respond(job, true, payload.as<JsonVariantConst>(), nullptr);
+}
+
+static void releaseJob(IotJob& job) {
+    xSemaphoreTake(jobLock, portMAX_DELAY);
+    free(job.params);
+    job.params = nullptr;
+    job.state = IOT_JOB_FREE;
+    xSemaphoreGive(jobLock);
+}
+
+/**
+ * Run one job to completion
+ */
+static void runJob(IotJob& job) {
+    if (remainingMs(job) == 0) {
+        expiredCount++;
+        Serial.printf("[IoT] Request %s expired in the queue\n", job.requestId);
+        respondError(job, "Deadline exceeded before the request could run");
+        return;
+    }
+
+    JsonDocument params;
+    if (job.params != nullptr) {
+        DeserializationError err = deserializeJson(params, job.params);
+        if (err) {
+            respondError(job, "Invalid params");
+            return;
+        }
+    }
+
+    switch (job.command) {
+        case IOT_CMD_HTTP:
+            handleIoTHttp(job, params.as<JsonObjectConst>());
+            break;
+
+        case IOT_CMD_WIFI_SCAN:
+            handleWifiScan(job);
+            break;
+    }
+}
+
+static void iotWorkerTask(void* parameter) {
+    while (true) {
+        uint8_t index;
+        if (xQueueReceive(jobQueue, &index, pdMS_TO_TICKS(HTTP_POOL_IDLE_MS / 2)) != pdTRUE) {
+            // Nothing to do - a good time to close stale keep-alive connections
+            httpPoolEvictIdle();
+            continue;
+        }
+        IotJob& job = jobs[index];
+
+        xSemaphoreTake(jobLock, portMAX_DELAY);
+        bool skip = job.cancelled;
+        job.state = IOT_JOB_RUNNING;
+        xSemaphoreGive(jobLock);
+
+        if (!skip) {
+            runJob(job);
+        }
+        releaseJob(job);
+    }
+}
+
+bool setupIotExecutor(IotSendCallback send) {
+    sendCallback = send;
+    if (jobQueue != nullptr) return true;
+
+    jobLock = xSemaphoreCreateMutex();
+    scanLock = xSemaphoreCreateMutex();
+    jobQueue = xQueueCreate(IOT_MAX_JOBS, sizeof(uint8_t));
+    if (jobLock == nullptr || scanLock == nullptr || jobQueue == nullptr || !setupHttpPool()) {
+        Serial.println("[IoT] Failed to create executor queue");
+        jobQueue = nullptr;
+        return false;
+    }
+
+    for (int i = 0; i < IOT_WORKER_COUNT; i++) {
+        xTaskCreatePinnedToCore(
+            iotWorkerTask,
+            "IotWorker",
+            IOT_WORKER_STACK,
+            nullptr,
+            IOT_WORKER_PRIORITY,
+            &workerHandles[i],
+            IOT_WORKER_CORE
+        );
+    }
+
+    Serial.printf("[IoT] Executor started (%d workers, %d jobs)\n", IOT_WORKER_COUNT, IOT_MAX_JOBS);
+    return true;
+}
+
+void submitIotRequest(JsonVariantConst msg) {
+    const char* requestId = msg["requestId"] | "";
+    const char* command = msg["command"] | "";
+    JsonObjectConst params = msg["params"];
+
+    Serial.printf("[IoT] Request %s: command=%s\n", requestId, command);
+
+    if (requestId[0] == '\0') {
+        Serial.println("[IoT] Missing requestId");
+        return;
+    }
+
+    if (!validRequestId(requestId)) {
+        Serial.println("[IoT] Invalid requestId");
+        return;
+    }
+
+    IotCommand cmd;
+    if (strcmp(command, "iot.http") == 0) {
+        cmd = IOT_CMD_HTTP;
+    } else if (strcmp(command, "wifi.scan") == 0) {
+        cmd = IOT_CMD_WIFI_SCAN;
+    } else if (strcmp(command, "iot.discover") == 0) {
+        // TODO: Implement mDNS/SSDP discovery
+        sendIoTError(requestId, "iot.discover not yet implemented");
+        return;
+    } else {
+        String error = "Unknown command: " + String(command);
+        sendIoTError(requestId, error.c_str());
+        return;
+    }
+
+    if (jobQueue == nullptr) {
+        sendIoTError(requestId, "IoT executor not running");
+        return;
+    }
+
+    // The parsed message only lives until the next frame - keep params as text
+    char* paramsText = nullptr;
+    if (!params.isNull()) {
+        size_t length = measureJson(params);
+        paramsText = (char*)malloc(length + 1);
+        if (paramsText == nullptr) {
+            sendIoTError(requestId, "Out of memory");
+            return;
+        }
+        serializeJson(params, paramsText, length + 1);
+    }
+
+    uint32_t timeout = params["timeoutMs"] | (uint32_t)IOT_DEFAULT_TIMEOUT_MS;
+    if (timeout == 0 || timeout > IOT_MAX_TIMEOUT_MS) timeout = IOT_MAX_TIMEOUT_MS;
+
+    xSemaphoreTake(jobLock, portMAX_DELAY);
+    int index = -1;
+    for (int i = 0; i < IOT_MAX_JOBS; i++) {
+        if (jobs[i].state == IOT_JOB_FREE) {
+            index = i;
+            break;
+        }
+    }
+    if (index >= 0) {
+        IotJob& job = jobs[index];
+        job.state = IOT_JOB_QUEUED;
+        job.cancelled = false;
+        job.command = cmd;
+        strncpy(job.requestId, requestId, sizeof(job.requestId) - 1);
+        job.requestId[sizeof(job.requestId) - 1] = '\0';
+        job.deadline = millis() + timeout;
+        job.params = paramsText;
+    }
+    xSemaphoreGive(jobLock);
+
+    if (index < 0) {
+        free(paramsText);
+        rejectedCount++;
+        Serial.printf("[IoT] Executor full, rejecting %s\n", requestId);
+        sendIoTError(requestId, "Busy: too many IoT requests in flight");
+        return;
+    }
+
+    // Every slot has room in the queue, so this can't fail
+    uint8_t slot = (uint8_t)index;
+    xQueueSend(jobQueue, &slot, 0);
+}
+
+bool cancelIotRequest(const char* requestId) {
+    if (jobLock == nullptr || requestId == nullptr) return false;
+
+    bool found = false;
+    xSemaphoreTake(jobLock, portMAX_DELAY);
+    for (int i = 0; i < IOT_MAX_JOBS; i++) {
+        IotJob& job = jobs[i];
+        if (job.state != IOT_JOB_FREE && !job.cancelled && strcmp(job.requestId, requestId) == 0) {
+            job.cancelled = true;
+            found = true;
+            cancelledCount++;
+        }
+    }
+    xSemaphoreGive(jobLock);
+
+    Serial.printf("[IoT] Cancel %s: %s\n", requestId, found ? "ok" : "not found");
+    return found;
+}
+
+void cancelAllIotRequests() {
+    if (jobLock == nullptr) return;
+
+    xSemaphoreTake(jobLock, portMAX_DELAY);
+    for (int i = 0; i < IOT_MAX_JOBS; i++) {
+        if (jobs[i].state != IOT_JOB_FREE && !jobs[i].cancelled) {
+            jobs[i].cancelled = true;
+            cancelledCount++;
+        }
+    }
+    xSemaphoreGive(jobLock);
+}
+
+void getIotExecutorStats(IotExecutorStats* stats) {
+    stats->queued = 0;
+    stats->running = 0;
+    if (jobLock != nullptr) {
+        xSemaphoreTake(jobLock, portMAX_DELAY);
+        for (int i = 0; i < IOT_MAX_JOBS; i++) {
+            if (jobs[i].state == IOT_JOB_QUEUED) stats->queued++;
+            if (jobs[i].state == IOT_JOB_RUNNING) stats->running++;
+        }
+        xSemaphoreGive(jobLock);
+    }
+    stats->completed = completedCount;
+    stats->rejected = rejectedCount;
+    stats->expired = expiredCount;
+    stats->cancelled = cancelledCount;
+    stats->chunksSent = chunksSentCount;
+}
@@ -0,0 +1,118 @@
+#include "jitter_buffer.h"
+
+#define JITTER_TARGET_LEAD_MIN_MS  200   // Rebuffer at least this much after an underrun
+
+JitterBuffer::JitterBuffer(uint32_t rate)
+    : sampleRate(rate),
+      inResponse(false),
+      firstArrivalUs(0),
+      lastArrivalUs(0),
+      mediaUs(0),
+      lastFrameMediaUs(0),
+      responsePeakLateUs(0),
+      frames(0),
+      responses(0),
+      totalUnderruns(0),
+      jitterUs(0),
+      peakLateUs(0),
+      penaltyUs(0) {}
+
+void JitterBuffer::beginResponse() {
+    inResponse = false;
+    frames = 0;
+    mediaUs = 0;
+    lastFrameMediaUs = 0;
+    responsePeakLateUs = 0;
+}
+
+void JitterBuffer::onFrame(uint64_t nowUs, size_t samples) {
+    uint64_t frameMediaUs = (uint64_t)samples * 1000000ULL / sampleRate;
+
+    if (!inResponse) {
+        // First frame of a response - everything is measured relative to it
+        inResponse = true;
+        firstArrivalUs = nowUs;
+    } else {
+        // Lateness: how far this frame arrived behind a real-time schedule that
+        // started at the first frame. Positive means it would have underrun
+        // with zero buffering; the worst value is the buffer we needed.
+        int64_t lateUs = (int64_t)(nowUs - firstArrivalUs) - (int64_t)mediaUs;
+        if (lateUs > responsePeakLateUs) {
+            responsePeakLateUs = lateUs;
+        }
+
+        // Jitter: only gaps longer than the previous frame's duration count
+        // (servers usually burst faster than real-time, which is harmless)
+        int64_t gapUs = (int64_t)(nowUs - lastArrivalUs) - (int64_t)lastFrameMediaUs;
+        uint32_t d = gapUs > 0 ? (uint32_t)gapUs : 0;
+        jitterUs = (uint32_t)((int32_t)jitterUs + ((int32_t)d - (int32_t)jitterUs) / 16);
+    }
+
+    lastArrivalUs = nowUs;
+    lastFrameMediaUs = frameMediaUs;
+    mediaUs += frameMediaUs;
+    frames++;
+}
+
+void JitterBuffer::endResponse(uint32_t underruns) {
+    if (frames > 0) {
+        uint32_t peak = responsePeakLateUs > 0 ? (uint32_t)responsePeakLateUs : 0;
+        // Rise fast, decay slowly so one bad response protects the next few
+        if (peak > peakLateUs) {
+            peakLateUs = peakLateUs + (peak - peakLateUs) / 2;
+        } else {
+            peakLateUs = peakLateUs - (peakLateUs - peak) / 8;
+        }
+        responses++;
+    }
+
+    totalUnderruns += underruns;
+    if (underruns > 0) {
+        penaltyUs += underruns * JITTER_UNDERRUN_PENALTY_MS * 1000;
+        if (penaltyUs > JITTER_MAX_PENALTY_MS * 1000) {
+            penaltyUs = JITTER_MAX_PENALTY_MS * 1000;
+        }
+    } else {
+        penaltyUs = penaltyUs * 3 / 4;
+    }
+
+    beginResponse();
+}
+
+uint32_t JitterBuffer::computeStartMs() const {
+    if (responses == 0 && frames < 2) {
+        return JITTER_INITIAL_START_MS;
+    }
+
+    uint32_t late = peakLateUs;
+    if (responsePeakLateUs > 0 && (uint32_t)responsePeakLateUs > late) {
+        late = (uint32_t)responsePeakLateUs;
+    }
+
+    uint32_t ms = JITTER_MIN_START_MS + (late + 2 * jitterUs + penaltyUs) / 1000;
+    if (ms > JITTER_MAX_START_MS) ms = JITTER_MAX_START_MS;
+    return ms;
+}
+
+size_t JitterBuffer::startThresholdSamples() const {
+    return (size_t)computeStartMs() * sampleRate / 1000;
+}
+
+size_t JitterBuffer::targetLeadSamples() const {
+    uint32_t ms = computeStartMs();
+    if (ms < JITTER_TARGET_LEAD_MIN_MS) ms = JITTER_TARGET_LEAD_MIN_MS;
+    ms += 2 * jitterUs / 1000;
+    if (ms > JITTER_MAX_START_MS) ms = JITTER_MAX_START_MS;
+    return (size_t)ms * sampleRate / 1000;
+}
+
+void JitterBuffer::getStats(JitterBufferStats* stats) const {
+    stats->jitterMs = jitterUs / 1000;
+    stats->peakLateMs = peakLateUs / 1000;
+    stats->penaltyMs = penaltyUs / 1000;
+    stats->startThresholdMs = computeStartMs();
+    stats->targetLeadMs = (uint32_t)(targetLeadSamples() * 1000 / sampleRate);
+    stats->frames = frames;
+    stats->responses = responses;
+    stats->underruns = totalUnderruns;
+}
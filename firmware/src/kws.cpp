@@ -0,0 +1,543 @@
+#include "kws.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM) && __has_include(<esp_dsp.h>)
+#include <esp_dsp.h>
+#define KWS_USE_ESP_DSP 1
+#endif
+
+// ============================================================================
+// Frontend tables (shared by every KwsFrontend, built once)
+// ============================================================================
+
+#define KWS_FFT_BINS  (KWS_FFT_SIZE / 2 + 1)
+
+static bool tablesReady = false;
+static float hannWindow[KWS_FRAME_LEN];
+static float dctMatrix[KWS_MFCC_COEFFS][KWS_MEL_BANDS];
+#ifndef KWS_USE_ESP_DSP
+static float twiddleCos[KWS_FFT_SIZE / 2];
+static float twiddleSin[KWS_FFT_SIZE / 2];
+#endif
+
+// Triangular mel filters never overlap by more than two, so each band only
+// stores the bins it covers and the weights live in one shared array
+static uint16_t melStart[KWS_MEL_BANDS];
+static uint16_t melCount[KWS_MEL_BANDS];
+static uint16_t melOffset[KWS_MEL_BANDS];
+static float melWeights[2 * KWS_FFT_BINS];
+
+static float hzToMel(float hz) {
+    return 2595.0f * log10f(1.0f + hz / 700.0f);
+}
+
+static float melToHz(float mel) {
+    return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+static void buildTables() {
+    if (tablesReady) return;
+
+    for (int i = 0; i < KWS_FRAME_LEN; i++) {
+        hannWindow[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (KWS_FRAME_LEN - 1));
+    }
+
+    // Band edges evenly spaced on the mel scale
+    float edges[KWS_MEL_BANDS + 2];
+    float melLow = hzToMel(KWS_MEL_LOW_HZ);
+    float melHigh = hzToMel(KWS_MEL_HIGH_HZ);
+    for (int i = 0; i < KWS_MEL_BANDS + 2; i++) {
+        float hz = melToHz(melLow + (melHigh - melLow) * i / (KWS_MEL_BANDS + 1));
+        edges[i] = hz * KWS_FFT_SIZE / KWS_SAMPLE_RATE;  // In (fractional) bins
+    }
+
+    uint16_t offset = 0;
+    for (int b = 0; b < KWS_MEL_BANDS; b++) {
+        int first = (int)ceilf(edges[b]);
+        int last = (int)floorf(edges[b + 2]);
+        if (last >= KWS_FFT_BINS) last = KWS_FFT_BINS - 1;
+        melStart[b] = (uint16_t)first;
+        melOffset[b] = offset;
+        melCount[b] = 0;
+        for (int k = first; k <= last && offset < 2 * KWS_FFT_BINS; k++) {
+            float w;
+            if (k <= edges[b + 1]) {
+                w = (k - edges[b]) / (edges[b + 1] - edges[b]);
+            } else {
+                w = (edges[b + 2] - k) / (edges[b + 2] - edges[b + 1]);
+            }
+            melWeights[offset++] = w > 0.0f ? w : 0.0f;
+            melCount[b]++;
+        }
+    }
+
+    // Orthonormal DCT-II
+    for (int i = 0; i < KWS_MFCC_COEFFS; i++) {
+        float norm = sqrtf((i == 0 ? 1.0f : 2.0f) / KWS_MEL_BANDS);
+        for (int j = 0; j < KWS_MEL_BANDS; j++) {
+            dctMatrix[i][j] = norm * cosf((float)M_PI * i * (j + 0.5f) / KWS_MEL_BANDS);
+        }
+    }
+
+#ifdef KWS_USE_ESP_DSP
+    dsps_fft2r_init_fc32(nullptr, KWS_FFT_SIZE);
+#else
+    for (int i = 0; i < KWS_FFT_SIZE / 2; i++) {
+        twiddleCos[i] = cosf(2.0f * (float)M_PI * i / KWS_FFT_SIZE);
+        twiddleSin[i] = -sinf(2.0f * (float)M_PI * i / KWS_FFT_SIZE);
+    }
+#endif
+
+    tablesReady = true;
+}
+
+/**
+ * In-place complex FFT on interleaved re/im data
+ */
+static void fft(float* data) {
+#ifdef KWS_USE_ESP_DSP
+    dsps_fft2r_fc32(data, KWS_FFT_SIZE);
+    dsps_bit_rev_fc32(data, KWS_FFT_SIZE);
+#else
+    const int n = KWS_FFT_SIZE;
+
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float tr = data[2 * i], ti = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = tr;
+            data[2 * j + 1] = ti;
+        }
+    }
+
+    for (int len = 2; len <= n; len <<= 1) {
+        int step = n / len;
+        for (int i = 0; i < n; i += len) {
+            for (int k = 0; k < len / 2; k++) {
+                float wr = twiddleCos[k * step], wi = twiddleSin[k * step];
+                float* a = &data[2 * (i + k)];
+                float* b = &data[2 * (i + k + len / 2)];
+                float br = b[0] * wr - b[1] * wi;
+                float bi = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - br;
+                b[1] = a[1] - bi;
+                a[0] += br;
+                a[1] += bi;
+            }
+        }
+    }
+#endif
+}
+
+// ============================================================================
+// KwsFrontend
+// ============================================================================
+
+KwsFrontend::KwsFrontend() {
+    reset();
+}
+
+void KwsFrontend::reset() {
+    pendingCount = 0;
+    featureHead = 0;
+    frames = 0;
+    memset(features, 0, sizeof(features));
+}
+
+size_t KwsFrontend::push(const int16_t* samples, size_t count) {
+    size_t produced = 0;
+
+    while (count > 0) {
+        size_t n = KWS_FRAME_LEN - pendingCount;
+        if (n > count) n = count;
+        memcpy(pending + pendingCount, samples, n * sizeof(int16_t));
+        pendingCount += n;
+        samples += n;
+        count -= n;
+
+        if (pendingCount == KWS_FRAME_LEN) {
+            computeFrame();
+            produced++;
+            // Keep the overlap for the next window
+            memmove(pending, pending + KWS_FRAME_HOP, (KWS_FRAME_LEN - KWS_FRAME_HOP) * sizeof(int16_t));
+            pendingCount = KWS_FRAME_LEN - KWS_FRAME_HOP;
+        }
+    }
+
+    return produced;
+}
+
+void KwsFrontend::computeFrame() {
+    buildTables();
+
+    // Scratch is static: one frontend runs at a time (the KWS task)
+    static float spectrum[2 * KWS_FFT_SIZE];
+
+    for (int i = 0; i < KWS_FRAME_LEN; i++) {
+        spectrum[2 * i] = pending[i] * (1.0f / 32768.0f) * hannWindow[i];
+        spectrum[2 * i + 1] = 0.0f;
+    }
+    memset(&spectrum[2 * KWS_FRAME_LEN], 0, 2 * (KWS_FFT_SIZE - KWS_FRAME_LEN) * sizeof(float));
+
+    fft(spectrum);
+
+    float logMel[KWS_MEL_BANDS];
+    for (int b = 0; b < KWS_MEL_BANDS; b++) {
+        float energy = 0.0f;
+        const float* w = &melWeights[melOffset[b]];
+        for (int k = 0; k < melCount[b]; k++) {
+            int bin = melStart[b] + k;
+            float re = spectrum[2 * bin], im = spectrum[2 * bin + 1];
+            energy += w[k] * (re * re + im * im);
+        }
+        logMel[b] = logf(energy + 1e-6f);
+    }
+
+    float* row = features[featureHead];
+    for (int i = 0; i < KWS_MFCC_COEFFS; i++) {
+        float acc = 0.0f;
+        for (int j = 0; j < KWS_MEL_BANDS; j++) {
+            acc += dctMatrix[i][j] * logMel[j];
+        }
+        row[i] = acc;
+    }
+
+    featureHead = (featureHead + 1) % KWS_WINDOW_FRAMES;
+    if (frames < UINT32_MAX) frames++;
+}
+
+void KwsFrontend::window(int8_t* out, float scale, int8_t zeroPoint) const {
+    float inv = scale > 0.0f ? 1.0f / scale : 1.0f;
+    for (int r = 0; r < KWS_WINDOW_FRAMES; r++) {
+        const float* row = features[(featureHead + r) % KWS_WINDOW_FRAMES];
+        for (int i = 0; i < KWS_MFCC_COEFFS; i++) {
+            int q = (int)lrintf(row[i] * inv) + zeroPoint;
+            if (q > 127) q = 127;
+            if (q < -128) q = -128;
+            *out++ = (int8_t)q;
+        }
+    }
+}
+
+// ============================================================================
+// KwsModel - int8 kernels
+// ============================================================================
+
+/**
+ * acc * multiplier * 2^shift / 2^31 with rounding (TFLite requantization)
+ */
+static inline int32_t requantize(int32_t acc, int32_t multiplier, int shift) {
+    int left = shift > 0 ? shift : 0;
+    int right = shift > 0 ? 0 : -shift;
+    int64_t prod = (int64_t)acc * ((int64_t)1 << left) * multiplier;
+    int32_t high = (int32_t)((prod + ((int64_t)1 << 30)) >> 31);
+    if (right > 0) {
+        high = (high + (1 << (right - 1))) >> right;
+    }
+    return high;
+}
+
+static inline int8_t saturate(int32_t value, int32_t low) {
+    if (value > 127) value = 127;
+    if (value < low) value = low;
+    return (int8_t)value;
+}
+
+static inline int32_t loadBias(const uint8_t* biases, int index) {
+    int32_t value;
+    memcpy(&value, biases + index * sizeof(int32_t), sizeof(value));
+    return value;
+}
+
+static inline uint16_t outputSize(uint16_t in, uint8_t stride) {
+    return (uint16_t)((in + stride - 1) / stride);  // "same" padding
+}
+
+static inline int padBefore(uint16_t in, uint16_t out, uint8_t kernel, uint8_t stride) {
+    int total = (out - 1) * stride + kernel - in;
+    return total > 0 ? total / 2 : 0;
+}
+
+static void convS8(const KwsLayerHeader* l, const int8_t* in, uint16_t inH, uint16_t inW, uint16_t inC,
+                   const int8_t* w, const uint8_t* bias, int8_t* out, uint16_t outH, uint16_t outW) {
+    const int padT = padBefore(inH, outH, l->kernelH, l->strideH);
+    const int padL = padBefore(inW, outW, l->kernelW, l->strideW);
+    const int32_t zp = l->inputZeroPoint;
+    const int32_t low = l->relu ? l->outputZeroPoint : -128;
+
+    for (int oy = 0; oy < outH; oy++) {
+        for (int ox = 0; ox < outW; ox++) {
+            for (int oc = 0; oc < l->outChannels; oc++) {
+                int32_t acc = loadBias(bias, oc);
+                const int8_t* filter = w + (size_t)oc * l->kernelH * l->kernelW * inC;
+
+                for (int ky = 0; ky < l->kernelH; ky++) {
+                    int iy = oy * l->strideH + ky - padT;
+                    if (iy < 0 || iy >= inH) continue;  // Padding is zero in real terms
+                    for (int kx = 0; kx < l->kernelW; kx++) {
+                        int ix = ox * l->strideW + kx - padL;
+                        if (ix < 0 || ix >= inW) continue;
+                        const int8_t* px = in + ((size_t)iy * inW + ix) * inC;
+                        const int8_t* fk = filter + ((size_t)ky * l->kernelW + kx) * inC;
+                        int c = 0;
+                        for (; c + 4 <= inC; c += 4) {
+                            acc += (px[c] - zp) * fk[c] + (px[c + 1] - zp) * fk[c + 1] +
+                                   (px[c + 2] - zp) * fk[c + 2] + (px[c + 3] - zp) * fk[c + 3];
+                        }
+                        for (; c < inC; c++) {
+                            acc += (px[c] - zp) * fk[c];
+                        }
+                    }
+                }
+
+                int32_t v = requantize(acc, l->outputMultiplier, l->outputShift) + l->outputZeroPoint;
+                *out++ = saturate(v, low);
+            }
+        }
+    }
+}
+
+static void depthwiseS8(const KwsLayerHeader* l, const int8_t* in, uint16_t inH, uint16_t inW, uint16_t c,
+                        const int8_t* w, const uint8_t* bias, int8_t* out, uint16_t outH, uint16_t outW) {
+    const int padT = padBefore(inH, outH, l->kernelH, l->strideH);
+    const int padL = padBefore(inW, outW, l->kernelW, l->strideW);
+    const int32_t zp = l->inputZeroPoint;
+    const int32_t low = l->relu ? l->outputZeroPoint : -128;
+    int32_t acc[256];
+
+    for (int oy = 0; oy < outH; oy++) {
+        for (int ox = 0; ox < outW; ox++) {
+            for (int ch = 0; ch < c; ch++) acc[ch] = loadBias(bias, ch);
+
+            // Channel-innermost so every tap is one contiguous multiply-add run
+            for (int ky = 0; ky < l->kernelH; ky++) {
+                int iy = oy * l->strideH + ky - padT;
+                if (iy < 0 || iy >= inH) continue;
+                for (int kx = 0; kx < l->kernelW; kx++) {
+                    int ix = ox * l->strideW + kx - padL;
+                    if (ix < 0 || ix >= inW) continue;
+                    const int8_t* px = in + ((size_t)iy * inW + ix) * c;
+                    const int8_t* fk = w + ((size_t)ky * l->kernelW + kx) * c;
+                    for (int ch = 0; ch < c; ch++) {
+                        acc[ch] += (px[ch] - zp) * fk[ch];
+                    }
+                }
+            }
+
+            for (int ch = 0; ch < c; ch++) {
+                int32_t v = requantize(acc[ch], l->outputMultiplier, l->outputShift) + l->outputZeroPoint;
+                *out++ = saturate(v, low);
+            }
+        }
+    }
+}
+
+static void avgPoolS8(const KwsLayerHeader* l, const int8_t* in, uint16_t inH, uint16_t inW, uint16_t c,
+                      int8_t* out) {
+    const int32_t n = (int32_t)inH * inW;
+    for (int ch = 0; ch < c; ch++) {
+        int32_t sum = 0;
+        for (int i = 0; i < n; i++) {
+            sum += in[(size_t)i * c + ch] - l->inputZeroPoint;
+        }
+        int32_t mean = sum >= 0 ? (sum + n / 2) / n : (sum - n / 2) / n;
+        out[ch] = saturate(mean + l->outputZeroPoint, -128);
+    }
+}
+
+static void fullyConnectedS8(const KwsLayerHeader* l, const int8_t* in, size_t inSize,
+                             const int8_t* w, const uint8_t* bias, int8_t* out) {
+    const int32_t zp = l->inputZeroPoint;
+    const int32_t low = l->relu ? l->outputZeroPoint : -128;
+    for (int oc = 0; oc < l->outChannels; oc++) {
+        int32_t acc = loadBias(bias, oc);
+        const int8_t* row = w + (size_t)oc * inSize;
+        for (size_t i = 0; i < inSize; i++) {
+            acc += (in[i] - zp) * row[i];
+        }
+        int32_t v = requantize(acc, l->outputMultiplier, l->outputShift) + l->outputZeroPoint;
+        out[oc] = saturate(v, low);
+    }
+}
+
+// ============================================================================
+// KwsModel
+// ============================================================================
+
+KwsModel::KwsModel() : header(nullptr) {}
+
+bool KwsModel::load(const uint8_t* blob, size_t length) {
+    header = nullptr;
+    if (blob == nullptr || length < sizeof(KwsModelHeader)) return false;
+
+    const KwsModelHeader* h = (const KwsModelHeader*)blob;
+    if (h->magic != KWS_MODEL_MAGIC || h->version != 1) return false;
+    if (h->inputFrames != KWS_WINDOW_FRAMES || h->inputCoeffs != KWS_MFCC_COEFFS) return false;
+    if (h->numLayers == 0 || h->numLayers > KWS_MAX_LAYERS) return false;
+    if (h->numClasses < 2 || h->numClasses > KWS_MAX_CLASSES || h->keywordClass >= h->numClasses) return false;
+
+    size_t pos = sizeof(KwsModelHeader);
+    Shape shape = {KWS_WINDOW_FRAMES, KWS_MFCC_COEFFS, 1};
+
+    for (int i = 0; i < h->numLayers; i++) {
+        if (pos + sizeof(KwsLayerHeader) > length) return false;
+        const KwsLayerHeader* l = (const KwsLayerHeader*)(blob + pos);
+        pos += sizeof(KwsLayerHeader);
+
+        Shape out = shape;
+        size_t weightCount = 0;
+        size_t biasCount = 0;
+
+        switch (l->type) {
+            case KWS_LAYER_CONV:
+                if (l->strideH == 0 || l->strideW == 0 || l->outChannels == 0) return false;
+                out.h = outputSize(shape.h, l->strideH);
+                out.w = outputSize(shape.w, l->strideW);
+                out.c = l->outChannels;
+                weightCount = (size_t)out.c * l->kernelH * l->kernelW * shape.c;
+                biasCount = out.c;
+                break;
+            case KWS_LAYER_DWCONV:
+                if (l->strideH == 0 || l->strideW == 0 || shape.c > 256) return false;
+                out.h = outputSize(shape.h, l->strideH);
+                out.w = outputSize(shape.w, l->strideW);
+                weightCount = (size_t)l->kernelH * l->kernelW * shape.c;
+                biasCount = shape.c;
+                break;
+            case KWS_LAYER_AVGPOOL:
+                out.h = 1;
+                out.w = 1;
+                break;
+            case KWS_LAYER_FC:
+                if (l->outChannels == 0) return false;
+                out.h = 1;
+                out.w = 1;
+                out.c = l->outChannels;
+                weightCount = (size_t)out.c * shape.h * shape.w * shape.c;
+                biasCount = out.c;
+                break;
+            default:
+                return false;
+        }
+
+        if ((size_t)out.h * out.w * out.c > h->arenaBytes) return false;
+        if (pos + weightCount + biasCount * sizeof(int32_t) > length) return false;
+
+        layers[i] = l;
+        inShape[i] = shape;
+        outShape[i] = out;
+        weights[i] = (const int8_t*)(blob + pos);
+        biases[i] = blob + pos + weightCount;
+        pos += weightCount + biasCount * sizeof(int32_t);
+        shape = out;
+    }
+
+    // Network must end in one logit per class
+    if (shape.h != 1 || shape.w != 1 || shape.c != h->numClasses) return false;
+
+    header = h;
+    return true;
+}
+
+size_t KwsModel::arenaBytes() const {
+    return header ? 2 * (size_t)header->arenaBytes : 0;
+}
+
+float KwsModel::inputScale() const {
+    return header ? header->inputScale : 1.0f;
+}
+
+int8_t KwsModel::inputZeroPoint() const {
+    return header ? header->inputZeroPoint : 0;
+}
+
+float KwsModel::run(const int8_t* input, int8_t* arena) {
+    if (header == nullptr) return 0.0f;
+
+    int8_t* buffers[2] = {arena, arena + header->arenaBytes};
+    const int8_t* in = input;
+    int8_t* out = buffers[0];
+
+    for (int i = 0; i < header->numLayers; i++) {
+        const KwsLayerHeader* l = layers[i];
+        const Shape& is = inShape[i];
+        const Shape& os = outShape[i];
+        out = buffers[i & 1];
+
+        switch (l->type) {
+            case KWS_LAYER_CONV:
+                convS8(l, in, is.h, is.w, is.c, weights[i], biases[i], out, os.h, os.w);
+                break;
+            case KWS_LAYER_DWCONV:
+                depthwiseS8(l, in, is.h, is.w, is.c, weights[i], biases[i], out, os.h, os.w);
+                break;
+            case KWS_LAYER_AVGPOOL:
+                avgPoolS8(l, in, is.h, is.w, is.c, out);
+                break;
+            case KWS_LAYER_FC:
+                fullyConnectedS8(l, in, (size_t)is.h * is.w * is.c, weights[i], biases[i], out);
+                break;
+        }
+        in = out;
+    }
+
+    // Softmax over the logits
+    float logits[KWS_MAX_CLASSES];
+    float maxLogit = -1e30f;
+    for (int c = 0; c < header->numClasses; c++) {
+        logits[c] = (out[c] - header->outputZeroPoint) * header->outputScale;
+        if (logits[c] > maxLogit) maxLogit = logits[c];
+    }
+    float sum = 0.0f;
+    for (int c = 0; c < header->numClasses; c++) {
+        logits[c] = expf(logits[c] - maxLogit);
+        sum += logits[c];
+    }
+    return logits[header->keywordClass] / sum;
+}
+
+// ============================================================================
+// KwsDetector
+// ============================================================================
+
+KwsDetector::KwsDetector(float threshold, uint8_t smoothing, uint8_t refractory)
+    : threshold(threshold),
+      smoothing(smoothing == 0 ? 1 : (smoothing > 8 ? 8 : smoothing)),
+      refractory(refractory) {
+    reset();
+}
+
+void KwsDetector::reset() {
+    historyLen = 0;
+    historyPos = 0;
+    hold = 0;
+    smoothed = 0.0f;
+}
+
+bool KwsDetector::update(float score) {
+    history[historyPos] = score;
+    historyPos = (historyPos + 1) % smoothing;
+    if (historyLen < smoothing) historyLen++;
+
+    float sum = 0.0f;
+    for (int i = 0; i < historyLen; i++) sum += history[i];
+    smoothed = sum / smoothing;  // Ramps up from cold so one spike can't trigger
+
+    if (hold > 0) {
+        hold--;
+        return false;
+    }
+
+    if (smoothed >= threshold) {
+        hold = refractory;
+        historyLen = 0;
+        historyPos = 0;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,74 @@
+#include "latency_trace.h"
+
+struct StageHistogram {
+    volatile uint32_t buckets[LATENCY_BUCKETS];
+    volatile uint32_t maxMs;
+    volatile uint64_t sumMs;
+};
+
+static StageHistogram histograms[LATENCY_STAGE_COUNT];
+
+static const char* const stageNames[LATENCY_STAGE_COUNT] = {
+    "captureToSend",
+    "receiveToPlay",
+    "firstByteToSpeaker",
+};
+
+static int bucketFor(uint32_t ms) {
+    int bucket = 0;
+    while (ms > 0 && bucket < LATENCY_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint32_t latencyBucketLimitMs(int bucket) {
+    if (bucket >= LATENCY_BUCKETS - 1) return UINT32_MAX;
+    return (uint32_t)1 << bucket;
+}
+
+/**
+ * Upper edge of the bucket the given fraction of samples falls into
+ */
+static uint32_t percentile(const LatencyStats* stats, uint32_t percent) {
+    if (stats->count == 0) return 0;
+
+    uint64_t rank = ((uint64_t)stats->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= rank) {
+            // The open-ended bucket is better described by the worst case
+            return i == LATENCY_BUCKETS - 1 ? stats->maxMs : latencyBucketLimitMs(i);
+        }
+    }
+    return stats->maxMs;
+}
+
+void latencyRecord(LatencyStage stage, uint32_t ms) {
+    if (stage >= LATENCY_STAGE_COUNT) return;
+
+    StageHistogram& h = histograms[stage];
+    h.buckets[bucketFor(ms)]++;
+    h.sumMs += ms;
+    if (ms > h.maxMs) h.maxMs = ms;
+}
+
+void getLatencyStats(LatencyStage stage, LatencyStats* stats) {
+    const StageHistogram& h = histograms[stage < LATENCY_STAGE_COUNT ? stage : 0];
+
+    stats->count = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        stats->buckets[i] = h.buckets[i];
+        stats->count += stats->buckets[i];
+    }
+    stats->maxMs = h.maxMs;
+    stats->meanMs = stats->count > 0 ? (uint32_t)(h.sumMs / stats->count) : 0;
+    stats->p50Ms = percentile(stats, 50);
+    stats->p95Ms = percentile(stats, 95);
+}
+
+const char* latencyStageName(LatencyStage stage) {
+    return stage < LATENCY_STAGE_COUNT ? stageNames[stage] : "unknown";
+}
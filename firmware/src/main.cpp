@@ -5,11 +5,16 @@
 #include "mote_face.h"
 #include "audio.h"
 #include "voice_client.h"
+#include "wake_word.h"
+#include "mote_log.h"
+#include "power_manager.h"
+#include "fast_connect.h"
+#include "gateway_select.h"
 
 // Device mode
 enum DeviceMode {
   MODE_BLE,    // BLE configuration mode (no WiFi config saved)
-  MODE_WIFI    // WiFi mode (config saved, BLE disabled)
+  MODE_WIFI    // WiFi mode (config saved, BLE alongside for the app)
 };
 
 DeviceMode currentMode = MODE_BLE;
@@ -21,12 +26,24 @@ static int16_t audioBuffer[AUDIO_BUFFER_SIZE];
 static unsigned long lastVoiceActivity = 0;
 static bool wasVoiceActive = false;
 
+// Local wake word: uplink stays closed in IDLE until the detector triggers
+#define WAKE_UPLINK_WINDOW_MS 8000   // Give up if the server doesn't start listening
+#define WAKE_PREROLL_MS       1500   // Covers the wake word itself plus detector latency
+static int16_t* preRollBuffer = nullptr;
+static WakeMode wakeModeSetting = WAKE_MODE_SERVER;
+static bool wakeUplinkOpen = false;
+static unsigned long wakeUplinkOpenedAt = 0;
+
+static IpMode ipModeSetting = IP_MODE_DHCP;
+static bool bootReported = false;
+
 // WiFi configuration
 char wifiSsid[32] = "";
 char wifiPassword[64] = "";
 char gatewayServer[128] = "";
 uint16_t gatewayPort = 3000;
 char gatewayToken[128] = "";
+char gatewayList[GATEWAY_LIST_SIZE] = "";  // Fallback gateways, comma-separated
 
 #define RGB_LED_PIN 38      // GPIO38 for RGB LED
 #define BATTERY_ADC_PIN 2   // GPIO2 for battery monitoring (ADC1_CH1, pin 38)
@@ -37,6 +54,14 @@ char gatewayToken[128] = "";
  */
 void onVoiceStateChange(VoiceState newState) {
   Serial.printf("[Voice] State changed to: %d\n", newState);
+  setPowerVoiceState(newState);
+  setBleVoiceSessionActive(newState == VOICE_LISTENING || newState == VOICE_PROCESSING ||
+                           newState == VOICE_SPEAKING);
+
+  if (newState == VOICE_IDLE && !bootReported) {
+    bootReported = true;
+    Serial.printf("[Mote] Ready in %lums (WiFi after %ums)\n", millis(), getFastConnectTimeMs());
+  }
 
   switch (newState) {
     case VOICE_DISCONNECTED:
@@ -80,7 +105,8 @@ void onVoiceTranscript(const char* text) {
  * Voice audio callback - queues TTS response for buffered playback
  */
 void onVoiceAudio(const uint8_t* data, size_t length) {
-  // Data is PCM 16-bit from ElevenLabs at 16kHz (pcm_16000 format)
+  // Data is PCM 16-bit at 16kHz - either raw pcm_16000 from the server or
+  // decoded from the negotiated downlink codec by the voice client
   size_t sampleCount = length / sizeof(int16_t);
   size_t queued = queueAudioData((const int16_t*)data, sampleCount);
   
@@ -111,12 +137,69 @@ int getMoteBatteryPercent() {
   return (int)((voltage - 3.0) / 1.2 * 100);
 }
 
-void setup() {
-  delay(1000);
+/**
+ * Bring up I2S, the playback/capture tasks and the wake word detector
+ */
+static void startAudio() {
+  Serial.println("[Audio] Initializing audio subsystem...");
+  audioInitialized = setupAudio();
+  if (!audioInitialized) {
+    Serial.println("[Audio] Audio initialization failed!");
+    return;
+  }
+
+  Serial.println("[Audio] Audio initialized successfully");
+  // Start buffered playback task for smooth TTS audio
+  startAudioPlaybackTask();
+  // Start mic capture task so loop() never blocks on I2S
+  startAudioCaptureTask();
+  // Local wake word (falls back to server detection without a model)
+  setupWakeWord();
+  setWakeMode(wakeModeSetting);
+  // Server still matches the wake word in the transcript, so the
+  // pre-roll after a local trigger has to include it
+  setPreRollLength(WAKE_PREROLL_MS);
+  preRollBuffer = (int16_t*)ps_malloc(AUDIO_PREROLL_MAX_MS * AUDIO_SAMPLE_RATE / 1000 * sizeof(int16_t));
+}
+
+/**
+ * The app saved new network settings over BLE - use them without a reboot
+ */
+static void onNetworkConfig(const BleNetworkConfig& config) {
+  strncpy(wifiSsid, config.wifiSsid, sizeof(wifiSsid) - 1);
+  strncpy(wifiPassword, config.wifiPassword, sizeof(wifiPassword) - 1);
+  strncpy(gatewayServer, config.gatewayServer, sizeof(gatewayServer) - 1);
+  strncpy(gatewayToken, config.gatewayToken, sizeof(gatewayToken) - 1);
+  strncpy(gatewayList, config.gatewayList, sizeof(gatewayList) - 1);
+  gatewayPort = config.gatewayPort;
+
+  if (currentMode == MODE_BLE) {
+    // First setup: bring up what setup() skipped; loop() opens the voice client
+    Serial.println("[Mote] Configured - switching to WiFi mode");
+    currentMode = MODE_WIFI;
+    startFastConnect(wifiSsid, wifiPassword, ipModeSetting);
+    startAudio();
+    setFaceState(FACE_HAPPY);
+    return;
+  }
+
+  if (config.wifiChanged) {
+    // The voice client reconnects by itself once the new network is up
+    Serial.printf("[WiFi] Network changed - joining %s\n", wifiSsid);
+    WiFi.disconnect();
+    startFastConnect(wifiSsid, wifiPassword, ipModeSetting);
+  }
 
+  if (config.gatewayChanged && voiceInitialized) {
+    reconnectVoiceClient(gatewayServer, gatewayPort, gatewayList, gatewayToken);
+  }
+}
+
+void setup() {
   // Initialize Serial
   Serial.begin(115200);
   Serial.println("\n[Mote] Starting...");
+  neopixelWrite(RGB_LED_PIN, 0, 0, 40);  // Dim blue while booting
 
   // Configure ADC for battery monitoring
   pinMode(BATTERY_ADC_PIN, INPUT);
@@ -127,25 +210,8 @@ void setup() {
   Preferences prefs;
   prefs.begin("mote", true); // Read-only
   bool hasWifiConfig = prefs.isKey("wifi_ssid");
-
-  // Flash RGB LED to show boot
-  neopixelWrite(RGB_LED_PIN, 255, 0, 0);  // Red
-  delay(200);
-  neopixelWrite(RGB_LED_PIN, 0, 255, 0);  // Green
-  delay(200);
-  neopixelWrite(RGB_LED_PIN, 0, 0, 255);  // Blue
-  delay(200);
-  neopixelWrite(RGB_LED_PIN, 0, 0, 0);    // Off
-
-  // Initialize face display (always)
-  setupFaceDisplay();
-  setFaceState(FACE_SLEEPING);
-  delay(500);
-  setFaceState(FACE_SURPRISED);
-  delay(300);
-  waveAnimation();
-  setFaceState(FACE_HAPPY);
-  delay(500);
+  wakeModeSetting = (WakeMode)prefs.getUChar("wake_mode", WAKE_MODE_SERVER);
+  ipModeSetting = (IpMode)prefs.getUChar(FAST_CONNECT_PREF_IP_MODE, IP_MODE_DHCP);
 
   if (hasWifiConfig) {
     // Load WiFi config
@@ -154,91 +220,62 @@ void setup() {
     String server = prefs.getString("gw_server", "");
     uint16_t port = prefs.getUShort("gw_port", 3000);
     String token = prefs.getString("gw_token", "");
+    String list = prefs.getString("gw_list", "");
 
     strncpy(wifiSsid, ssid.c_str(), sizeof(wifiSsid) - 1);
     strncpy(wifiPassword, password.c_str(), sizeof(wifiPassword) - 1);
     strncpy(gatewayServer, server.c_str(), sizeof(gatewayServer) - 1);
     strncpy(gatewayToken, token.c_str(), sizeof(gatewayToken) - 1);
+    strncpy(gatewayList, list.c_str(), sizeof(gatewayList) - 1);
     gatewayPort = port;
 
-    prefs.end();
-
     // Start in WiFi mode
     currentMode = MODE_WIFI;
     Serial.println("[Mote] WiFi config found - starting in WiFi mode");
     Serial.printf("[WiFi] SSID: %s, Server: %s:%d\n", wifiSsid, gatewayServer, gatewayPort);
-
-    // WiFi will be started in loop() to avoid blocking setup()
-
+    if (strlen(gatewayList) > 0) {
+      Serial.printf("[WiFi] Fallback gateways: %s\n", gatewayList);
+    }
   } else {
-    prefs.end();
-
     // Start in BLE mode for configuration
     currentMode = MODE_BLE;
     Serial.println("[Mote] No WiFi config - starting in BLE mode");
   }
+  prefs.end();
 
-  // Initialize BLE (always, for app communication)
+  // Initialize BLE (always, for app communication) - before WiFi
   setupBleConfig();
+  setBleNetworkConfigCallback(onNetworkConfig);
+
+  // Association runs in the WiFi task while the display and audio come up
+  if (currentMode == MODE_WIFI) {
+    startFastConnect(wifiSsid, wifiPassword, ipModeSetting);
+  }
+
+  // Initialize face display (always); the greeting plays from the render task
+  setupFaceDisplay();
+  waveAnimation();
+  setFaceState(currentMode == MODE_WIFI ? FACE_HAPPY : FACE_IDLE);
 
-  // Flash blue to show BLE started
-  neopixelWrite(RGB_LED_PIN, 0, 0, 255);  // Blue ON
-  delay(300);
-  neopixelWrite(RGB_LED_PIN, 0, 0, 0);    // Off
+  if (currentMode == MODE_WIFI) {
+    startAudio();
+  }
 
-  // Face now idle and ready
-  setFaceState(FACE_IDLE);
+  // Full power for now; dims and slows down once nothing is happening
+  setupPowerManager();
+  neopixelWrite(RGB_LED_PIN, 0, 0, 0);
 
-  Serial.printf("[Mote] Setup complete! Mode: %s, Battery: %.2fV (%d%%)\n",
-                currentMode == MODE_BLE ? "BLE" : "WiFi",
+  Serial.printf("[Mote] Setup complete in %lums! Mode: %s, Battery: %.2fV (%d%%)\n",
+                millis(), currentMode == MODE_BLE ? "BLE" : "WiFi",
                 getMoteBatteryVoltage(), getMoteBatteryPercent());
 }
 
 void loop() {
-  // WiFi mode: Start WiFi connection after 2 second delay (once)
   if (currentMode == MODE_WIFI) {
-    static bool wifiStarted = false;
-    static unsigned long bootTime = millis();
-
-    if (!wifiStarted && (millis() - bootTime > 2000)) {
-      Serial.println("[WiFi] Starting WiFi connection...");
-
-      // Disable watchdog timers during WiFi initialization
-      disableCore0WDT();
-      disableLoopWDT();
-
-      WiFi.mode(WIFI_STA);
-      WiFi.begin(wifiSsid, wifiPassword);
-
-      // Give WiFi time to initialize with yields to feed any remaining watchdogs
-      for (int i = 0; i < 50; i++) {
-        delay(100);
-        yield();
-      }
+    handleFastConnect();
 
-      // Re-enable watchdog
-      enableCore0WDT();
-      enableLoopWDT();
-
-      wifiStarted = true;
-      Serial.println("[WiFi] WiFi.begin() complete, checking status...");
-    }
-
-    // Initialize audio and voice after WiFi connects
-    if (wifiStarted && WiFi.status() == WL_CONNECTED && !audioInitialized) {
-      Serial.println("[Audio] Initializing audio subsystem...");
-      audioInitialized = setupAudio();
-      if (audioInitialized) {
-        Serial.println("[Audio] Audio initialized successfully");
-        // Start buffered playback task for smooth TTS audio
-        startAudioPlaybackTask();
-      } else {
-        Serial.println("[Audio] Audio initialization failed!");
-      }
-    }
-
-    // Initialize voice client after audio is ready
-    if (audioInitialized && !voiceInitialized && strlen(gatewayServer) > 0) {
+    // Open the voice WebSocket as soon as there is an IP
+    if (audioInitialized && !voiceInitialized && strlen(gatewayServer) > 0 && WiFi.status() == WL_CONNECTED) {
       Serial.println("[Voice] Initializing voice client...");
 
       // Set up callbacks
@@ -246,24 +283,7 @@ void loop() {
       setVoiceTranscriptCallback(onVoiceTranscript);
       setVoiceAudioCallback(onVoiceAudio);
 
-      // Extract hostname from server URL (remove wss:// prefix if present)
-      char hostname[128];
-      const char* serverStr = gatewayServer;
-      if (strncmp(serverStr, "wss://", 6) == 0) {
-        serverStr += 6;
-      } else if (strncmp(serverStr, "ws://", 5) == 0) {
-        serverStr += 5;
-      }
-      strncpy(hostname, serverStr, sizeof(hostname) - 1);
-      hostname[sizeof(hostname) - 1] = '\0';
-
-      // Remove trailing slash if present
-      size_t len = strlen(hostname);
-      if (len > 0 && hostname[len - 1] == '/') {
-        hostname[len - 1] = '\0';
-      }
-
-      voiceInitialized = setupVoiceClient(hostname, gatewayPort, gatewayToken);
+      voiceInitialized = setupVoiceClient(gatewayServer, gatewayPort, gatewayList, gatewayToken);
       if (voiceInitialized) {
         Serial.println("[Voice] Voice client initialized");
       } else {
@@ -275,43 +295,81 @@ void loop() {
     if (voiceInitialized) {
       handleVoiceClient();
 
-      // Stream audio continuously for server-side wake word detection
+      // Stream audio continuously for server-side wake word detection,
+      // or only after a local trigger when the on-device detector is active
       VoiceState voiceState = getVoiceState();
-
-      // Debug: Log voice state periodically
-      static unsigned long lastStateLog = 0;
-      if (millis() - lastStateLog > 3000) {
-        Serial.printf("[Voice] State: %d (0=DISCONNECTED, 1=IDLE, 2=LISTENING, 3=PROCESSING, 4=SPEAKING)\n", voiceState);
-        lastStateLog = millis();
+      bool localWake = isLocalWakeActive();
+
+      // With echo cancellation the mic stays live over TTS playback, so the
+      // wake word can barge in instead of waiting for the response to end
+      bool fullDuplex = isEchoCancellationActive();
+      bool wakeListening = voiceState == VOICE_IDLE || (fullDuplex && voiceState == VOICE_SPEAKING);
+
+      if (localWake && wakeListening) {
+        float score;
+        if (!wakeUplinkOpen && takeWakeWordTrigger(&score)) {
+          Serial.printf("[Wake] Local trigger (score=%.2f) - opening uplink\n", score);
+          // Cut the speaker now rather than after the server's interrupt
+          interruptVoicePlayback();
+          // Drop the unread backlog before the pre-roll read, so the pre-roll
+          // ends at the newest sample and live audio follows on from it
+          flushCapturedAudio();
+          sendVoiceWake(score);
+          wakeUplinkOpen = true;
+          wakeUplinkOpenedAt = millis();
+
+          // Send what was said before the trigger in one batch, then go live
+          if (preRollBuffer != nullptr) {
+            size_t preRoll = readPreRollAudio(preRollBuffer, AUDIO_PREROLL_MAX_MS * AUDIO_SAMPLE_RATE / 1000);
+            if (preRoll > 0) {
+              // It ends where the next live read begins
+              uint32_t capturedMs = getCaptureTimestampMs() - preRoll * 1000 / AUDIO_SAMPLE_RATE;
+              sendVoiceAudio(preRollBuffer, preRoll, capturedMs);
+              Serial.printf("[Wake] Sent %dms pre-roll\n", preRoll * 1000 / AUDIO_SAMPLE_RATE);
+            }
+          }
+        } else if (wakeUplinkOpen && millis() - wakeUplinkOpenedAt > WAKE_UPLINK_WINDOW_MS) {
+          // Server never picked it up (false trigger or no command) - close again
+          Serial.println("[Wake] No response to local trigger - closing uplink");
+          wakeUplinkOpen = false;
+          wasVoiceActive = false;
+          resetWakeWord();
+        }
+      } else if (wakeUplinkOpen) {
+        // Server took over; the next IDLE starts gated again
+        wakeUplinkOpen = false;
+        resetWakeWord();
       }
 
-      if (voiceState == VOICE_IDLE || voiceState == VOICE_LISTENING) {
-        size_t samplesRead = readMicrophoneData(audioBuffer, AUDIO_BUFFER_SIZE);
-        if (samplesRead > 0) {
+      if (voiceState == VOICE_IDLE || voiceState == VOICE_LISTENING || (fullDuplex && voiceState == VOICE_SPEAKING)) {
+        // Drain the capture ring in whole blocks (non-blocking)
+        while (getCapturedSampleCount() >= AUDIO_BUFFER_SIZE) {
+          uint32_t capturedMs = getCaptureTimestampMs();
+          size_t samplesRead = readCapturedAudio(audioBuffer, AUDIO_BUFFER_SIZE);
+          if (samplesRead == 0) {
+            break;
+          }
+
+          if (localWake && wakeListening && !wakeUplinkOpen) {
+            // Nothing leaves the device until the detector fires
+            feedWakeWord(audioBuffer, samplesRead);
+            continue;
+          }
+
           // Always send audio to server for transcription
-          bool sent = sendVoiceAudio(audioBuffer, samplesRead);
-
-          // Debug: Log audio sending periodically
-          static unsigned long lastAudioLog = 0;
-          static size_t audioSentCount = 0;
-          audioSentCount++;
-          if (millis() - lastAudioLog > 5000) {
-            Serial.printf("[Voice] Audio packets sent in last 5s: %d, last send success: %s\n",
-                         audioSentCount, sent ? "true" : "false");
-            audioSentCount = 0;
-            lastAudioLog = millis();
+          sendVoiceAudio(audioBuffer, samplesRead, capturedMs);
+
+          if (voiceState == VOICE_SPEAKING) {
+            // Streamed only so the server can hear a wake word over playback;
+            // end of speech matters once it has switched to listening
+            continue;
           }
 
           // Use VAD only to detect end of speech (for processing trigger)
           bool voiceDetected = detectVoiceActivity(audioBuffer, samplesRead);
 
-          // Debug: Log VAD state periodically
-          static unsigned long lastVadLog = 0;
-          if (millis() - lastVadLog > 3000) {
-            Serial.printf("[VAD] voiceDetected=%d, wasVoiceActive=%d, timeSinceActivity=%lums\n",
-                         voiceDetected, wasVoiceActive, wasVoiceActive ? (millis() - lastVoiceActivity) : 0);
-            lastVadLog = millis();
-          }
+          LOG_DEBUG_EVERY(3000, "[VAD] voiceDetected=%d, wasVoiceActive=%d, timeSinceActivity=%lums\n",
+                          voiceDetected, wasVoiceActive, wasVoiceActive ? (millis() - lastVoiceActivity) : 0);
 
           if (voiceDetected) {
             lastVoiceActivity = millis();
@@ -323,6 +381,9 @@ void loop() {
             wasVoiceActive = false;
           }
         }
+      } else {
+        // Mic isn't streamed while processing (or speaking without AEC) - don't let stale audio pile up
+        flushCapturedAudio();
       }
     }
   }
@@ -339,6 +400,7 @@ void loop() {
 
     if (isConnected && !wasConnected) {
       // Just connected - happy face!
+      powerWake();
       setFaceState(FACE_HAPPY);
       neopixelWrite(RGB_LED_PIN, 0, 255, 255);  // Bright cyan
       delay(100);
@@ -353,19 +415,15 @@ void loop() {
     wasConnected = isConnected;
   }
 
-  // Update face animation (30 FPS)
-  updateFaceAnimation();
-
   // Update status indicators every 5 seconds
   static unsigned long lastStatusUpdate = 0;
 
   if (millis() - lastStatusUpdate > 5000) {
     // Battery indicator
-    int raw = analogRead(BATTERY_ADC_PIN);
-    float voltage = getMoteBatteryVoltage();
     int batteryPercent = getMoteBatteryPercent();
     bool charging = false; // TODO: Add charging detection
-    Serial.printf("[Battery] Raw ADC: %d, Voltage: %.2fV, Percent: %d%%\n", raw, voltage, batteryPercent);
+    LOG_DEBUG("[Battery] Raw ADC: %d, Voltage: %.2fV, Percent: %d%%\n",
+              analogRead(BATTERY_ADC_PIN), getMoteBatteryVoltage(), batteryPercent);
     drawBatteryIndicator(batteryPercent, charging);
 
     // WiFi status indicator (only in WiFi mode)
@@ -374,6 +432,7 @@ void loop() {
       wl_status_t wifiStatus = WiFi.status();
       wifiConnected = (wifiStatus == WL_CONNECTED);
 
+#if MOTE_LOG_LEVEL >= MOTE_LOG_DEBUG
       // Log WiFi status
       const char* statusStr = "";
       switch (wifiStatus) {
@@ -387,9 +446,28 @@ void loop() {
         default: statusStr = "UNKNOWN"; break;
       }
       Serial.printf("[WiFi] Status: %s, IP: %s\n", statusStr, WiFi.localIP().toString().c_str());
+#endif
 
       drawWifiStatus(wifiConnected);
 
+#if MOTE_LOG_LEVEL >= MOTE_LOG_DEBUG
+      if (isLocalWakeActive()) {
+        WakeWordStats wake;
+        getWakeWordStats(&wake);
+        Serial.printf("[Wake] Inferences: %u, detections: %u, score: %.2f, time: %uus (max %uus), dropped: %u\n",
+                      wake.inferences, wake.detections, wake.lastScore, wake.lastInferenceUs,
+                      wake.maxInferenceUs, wake.droppedSamples);
+      }
+
+      if (isEchoCancellationActive()) {
+        EchoStats echo;
+        getEchoStats(&echo);
+        Serial.printf("[AEC] aligned: %d, ERLE: %.1fdB, coupling: %.2f, double talk: %d, resets: %u, resyncs: %u\n",
+                      echo.aligned, echo.erleDb, echo.couplingGain, echo.doubleTalk,
+                      echo.filterResets, echo.resyncs);
+      }
+#endif
+
       // Gateway status indicator (voice WebSocket connection)
       bool gatewayConnected = isVoiceConnected();
       drawGatewayStatus(gatewayConnected);
@@ -418,5 +496,8 @@ void loop() {
     }
   }
 
-  delay(10);
+  handlePowerManager();
+
+  // Sleep until the next pass (longer when idle), or until powerWake()
+  powerIdleDelay();
 }
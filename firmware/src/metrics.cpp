@@ -0,0 +1,144 @@
+#include "metrics.h"
+#include "latency_trace.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+std::atomic<uint32_t> metricValues[METRIC_COUNT];
+
+static const char* const metricNames[METRIC_COUNT] = {
+    "wsTextRx",
+    "wsBinaryRx",
+    "wsBinaryRxBytes",
+    "wsDisconnects",
+    "uplinkFrames",
+    "uplinkSendFailures",
+    "uplinkPacketDrops",
+    "downlinkErrors",
+    "playbackUnderruns",
+    "playbackDroppedSamples",
+    "captureOverrunSamples",
+    "poolAllocFailures",
+    "voiceState",
+    "playbackBuffered",
+    "playbackBufferedPeak",
+    "captureBacklogPeak",
+    "heapFree",
+    "heapMinFree",
+    "psramFree",
+    "psramMinFree",
+    "powerLevel",
+    "cpuMhz",
+    "poolInternalBlocks",
+    "poolInternalPeak",
+    "poolPsramBlocks",
+    "poolPsramPeak",
+};
+
+const char* metricName(MetricId id) {
+    if (id >= METRIC_COUNT) return "unknown";
+    return metricNames[id];
+}
+
+void sampleSystemMetrics() {
+    metricSet(METRIC_HEAP_FREE, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    metricSet(METRIC_HEAP_MIN_FREE, heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    metricSet(METRIC_PSRAM_FREE, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    metricSet(METRIC_PSRAM_MIN_FREE, heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM));
+}
+
+static void addLatency(JsonObject latency) {
+    LatencyStats stats;
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencyStage stage = (LatencyStage)i;
+        getLatencyStats(stage, &stats);
+
+        JsonObject entry = latency[latencyStageName(stage)].to<JsonObject>();
+        entry["count"] = stats.count;
+        entry["meanMs"] = stats.meanMs;
+        entry["p50Ms"] = stats.p50Ms;
+        entry["p95Ms"] = stats.p95Ms;
+        entry["maxMs"] = stats.maxMs;
+        JsonArray buckets = entry["buckets"].to<JsonArray>();
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            buckets.add(stats.buckets[b]);
+        }
+    }
+}
+
+#if configUSE_TRACE_FACILITY
+// Run time counters at the previous report, for CPU share since then
+struct TaskRuntime {
+    TaskHandle_t handle;
+    uint32_t runtime;
+};
+
+static TaskRuntime lastRuntimes[METRICS_MAX_TASKS];
+static int lastRuntimeCount = 0;
+static uint32_t lastTotalRuntime = 0;
+
+static uint32_t previousRuntime(TaskHandle_t handle) {
+    for (int i = 0; i < lastRuntimeCount; i++) {
+        if (lastRuntimes[i].handle == handle) return lastRuntimes[i].runtime;
+    }
+    return 0;
+}
+
+/**
+ * CPU share (percent of one core) since the previous report and stack
+ * headroom of every task
+ */
+static void addTasks(JsonArray tasks) {
+    static TaskStatus_t status[METRICS_MAX_TASKS];
+    uint32_t totalRuntime = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, METRICS_MAX_TASKS, &totalRuntime);
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        JsonObject task = tasks.add<JsonObject>();
+        task["name"] = status[i].pcTaskName;
+        task["priority"] = status[i].uxCurrentPriority;
+        task["stackFree"] = status[i].usStackHighWaterMark;
+#if configGENERATE_RUN_TIME_STATS
+        uint32_t elapsed = totalRuntime - lastTotalRuntime;
+        if (elapsed > 0 && lastRuntimeCount > 0) {
+            uint32_t ran = status[i].ulRunTimeCounter - previousRuntime(status[i].xHandle);
+            task["cpu"] = (uint32_t)((uint64_t)ran * 100 / elapsed);
+        }
+#endif
+    }
+
+    lastRuntimeCount = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        lastRuntimes[lastRuntimeCount].handle = status[i].xHandle;
+        lastRuntimes[lastRuntimeCount].runtime = status[i].ulRunTimeCounter;
+        lastRuntimeCount++;
+    }
+    lastTotalRuntime = totalRuntime;
+}
+#endif
+
+void buildMetricsReport(JsonDocument& doc, bool detailed) {
+    sampleSystemMetrics();
+
+    doc["type"] = "device.metrics";
+    doc["uptimeMs"] = millis();
+
+    JsonObject counters = doc["counters"].to<JsonObject>();
+    for (int i = 0; i < METRIC_FIRST_GAUGE; i++) {
+        counters[metricNames[i]] = metricGet((MetricId)i);
+    }
+    JsonObject gauges = doc["gauges"].to<JsonObject>();
+    for (int i = METRIC_FIRST_GAUGE; i < METRIC_COUNT; i++) {
+        gauges[metricNames[i]] = metricGet((MetricId)i);
+    }
+
+    if (!detailed) {
+        return;
+    }
+
+    addLatency(doc["latency"].to<JsonObject>());
+#if configUSE_TRACE_FACILITY
+    addTasks(doc["tasks"].to<JsonArray>());
+#endif
+}
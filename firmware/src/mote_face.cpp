@@ -1,12 +1,10 @@
 #include "mote_face.h"
-
-// Pin definitions (from docs/display.md)
-#define TFT_MOSI  11
-#define TFT_SCLK  13
-#define TFT_CS    10
-#define TFT_DC    9
-#define TFT_RST   14
-#define TFT_BL    8
+#include "display.h"
+#include "face_scene.h"
+#include "audio.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 
 // RGB565 Colors
 #define COLOR_BLACK   0x0000
@@ -18,357 +16,511 @@
 #define COLOR_CYAN    0x07FF
 #define COLOR_ORANGE  0xFD20
 
-// SPI instance
-SPIClass *spi = NULL;
+// Messages to the render task
+enum FaceCommandType : uint8_t {
+  FACE_CMD_STATE,
+  FACE_CMD_BATTERY,
+  FACE_CMD_WIFI,
+  FACE_CMD_GATEWAY,
+  FACE_CMD_BLINK,
+  FACE_CMD_LOOK,
+  FACE_CMD_WAVE,
+  FACE_CMD_BRIGHTNESS,
+  FACE_CMD_FRAME_MS
+};
+
+struct FaceCommand {
+  FaceCommandType type;
+  int16_t value;     // State, battery/brightness percent, look offset or frame ms
+  bool flag;         // Charging / connected
+};
+
+static QueueHandle_t faceQueue = nullptr;
+static TaskHandle_t faceTaskHandle = nullptr;
+
+// Everything below belongs to the render task
 
 // Current face state
-FaceState currentState = FACE_IDLE;
-unsigned long lastAnimUpdate = 0;
-int animFrame = 0;
-
-/**
- * Low-level SPI communication
- */
-void writeCommand(uint8_t cmd) {
-  digitalWrite(TFT_DC, LOW);   // Command mode
-  digitalWrite(TFT_CS, LOW);
-  spi->transfer(cmd);
-  digitalWrite(TFT_CS, HIGH);
+static FaceState currentState = FACE_IDLE;
+static uint16_t frameMs = FACE_FRAME_MS;
+
+// Retained scene: edit `scene`, then presentScene() sends only what changed
+static FaceScene scene;
+static FaceScene shownScene;
+static bool sceneShown = false;
+
+// Geometry of one expression
+struct FaceLayout {
+  SceneRect leftEye, rightEye;
+  SceneRect leftPupil, rightPupil;   // w == 0: no pupils
+  SceneRect mouth;
+};
+
+// Default face (also listening/thinking/speaking for now)
+static const FaceLayout simpleFace = {
+  {80, 80, 50, 60, COLOR_WHITE}, {190, 80, 50, 60, COLOR_WHITE},
+  {95, 95, 20, 30, COLOR_BLUE}, {205, 95, 20, 30, COLOR_BLUE},
+  {120, 160, 80, 15, COLOR_ORANGE}   // Happy mouth (orange smile)
+};
+
+// Big eyes, wide smile
+static const FaceLayout happyFace = {
+  {70, 70, 60, 70, COLOR_WHITE}, {190, 70, 60, 70, COLOR_WHITE},
+  {90, 90, 20, 30, COLOR_BLUE}, {210, 90, 20, 30, COLOR_BLUE},
+  {110, 160, 100, 20, COLOR_ORANGE}
+};
+
+// Closed eyes (horizontal lines), small mouth
+static const FaceLayout sleepingFace = {
+  {80, 110, 50, 5, COLOR_WHITE}, {190, 110, 50, 5, COLOR_WHITE},
+  {0, 0, 0, 0, 0}, {0, 0, 0, 0, 0},
+  {140, 170, 40, 5, COLOR_ORANGE}
+};
+
+// Wide eyes, round mouth
+static const FaceLayout surprisedFace = {
+  {70, 70, 60, 70, COLOR_WHITE}, {180, 70, 60, 70, COLOR_WHITE},
+  {85, 85, 30, 40, COLOR_BLUE}, {195, 85, 30, 40, COLOR_BLUE},
+  {140, 150, 40, 40, COLOR_ORANGE}
+};
+
+static const FaceLayout* layoutFor(FaceState state) {
+  switch (state) {
+    case FACE_HAPPY:     return &happyFace;
+    case FACE_SLEEPING:  return &sleepingFace;
+    case FACE_SURPRISED: return &surprisedFace;
+    default:             return &simpleFace;
+  }
 }
 
-void writeData(uint8_t data) {
-  digitalWrite(TFT_DC, HIGH);  // Data mode
-  digitalWrite(TFT_CS, LOW);
-  spi->transfer(data);
-  digitalWrite(TFT_CS, HIGH);
+// Keyframe track: value is interpolated linearly between keyframes. A
+// one-shot track holds its last value once it's done.
+#define FACE_MAX_KEYFRAMES 8
+
+struct Keyframe {
+  uint16_t atMs;     // From track start, ascending
+  int16_t value;
+};
+
+struct Track {
+  Keyframe frames[FACE_MAX_KEYFRAMES];
+  uint8_t count;
+  uint32_t start;
+  bool loop;
+};
+
+static void trackPlay(Track& track, const Keyframe* frames, uint8_t count, uint32_t now, bool loop) {
+  if (count > FACE_MAX_KEYFRAMES) count = FACE_MAX_KEYFRAMES;
+  memcpy(track.frames, frames, count * sizeof(Keyframe));
+  track.count = count;
+  track.start = now;
+  track.loop = loop;
 }
 
-void writeData16(uint16_t data) {
-  digitalWrite(TFT_DC, HIGH);
-  digitalWrite(TFT_CS, LOW);
-  spi->transfer(data >> 8);
-  spi->transfer(data & 0xFF);
-  digitalWrite(TFT_CS, HIGH);
-}
+static int16_t trackValue(const Track& track, uint32_t now) {
+  if (track.count == 0) return 0;
 
-/**
- * Set drawing window
- */
-void setWindow(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
-  writeCommand(0x2A); // CASET
-  writeData16(x0);
-  writeData16(x1);
+  const Keyframe* f = track.frames;
+  uint32_t duration = f[track.count - 1].atMs;
+  uint32_t t = now - track.start;
+  if (t >= duration) {
+    if (!track.loop || duration == 0) return f[track.count - 1].value;
+    t %= duration;
+  }
+
+  uint8_t i = 1;
+  while (i < track.count - 1 && f[i].atMs <= t) i++;
+  if (t <= f[i - 1].atMs) return f[i - 1].value;
 
-  writeCommand(0x2B); // RASET
-  writeData16(y0);
-  writeData16(y1);
+  int32_t span = f[i].atMs - f[i - 1].atMs;
+  if (span <= 0) return f[i].value;
+  int32_t delta = f[i].value - f[i - 1].value;
+  return f[i - 1].value + (int16_t)(delta * (int32_t)(t - f[i - 1].atMs) / span);
+}
 
-  writeCommand(0x2C); // RAMWR
+static bool trackDone(const Track& track, uint32_t now) {
+  return !track.loop && (track.count == 0 || now - track.start >= track.frames[track.count - 1].atMs);
 }
 
 /**
- * Fill entire screen with color
+ * Move from wherever the track is now to a new value
  */
-void fillScreen(uint16_t color) {
-  setWindow(0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1);
+static void trackTweenTo(Track& track, int16_t target, uint16_t ms, uint32_t now) {
+  Keyframe frames[2] = {{0, trackValue(track, now)}, {ms, target}};
+  trackPlay(track, frames, 2, now, false);
+}
 
-  digitalWrite(TFT_DC, HIGH);
-  digitalWrite(TFT_CS, LOW);
+// Eye openness in percent: shut and reopen
+static const Keyframe blinkFrames[] = {
+  {0, 100}, {50, 0}, {100, 0}, {160, 100}
+};
 
-  uint8_t hi = color >> 8;
-  uint8_t lo = color & 0xFF;
+// Pupil offset: glance left, back, right, back
+static const Keyframe waveFrames[] = {
+  {0, 0}, {100, -FACE_LOOK_OFFSET}, {300, -FACE_LOOK_OFFSET}, {400, 0},
+  {500, 0}, {600, FACE_LOOK_OFFSET}, {800, FACE_LOOK_OFFSET}, {900, 0}
+};
 
-  for (uint32_t i = 0; i < (SCREEN_WIDTH * SCREEN_HEIGHT); i++) {
-    spi->transfer(hi);
-    spi->transfer(lo);
-  }
+static Track eyeTrack;     // Openness, 0-100
+static Track lookTrack;    // Pupil x offset
+static int16_t lipLevel = 0;  // Extra mouth height from the playback envelope
+static uint32_t nextBlinkAt = 0;
 
-  digitalWrite(TFT_CS, HIGH);
+static void setSceneRect(SceneElementId id, const SceneRect& r, int16_t dx = 0) {
+  sceneSetRect(&scene, id, r.x + dx, r.y, r.w, r.h, r.color);
 }
 
 /**
- * Fill rectangle with color
+ * Eye squashed vertically around its center, pupil cut to what's left of it
  */
-void fillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color) {
-  if (x + w > SCREEN_WIDTH) w = SCREEN_WIDTH - x;
-  if (y + h > SCREEN_HEIGHT) h = SCREEN_HEIGHT - y;
+static void layoutEye(SceneElementId eyeId, SceneElementId pupilId,
+                      const SceneRect& eye, const SceneRect& pupil, int16_t open, int16_t look) {
+  int16_t h = eye.h * open / 100;
+  if (h <= 0) {
+    sceneClearElement(&scene, eyeId);
+    sceneClearElement(&scene, pupilId);
+    return;
+  }
 
-  setWindow(x, y, x + w - 1, y + h - 1);
+  int16_t y = eye.y + (eye.h - h) / 2;
+  sceneSetRect(&scene, eyeId, eye.x, y, eye.w, h, eye.color);
 
-  digitalWrite(TFT_DC, HIGH);
-  digitalWrite(TFT_CS, LOW);
+  int16_t py0 = max(pupil.y, y);
+  int16_t py1 = min((int16_t)(pupil.y + pupil.h), (int16_t)(y + h));
+  if (pupil.w > 0 && py1 > py0) {
+    sceneSetRect(&scene, pupilId, pupil.x + look, py0, pupil.w, py1 - py0, pupil.color);
+  } else {
+    sceneClearElement(&scene, pupilId);
+  }
+}
 
-  uint8_t hi = color >> 8;
-  uint8_t lo = color & 0xFF;
+/**
+ * Put the current expression into the scene
+ * @param open Eye openness in percent (0 = shut)
+ * @param look Pupil offset in pixels (negative = left)
+ * @param mouthOpen Extra mouth height in pixels
+ */
+static void layoutFace(int16_t open, int16_t look, int16_t mouthOpen) {
+  const FaceLayout* layout = layoutFor(currentState);
 
-  for (uint32_t i = 0; i < (w * h); i++) {
-    spi->transfer(hi);
-    spi->transfer(lo);
-  }
+  layoutEye(SCENE_LEFT_EYE, SCENE_LEFT_PUPIL, layout->leftEye, layout->leftPupil, open, look);
+  layoutEye(SCENE_RIGHT_EYE, SCENE_RIGHT_PUPIL, layout->rightEye, layout->rightPupil, open, look);
 
-  digitalWrite(TFT_CS, HIGH);
+  const SceneRect& mouth = layout->mouth;
+  sceneSetRect(&scene, SCENE_MOUTH, mouth.x, mouth.y - mouthOpen / 2, mouth.w, mouth.h + mouthOpen, mouth.color);
 }
 
 /**
- * Draw a simple happy face (initial implementation)
+ * Send the difference between the panel and the scene
  */
-void drawSimpleFace() {
-  // Left eye (white oval)
-  fillRect(80, 80, 50, 60, COLOR_WHITE);
-  // Left pupil
-  fillRect(95, 95, 20, 30, COLOR_BLUE);
-
-  // Right eye (white oval)
-  fillRect(190, 80, 50, 60, COLOR_WHITE);
-  // Right pupil
-  fillRect(205, 95, 20, 30, COLOR_BLUE);
-
-  // Happy mouth (orange smile)
-  fillRect(120, 160, 80, 15, COLOR_ORANGE);
+static void presentScene() {
+  sceneCompose(sceneShown ? &shownScene : nullptr, &scene);
+  shownScene = scene;
+  sceneShown = true;
 }
 
 /**
- * Initialize display hardware
+ * Battery indicator element
  */
-void setupFaceDisplay() {
-  Serial.println("[Face] Initializing display...");
+static void layoutBattery(int percent, bool charging) {
+  int x = SCREEN_WIDTH - 50;
+  int y = 10;
 
-  // Setup GPIO pins
-  pinMode(TFT_BL, OUTPUT);
-  pinMode(TFT_CS, OUTPUT);
-  pinMode(TFT_DC, OUTPUT);
-  pinMode(TFT_RST, OUTPUT);
+  sceneClearElement(&scene, SCENE_BATTERY);
 
-  digitalWrite(TFT_CS, HIGH);
-  digitalWrite(TFT_DC, HIGH);
-  digitalWrite(TFT_BL, HIGH); // Backlight ON
+  // Draw outline
+  sceneAddRect(&scene, SCENE_BATTERY, x, y, 40, 2, COLOR_WHITE); // Top
+  sceneAddRect(&scene, SCENE_BATTERY, x, y + 18, 40, 2, COLOR_WHITE); // Bottom
+  sceneAddRect(&scene, SCENE_BATTERY, x, y, 2, 20, COLOR_WHITE); // Left
+  sceneAddRect(&scene, SCENE_BATTERY, x + 38, y, 2, 20, COLOR_WHITE); // Right
+  sceneAddRect(&scene, SCENE_BATTERY, x + 40, y + 6, 3, 8, COLOR_WHITE); // Tip
 
-  // Initialize SPI with HSPI bus (CRITICAL for ESP32-S3 custom pins!)
-  spi = new SPIClass(HSPI);
-  spi->begin(TFT_SCLK, -1, TFT_MOSI, -1);
-  spi->setFrequency(40000000); // 40MHz
-  spi->setDataMode(SPI_MODE0);
-  spi->setBitOrder(MSBFIRST);
+  // Fill based on percentage
+  uint16_t fillColor = COLOR_GREEN;
+  if (percent < 25) fillColor = COLOR_RED;
+  else if (percent < 75) fillColor = COLOR_YELLOW;
 
-  Serial.println("[Face] SPI initialized at 40MHz");
+  if (charging) fillColor = COLOR_CYAN;
 
-  // Hardware reset
-  digitalWrite(TFT_RST, LOW);
-  delay(20);
-  digitalWrite(TFT_RST, HIGH);
-  delay(150);
+  int fillWidth = (36 * percent) / 100;
+  if (fillWidth > 0) {
+    sceneAddRect(&scene, SCENE_BATTERY, x + 2, y + 2, fillWidth, 16, fillColor);
+  }
+}
 
-  // Software reset
-  writeCommand(0x01); // SWRESET
-  delay(150);
+/**
+ * WiFi status element (top left corner)
+ */
+static void layoutWifi(bool connected) {
+  int x = 8;
+  int y = 8;
+  uint16_t color = connected ? COLOR_GREEN : COLOR_RED;
+  const SceneElementId id = SCENE_WIFI;
 
-  // Sleep out
-  writeCommand(0x11); // SLPOUT
-  delay(120);
+  sceneClearElement(&scene, id);
 
-  // Color mode - 16-bit RGB565
-  writeCommand(0x3A); // COLMOD
-  writeData(0x55);
+  // Draw WiFi text "Wi"
+  sceneAddRect(&scene, id, x, y, 2, 16, color);             // W left
+  sceneAddRect(&scene, id, x, y + 14, 4, 2, color);         // W bottom-left
+  sceneAddRect(&scene, id, x + 4, y + 8, 2, 8, color);      // W middle
+  sceneAddRect(&scene, id, x + 6, y + 14, 4, 2, color);     // W bottom-right
+  sceneAddRect(&scene, id, x + 10, y, 2, 16, color);        // W right
+
+  sceneAddRect(&scene, id, x + 14, y, 2, 16, color);        // i stem
+  sceneAddRect(&scene, id, x + 14, y - 2, 2, 2, color);     // i dot
+}
+
+/**
+ * Gateway status element (next to WiFi)
+ */
+static void layoutGateway(bool connected) {
+  int x = 42;  // Right next to WiFi
+  int y = 8;
+  uint16_t color = connected ? COLOR_GREEN : COLOR_RED;
+  const SceneElementId id = SCENE_GATEWAY;
 
-  // Memory access control - Landscape mode
-  writeCommand(0x36); // MADCTL
-  writeData(0x60); // MV=1, MX=1 for 90° rotation
+  sceneClearElement(&scene, id);
 
-  // Inversion on (required for ST7789)
-  writeCommand(0x21); // INVON
+  // Draw "GW" text
+  sceneAddRect(&scene, id, x, y, 2, 16, color);             // G left
+  sceneAddRect(&scene, id, x, y, 10, 2, color);             // G top
+  sceneAddRect(&scene, id, x, y + 14, 10, 2, color);        // G bottom
+  sceneAddRect(&scene, id, x + 8, y + 7, 2, 9, color);      // G right
+  sceneAddRect(&scene, id, x + 5, y + 7, 5, 2, color);      // G middle
+
+  sceneAddRect(&scene, id, x + 14, y, 2, 16, color);        // W left
+  sceneAddRect(&scene, id, x + 14, y + 14, 4, 2, color);    // W bottom-left
+  sceneAddRect(&scene, id, x + 18, y + 8, 2, 8, color);     // W middle
+  sceneAddRect(&scene, id, x + 20, y + 14, 4, 2, color);    // W bottom-right
+  sceneAddRect(&scene, id, x + 24, y, 2, 16, color);        // W right
+}
 
-  // Display on
-  writeCommand(0x29); // DISPON
-  delay(100);
+static void scheduleBlink(uint32_t now) {
+  nextBlinkAt = now + random(FACE_BLINK_MIN_MS, FACE_BLINK_MAX_MS);
+}
 
-  Serial.println("[Face] ST7789V initialized (320x240 landscape)");
+static void applyState(FaceState state, uint32_t now) {
+  if (state == currentState) return;
+  currentState = state;
 
-  // Draw initial face
-  fillScreen(COLOR_BLACK);
-  drawSimpleFace();
+  // A held glance re-centers; one still playing (wave) finishes on the new face
+  if (trackDone(lookTrack, now)) {
+    trackTweenTo(lookTrack, 0, FACE_LOOK_MS, now);
+  }
+
+  Serial.printf("[Face] State: %d\n", state);
 }
 
 /**
- * Update face animation
+ * Mouth opening for this frame: follows the speaker envelope while
+ * speaking, opens at once and closes over a few frames
  */
-void updateFaceAnimation() {
-  unsigned long now = millis();
-
-  // Update at 10 FPS (simple for now)
-  if (now - lastAnimUpdate < 100) return;
-  lastAnimUpdate = now;
-  animFrame++;
-
-  // Simple blink every 3 seconds
-  if (animFrame % 30 == 0) {
-    // Close eyes (fill with black)
-    fillRect(80, 80, 50, 60, COLOR_BLACK);
-    fillRect(190, 80, 50, 60, COLOR_BLACK);
-    delay(100);
-
-    // Reopen eyes
-    fillRect(80, 80, 50, 60, COLOR_WHITE);
-    fillRect(95, 95, 20, 30, COLOR_BLUE);
-    fillRect(190, 80, 50, 60, COLOR_WHITE);
-    fillRect(205, 95, 20, 30, COLOR_BLUE);
+static int16_t updateLipSync() {
+  int32_t target = 0;
+  if (currentState == FACE_SPEAKING) {
+    int32_t peak = getPlaybackEnvelope();
+    target = (peak - FACE_LIPSYNC_FLOOR) * FACE_MOUTH_MAX_OPEN / (FACE_LIPSYNC_FULL - FACE_LIPSYNC_FLOOR);
+    target = constrain(target, 0, FACE_MOUTH_MAX_OPEN);
   }
+
+  if (target >= lipLevel) {
+    lipLevel = target;
+  } else {
+    lipLevel -= (lipLevel - target + 1) / 2;
+  }
+  return lipLevel;
 }
 
-/**
- * Set face state
- */
-void setFaceState(FaceState state) {
-  if (currentState == state) return;
-  currentState = state;
+static void handleCommand(const FaceCommand& cmd, uint32_t now) {
+  switch (cmd.type) {
+    case FACE_CMD_STATE:
+      applyState((FaceState)cmd.value, now);
+      break;
 
-  fillScreen(COLOR_BLACK);
+    case FACE_CMD_BATTERY:
+      layoutBattery(cmd.value, cmd.flag);
+      break;
 
-  switch (state) {
-    case FACE_HAPPY:
-      // Big eyes, wide smile
-      fillRect(70, 70, 60, 70, COLOR_WHITE);
-      fillRect(90, 90, 20, 30, COLOR_BLUE);
-      fillRect(190, 70, 60, 70, COLOR_WHITE);
-      fillRect(210, 90, 20, 30, COLOR_BLUE);
-      fillRect(110, 160, 100, 20, COLOR_ORANGE);
+    case FACE_CMD_WIFI:
+      layoutWifi(cmd.flag);
+      break;
+
+    case FACE_CMD_GATEWAY:
+      layoutGateway(cmd.flag);
+      break;
+
+    case FACE_CMD_BLINK:
+      trackPlay(eyeTrack, blinkFrames, sizeof(blinkFrames) / sizeof(blinkFrames[0]), now, false);
+      scheduleBlink(now);
+      break;
+
+    case FACE_CMD_LOOK:
+      trackTweenTo(lookTrack, cmd.value, FACE_LOOK_MS, now);
       break;
 
-    case FACE_SLEEPING:
-      // Closed eyes (horizontal lines)
-      fillRect(80, 110, 50, 5, COLOR_WHITE);
-      fillRect(190, 110, 50, 5, COLOR_WHITE);
-      // Small mouth
-      fillRect(140, 170, 40, 5, COLOR_ORANGE);
+    case FACE_CMD_WAVE:
+      trackPlay(lookTrack, waveFrames, sizeof(waveFrames) / sizeof(waveFrames[0]), now, false);
       break;
 
-    case FACE_SURPRISED:
-      // Wide eyes
-      fillRect(70, 70, 60, 70, COLOR_WHITE);
-      fillRect(85, 85, 30, 40, COLOR_BLUE);
-      fillRect(180, 70, 60, 70, COLOR_WHITE);
-      fillRect(195, 85, 30, 40, COLOR_BLUE);
-      // Round mouth
-      fillRect(140, 150, 40, 40, COLOR_ORANGE);
+    case FACE_CMD_BRIGHTNESS:
+      displayBrightness(cmd.value);
       break;
 
-    default: // FACE_IDLE
-      drawSimpleFace();
+    case FACE_CMD_FRAME_MS:
+      frameMs = cmd.value;
       break;
   }
+}
 
-  Serial.printf("[Face] State: %d\n", state);
+/**
+ * Render task: apply commands, sample the tracks, present - once per frame
+ */
+static void faceRenderTask(void* param) {
+  uint32_t now = millis();
+  Keyframe open = {0, 100};
+  trackPlay(eyeTrack, &open, 1, now, false);
+  scheduleBlink(now);
+
+  // Draw initial face (first present covers the whole screen)
+  layoutFace(100, 0, 0);
+  presentScene();
+
+  TickType_t lastFrame = xTaskGetTickCount();
+
+  while (true) {
+    // Sleep until the next frame - or the next command, so a state change
+    // shows at once even at the slow idle frame rate
+    TickType_t period = pdMS_TO_TICKS(frameMs);
+    TickType_t elapsed = xTaskGetTickCount() - lastFrame;
+    if (elapsed < period) {
+      FaceCommand pending;
+      xQueuePeek(faceQueue, &pending, period - elapsed);
+    }
+    lastFrame = xTaskGetTickCount();
+    now = millis();
+
+    FaceCommand cmd;
+    while (xQueueReceive(faceQueue, &cmd, 0) == pdTRUE) {
+      handleCommand(cmd, now);
+    }
+
+    // Idle blink (sleeping eyes are already shut)
+    if ((int32_t)(now - nextBlinkAt) >= 0) {
+      if (currentState != FACE_SLEEPING && trackDone(eyeTrack, now)) {
+        trackPlay(eyeTrack, blinkFrames, sizeof(blinkFrames) / sizeof(blinkFrames[0]), now, false);
+      }
+      scheduleBlink(now);
+    }
+
+    layoutFace(trackValue(eyeTrack, now), trackValue(lookTrack, now), updateLipSync());
+
+    // Only what changed since the last frame goes out (often nothing,
+    // just the mouth while speaking)
+    presentScene();
+  }
 }
 
 /**
- * Draw battery indicator
+ * Queue a command for the render task, never waiting
  */
-void drawBatteryIndicator(int percent, bool charging) {
-  int x = SCREEN_WIDTH - 50;
-  int y = 10;
+static void postFaceCommand(FaceCommandType type, int16_t value = 0, bool flag = false) {
+  if (faceQueue == nullptr) return;
 
-  // Battery outline (white)
-  fillRect(x, y, 40, 20, COLOR_BLACK); // Clear area first
+  FaceCommand cmd = {type, value, flag};
+  if (xQueueSend(faceQueue, &cmd, 0) != pdTRUE) {
+    Serial.println("[Face] Command queue full - dropped");
+  }
+}
 
-  // Draw outline
-  fillRect(x, y, 40, 2, COLOR_WHITE); // Top
-  fillRect(x, y + 18, 40, 2, COLOR_WHITE); // Bottom
-  fillRect(x, y, 2, 20, COLOR_WHITE); // Left
-  fillRect(x + 38, y, 2, 20, COLOR_WHITE); // Right
-  fillRect(x + 40, y + 6, 3, 8, COLOR_WHITE); // Tip
+/**
+ * Initialize display hardware
+ */
+void setupFaceDisplay() {
+  Serial.println("[Face] Initializing display...");
 
-  // Fill based on percentage
-  uint16_t fillColor = COLOR_GREEN;
-  if (percent < 25) fillColor = COLOR_RED;
-  else if (percent < 75) fillColor = COLOR_YELLOW;
+  if (!displayInit()) {
+    Serial.println("[Face] Display initialization failed");
+    return;
+  }
 
-  if (charging) fillColor = COLOR_CYAN;
+  Serial.println("[Face] ST7789V initialized (320x240 landscape)");
 
-  int fillWidth = (36 * percent) / 100;
-  if (fillWidth > 0) {
-    fillRect(x + 2, y + 2, fillWidth, 16, fillColor);
+  if (faceTaskHandle != nullptr) return;
+
+  sceneInit(&scene, COLOR_BLACK);
+  faceQueue = xQueueCreate(FACE_QUEUE_DEPTH, sizeof(FaceCommand));
+  if (faceQueue == nullptr) {
+    Serial.println("[Face] Failed to create command queue");
+    return;
   }
+
+  // From here on only the render task touches the display
+  xTaskCreatePinnedToCore(
+    faceRenderTask,
+    "FaceRender",
+    FACE_TASK_STACK,
+    nullptr,
+    FACE_TASK_PRIORITY,
+    &faceTaskHandle,
+    FACE_TASK_CORE
+  );
 }
 
 /**
- * Simple animations
+ * Set face state
  */
-void blinkEyes() {
-  fillRect(80, 80, 50, 60, COLOR_BLACK);
-  fillRect(190, 80, 50, 60, COLOR_BLACK);
-  delay(150);
-  fillRect(80, 80, 50, 60, COLOR_WHITE);
-  fillRect(95, 95, 20, 30, COLOR_BLUE);
-  fillRect(190, 80, 50, 60, COLOR_WHITE);
-  fillRect(205, 95, 20, 30, COLOR_BLUE);
+void setFaceState(FaceState state) {
+  postFaceCommand(FACE_CMD_STATE, state);
 }
 
-void lookLeft() {
-  fillRect(80, 80, 50, 60, COLOR_WHITE);
-  fillRect(85, 95, 20, 30, COLOR_BLUE);
-  fillRect(190, 80, 50, 60, COLOR_WHITE);
-  fillRect(195, 95, 20, 30, COLOR_BLUE);
+/**
+ * Draw battery indicator
+ */
+void drawBatteryIndicator(int percent, bool charging) {
+  postFaceCommand(FACE_CMD_BATTERY, percent, charging);
 }
 
-void lookRight() {
-  fillRect(80, 80, 50, 60, COLOR_WHITE);
-  fillRect(105, 95, 20, 30, COLOR_BLUE);
-  fillRect(190, 80, 50, 60, COLOR_WHITE);
-  fillRect(215, 95, 20, 30, COLOR_BLUE);
+/**
+ * Draw WiFi status indicator (top left corner)
+ */
+void drawWifiStatus(bool connected) {
+  postFaceCommand(FACE_CMD_WIFI, 0, connected);
 }
 
-void waveAnimation() {
-  lookLeft();
-  delay(300);
-  drawSimpleFace();
-  delay(200);
-  lookRight();
-  delay(300);
-  drawSimpleFace();
+/**
+ * Draw Gateway status indicator (next to WiFi)
+ */
+void drawGatewayStatus(bool connected) {
+  postFaceCommand(FACE_CMD_GATEWAY, 0, connected);
 }
 
 /**
- * Draw WiFi status indicator (top left corner)
+ * Simple animations
  */
-void drawWifiStatus(bool connected) {
-  int x = 8;
-  int y = 8;
-  uint16_t color = connected ? COLOR_GREEN : COLOR_RED;
+void blinkEyes() {
+  postFaceCommand(FACE_CMD_BLINK);
+}
 
-  // Clear area first
-  fillRect(x, y, 24, 20, COLOR_BLACK);
+void lookLeft() {
+  postFaceCommand(FACE_CMD_LOOK, -FACE_LOOK_OFFSET);
+}
 
-  // Draw WiFi text "Wi"
-  fillRect(x, y, 2, 16, color);             // W left
-  fillRect(x, y + 14, 4, 2, color);         // W bottom-left
-  fillRect(x + 4, y + 8, 2, 8, color);      // W middle
-  fillRect(x + 6, y + 14, 4, 2, color);     // W bottom-right
-  fillRect(x + 10, y, 2, 16, color);        // W right
-
-  fillRect(x + 14, y, 2, 16, color);        // i stem
-  fillRect(x + 14, y - 2, 2, 2, color);     // i dot
+void lookRight() {
+  postFaceCommand(FACE_CMD_LOOK, FACE_LOOK_OFFSET);
+}
+
+void waveAnimation() {
+  postFaceCommand(FACE_CMD_WAVE);
 }
 
 /**
- * Draw Gateway status indicator (next to WiFi)
+ * Power saving (see power_manager.h)
  */
-void drawGatewayStatus(bool connected) {
-  int x = 42;  // Right next to WiFi
-  int y = 8;
-  uint16_t color = connected ? COLOR_GREEN : COLOR_RED;
-
-  // Clear area first
-  fillRect(x, y, 30, 20, COLOR_BLACK);
+void setFaceBrightness(uint8_t percent) {
+  postFaceCommand(FACE_CMD_BRIGHTNESS, percent);
+}
 
-  // Draw "GW" text
-  fillRect(x, y, 2, 16, color);             // G left
-  fillRect(x, y, 10, 2, color);             // G top
-  fillRect(x, y + 14, 10, 2, color);        // G bottom
-  fillRect(x + 8, y + 7, 2, 9, color);      // G right
-  fillRect(x + 5, y + 7, 5, 2, color);      // G middle
-
-  fillRect(x + 14, y, 2, 16, color);        // W left
-  fillRect(x + 14, y + 14, 4, 2, color);    // W bottom-left
-  fillRect(x + 18, y + 8, 2, 8, color);     // W middle
-  fillRect(x + 20, y + 14, 4, 2, color);    // W bottom-right
-  fillRect(x + 24, y, 2, 16, color);        // W right
+void setFaceFrameInterval(uint16_t ms) {
+  if (ms < FACE_FRAME_MS) ms = FACE_FRAME_MS;
+  postFaceCommand(FACE_CMD_FRAME_MS, ms);
 }
@@ -0,0 +1,488 @@
+#include "ota_update.h"
+#include "wake_word.h"
+#include "power_manager.h"
+#include <Preferences.h>
+#include <esp_partition.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/md.h>
+
+#define OTA_SECTOR_BYTES    4096
+#define OTA_FRAME_SIZE      384     // Longest control frame we send (ota.status)
+
+enum OtaPhase : uint8_t {
+    OTA_PHASE_IDLE,         // Nothing running (a checkpoint may wait for its offer)
+    OTA_PHASE_RECEIVING,
+    OTA_PHASE_VERIFYING,
+    OTA_PHASE_STAGED        // Firmware is the boot partition, reboot pending
+};
+
+// Transfer state - checkpointed to NVS as one blob
+struct OtaSession {
+    uint8_t target;                 // OtaTarget
+    char version[OTA_VERSION_SIZE];
+    char partition[17];             // Slot label
+    uint32_t size;
+    uint8_t sha256[32];
+    uint32_t written;               // Bytes in flash, from offset 0
+};
+
+static OtaSendCallback sendCallback = nullptr;
+static OtaSession session = {};
+static bool sessionValid = false;
+static OtaPhase phase = OTA_PHASE_IDLE;
+static const esp_partition_t* slot = nullptr;
+static bool connected = false;
+static bool appConfirmed = false;
+
+static bool requestInFlight = false;
+static unsigned long requestedAt = 0;
+static unsigned long lastChunkAt = 0;
+static uint8_t chunk[OTA_CHUNK_BYTES];
+static size_t chunkLength = 0;      // Received but not yet written
+
+static mbedtls_md_context_t sha;
+static uint32_t verified = 0;
+static char stagedVersion[OTA_VERSION_SIZE] = "";
+
+static const char* targetName(uint8_t target) {
+    return target == OTA_TARGET_MODEL ? "model" : "firmware";
+}
+
+static bool targetFromName(const char* name, OtaTarget* target) {
+    if (name == nullptr) return false;
+    if (strcmp(name, "firmware") == 0) {
+        *target = OTA_TARGET_FIRMWARE;
+    } else if (strcmp(name, "model") == 0) {
+        *target = OTA_TARGET_MODEL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Versions are echoed into frames unescaped - keep them to a safe alphabet
+ */
+static bool validVersion(const char* version) {
+    if (version == nullptr || version[0] == '\0' || strlen(version) >= OTA_VERSION_SIZE) return false;
+    for (const char* c = version; *c; c++) {
+        if (!isalnum((unsigned char)*c) && strchr(".-_+", *c) == nullptr) return false;
+    }
+    return true;
+}
+
+static bool parseSha256(const char* hex, uint8_t* digest) {
+    if (hex == nullptr || strlen(hex) != 64) return false;
+    for (int i = 0; i < 32; i++) {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        char* end;
+        digest[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0') return false;
+    }
+    return true;
+}
+
+static String loadModelVersion() {
+    Preferences prefs;
+    prefs.begin("mote", true);
+    String version = prefs.getString("kws_ver", "");
+    prefs.end();
+    return version;
+}
+
+static void saveModelVersion(const char* version) {
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.putString("kws_ver", version);
+    prefs.end();
+}
+
+static void saveSession() {
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.putBytes("ota_session", &session, sizeof(session));
+    prefs.end();
+}
+
+static void clearSession() {
+    sessionValid = false;
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.remove("ota_session");
+    prefs.end();
+}
+
+static bool loadSession() {
+    Preferences prefs;
+    prefs.begin("mote", true);
+    size_t length = prefs.getBytes("ota_session", &session, sizeof(session));
+    prefs.end();
+
+    session.version[sizeof(session.version) - 1] = '\0';
+    session.partition[sizeof(session.partition) - 1] = '\0';
+    return length == sizeof(session) && session.target <= OTA_TARGET_MODEL &&
+           session.size > 0 && session.written <= session.size;
+}
+
+/**
+ * Copy a frame into a heap buffer for the send queue
+ */
+static void sendText(const char* text, int length) {
+    if (sendCallback == nullptr || length <= 0 || length >= OTA_FRAME_SIZE) return;
+
+    char* frame = (char*)malloc(length + 1);
+    if (frame == nullptr) return;
+    memcpy(frame, text, length + 1);
+    sendCallback(frame, length, 0);
+}
+
+static void sendResult(uint8_t target, const char* version, const char* error, bool rebooting, bool nextBoot) {
+    char frame[OTA_FRAME_SIZE];
+    int n = snprintf(frame, sizeof(frame), "{\"type\":\"ota.result\",\"target\":\"%s\",\"version\":\"%s\",\"ok\":%s",
+                     targetName(target), version, error == nullptr ? "true" : "false");
+    if (error != nullptr) {
+        n += snprintf(frame + n, sizeof(frame) - n, ",\"error\":\"%s\"", error);
+    }
+    n += snprintf(frame + n, sizeof(frame) - n, ",\"rebooting\":%s%s}", rebooting ? "true" : "false",
+                  nextBoot ? ",\"nextBoot\":true" : "");
+    sendText(frame, n);
+}
+
+static void sendStatus() {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+
+    char frame[OTA_FRAME_SIZE];
+    int n = snprintf(frame, sizeof(frame),
+                     "{\"type\":\"ota.status\",\"firmware\":\"%s\",\"partition\":\"%s\",\"model\":\"%s\",\"modelSlot\":\"%s\"",
+                     MOTE_FIRMWARE_VERSION, running ? running->label : "", loadModelVersion().c_str(),
+                     getWakeModelActivePartition());
+    if (phase == OTA_PHASE_STAGED) {
+        n += snprintf(frame + n, sizeof(frame) - n, ",\"staged\":\"%s\"", stagedVersion);
+    } else if (sessionValid) {
+        n += snprintf(frame + n, sizeof(frame) - n,
+                      ",\"pending\":{\"target\":\"%s\",\"version\":\"%s\",\"offset\":%u,\"size\":%u}",
+                      targetName(session.target), session.version, (unsigned)session.written, (unsigned)session.size);
+    }
+    n += snprintf(frame + n, sizeof(frame) - n, "}");
+    sendText(frame, n);
+}
+
+static void sendRequest() {
+    uint32_t remaining = session.size - session.written;
+    uint32_t length = remaining < OTA_CHUNK_BYTES ? remaining : OTA_CHUNK_BYTES;
+
+    char frame[OTA_FRAME_SIZE];
+    int n = snprintf(frame, sizeof(frame),
+                     "{\"type\":\"ota.request\",\"target\":\"%s\",\"version\":\"%s\",\"offset\":%u,\"length\":%u}",
+                     targetName(session.target), session.version, (unsigned)session.written, (unsigned)length);
+    sendText(frame, n);
+    requestInFlight = true;
+    requestedAt = millis();
+}
+
+/**
+ * Give up on the current transfer (the next offer starts from scratch)
+ */
+static void failTransfer(const char* error) {
+    Serial.printf("[OTA] %s %s failed: %s\n", targetName(session.target), session.version, error);
+    if (phase == OTA_PHASE_VERIFYING) mbedtls_md_free(&sha);
+    sendResult(session.target, session.version, error, false, false);
+    clearSession();
+    phase = OTA_PHASE_IDLE;
+    slot = nullptr;
+    requestInFlight = false;
+    chunkLength = 0;
+}
+
+static void startVerify() {
+    saveSession();
+    mbedtls_md_init(&sha);
+    if (mbedtls_md_setup(&sha, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0) != 0) {
+        mbedtls_md_free(&sha);
+        failTransfer("Hash unavailable");
+        return;
+    }
+    mbedtls_md_starts(&sha);
+    verified = 0;
+    phase = OTA_PHASE_VERIFYING;
+    Serial.printf("[OTA] Received %u bytes, verifying\n", (unsigned)session.size);
+}
+
+static void handleOffer(JsonVariantConst msg) {
+    OtaTarget target;
+    const char* version = msg["version"];
+    uint32_t size = msg["size"] | 0u;
+    uint8_t digest[32];
+    if (!targetFromName(msg["target"], &target) || !validVersion(version) || size == 0 ||
+        !parseSha256(msg["sha256"], digest)) {
+        Serial.println("[OTA] Ignoring malformed offer");
+        return;
+    }
+
+    if (phase == OTA_PHASE_VERIFYING || phase == OTA_PHASE_STAGED) {
+        sendResult(target, version, "Busy", false, false);
+        return;
+    }
+
+    bool sameImage = sessionValid && session.target == target && session.size == size &&
+                     strcmp(session.version, version) == 0 && memcmp(session.sha256, digest, sizeof(digest)) == 0;
+    if (phase == OTA_PHASE_RECEIVING) {
+        if (sameImage) return;  // Repeated offer - the request in flight stands
+        Serial.printf("[OTA] %s %s superseded by %s\n", targetName(session.target), session.version, version);
+    }
+
+    if ((target == OTA_TARGET_FIRMWARE && strcmp(version, MOTE_FIRMWARE_VERSION) == 0) ||
+        (target == OTA_TARGET_MODEL && loadModelVersion() == version)) {
+        sendResult(target, version, nullptr, false, false);  // Already installed
+        return;
+    }
+
+    const esp_partition_t* candidate = target == OTA_TARGET_FIRMWARE
+        ? esp_ota_get_next_update_partition(nullptr)
+        : esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, getWakeModelStandbyPartition());
+    if (candidate == nullptr) {
+        sendResult(target, version, "No update partition", false, false);
+        return;
+    }
+    if (size > candidate->size) {
+        sendResult(target, version, "Image too large", false, false);
+        return;
+    }
+
+    // A checkpoint for the same image in the same slot carries on where it stopped
+    bool resume = sameImage && strcmp(session.partition, candidate->label) == 0;
+    if (!resume) {
+        memset(&session, 0, sizeof(session));
+        session.target = target;
+        strncpy(session.version, version, sizeof(session.version) - 1);
+        strncpy(session.partition, candidate->label, sizeof(session.partition) - 1);
+        session.size = size;
+        memcpy(session.sha256, digest, sizeof(digest));
+        sessionValid = true;
+        saveSession();
+    }
+
+    slot = candidate;
+    phase = OTA_PHASE_RECEIVING;
+    requestInFlight = false;
+    chunkLength = 0;
+    lastChunkAt = 0;
+    Serial.printf("[OTA] %s %s %s (%u bytes) into %s at %u\n", resume ? "Resuming" : "Receiving",
+                  targetName(target), version, (unsigned)size, candidate->label, (unsigned)session.written);
+
+    if (session.written == session.size) {
+        startVerify();
+    }
+}
+
+static void handleChunk(JsonVariantConst msg) {
+    if (phase != OTA_PHASE_RECEIVING || !requestInFlight) return;  // Late or unasked for
+
+    uint32_t offset = msg["offset"] | UINT32_MAX;
+    const char* data = msg["data"];
+    if (offset != session.written || data == nullptr) return;  // Stale - the timeout asks again
+
+    uint32_t remaining = session.size - session.written;
+    size_t expected = remaining < OTA_CHUNK_BYTES ? remaining : OTA_CHUNK_BYTES;
+    size_t decoded = 0;
+    requestInFlight = false;
+    if (mbedtls_base64_decode(chunk, sizeof(chunk), &decoded, (const unsigned char*)data, strlen(data)) != 0 ||
+        decoded != expected) {
+        Serial.printf("[OTA] Bad chunk at %u - asking again\n", (unsigned)offset);
+        return;
+    }
+
+    // Written from handleOtaUpdate(), once no conversation is running
+    chunkLength = decoded;
+    lastChunkAt = millis();
+}
+
+static void handleCancel(JsonVariantConst msg) {
+    OtaTarget target;
+    if (targetFromName(msg["target"], &target) && sessionValid && target != session.target) return;
+
+    if (phase == OTA_PHASE_STAGED) {
+        // Boot the running build again
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        if (running != nullptr) esp_ota_set_boot_partition(running);
+        Serial.printf("[OTA] Staged firmware %s cancelled\n", stagedVersion);
+        phase = OTA_PHASE_IDLE;
+        stagedVersion[0] = '\0';
+        return;
+    }
+
+    if (!sessionValid) return;
+    Serial.printf("[OTA] %s %s cancelled at %u bytes\n", targetName(session.target), session.version,
+                  (unsigned)session.written);
+    if (phase == OTA_PHASE_VERIFYING) mbedtls_md_free(&sha);
+    clearSession();
+    phase = OTA_PHASE_IDLE;
+    slot = nullptr;
+    requestInFlight = false;
+    chunkLength = 0;
+}
+
+static void writeChunk() {
+    // Chunks are sector sized and aligned, so each one erases only its own sector
+    size_t erase = (chunkLength + OTA_SECTOR_BYTES - 1) / OTA_SECTOR_BYTES * OTA_SECTOR_BYTES;
+    if (esp_partition_erase_range(slot, session.written, erase) != ESP_OK ||
+        esp_partition_write(slot, session.written, chunk, chunkLength) != ESP_OK) {
+        failTransfer("Flash write failed");
+        return;
+    }
+
+    session.written += chunkLength;
+    chunkLength = 0;
+
+    if (session.written == session.size) {
+        startVerify();
+    } else if (session.written % OTA_CHECKPOINT_BYTES == 0) {
+        saveSession();
+    }
+}
+
+/**
+ * Hash the next OTA_VERIFY_STEP_BYTES read back from the slot
+ */
+static void verifyStep() {
+    uint32_t end = session.size - verified > OTA_VERIFY_STEP_BYTES ? verified + OTA_VERIFY_STEP_BYTES : session.size;
+    while (verified < end) {
+        size_t n = end - verified < sizeof(chunk) ? end - verified : sizeof(chunk);
+        if (esp_partition_read(slot, verified, chunk, n) != ESP_OK) {
+            failTransfer("Flash read failed");
+            return;
+        }
+        mbedtls_md_update(&sha, chunk, n);
+        verified += n;
+    }
+    if (verified < session.size) return;
+
+    uint8_t digest[32];
+    mbedtls_md_finish(&sha, digest);
+    mbedtls_md_free(&sha);
+    phase = OTA_PHASE_IDLE;  // Hash context is gone - failTransfer() mustn't free it again
+
+    if (memcmp(digest, session.sha256, sizeof(digest)) != 0) {
+        failTransfer("Hash mismatch");
+        return;
+    }
+
+    if (session.target == OTA_TARGET_FIRMWARE) {
+        // Also checks the image itself
+        if (esp_ota_set_boot_partition(slot) != ESP_OK) {
+            failTransfer("Invalid firmware image");
+            return;
+        }
+        strncpy(stagedVersion, session.version, sizeof(stagedVersion) - 1);
+        Serial.printf("[OTA] Firmware %s staged in %s, rebooting when idle\n", stagedVersion, slot->label);
+        sendResult(session.target, session.version, nullptr, true, false);
+        clearSession();
+        phase = OTA_PHASE_STAGED;
+        return;
+    }
+
+    bool deferred = false;
+    if (!activateWakeWordModel(slot->label, &deferred)) {
+        failTransfer("Invalid model");
+        return;
+    }
+    saveModelVersion(session.version);
+    Serial.printf("[OTA] Model %s installed in %s%s\n", session.version, slot->label,
+                  deferred ? " (active after reboot)" : "");
+    sendResult(session.target, session.version, nullptr, false, deferred);
+    clearSession();
+    slot = nullptr;
+}
+
+void setupOtaUpdate(OtaSendCallback send) {
+    sendCallback = send;
+
+    sessionValid = loadSession();
+    if (sessionValid) {
+        Serial.printf("[OTA] Checkpoint: %s %s at %u/%u bytes\n", targetName(session.target), session.version,
+                      (unsigned)session.written, (unsigned)session.size);
+    }
+}
+
+void handleOtaMessage(VoiceMessageType type, JsonVariantConst msg) {
+    switch (type) {
+        case VOICE_MSG_OTA_OFFER:
+            handleOffer(msg);
+            break;
+        case VOICE_MSG_OTA_CHUNK:
+            handleChunk(msg);
+            break;
+        case VOICE_MSG_OTA_CANCEL:
+            handleCancel(msg);
+            break;
+        default:
+            break;
+    }
+}
+
+void onOtaConnected() {
+    connected = true;
+
+    if (!appConfirmed) {
+        // Reaching the gateway is the health check for a freshly installed build
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        esp_ota_img_states_t state;
+        if (running != nullptr && esp_ota_get_state_partition(running, &state) == ESP_OK &&
+            state == ESP_OTA_IMG_PENDING_VERIFY) {
+            esp_ota_mark_app_valid_cancel_rollback();
+            Serial.printf("[OTA] Firmware %s confirmed\n", MOTE_FIRMWARE_VERSION);
+        }
+        appConfirmed = true;
+    }
+
+    sendStatus();
+}
+
+void onOtaDisconnected() {
+    connected = false;
+    requestInFlight = false;
+
+    if (phase == OTA_PHASE_RECEIVING) {
+        // Resumes from here when the gateway offers the same image again
+        chunkLength = 0;
+        saveSession();
+        phase = OTA_PHASE_IDLE;
+        slot = nullptr;
+        Serial.printf("[OTA] Paused at %u/%u bytes\n", (unsigned)session.written, (unsigned)session.size);
+    }
+}
+
+void handleOtaUpdate(bool conversationActive) {
+    if (phase == OTA_PHASE_STAGED) {
+        if (!conversationActive && getPowerLevel() != POWER_ACTIVE) {
+            Serial.printf("[OTA] Rebooting into firmware %s\n", stagedVersion);
+            Serial.flush();
+            ESP.restart();
+        }
+        return;
+    }
+
+    // Erasing flash stalls the cache and chunks take link time - both belong to audio now
+    if (conversationActive) return;
+
+    if (phase == OTA_PHASE_VERIFYING) {
+        verifyStep();
+        return;
+    }
+    if (phase != OTA_PHASE_RECEIVING) return;
+
+    if (chunkLength > 0) {
+        writeChunk();
+        return;
+    }
+
+    if (!connected) return;
+    if (requestInFlight) {
+        if (millis() - requestedAt < OTA_REQUEST_TIMEOUT_MS) return;
+        Serial.printf("[OTA] No chunk at %u - asking again\n", (unsigned)session.written);
+    } else if (millis() - lastChunkAt < OTA_REQUEST_INTERVAL_MS) {
+        return;
+    }
+    sendRequest();
+}
@@ -0,0 +1,95 @@
+#include "playback_control.h"
+
+PlaybackControl::PlaybackControl(uint32_t rate, size_t queueSamples, size_t frameSamples)
+    : sampleRate(rate),
+      queueUs((uint64_t)queueSamples * 1000000ULL / rate),
+      frameUs((uint64_t)frameSamples * 1000000ULL / rate),
+      isPlaying(false),
+      isRebuffering(false),
+      isDraining(false),
+      underrunStartUs(0),
+      playedOutUs(0) {}
+
+PlaybackAction PlaybackControl::step(const PlaybackInput& in, size_t* samples) {
+    *samples = 0;
+    size_t chunk = in.buffered < PLAYBACK_CHUNK_SAMPLES ? in.buffered : PLAYBACK_CHUNK_SAMPLES;
+
+    if (!isPlaying) {
+        // Enough lead, or the stream is done but there's still audio to play
+        if ((in.buffered >= in.startThreshold && !in.streamFinished) || (in.streamFinished && in.buffered > 0)) {
+            isPlaying = true;
+            isRebuffering = false;
+            isDraining = false;
+            playedOutUs = in.nowUs;
+            *samples = chunk;
+            return PLAYBACK_START;
+        }
+        return PLAYBACK_IDLE;
+    }
+
+    if (in.buffered == 0 && in.streamFinished) {
+        // Let the amp play out its queue before turning it off
+        isDraining = true;
+        if (!speakerDrained(in.nowUs)) {
+            return PLAYBACK_WAIT;
+        }
+        stop();
+        return PLAYBACK_FINISHED;
+    }
+    isDraining = false;
+
+    if (in.buffered == 0 && !isRebuffering) {
+        if (!speakerDrained(in.nowUs)) {
+            // The ring keeps running dry between frames while the amp still
+            // has its queue to play - that's a lead, not an underrun
+            return PLAYBACK_WAIT;
+        }
+        // The amp is playing silence: hold off until the target lead is
+        // rebuilt instead of trickling out whatever arrives next
+        isRebuffering = true;
+        underrunStartUs = in.nowUs;
+        return PLAYBACK_UNDERRUN;
+    }
+
+    if (isRebuffering) {
+        if (in.buffered >= in.targetLead || in.streamFinished) {
+            isRebuffering = false;
+        } else {
+            if (in.nowUs - underrunStartUs > (uint64_t)PLAYBACK_UNDERRUN_TIMEOUT_MS * 1000) {
+                stop();
+                return PLAYBACK_TIMEOUT;
+            }
+            return PLAYBACK_WAIT;
+        }
+    }
+
+    *samples = chunk;
+    return PLAYBACK_WRITE;
+}
+
+void PlaybackControl::onSpeakerWrite(size_t samples, uint64_t nowUs, bool blocked) {
+    if (blocked) {
+        // Returned as soon as a DMA buffer freed up - the queue is full again
+        playedOutUs = nowUs + queueUs;
+        return;
+    }
+    if (playedOutUs < nowUs) {
+        playedOutUs = nowUs;    // Ran dry before this write
+    }
+    playedOutUs += (uint64_t)samples * 1000000ULL / sampleRate;
+}
+
+void PlaybackControl::stop() {
+    isPlaying = false;
+    isRebuffering = false;
+    isDraining = false;
+}
+
+size_t PlaybackControl::speakerQueued(uint64_t nowUs) const {
+    if (playedOutUs <= nowUs) return 0;
+    return (size_t)((playedOutUs - nowUs) * sampleRate / 1000000ULL);
+}
+
+bool PlaybackControl::speakerDrained(uint64_t nowUs) const {
+    return nowUs >= playedOutUs + frameUs;
+}
@@ -0,0 +1,197 @@
+#include "power_manager.h"
+#include "mote_face.h"
+#include "wake_word.h"
+#include "metrics.h"
+#include "audio.h"
+#include <WiFi.h>
+#include <esp_wifi.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#include <esp_idf_version.h>
+#endif
+
+static TaskHandle_t loopTask = nullptr;
+static volatile uint32_t lastActivityMs = 0;
+static VoiceState voiceState = VOICE_DISCONNECTED;
+
+static PowerLevel level = POWER_ACTIVE;
+static uint32_t appliedIdleMhz = 0;
+static bool wifiApplied = false;      // Modem sleep set for this level and connection
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpuLock = nullptr;
+static bool cpuLockHeld = false;
+static bool dfsEnabled = false;
+#endif
+
+static const char* const levelNames[] = {"active", "idle", "standby"};
+
+static const uint16_t loopMs[] = {
+    POWER_ACTIVE_LOOP_MS, POWER_IDLE_LOOP_MS, POWER_STANDBY_LOOP_MS
+};
+
+const char* powerLevelName(PowerLevel level) {
+    if (level > POWER_STANDBY) return "unknown";
+    return levelNames[level];
+}
+
+/**
+ * Idle clock: the KWS network and the Opus encoder need more than 80MHz
+ */
+static uint32_t idleCpuMhz() {
+    if (isLocalWakeActive() || getUplinkCodec() == AUDIO_CODEC_OPUS) {
+        return POWER_BUSY_IDLE_CPU_MHZ;
+    }
+    return POWER_IDLE_CPU_MHZ;
+}
+
+static void applyCpu(bool full, uint32_t idleMhz) {
+#if CONFIG_PM_ENABLE
+    if (dfsEnabled) {
+        // DFS: idle runs at the minimum unless a driver (Wi-Fi) holds a lock
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_pm_config_t config = {};
+#else
+        esp_pm_config_esp32s3_t config = {};
+#endif
+        config.max_freq_mhz = POWER_ACTIVE_CPU_MHZ;
+        config.min_freq_mhz = idleMhz;
+        config.light_sleep_enable = false;
+        esp_pm_configure(&config);
+
+        if (full && !cpuLockHeld) {
+            esp_pm_lock_acquire(cpuLock);
+            cpuLockHeld = true;
+        } else if (!full && cpuLockHeld) {
+            esp_pm_lock_release(cpuLock);
+            cpuLockHeld = false;
+        }
+        return;
+    }
+#endif
+    setCpuFrequencyMhz(full ? POWER_ACTIVE_CPU_MHZ : idleMhz);
+}
+
+/**
+ * Modem sleep for a level. Active keeps the radio awake unless BLE is up
+ * too - coexistence needs modem sleep, so it wakes for every DTIM instead.
+ */
+static void applyWifiSleep() {
+    wifi_ps_type_t mode;
+    switch (level) {
+        case POWER_ACTIVE:
+            mode = btStarted() ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE;
+            break;
+        case POWER_IDLE:
+            mode = WIFI_PS_MIN_MODEM;      // Wake for every DTIM beacon
+            break;
+        default:
+            mode = WIFI_PS_MAX_MODEM;      // Wake every listen interval
+            break;
+    }
+    esp_wifi_set_ps(mode);
+    wifiApplied = true;
+}
+
+static void applyLevel(PowerLevel next, uint32_t idleMhz) {
+    PowerLevel previous = level;
+    level = next;
+
+    applyCpu(next == POWER_ACTIVE, idleMhz);
+    appliedIdleMhz = idleMhz;
+    setCaptureLowLatency(next == POWER_ACTIVE);
+    wifiApplied = false;  // handlePowerManager() sets it once connected
+
+    switch (next) {
+        case POWER_ACTIVE:
+            setFaceBrightness(POWER_ACTIVE_BRIGHTNESS);
+            setFaceFrameInterval(FACE_FRAME_MS);
+            break;
+        case POWER_IDLE:
+            setFaceBrightness(POWER_IDLE_BRIGHTNESS);
+            setFaceFrameInterval(POWER_IDLE_FRAME_MS);
+            break;
+        case POWER_STANDBY:
+            setFaceBrightness(POWER_STANDBY_BRIGHTNESS);
+            setFaceFrameInterval(POWER_STANDBY_FRAME_MS);
+            setFaceState(FACE_SLEEPING);
+            break;
+    }
+
+    // A conversation starting set its own face already
+    if (previous == POWER_STANDBY && next != POWER_STANDBY &&
+        (voiceState == VOICE_IDLE || voiceState == VOICE_DISCONNECTED)) {
+        setFaceState(FACE_IDLE);
+    }
+
+    metricSet(METRIC_POWER_LEVEL, next);
+    metricSet(METRIC_CPU_MHZ, next == POWER_ACTIVE ? POWER_ACTIVE_CPU_MHZ : idleMhz);
+    Serial.printf("[Power] %s -> %s (idle clock %uMHz)\n",
+                  powerLevelName(previous), powerLevelName(next), idleMhz);
+}
+
+void setupPowerManager() {
+    loopTask = xTaskGetCurrentTaskHandle();
+    lastActivityMs = millis();
+
+#if CONFIG_PM_ENABLE
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "mote", &cpuLock) == ESP_OK) {
+        dfsEnabled = true;
+    }
+#endif
+
+    applyLevel(POWER_ACTIVE, idleCpuMhz());
+}
+
+void setPowerVoiceState(VoiceState state) {
+    voiceState = state;
+    lastActivityMs = millis();  // Leaving a conversation holds full power a little longer
+}
+
+void powerWake() {
+    lastActivityMs = millis();
+    if (loopTask != nullptr && xTaskGetCurrentTaskHandle() != loopTask) {
+        xTaskNotifyGive(loopTask);
+    }
+}
+
+void handlePowerManager() {
+    uint32_t quietMs = millis() - lastActivityMs;
+    bool conversation = voiceState == VOICE_LISTENING || voiceState == VOICE_PROCESSING ||
+                        voiceState == VOICE_SPEAKING;
+
+    // Server-side wake needs the mic streamed and its reply on time
+    bool streaming = voiceState == VOICE_IDLE && !isLocalWakeActive();
+
+    PowerLevel next;
+    if (conversation || quietMs < POWER_ACTIVE_HOLD_MS) {
+        next = POWER_ACTIVE;
+    } else if (streaming || quietMs < POWER_ACTIVE_HOLD_MS + POWER_STANDBY_AFTER_MS) {
+        next = POWER_IDLE;
+    } else {
+        next = POWER_STANDBY;
+    }
+
+    uint32_t idleMhz = idleCpuMhz();
+    if (next != level || idleMhz != appliedIdleMhz) {
+        applyLevel(next, idleMhz);
+    }
+
+    // Modem sleep can only be set on a started station; a reconnect resets it
+    bool wifiUp = WiFi.status() == WL_CONNECTED;
+    if (!wifiUp) {
+        wifiApplied = false;
+    } else if (!wifiApplied) {
+        applyWifiSleep();
+    }
+}
+
+void powerIdleDelay() {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(loopMs[level]));
+}
+
+PowerLevel getPowerLevel() {
+    return level;
+}
@@ -0,0 +1,138 @@
+#include "vad.h"
+#include <math.h>
+
+#define VAD_BAND_LOW_HZ     300.0f
+#define VAD_BAND_HIGH_HZ    3400.0f
+#define VAD_FLOOR_FALL      0.2f     // Fraction of the gap closed per frame when quieter
+#define VAD_FLOOR_RISE_MAX  0.05f    // dB per frame (5 dB/s) while not speaking
+#define VAD_FLOOR_CREEP     0.002f   // dB per frame while "speaking" - recovers from a stuck floor
+
+/**
+ * RBJ cookbook 2nd order Butterworth section (Q = 1/sqrt(2))
+ */
+static void designBiquad(float* coeffs, float sampleRate, float cutoff, bool highPass) {
+    const float w0 = 2.0f * (float)M_PI * cutoff / sampleRate;
+    const float alpha = sinf(w0) / (2.0f * 0.70710678f);
+    const float c = cosf(w0);
+    const float a0 = 1.0f + alpha;
+
+    float b0, b1;
+    if (highPass) {
+        b0 = (1.0f + c) / 2.0f;
+        b1 = -(1.0f + c);
+    } else {
+        b0 = (1.0f - c) / 2.0f;
+        b1 = 1.0f - c;
+    }
+    coeffs[0] = b0 / a0;
+    coeffs[1] = b1 / a0;
+    coeffs[2] = b0 / a0;
+    coeffs[3] = -2.0f * c / a0;
+    coeffs[4] = (1.0f - alpha) / a0;
+}
+
+Vad::Vad(uint32_t rate)
+    : sampleRate(rate),
+      frameSamples(rate * VAD_FRAME_MS / 1000),
+      hangoverFrames(VAD_HANGOVER_MS / VAD_FRAME_MS) {
+    float c[5];
+    designBiquad(c, (float)rate, VAD_BAND_LOW_HZ, true);
+    highPass = {c[0], c[1], c[2], c[3], c[4], 0.0f, 0.0f};
+    designBiquad(c, (float)rate, VAD_BAND_HIGH_HZ, false);
+    lowPass = {c[0], c[1], c[2], c[3], c[4], 0.0f, 0.0f};
+    reset();
+}
+
+void Vad::reset() {
+    highPass.z1 = highPass.z2 = 0.0f;
+    lowPass.z1 = lowPass.z2 = 0.0f;
+    frameFill = 0;
+    bandEnergy = 0.0f;
+    crossings = 0;
+    lastSample = 0;
+    noiseFloorDb = 0.0f;
+    initFrames = 0;
+    onsetCount = 0;
+    hangoverLeft = 0;
+    active = false;
+    lastEnergyDb = 0.0f;
+    lastZcr = 0.0f;
+}
+
+inline float Vad::runBiquad(Biquad* f, float x) {
+    // Transposed direct form II
+    float y = f->b0 * x + f->z1;
+    f->z1 = f->b1 * x - f->a1 * y + f->z2;
+    f->z2 = f->b2 * x - f->a2 * y;
+    return y;
+}
+
+bool Vad::process(const int16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int16_t s = samples[i];
+        float y = runBiquad(&lowPass, runBiquad(&highPass, (float)s));
+        bandEnergy += y * y;
+        if ((s ^ lastSample) < 0) crossings++;
+        lastSample = s;
+
+        if (++frameFill == frameSamples) {
+            processFrame();
+        }
+    }
+    return active;
+}
+
+void Vad::processFrame() {
+    float energyDb = 10.0f * log10f(bandEnergy / frameSamples + 1.0f);
+    float zcr = (float)crossings / frameSamples;
+    frameFill = 0;
+    bandEnergy = 0.0f;
+    crossings = 0;
+
+    lastEnergyDb = energyDb;
+    lastZcr = zcr;
+
+    if (initFrames < VAD_INIT_FRAMES) {
+        // Seed the floor with a running mean of the first frames
+        initFrames++;
+        noiseFloorDb += (energyDb - noiseFloorDb) / initFrames;
+        return;
+    }
+
+    float snr = energyDb - noiseFloorDb;
+    bool speechFrame = energyDb > VAD_MIN_ENERGY_DB &&
+                       snr > VAD_SPEECH_MARGIN_DB &&
+                       (zcr < VAD_ZCR_MAX || snr > VAD_STRONG_MARGIN_DB);
+
+    if (speechFrame) {
+        onsetCount++;
+        if (onsetCount >= VAD_ONSET_FRAMES) {
+            active = true;
+            hangoverLeft = hangoverFrames;
+        }
+    } else {
+        onsetCount = 0;
+        if (hangoverLeft > 0) {
+            hangoverLeft--;
+        } else {
+            active = false;
+        }
+    }
+
+    // Track the noise floor: drop fast, rise slowly and mostly between words
+    if (energyDb < noiseFloorDb) {
+        noiseFloorDb += (energyDb - noiseFloorDb) * VAD_FLOOR_FALL;
+    } else if (!speechFrame) {
+        float rise = (energyDb - noiseFloorDb) * 0.05f;
+        noiseFloorDb += rise < VAD_FLOOR_RISE_MAX ? rise : VAD_FLOOR_RISE_MAX;
+    } else {
+        noiseFloorDb += VAD_FLOOR_CREEP;
+    }
+}
+
+void Vad::getStats(VadStats* stats) const {
+    stats->energyDb = lastEnergyDb;
+    stats->noiseFloorDb = noiseFloorDb;
+    stats->zcr = lastZcr;
+    stats->speech = active;
+}
@@ -1,8 +1,22 @@
 #include "voice_client.h"
 #include "audio.h"
+#include "jitter_buffer.h"
+#include "audio_codec.h"
+#include "spsc_ring.h"
+#include "block_ring.h"
+#include "voice_protocol.h"
+#include "iot_executor.h"
+#include "ota_update.h"
+#include "gateway_select.h"
+#include "latency_trace.h"
+#include "metrics.h"
+#include "mote_log.h"
+#include "power_manager.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
 
 // WebSocket client
 static WebSocketsClient webSocket;
@@ -17,13 +31,152 @@ static VoiceStateCallback stateCallback = nullptr;
 static VoiceTranscriptCallback transcriptCallback = nullptr;
 static VoiceAudioCallback audioCallback = nullptr;
 
-// Reconnection
-static unsigned long lastReconnectAttempt = 0;
-static const unsigned long RECONNECT_INTERVAL = 5000;
-
-// Forward declaration
-static void handleIoTRequest(const char* payload, size_t length);
-static void sendIoTResponse(const String& requestId, bool ok, const String& payload, const String& error);
+// Adaptive jitter buffer for TTS playback (fed by WStype_BIN arrivals)
+static JitterBuffer jitterBuffer(AUDIO_SAMPLE_RATE);
+
+// Uplink codec (PCM until the server picks one via voice.config)
+// Compressed audio is encoded on the other core: sendVoiceAudio() feeds PCM in,
+// the encoder task writes length-prefixed packets out, handleVoiceClient() sends them.
+// In the packet ring each packet also carries the PCM ring index of its first
+// sample, which maps it back to a capture time; it isn't sent.
+#define UPLINK_PCM_RING_SIZE      32768  // Samples (2s - room for a full pre-roll batch), power of two
+#define UPLINK_PACKET_RING_SIZE   8192   // Bytes, power of two
+#define UPLINK_PACKET_INDEX_BYTES 4
+#define UPLINK_CAPTURE_STAMPS     16     // sendVoiceAudio() calls remembered (~1s of live audio)
+#define UPLINK_ENCODER_CORE       0      // WebSocket loop runs on core 1
+#define UPLINK_ENCODER_PRIORITY   5
+#ifdef MOTE_CODEC_OPUS
+#define UPLINK_ENCODER_STACK      32768  // libopus is stack hungry
+#else
+#define UPLINK_ENCODER_STACK      4096
+#endif
+
+static volatile AudioCodec uplinkCodec = AUDIO_CODEC_PCM16;
+static volatile AudioCodec pendingUplinkCodec = AUDIO_CODEC_PCM16;
+static volatile bool encoderResetRequested = false;
+static AudioEncoder uplinkEncoder = {};
+static BlockRing<int16_t> uplinkPcmRing;
+static BlockRing<uint8_t> uplinkPacketRing;
+static TaskHandle_t encoderTaskHandle = nullptr;
+static uint32_t uplinkBytesSent = 0;
+
+// PCM ring index -> capture time, loop() only
+struct CaptureStamp {
+    uint32_t index;
+    uint32_t capturedMs;
+};
+
+static CaptureStamp captureStamps[UPLINK_CAPTURE_STAMPS];
+static uint8_t captureStampNext = 0;
+static uint8_t captureStampCount = 0;
+
+// Uplink send scheduler: audio collects in one batch that goes out as a
+// single binary frame (one WebSocket header, one TLS record) once it is as
+// old as the current state allows, or full. With typed framing (opt-in via
+// voice.config) end-of-speech markers ride in the same frames:
+//   [seq u16] then records [type u8][length u16][payload], little-endian
+#define UPLINK_BATCH_BYTES          8192   // Largest binary frame payload
+#define UPLINK_BATCH_IDLE_MS        192    // Server-side wake word scan - 3 mic blocks per frame
+#define UPLINK_BATCH_LISTENING_MS   0      // Command audio goes out right away
+#define UPLINK_BATCH_SPEAKING_MS    128    // Barge-in scan over playback
+#define UPLINK_RECORD_AUDIO         0x01   // Audio in the uplink codec
+#define UPLINK_RECORD_END_OF_SPEECH 0x02   // Replaces voice.silence (no payload)
+#define UPLINK_RECORD_TIMESTAMP     0x03   // u32 capture millis() of the audio record that follows
+#define UPLINK_RECORD_HEADER        3
+#define UPLINK_SEQUENCE_HEADER      2
+
+// Room in front for the WebSocket header, so sendBIN() needs no copy
+static uint8_t batchStorage[WEBSOCKETS_MAX_HEADER_SIZE + UPLINK_BATCH_BYTES];
+static size_t batchUsed = 0;                // Payload bytes
+static int batchAudioRecord = -1;           // Offset of the open audio record (typed framing)
+static unsigned long batchStartedAt = 0;
+static uint32_t batchCapturedMs = 0;       // Capture time of the batch's first audio
+static bool batchHasAudio = false;
+static bool typedFraming = false;
+static uint16_t uplinkSequence = 0;
+static uint16_t batchIntervalMs[VOICE_SPEAKING + 1] = {
+    0, UPLINK_BATCH_IDLE_MS, UPLINK_BATCH_LISTENING_MS, 0, UPLINK_BATCH_SPEAKING_MS
+};
+
+// Downlink codec (PCM until the server picks one via voice.config)
+// WebSocket frames are copied as-is into a compressed byte ring; the decoder
+// task reassembles length-prefixed packets across frame boundaries and decodes
+// just in time, keeping only DOWNLINK_DECODE_LEAD_MS of PCM in the playback ring
+#define DOWNLINK_RING_SIZE        (1u << 19)  // Bytes (~60s ADPCM, minutes of Opus), power of two
+#define DOWNLINK_DECODE_LEAD_MS   2000        // PCM kept ahead of the speaker
+#define DOWNLINK_DECODER_CORE     0
+#define DOWNLINK_DECODER_PRIORITY 6           // Above the uplink encoder - underruns are audible
+#define DOWNLINK_RESET_WAIT_MS    100         // Longest the loop waits for the decoder to let go of playback
+#ifdef MOTE_CODEC_OPUS
+#define DOWNLINK_DECODER_STACK    16384
+#else
+#define DOWNLINK_DECODER_STACK    4096
+#endif
+
+static volatile AudioCodec downlinkCodec = AUDIO_CODEC_PCM16;
+static volatile AudioCodec pendingDownlinkCodec = AUDIO_CODEC_PCM16;
+static volatile bool decoderResetRequested = false;
+static volatile bool decoderClearPlayback = false;
+static volatile bool downlinkEndRequested = false;
+static volatile bool downlinkOverflow = false;
+static volatile bool downlinkMuted = false;     // Barged in locally - ignore the rest of this response
+static AudioDecoder downlinkDecoder = {};
+static BlockRing<uint8_t> downlinkRing;
+static TaskHandle_t decoderTaskHandle = nullptr;
+static uint32_t downlinkBytesReceived = 0;
+
+// Downlink arrival times for the decoder task, keyed by downlink ring index
+#define DOWNLINK_ARRIVAL_STAMPS   32     // Power of two
+
+struct DownlinkArrival {
+    size_t index;
+    uint32_t receivedMs;
+    bool firstOfResponse;
+};
+
+static DownlinkArrival downlinkArrivalStorage[DOWNLINK_ARRIVAL_STAMPS];
+static SpscRing<DownlinkArrival> downlinkArrivals;
+static bool responseFirstFrame = false;     // Next downlink frame starts a response
+
+// Metrics report to the server (device.metrics)
+static unsigned long lastMetricsReport = 0;
+
+// Gateway selection (gateway_select.h): RTT probes, connect attempts, failover
+#define GATEWAY_CONNECT_TIMEOUT_MS  10000   // TCP + TLS + upgrade, then the attempt counts as failed
+#define GATEWAY_PROBE_TIMEOUT_MS    1000    // TCP connect per endpoint
+#define GATEWAY_PROBE_INTERVAL_MS   600000  // Re-rank while connected
+#define GATEWAY_PROBE_CORE          0       // Away from loop()/WebSocket
+#define GATEWAY_PROBE_PRIORITY      1       // Below every audio task
+#define GATEWAY_PROBE_STACK         4096
+
+static GatewaySelector gateways;
+static char gatewayToken[128] = "";
+static int activeGateway = -1;              // Endpoint of the open (or opening) socket
+static bool socketOpen = false;             // webSocket.begin() done, not torn down yet
+static unsigned long attemptStartedAt = 0;
+static bool movingGateway = false;          // Planned close for a faster gateway, not a failure
+static bool rankChanged = false;            // Fresh probe results not yet checked for a move
+
+static GatewayEndpoint probeTargets[GATEWAY_MAX_ENDPOINTS];
+static volatile uint32_t probeResults[GATEWAY_MAX_ENDPOINTS];
+static size_t probeCount = 0;
+static volatile bool probeRunning = false;  // Set by loop(), cleared by the probe task
+static bool probeWanted = false;
+static bool probeApplied = true;
+static uint32_t gatewayGeneration = 0;      // Bumped per configure(); stale probes are dropped
+static uint32_t probeGeneration = 0;
+static unsigned long lastProbeAt = 0;
+static TaskHandle_t probeTaskHandle = nullptr;
+
+// Text frames queued by other tasks (IoT workers), sent from handleVoiceClient()
+#define SEND_QUEUE_DEPTH          16
+
+struct OutgoingFrame {
+    char* data;       // malloc()ed by the producer, freed once sent
+    size_t length;
+};
+
+static QueueHandle_t sendQueue = nullptr;
 
 /**
  * Set voice state and notify callback
@@ -32,6 +185,7 @@ static void setVoiceState(VoiceState newState) {
     if (currentVoiceState != newState) {
         Serial.printf("[Voice] State change: %d -> %d\n", currentVoiceState, newState);
         currentVoiceState = newState;
+        metricSet(METRIC_VOICE_STATE, newState);
         if (stateCallback) {
             stateCallback(newState);
         }
@@ -39,297 +193,759 @@ static void setVoiceState(VoiceState newState) {
 }
 
 /**
- * Parse JSON message from server
- * Simple manual parsing to avoid ArduinoJson dependency
+ * Uplink encoder task - turns PCM frames into length-prefixed codec packets
  */
-static void handleServerMessage(const char* payload, size_t length) {
-    String json = String(payload);
-    Serial.printf("[Voice] Received: %s\n", payload);
-
-    // Extract message type
-    int typeStart = json.indexOf("\"type\":\"") + 8;
-    int typeEnd = json.indexOf("\"", typeStart);
-    if (typeStart < 8 || typeEnd < 0) {
-        Serial.println("[Voice] Failed to parse message type");
-        return;
-    }
-    String msgType = json.substring(typeStart, typeEnd);
-
-    if (msgType == "voice.listening") {
-        // Server detected wake word, now listening for command
-        setVoiceState(VOICE_LISTENING);
-    }
-    else if (msgType == "voice.transcription") {
-        // Extract transcription text
-        int textStart = json.indexOf("\"text\":\"") + 8;
-        int textEnd = json.indexOf("\"", textStart);
-        if (textStart >= 8 && textEnd > textStart) {
-            String text = json.substring(textStart, textEnd);
-            Serial.printf("[Voice] Transcription: %s\n", text.c_str());
-            if (transcriptCallback) {
-                transcriptCallback(text.c_str());
+static void uplinkEncoderTask(void* parameter) {
+    int16_t frame[AUDIO_CODEC_FRAME_SAMPLES];
+    uint8_t packet[2 + UPLINK_PACKET_INDEX_BYTES + AUDIO_CODEC_MAX_PACKET];
+    const size_t header = 2 + UPLINK_PACKET_INDEX_BYTES;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+
+        if (encoderResetRequested) {
+            // Codec change or new session - start the stream cold
+            uplinkPcmRing.discardAll();
+            if (!audioEncoderInit(&uplinkEncoder, pendingUplinkCodec)) {
+                Serial.printf("[Voice] Failed to init %s encoder\n", audioCodecName(pendingUplinkCodec));
             }
+            audioEncoderReset(&uplinkEncoder);
+            encoderResetRequested = false;
         }
-    }
-    else if (msgType == "voice.processing") {
-        // AI is processing the command
-        setVoiceState(VOICE_PROCESSING);
-    }
-    else if (msgType == "voice.response") {
-        // AI response text (before audio)
-        int textStart = json.indexOf("\"text\":\"") + 8;
-        int textEnd = json.indexOf("\"", textStart);
-        if (textStart >= 8 && textEnd > textStart) {
-            String text = json.substring(textStart, textEnd);
-            Serial.printf("[Voice] AI Response: %s\n", text.c_str());
+
+        while (uplinkPcmRing.available() >= AUDIO_CODEC_FRAME_SAMPLES) {
+            uint32_t index = (uint32_t)uplinkPcmRing.readIndex();
+            uplinkPcmRing.read(frame, AUDIO_CODEC_FRAME_SAMPLES);
+
+            size_t len = audioEncoderEncode(&uplinkEncoder, frame, packet + header, AUDIO_CODEC_MAX_PACKET);
+            if (len == 0) {
+                continue;
+            }
+            packet[0] = (uint8_t)(len & 0xFF);
+            packet[1] = (uint8_t)(len >> 8);
+            memcpy(packet + 2, &index, UPLINK_PACKET_INDEX_BYTES);
+
+            // Whole packets only, so the sender never sees a partial one
+            if (!uplinkPacketRing.writeAll(packet, len + header)) {
+                metricAdd(METRIC_UPLINK_PACKET_DROPS);
+            }
         }
-        setVoiceState(VOICE_SPEAKING);
     }
-    else if (msgType == "voice.done") {
-        // Interaction complete, ready for next
-        finishAudioStream();  // Signal that audio stream is complete
-        restartMicrophone();  // Restart microphone I2S for fresh wake word detection
-        setVoiceState(VOICE_IDLE);
+}
+
+/**
+ * Switch uplink codec (called from the WebSocket loop)
+ */
+static void setUplinkCodec(AudioCodec codec) {
+    if (!audioCodecAvailable(codec)) {
+        Serial.printf("[Voice] Uplink codec %s not available, keeping %s\n",
+                      audioCodecName(codec), audioCodecName(uplinkCodec));
+        return;
     }
-    else if (msgType == "voice.interrupt") {
-        // User said wake word while we were speaking - stop playback immediately
-        Serial.println("[Voice] Interrupt received - stopping playback");
-        clearAudioBuffer();   // Stop playback and clear buffer
-        restartMicrophone();  // Restart microphone for fresh capture
-        setVoiceState(VOICE_LISTENING);
-    }
-    else if (msgType == "voice.error") {
-        // Error occurred
-        int errorStart = json.indexOf("\"error\":\"") + 9;
-        int errorEnd = json.indexOf("\"", errorStart);
-        if (errorStart >= 9 && errorEnd > errorStart) {
-            String error = json.substring(errorStart, errorEnd);
-            Serial.printf("[Voice] Error: %s\n", error.c_str());
+
+    if (codec != AUDIO_CODEC_PCM16 && encoderTaskHandle == nullptr) {
+        if (!uplinkPcmRing.init(AUDIO_POOL_PSRAM, UPLINK_PCM_RING_SIZE) ||
+            !uplinkPacketRing.init(AUDIO_POOL_PSRAM, UPLINK_PACKET_RING_SIZE)) {
+            Serial.println("[Voice] Failed to allocate uplink encoder buffers");
+            return;
         }
-        setVoiceState(VOICE_IDLE);
+
+        xTaskCreatePinnedToCore(
+            uplinkEncoderTask,
+            "UplinkEncoder",
+            UPLINK_ENCODER_STACK,
+            nullptr,
+            UPLINK_ENCODER_PRIORITY,
+            &encoderTaskHandle,
+            UPLINK_ENCODER_CORE
+        );
     }
-    else if (msgType == "iot.request") {
-        // IoT command from clawd - handle asynchronously
-        handleIoTRequest(payload, length);
+
+    pendingUplinkCodec = codec;
+    if (encoderTaskHandle != nullptr) {
+        uplinkPacketRing.discardAll();  // Consumer side: drop packets from the old codec
+        encoderResetRequested = true;
+        xTaskNotifyGive(encoderTaskHandle);
     }
+    uplinkCodec = codec;
+
+    Serial.printf("[Voice] Uplink codec: %s\n", audioCodecName(codec));
 }
 
 /**
- * Send IoT response back to server
+ * Send the uplink batch as one binary frame
+ * @return false if it had to be dropped
  */
-static void sendIoTResponse(const String& requestId, bool ok, const String& payload, const String& error) {
-    StaticJsonDocument<1024> doc;
-    doc["type"] = "iot.response";
-    doc["requestId"] = requestId;
-    doc["ok"] = ok;
-
-    if (ok && payload.length() > 0) {
-        // Parse payload as JSON if possible
-        StaticJsonDocument<512> payloadDoc;
-        DeserializationError err = deserializeJson(payloadDoc, payload);
-        if (err) {
-            doc["payload"] = payload; // Send as string if not valid JSON
-        } else {
-            doc["payload"] = payloadDoc;
-        }
+static bool sendUplinkBatch() {
+    if (batchUsed == 0) {
+        return true;
     }
+    size_t length = batchUsed;
+    bool hadAudio = batchHasAudio;
+    batchUsed = 0;
+    batchAudioRecord = -1;
+    batchHasAudio = false;
 
-    if (!ok && error.length() > 0) {
-        doc["error"] = error;
+    if (!wsConnected) {
+        return false;
     }
 
-    String response;
-    serializeJson(doc, response);
-    webSocket.sendTXT(response);
-    Serial.printf("[IoT] Sent response: %s\n", response.c_str());
+    // headerToPayload: the header goes into the reserved room, one write
+    if (!webSocket.sendBIN(batchStorage, length, true)) {
+        LOG_WARN("[Voice] Failed to send audio data\n");
+        metricAdd(METRIC_UPLINK_SEND_FAILURES);
+        return false;
+    }
+    metricAdd(METRIC_UPLINK_FRAMES);
+    if (hadAudio) {
+        latencyRecord(LATENCY_CAPTURE_TO_SEND, millis() - batchCapturedMs);
+    }
+    return true;
 }
 
 /**
- * Handle IoT HTTP request
+ * Make room for `need` more bytes, starting a new batch if required
  */
-static void handleIoTHttp(const String& requestId, JsonObject& params) {
-    String url = params["url"] | "";
-    String method = params["method"] | "GET";
-    String body = params["body"] | "";
+static void reserveUplinkBatch(size_t need) {
+    if (batchUsed + need > UPLINK_BATCH_BYTES) {
+        sendUplinkBatch();
+    }
 
-    if (url.length() == 0) {
-        sendIoTResponse(requestId, false, "", "URL is required");
-        return;
+    if (batchUsed == 0) {
+        batchStartedAt = millis();
+        if (typedFraming) {
+            uint8_t* out = batchStorage + WEBSOCKETS_MAX_HEADER_SIZE;
+            out[0] = (uint8_t)(uplinkSequence & 0xFF);
+            out[1] = (uint8_t)(uplinkSequence >> 8);
+            uplinkSequence++;
+            batchUsed = UPLINK_SEQUENCE_HEADER;
+        }
     }
+}
 
-    Serial.printf("[IoT] HTTP %s %s\n", method.c_str(), url.c_str());
+/**
+ * Add audio to the batch (at most a quarter batch per call)
+ * @param capturedMs Capture time of its first sample
+ */
+static void appendUplinkAudio(const uint8_t* data, size_t length, uint32_t capturedMs) {
+    // Worst case: a timestamp record and a new audio record header
+    reserveUplinkBatch(length + (typedFraming ? 2 * UPLINK_RECORD_HEADER + 4 : 0));
+    uint8_t* out = batchStorage + WEBSOCKETS_MAX_HEADER_SIZE;
+
+    if (!batchHasAudio) {
+        batchCapturedMs = capturedMs;
+        batchHasAudio = true;
+    }
 
-    HTTPClient http;
-    http.begin(url);
-    http.setTimeout(10000); // 10 second timeout
+    if (typedFraming) {
+        if (batchAudioRecord < 0) {
+            out[batchUsed] = UPLINK_RECORD_TIMESTAMP;
+            out[batchUsed + 1] = 4;
+            out[batchUsed + 2] = 0;
+            for (int i = 0; i < 4; i++) {
+                out[batchUsed + UPLINK_RECORD_HEADER + i] = (uint8_t)(capturedMs >> (8 * i));
+            }
+            batchUsed += UPLINK_RECORD_HEADER + 4;
 
-    // Add headers if provided
-    JsonObject headers = params["headers"];
-    if (headers) {
-        for (JsonPair kv : headers) {
-            http.addHeader(kv.key().c_str(), kv.value().as<String>());
+            batchAudioRecord = batchUsed;
+            out[batchUsed] = UPLINK_RECORD_AUDIO;
+            out[batchUsed + 1] = 0;
+            out[batchUsed + 2] = 0;
+            batchUsed += UPLINK_RECORD_HEADER;
         }
+        size_t recordLength = (out[batchAudioRecord + 1] | (out[batchAudioRecord + 2] << 8)) + length;
+        out[batchAudioRecord + 1] = (uint8_t)(recordLength & 0xFF);
+        out[batchAudioRecord + 2] = (uint8_t)(recordLength >> 8);
     }
 
-    int httpCode;
-    if (method == "GET") {
-        httpCode = http.GET();
-    } else if (method == "POST") {
-        if (!headers || !headers.containsKey("Content-Type")) {
-            http.addHeader("Content-Type", "application/json");
-        }
-        httpCode = http.POST(body);
-    } else if (method == "PUT") {
-        if (!headers || !headers.containsKey("Content-Type")) {
-            http.addHeader("Content-Type", "application/json");
+    memcpy(out + batchUsed, data, length);
+    batchUsed += length;
+}
+
+/**
+ * Add an empty marker record (typed framing only)
+ */
+static void appendUplinkMarker(uint8_t type) {
+    reserveUplinkBatch(UPLINK_RECORD_HEADER);
+    uint8_t* out = batchStorage + WEBSOCKETS_MAX_HEADER_SIZE + batchUsed;
+    out[0] = type;
+    out[1] = 0;
+    out[2] = 0;
+    batchUsed += UPLINK_RECORD_HEADER;
+    batchAudioRecord = -1;  // Audio after the marker gets its own record
+}
+
+/**
+ * Send the batch if it has waited as long as the current state allows
+ */
+static void serviceUplinkBatch() {
+    if (batchUsed > 0 && millis() - batchStartedAt >= batchIntervalMs[currentVoiceState]) {
+        sendUplinkBatch();
+    }
+}
+
+/**
+ * Remember when the PCM about to enter the encoder ring was captured
+ */
+static void pushCaptureStamp(uint32_t index, uint32_t capturedMs) {
+    captureStamps[captureStampNext] = {index, capturedMs};
+    captureStampNext = (captureStampNext + 1) % UPLINK_CAPTURE_STAMPS;
+    if (captureStampCount < UPLINK_CAPTURE_STAMPS) captureStampCount++;
+}
+
+/**
+ * Capture time of the PCM sample at an encoder ring index
+ */
+static uint32_t captureTimeAt(uint32_t index) {
+    // Newest stamp at or before the index
+    for (uint8_t i = 1; i <= captureStampCount; i++) {
+        const CaptureStamp& stamp = captureStamps[(captureStampNext + UPLINK_CAPTURE_STAMPS - i) % UPLINK_CAPTURE_STAMPS];
+        int32_t offset = (int32_t)(index - stamp.index);
+        if (offset >= 0) {
+            return stamp.capturedMs + (uint32_t)offset * 1000 / AUDIO_SAMPLE_RATE;
         }
-        httpCode = http.PUT(body);
-    } else if (method == "DELETE") {
-        httpCode = http.sendRequest("DELETE", body);
-    } else {
-        sendIoTResponse(requestId, false, "", "Unsupported HTTP method: " + method);
-        http.end();
+    }
+    return millis();  // Older than anything remembered
+}
+
+/**
+ * Move queued encoder packets into the uplink batch
+ */
+static void flushUplinkPackets() {
+    if (encoderTaskHandle == nullptr) {
+        return;
+    }
+    if (!wsConnected) {
+        uplinkPacketRing.discardAll();
         return;
     }
 
-    if (httpCode > 0) {
-        // Limit response size to prevent memory issues
-        int contentLength = http.getSize();
-        String response;
+    uint8_t packet[2 + AUDIO_CODEC_MAX_PACKET];
+    while (true) {
+        uint8_t header[2 + UPLINK_PACKET_INDEX_BYTES];
+        if (uplinkPacketRing.peek(header, sizeof(header)) < sizeof(header)) break;
+        size_t len = (size_t)header[0] | ((size_t)header[1] << 8);
+        uint32_t index;
+        memcpy(&index, header + 2, UPLINK_PACKET_INDEX_BYTES);
+
+        // Length prefix stays, the ring index doesn't go on the wire
+        uplinkPacketRing.skip(sizeof(header));
+        packet[0] = header[0];
+        packet[1] = header[1];
+        uplinkPacketRing.read(packet + 2, len);
+
+        appendUplinkAudio(packet, 2 + len, captureTimeAt(index));
+        uplinkBytesSent += 2 + len;
+    }
+}
 
-        if (contentLength > 4096) {
-            // Response too large, truncate
-            WiFiClient* stream = http.getStreamPtr();
-            char buffer[4097];
-            int bytesRead = stream->readBytes(buffer, 4096);
-            buffer[bytesRead] = '\0';
-            response = String(buffer) + "... (truncated)";
-            Serial.printf("[IoT] Response truncated from %d bytes\n", contentLength);
-        } else {
-            response = http.getString();
+/**
+ * Peek the next downlink packet
+ * @param len Set to the payload length when a whole packet is buffered
+ * @return 1 if a whole packet is buffered, 0 if more bytes are needed,
+ *         -1 if the stream is corrupt
+ */
+static int peekDownlinkPacket(size_t* len) {
+    uint8_t header[2];
+    if (downlinkRing.peek(header, 2) < 2) return 0;
+
+    *len = (size_t)header[0] | ((size_t)header[1] << 8);
+    if (*len == 0 || *len > AUDIO_CODEC_MAX_RX_PACKET) return -1;
+
+    return downlinkRing.available() >= 2 + *len ? 1 : 0;
+}
+
+/**
+ * Downlink decoder task - turns codec packets into PCM for the playback ring
+ *
+ * In compressed sessions this task is the only producer of the playback ring,
+ * so stream end and interrupts are applied here rather than on the
+ * WebSocket loop, keeping them ordered with the PCM we've already queued.
+ */
+static void downlinkDecoderTask(void* parameter) {
+    static uint8_t packet[AUDIO_CODEC_MAX_RX_PACKET];
+    static int16_t pcm[AUDIO_CODEC_MAX_DECODED];
+    const size_t leadSamples = (size_t)DOWNLINK_DECODE_LEAD_MS * AUDIO_SAMPLE_RATE / 1000;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+
+        if (decoderResetRequested) {
+            // Codec change, new session, or interrupt - start the stream cold
+            downlinkRing.discardAll();
+            downlinkArrivals.discardAll();
+            if (!audioDecoderInit(&downlinkDecoder, pendingDownlinkCodec)) {
+                Serial.printf("[Voice] Failed to init %s decoder\n", audioCodecName(pendingDownlinkCodec));
+            }
+            audioDecoderReset(&downlinkDecoder);
+            if (decoderClearPlayback) {
+                clearPlaybackBuffer();  // Capture ring is loop()'s - stopPlayback() flushed it
+                decoderClearPlayback = false;
+            }
+            downlinkEndRequested = false;
+            decoderResetRequested = false;  // Acknowledge - nothing more goes to playback until new packets
         }
 
-        Serial.printf("[IoT] HTTP response %d: %.100s\n", httpCode, response.c_str());
+        int ready = 0;
+        size_t len = 0;
+        while (!decoderResetRequested) {
+            PlaybackStats playback;
+            getPlaybackStats(&playback);
+            if (playback.buffered >= leadSamples) break;  // Far enough ahead, decode later
+
+            ready = peekDownlinkPacket(&len);
+            if (ready <= 0) break;
+
+            // Does a new frame's arrival time apply from this packet on?
+            size_t packetStart = downlinkRing.readIndex();
+            DownlinkArrival arrival, next;
+            bool arrived = false;
+            while (downlinkArrivals.peek(&next, 1) == 1 && (ptrdiff_t)(packetStart - next.index) >= 0) {
+                downlinkArrivals.skip(1);
+                arrival = next;
+                arrived = true;
+            }
+
+            downlinkRing.skip(2);
+            downlinkRing.read(packet, len);
 
-        // Build response payload with adequate buffer
-        StaticJsonDocument<5120> payload;
-        payload["statusCode"] = httpCode;
-        payload["body"] = response;
+            size_t samples = audioDecoderDecode(&downlinkDecoder, packet, len, pcm, AUDIO_CODEC_MAX_DECODED);
+            if (samples == 0) {
+                metricAdd(METRIC_DOWNLINK_ERRORS);
+                continue;
+            }
+            if (arrived) {
+                markPlaybackArrival(arrival.receivedMs, arrival.firstOfResponse);
+            }
+            if (audioCallback) {
+                audioCallback((const uint8_t*)pcm, samples * sizeof(int16_t));
+            }
+        }
 
-        String payloadStr;
-        serializeJson(payload, payloadStr);
+        if (ready < 0) {
+            // Bad length prefix - nothing after it can be trusted
+            Serial.printf("[Voice] Corrupt downlink packet (len=%d), dropping %d bytes\n",
+                          len, downlinkRing.available());
+            downlinkRing.discardAll();
+            metricAdd(METRIC_DOWNLINK_ERRORS);
+        }
 
-        sendIoTResponse(requestId, httpCode >= 200 && httpCode < 400, payloadStr, "");
-    } else {
-        String error = "HTTP request failed: " + String(http.errorToString(httpCode).c_str());
-        Serial.printf("[IoT] %s\n", error.c_str());
-        sendIoTResponse(requestId, false, "", error);
+        if (downlinkEndRequested && !decoderResetRequested && peekDownlinkPacket(&len) != 1) {
+            // Server is done and every whole packet is decoded; a truncated tail can't be
+            downlinkRing.discardAll();
+            finishAudioStream();
+            downlinkEndRequested = false;
+        }
     }
-
-    http.end();
 }
 
 /**
- * Handle IoT WiFi scan request
+ * Wait for the decoder task to act on a reset request
+ *
+ * Until it does, it may still be writing its backlog into the playback ring,
+ * so the loop mustn't produce PCM there itself (the ring is single-producer).
+ * @return false if it didn't answer within DOWNLINK_RESET_WAIT_MS
  */
-static void handleWifiScan(const String& requestId) {
-    Serial.println("[IoT] Starting WiFi scan...");
+static bool waitForDecoderReset() {
+    unsigned long start = millis();
+    while (decoderResetRequested) {
+        if (millis() - start >= DOWNLINK_RESET_WAIT_MS) {
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return true;
+}
 
-    int n = WiFi.scanNetworks();
+/**
+ * Switch downlink codec (called from the WebSocket loop)
+ * May arrive mid-response (voice.config, or a reconnect); switching back to
+ * PCM waits for the decoder task to stop producing before the loop takes
+ * over the playback ring.
+ */
+static void setDownlinkCodec(AudioCodec codec) {
+    if (!audioCodecAvailable(codec)) {
+        Serial.printf("[Voice] Downlink codec %s not available, keeping %s\n",
+                      audioCodecName(codec), audioCodecName(downlinkCodec));
+        return;
+    }
 
-    StaticJsonDocument<2048> payload;
-    JsonArray networks = payload.createNestedArray("networks");
+    if (codec != AUDIO_CODEC_PCM16 && decoderTaskHandle == nullptr) {
+        downlinkArrivals.init(downlinkArrivalStorage, DOWNLINK_ARRIVAL_STAMPS);
+        if (!downlinkRing.init(AUDIO_POOL_PSRAM, DOWNLINK_RING_SIZE)) {
+            Serial.println("[Voice] Failed to allocate downlink decoder buffer");
+            return;
+        }
 
-    for (int i = 0; i < n && i < 20; i++) { // Limit to 20 networks
-        JsonObject net = networks.createNestedObject();
-        net["ssid"] = WiFi.SSID(i);
-        net["rssi"] = WiFi.RSSI(i);
-        net["channel"] = WiFi.channel(i);
-        net["encryption"] = WiFi.encryptionType(i);
+        xTaskCreatePinnedToCore(
+            downlinkDecoderTask,
+            "DownlinkDecoder",
+            DOWNLINK_DECODER_STACK,
+            nullptr,
+            DOWNLINK_DECODER_PRIORITY,
+            &decoderTaskHandle,
+            DOWNLINK_DECODER_CORE
+        );
     }
 
-    payload["count"] = n;
-
-    String payloadStr;
-    serializeJson(payload, payloadStr);
+    pendingDownlinkCodec = codec;
+    if (decoderTaskHandle != nullptr) {
+        decoderResetRequested = true;
+        xTaskNotifyGive(decoderTaskHandle);
+        if (codec == AUDIO_CODEC_PCM16 && !waitForDecoderReset()) {
+            // WStype_BIN drops PCM frames until the decoder catches up
+            Serial.println("[Voice] Decoder slow to reset - holding PCM downlink");
+        }
+    }
+    downlinkCodec = codec;
+    downlinkOverflow = false;
 
-    Serial.printf("[IoT] Found %d networks\n", n);
-    sendIoTResponse(requestId, true, payloadStr, "");
+    Serial.printf("[Voice] Downlink codec: %s\n", audioCodecName(codec));
+}
 
-    WiFi.scanDelete(); // Clean up scan results
+/**
+ * Whether downlink audio goes through the decoder task
+ */
+static bool isDownlinkCompressed() {
+    return downlinkCodec != AUDIO_CODEC_PCM16 && decoderTaskHandle != nullptr;
 }
 
 /**
- * Handle incoming IoT request from server
+ * Queue one WebSocket frame of compressed downlink audio
  */
-static void handleIoTRequest(const char* payload, size_t length) {
-    StaticJsonDocument<1024> doc;
-    DeserializationError error = deserializeJson(doc, payload, length);
+static void receiveDownlinkFrame(const uint8_t* payload, size_t length, uint32_t receivedMs, bool first) {
+    if (downlinkOverflow) {
+        return;  // Rest of this response is lost, framing can't be recovered mid-stream
+    }
 
-    if (error) {
-        Serial.printf("[IoT] Failed to parse request: %s\n", error.c_str());
+    if (downlinkRing.freeSpace() < length) {
+        Serial.println("[Voice] Downlink ring full, dropping rest of response");
+        downlinkOverflow = true;
+        metricAdd(METRIC_DOWNLINK_ERRORS);
         return;
     }
 
-    String requestId = doc["requestId"] | "";
-    String command = doc["command"] | "";
-    JsonObject params = doc["params"];
+    DownlinkArrival arrival = {downlinkRing.writeIndex(), receivedMs, first};
+    downlinkArrivals.write(&arrival, 1);  // Full: this frame just goes unmeasured
+    if (!downlinkRing.writeAll(payload, length)) {
+        Serial.println("[Voice] Audio pool exhausted, dropping rest of response");
+        downlinkOverflow = true;
+        metricAdd(METRIC_DOWNLINK_ERRORS);
+        return;
+    }
+    downlinkBytesReceived += length;
+    xTaskNotifyGive(decoderTaskHandle);
+}
 
-    Serial.printf("[IoT] Request %s: command=%s\n", requestId.c_str(), command.c_str());
+/**
+ * Close out jitter measurements for the current response and log the result
+ */
+static void finishJitterResponse() {
+    PlaybackStats playback;
+    getPlaybackStats(&playback);
+    jitterBuffer.endResponse(playback.responseUnderruns);
+
+    JitterBufferStats stats;
+    jitterBuffer.getStats(&stats);
+    Serial.printf("[Voice] Jitter buffer: jitter=%ums late=%ums penalty=%ums start=%ums lead=%ums underruns=%u first-audio=%ums\n",
+                  stats.jitterMs, stats.peakLateMs, stats.penaltyMs, stats.startThresholdMs,
+                  stats.targetLeadMs, stats.underruns, playback.lastStartDelayMs);
+
+    // Apply the new picks for the next response
+    setPlaybackStartThreshold(jitterBuffer.startThresholdSamples());
+    setPlaybackTargetLead(jitterBuffer.targetLeadSamples());
+}
+
+/**
+ * Stop TTS playback and drop whatever is queued for it
+ */
+static void stopPlayback() {
+    if (isDownlinkCompressed()) {
+        // Decoder task owns the playback ring and drops it in order with what
+        // it queued; the capture ring is read by this task, so flush it here
+        decoderClearPlayback = true;
+        decoderResetRequested = true;
+        xTaskNotifyGive(decoderTaskHandle);
+        flushCapturedAudio();
+    } else {
+        clearAudioBuffer();   // Stop playback and clear buffer
+    }
+    finishJitterResponse();
+}
 
-    if (requestId.length() == 0) {
-        Serial.println("[IoT] Missing requestId");
+/**
+ * Dispatch one text frame from the server
+ * Parsed once into the protocol arena; strings below point into it and are
+ * only valid until the next frame.
+ */
+static void handleServerMessage(const uint8_t* payload, size_t length) {
+    VoiceMessageType type;
+    JsonVariantConst msg = voiceProtocolParse(payload, length, &type);
+    if (msg.isNull()) {
         return;
     }
 
-    if (command == "iot.http") {
-        handleIoTHttp(requestId, params);
+    // Background transfers shouldn't light the screen or hold the CPU at full clock
+    if (type != VOICE_MSG_OTA_OFFER && type != VOICE_MSG_OTA_CHUNK && type != VOICE_MSG_OTA_CANCEL) {
+        powerWake();
     }
-    else if (command == "wifi.scan") {
-        handleWifiScan(requestId);
+
+    switch (type) {
+        case VOICE_MSG_LISTENING:
+            // Server detected wake word, now listening for command
+            setVoiceState(VOICE_LISTENING);
+            break;
+
+        case VOICE_MSG_TRANSCRIPTION: {
+            const char* text = msg["text"];
+            if (text != nullptr && text[0] != '\0') {
+                Serial.printf("[Voice] Transcription: %s\n", text);
+                if (transcriptCallback) {
+                    transcriptCallback(text);
+                }
+            }
+            break;
+        }
+
+        case VOICE_MSG_PROCESSING:
+            // AI is processing the command
+            setVoiceState(VOICE_PROCESSING);
+            break;
+
+        case VOICE_MSG_RESPONSE: {
+            // AI response text (before audio)
+            const char* text = msg["text"];
+            if (text != nullptr && text[0] != '\0') {
+                Serial.printf("[Voice] AI Response: %s\n", text);
+            }
+            jitterBuffer.beginResponse();  // Audio for this response follows
+            responseFirstFrame = true;
+            downlinkOverflow = false;
+            downlinkMuted = false;
+            setVoiceState(VOICE_SPEAKING);
+            break;
+        }
+
+        case VOICE_MSG_DONE:
+            // Interaction complete, ready for next
+            if (isDownlinkCompressed()) {
+                // Decoder task finishes the stream once the last packet is decoded
+                downlinkEndRequested = true;
+                xTaskNotifyGive(decoderTaskHandle);
+            } else {
+                finishAudioStream();  // Signal that audio stream is complete
+            }
+            finishJitterResponse();
+            restartMicrophone();  // Fresh capture for wake word detection
+            setVoiceState(VOICE_IDLE);
+            break;
+
+        case VOICE_MSG_INTERRUPT:
+            // User said wake word while we were speaking - stop playback immediately
+            Serial.println("[Voice] Interrupt received - stopping playback");
+            stopPlayback();
+            restartMicrophone();  // Fresh capture for the command
+            setVoiceState(VOICE_LISTENING);
+            break;
+
+        case VOICE_MSG_ERROR: {
+            const char* error = msg["error"];
+            if (error != nullptr && error[0] != '\0') {
+                Serial.printf("[Voice] Error: %s\n", error);
+            }
+            setVoiceState(VOICE_IDLE);
+            break;
+        }
+
+        case VOICE_MSG_CONFIG: {
+            // Server picked session options from what we advertised in voice.start
+            AudioCodec codec;
+            const char* name = msg["uplinkCodec"];
+            if (name != nullptr) {
+                if (audioCodecFromName(name, &codec)) {
+                    sendUplinkBatch();  // Don't mix codecs in one frame
+                    setUplinkCodec(codec);
+                } else {
+                    Serial.printf("[Voice] Unknown uplink codec: %s\n", name);
+                }
+            }
+
+            name = msg["downlinkCodec"];
+            if (name != nullptr) {
+                if (audioCodecFromName(name, &codec)) {
+                    setDownlinkCodec(codec);
+                } else {
+                    Serial.printf("[Voice] Unknown downlink codec: %s\n", name);
+                }
+            }
+
+            name = msg["uplinkFraming"];
+            if (name != nullptr) {
+                sendUplinkBatch();  // Already batched audio keeps the old layout
+                typedFraming = strcmp(name, "typed") == 0;
+                Serial.printf("[Voice] Uplink framing: %s\n", typedFraming ? "typed" : "raw");
+            }
+            break;
+        }
+
+        case VOICE_MSG_IOT_REQUEST:
+            // IoT command from clawd - runs on the executor, response comes back via sendQueue
+            submitIotRequest(msg);
+            break;
+
+        case VOICE_MSG_IOT_CANCEL:
+            cancelIotRequest(msg["requestId"]);
+            break;
+
+        case VOICE_MSG_OTA_OFFER:
+        case VOICE_MSG_OTA_CHUNK:
+        case VOICE_MSG_OTA_CANCEL:
+            // Chunks are only buffered here; flash is written from handleVoiceClient()
+            handleOtaMessage(type, msg);
+            break;
+
+        case VOICE_MSG_UNKNOWN:
+            break;  // Newer server - ignore what we don't know
     }
-    else if (command == "iot.discover") {
-        // TODO: Implement mDNS/SSDP discovery
-        sendIoTResponse(requestId, false, "", "iot.discover not yet implemented");
+}
+
+/**
+ * Queue a text frame for the WebSocket (any task)
+ * webSocket isn't thread-safe, so frames from other tasks go out from loop()
+ * @param frame malloc()ed frame, owned by the queue from here on
+ */
+static bool queueTextFrame(char* frame, size_t length, uint32_t waitMs) {
+    OutgoingFrame item = {frame, length};
+    if (sendQueue == nullptr || xQueueSend(sendQueue, &item, pdMS_TO_TICKS(waitMs)) != pdTRUE) {
+        free(frame);
+        return false;
     }
-    else {
-        sendIoTResponse(requestId, false, "", "Unknown command: " + command);
+    return true;
+}
+
+/**
+ * Send (or, while disconnected, drop) queued text frames
+ */
+static void flushSendQueue() {
+    if (sendQueue == nullptr) return;
+
+    OutgoingFrame frame;
+    while (xQueueReceive(sendQueue, &frame, 0) == pdTRUE) {
+        if (wsConnected) {
+            webSocket.sendTXT((uint8_t*)frame.data, frame.length);
+        }
+        free(frame.data);
     }
 }
 
 /**
  * WebSocket event handler
  */
+#ifdef MOTE_WS_TRACE
+/**
+ * Log received frames in the replay harness's trace format (test/README).
+ * Binary frames are logged by length only - the console can't keep up with
+ * the audio itself, and replay fills them with silence.
+ */
+static void traceFrame(WStype_t type, const uint8_t* payload, size_t length) {
+    if (type == WStype_TEXT) {
+        Serial.printf("[WsTrace] %llu T %.*s\n", (unsigned long long)micros(), (int)length, (const char*)payload);
+    } else if (type == WStype_BIN) {
+        Serial.printf("[WsTrace] %llu B %u\n", (unsigned long long)micros(), (unsigned)length);
+    }
+}
+#endif
+
 static void webSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
+#ifdef MOTE_WS_TRACE
+    traceFrame(type, payload, length);
+#endif
     switch (type) {
         case WStype_DISCONNECTED:
             Serial.println("[Voice] WebSocket disconnected");
+            if (wsConnected) {
+                metricAdd(METRIC_WS_DISCONNECTS);
+                if (movingGateway) {
+                    movingGateway = false;
+                } else {
+                    gateways.onDisconnected(activeGateway, millis(), esp_random());
+                }
+            } else if (socketOpen) {
+                // Refused upgrade or TLS failure - no session was established
+                gateways.onFailure(activeGateway, millis(), esp_random());
+            }
+            socketOpen = false;  // serviceGateway() picks the next attempt, not the library
             wsConnected = false;
+            batchUsed = 0;
+            batchAudioRecord = -1;
+            cancelAllIotRequests();  // Their responses have nowhere to go
+            onOtaDisconnected();
             setVoiceState(VOICE_DISCONNECTED);
             break;
 
         case WStype_CONNECTED:
             Serial.printf("[Voice] WebSocket connected to: %s\n", payload);
             wsConnected = true;
+            gateways.onConnected(millis());
+            downlinkMuted = false;
+            typedFraming = false;  // Until the server asks for it
+            uplinkSequence = 0;
+
+            // Every session starts as raw PCM until the server opts into a codec
+            if (uplinkCodec != AUDIO_CODEC_PCM16) {
+                setUplinkCodec(AUDIO_CODEC_PCM16);
+            }
+            if (downlinkCodec != AUDIO_CODEC_PCM16) {
+                setDownlinkCodec(AUDIO_CODEC_PCM16);
+            }
 
-            // Send initial voice.start message
+            // Send initial voice.start message, advertising the codecs we can encode
             {
-                String startMsg = "{\"type\":\"voice.start\",\"deviceId\":\"" + deviceId + "\"}";
+                String startMsg = "{\"type\":\"voice.start\",\"deviceId\":\"" + deviceId + "\",\"uplinkCodecs\":[";
+                if (audioCodecAvailable(AUDIO_CODEC_OPUS)) {
+                    startMsg += "\"opus\",";
+                }
+                startMsg += "\"adpcm\",\"pcm\"],\"downlinkCodecs\":[";
+                if (audioCodecAvailable(AUDIO_CODEC_OPUS)) {
+                    startMsg += "\"opus\",";
+                }
+                startMsg += "\"adpcm\",\"pcm_16000\"],\"uplinkFraming\":[\"typed\",\"raw\"],";
+                startMsg += "\"codecFrameSamples\":" + String(AUDIO_CODEC_FRAME_SAMPLES) + "}";
                 webSocket.sendTXT(startMsg);
                 Serial.println("[Voice] Sent voice.start");
             }
+            onOtaConnected();  // ota.status goes out right behind voice.start
             setVoiceState(VOICE_IDLE);
             break;
 
         case WStype_TEXT:
-            handleServerMessage((const char*)payload, length);
+            metricAdd(METRIC_WS_TEXT_RX);
+            handleServerMessage(payload, length);
             break;
 
         case WStype_BIN:
             // Binary audio data from server (ElevenLabs TTS response)
-            Serial.printf("[Voice] Received %d bytes of audio\n", length);
-            if (audioCallback) {
-                audioCallback(payload, length);
+            metricAdd(METRIC_WS_BINARY_RX);
+            metricAdd(METRIC_WS_BINARY_RX_BYTES, length);
+            if (downlinkMuted) {
+                break;  // Still streaming the response the user talked over
+            }
+            LOG_DEBUG("[Voice] Received %d bytes of audio\n", length);
+            jitterBuffer.onFrame(micros(), audioCodecEstimateSamples(downlinkCodec, length));
+            setPlaybackStartThreshold(jitterBuffer.startThresholdSamples());
+            setPlaybackTargetLead(jitterBuffer.targetLeadSamples());
+            {
+                bool first = responseFirstFrame;
+                responseFirstFrame = false;
+                if (isDownlinkCompressed()) {
+                    receiveDownlinkFrame(payload, length, millis(), first);
+                } else if (decoderTaskHandle != nullptr && decoderResetRequested) {
+                    // Switched to PCM but the decoder may still be writing its backlog
+                    metricAdd(METRIC_DOWNLINK_ERRORS);
+                } else if (audioCallback) {
+                    markPlaybackArrival(millis(), first);
+                    audioCallback(payload, length);
+                }
             }
             break;
 
@@ -338,11 +954,11 @@ static void webSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
             break;
 
         case WStype_PING:
-            Serial.println("[Voice] Ping received");
+            LOG_DEBUG("[Voice] Ping received\n");
             break;
 
         case WStype_PONG:
-            Serial.println("[Voice] Pong received");
+            LOG_DEBUG("[Voice] Pong received\n");
             break;
 
         default:
@@ -350,46 +966,258 @@ static void webSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
     }
 }
 
-bool setupVoiceClient(const char* server, uint16_t port, const char* token) {
-    Serial.println("[Voice] Setting up voice client...");
+/**
+ * TCP connect time to a gateway (DNS excluded) - one round trip
+ */
+static uint32_t probeGateway(const GatewayEndpoint& endpoint) {
+    IPAddress ip;
+    if (!WiFi.hostByName(endpoint.host, ip)) {
+        return GATEWAY_RTT_FAILED;
+    }
 
-    // Store device ID for messages
-    deviceId = WiFi.macAddress();
-    deviceId.replace(":", "");
+    WiFiClient client;
+    unsigned long start = micros();
+    bool reached = client.connect(ip, endpoint.port, GATEWAY_PROBE_TIMEOUT_MS);
+    uint32_t rttMs = (micros() - start + 500) / 1000;
+    client.stop();
+    return reached ? rttMs : GATEWAY_RTT_FAILED;
+}
+
+/**
+ * Probe task - blocking connects stay off loop()
+ */
+static void gatewayProbeTask(void* parameter) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (size_t i = 0; i < probeCount; i++) {
+            probeResults[i] = probeGateway(probeTargets[i]);
+        }
+        probeRunning = false;
+    }
+}
+
+static void startGatewayProbe() {
+    probeWanted = false;
+    if (probeTaskHandle == nullptr || gateways.count() < 2) {
+        return;  // One gateway - nothing to rank
+    }
 
-    // Build WebSocket path with token
-    String path = "/ws/voice?token=" + String(token);
+    probeCount = gateways.count();
+    for (size_t i = 0; i < probeCount; i++) {
+        probeTargets[i] = gateways.endpoint(i);
+    }
+    probeGeneration = gatewayGeneration;
+    probeApplied = false;
+    probeRunning = true;
+    lastProbeAt = millis();
+    xTaskNotifyGive(probeTaskHandle);
+}
 
-    // Check if server is a local/private IP (no SSL needed)
-    String serverStr = String(server);
-    bool isLocalNetwork = serverStr.startsWith("10.") ||
-                          serverStr.startsWith("192.168.") ||
-                          serverStr.startsWith("172.") ||
-                          serverStr.startsWith("127.") ||
-                          serverStr.equals("localhost");
+static void applyGatewayProbe() {
+    if (probeApplied || probeRunning) {
+        return;
+    }
+    probeApplied = true;
+    if (probeGeneration != gatewayGeneration) {
+        return;  // Probed the list before the last reconfigure
+    }
 
-    if (isLocalNetwork) {
-        Serial.printf("[Voice] Connecting to ws://%s:%d%s (no SSL - local network)\n", server, port, path.c_str());
-        webSocket.begin(server, port, path.c_str());
+    for (size_t i = 0; i < probeCount; i++) {
+        gateways.setRtt(i, probeResults[i]);
+        const GatewayEndpoint& endpoint = gateways.endpoint(i);
+        if (probeResults[i] == GATEWAY_RTT_FAILED) {
+            Serial.printf("[Voice] Gateway %s:%u unreachable\n", endpoint.host, endpoint.port);
+        } else {
+            Serial.printf("[Voice] Gateway %s:%u RTT %ums\n", endpoint.host, endpoint.port, (unsigned)probeResults[i]);
+        }
+    }
+    rankChanged = true;
+}
+
+/**
+ * Point the WebSocket at a gateway (connects from the next webSocket.loop())
+ */
+static void openGateway(int index) {
+    const GatewayEndpoint& endpoint = gateways.endpoint(index);
+    String path = "/ws/voice?token=" + String(gatewayToken);
+
+    if (endpoint.tls) {
+        Serial.printf("[Voice] Connecting to wss://%s:%u%s (SSL)\n", endpoint.host, endpoint.port, path.c_str());
+        webSocket.beginSSL(endpoint.host, endpoint.port, path.c_str());
     } else {
-        Serial.printf("[Voice] Connecting to wss://%s:%d%s (SSL)\n", server, port, path.c_str());
-        webSocket.beginSSL(server, port, path.c_str());
+        Serial.printf("[Voice] Connecting to ws://%s:%u%s (no SSL)\n", endpoint.host, endpoint.port, path.c_str());
+        webSocket.begin(endpoint.host, endpoint.port, path.c_str());
+    }
+
+    activeGateway = index;
+    socketOpen = true;
+    attemptStartedAt = millis();
+}
+
+/**
+ * Tear the socket down - the caller has already accounted for the failure,
+ * so a half-open attempt isn't penalised twice by the event handler
+ */
+static void closeGatewaySocket() {
+    bool wasOpen = socketOpen;
+    socketOpen = false;
+    if (wasOpen) {
+        webSocket.disconnect();  // Fires WStype_DISCONNECTED if a session was up
+    }
+    wsConnected = false;
+}
+
+/**
+ * Replace the endpoint list and connect again from scratch
+ */
+static void configureGateways(const char* server, uint16_t port, const char* gatewayList, const char* token) {
+    strncpy(gatewayToken, token, sizeof(gatewayToken) - 1);
+    gatewayToken[sizeof(gatewayToken) - 1] = '\0';
+
+    size_t count = gateways.configure(server, port, gatewayList);
+    gatewayGeneration++;
+    activeGateway = -1;
+    rankChanged = false;
+    probeWanted = count > 1;
+    Serial.printf("[Voice] %u gateway%s configured\n", (unsigned)count, count == 1 ? "" : "s");
+}
+
+/**
+ * Connection management: rank by RTT, open the best endpoint out of backoff,
+ * fail over when an attempt stalls, move an idle session to a faster gateway
+ */
+static void serviceGateway() {
+    if (gateways.count() == 0) {
+        return;
+    }
+    applyGatewayProbe();
+    unsigned long now = millis();
+
+    if (wsConnected) {
+        if (gateways.count() > 1 && now - lastProbeAt >= GATEWAY_PROBE_INTERVAL_MS) {
+            probeWanted = true;
+        }
+        if (probeWanted && !probeRunning) {
+            startGatewayProbe();
+        }
+
+        // Only between conversations - the move drops the session
+        if (rankChanged && currentVoiceState == VOICE_IDLE) {
+            rankChanged = false;
+            int faster = gateways.fasterThan(activeGateway, now);
+            if (faster >= 0) {
+                Serial.printf("[Voice] Moving to faster gateway %s (%ums vs %ums)\n", gateways.endpoint(faster).host,
+                              (unsigned)gateways.rtt(faster), (unsigned)gateways.rtt(activeGateway));
+                movingGateway = true;
+                closeGatewaySocket();
+                openGateway(faster);
+            }
+        }
+        return;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) {
+        return;  // Attempts would only fail and run up the backoff
+    }
+
+    if (socketOpen) {
+        if (now - attemptStartedAt < GATEWAY_CONNECT_TIMEOUT_MS) {
+            return;
+        }
+        const GatewayEndpoint& endpoint = gateways.endpoint(activeGateway);
+        Serial.printf("[Voice] No session with %s:%u - trying again\n", endpoint.host, endpoint.port);
+        gateways.onFailure(activeGateway, now, esp_random());
+        closeGatewaySocket();
     }
 
+    // Rank before connecting, so the first session already lands on the fastest gateway
+    if (probeWanted && !probeRunning) {
+        startGatewayProbe();
+    }
+    if (probeRunning) {
+        return;
+    }
+
+    int next = gateways.select(now);
+    if (next >= 0) {
+        openGateway(next);
+    }
+}
+
+bool setupVoiceClient(const char* server, uint16_t port, const char* gatewayList, const char* token) {
+    Serial.println("[Voice] Setting up voice client...");
+
+    // Store device ID for messages
+    deviceId = WiFi.macAddress();
+    deviceId.replace(":", "");
+
     webSocket.onEvent(webSocketEvent);
 
-    // Set reconnect interval
-    webSocket.setReconnectInterval(RECONNECT_INTERVAL);
+    // IoT commands run off the WebSocket loop and answer through the send queue
+    if (sendQueue == nullptr) {
+        sendQueue = xQueueCreate(SEND_QUEUE_DEPTH, sizeof(OutgoingFrame));
+    }
+    setupIotExecutor(queueTextFrame);
+    setupOtaUpdate(queueTextFrame);
+
+    if (probeTaskHandle == nullptr) {
+        xTaskCreatePinnedToCore(
+            gatewayProbeTask,
+            "GwProbe",
+            GATEWAY_PROBE_STACK,
+            nullptr,
+            GATEWAY_PROBE_PRIORITY,
+            &probeTaskHandle,
+            GATEWAY_PROBE_CORE
+        );
+    }
+
+    // One library attempt per openGateway(); retries and failover are serviceGateway()'s
+    webSocket.setReconnectInterval(GATEWAY_CONNECT_TIMEOUT_MS);
 
     // Enable heartbeat for connection keep-alive
     webSocket.enableHeartbeat(15000, 3000, 2);
 
+    configureGateways(server, port, gatewayList, token);
+    if (gateways.count() == 0) {
+        Serial.printf("[Voice] No valid gateway in \"%s\"\n", server);
+        return false;
+    }
+
     Serial.println("[Voice] Voice client setup complete");
     return true;
 }
 
+/**
+ * Send the device.metrics report every METRICS_REPORT_MS
+ */
+static void reportMetrics() {
+    if (!wsConnected || millis() - lastMetricsReport < METRICS_REPORT_MS) {
+        return;
+    }
+    lastMetricsReport = millis();
+
+    JsonDocument doc;
+    buildMetricsReport(doc, true);
+
+    String report;
+    serializeJson(doc, report);
+    webSocket.sendTXT(report);
+    LOG_DEBUG("[Metrics] %s\n", report.c_str());
+}
+
 void handleVoiceClient() {
-    webSocket.loop();
+    serviceGateway();
+    if (socketOpen) {
+        webSocket.loop();
+    }
+    flushUplinkPackets();
+    serviceUplinkBatch();
+    handleOtaUpdate(currentVoiceState == VOICE_LISTENING ||
+                    currentVoiceState == VOICE_PROCESSING ||
+                    currentVoiceState == VOICE_SPEAKING);
+    flushSendQueue();
+    reportMetrics();
 }
 
 bool isVoiceConnected() {
@@ -400,14 +1228,9 @@ VoiceState getVoiceState() {
     return currentVoiceState;
 }
 
-bool sendVoiceAudio(const int16_t* samples, size_t count) {
+bool sendVoiceAudio(const int16_t* samples, size_t count, uint32_t capturedMs) {
     if (!wsConnected) {
-        // Debug: Log why audio isn't being sent
-        static unsigned long lastWsLog = 0;
-        if (millis() - lastWsLog > 5000) {
-            Serial.println("[Voice] Cannot send audio: WebSocket not connected");
-            lastWsLog = millis();
-        }
+        LOG_DEBUG_EVERY(5000, "[Voice] Cannot send audio: WebSocket not connected\n");
         return false;
     }
 
@@ -419,15 +1242,26 @@ bool sendVoiceAudio(const int16_t* samples, size_t count) {
         return false;
     }
 
-    // Send binary PCM data
-    size_t bytes = count * sizeof(int16_t);
-    bool sent = webSocket.sendBIN((const uint8_t*)samples, bytes);
-
-    if (!sent) {
-        Serial.println("[Voice] Failed to send audio data");
+    if (uplinkCodec != AUDIO_CODEC_PCM16 && encoderTaskHandle != nullptr) {
+        // Hand off to the encoder core - packets go out from handleVoiceClient()
+        pushCaptureStamp((uint32_t)uplinkPcmRing.writeIndex(), capturedMs);
+        size_t queued = uplinkPcmRing.write(samples, count);
+        xTaskNotifyGive(encoderTaskHandle);
+        if (queued < count) {
+            Serial.println("[Voice] Uplink encoder backlog, dropping audio");
+        }
+        return queued == count;
     }
 
-    return sent;
+    // Binary PCM goes out with the next batch, in whole samples
+    const size_t chunkSamples = UPLINK_BATCH_BYTES / 4 / sizeof(int16_t);
+    for (size_t i = 0; i < count; i += chunkSamples) {
+        size_t n = min(count - i, chunkSamples);
+        appendUplinkAudio((const uint8_t*)(samples + i), n * sizeof(int16_t),
+                          capturedMs + (uint32_t)(i * 1000 / AUDIO_SAMPLE_RATE));
+    }
+    serviceUplinkBatch();
+    return true;
 }
 
 void sendVoiceSilence() {
@@ -435,18 +1269,89 @@ void sendVoiceSilence() {
         return;
     }
 
+    // End of speech is what the server waits on - no batching delay
+    if (typedFraming) {
+        appendUplinkMarker(UPLINK_RECORD_END_OF_SPEECH);
+        sendUplinkBatch();
+        return;
+    }
+
+    sendUplinkBatch();  // Audio before it has to arrive first
     String silenceMsg = "{\"type\":\"voice.silence\"}";
     webSocket.sendTXT(silenceMsg);
     // Don't log every silence message to avoid spam
 }
 
+void sendVoiceWake(float score) {
+    if (!wsConnected) {
+        return;
+    }
+
+    sendUplinkBatch();
+    String wakeMsg = "{\"type\":\"voice.wake\",\"source\":\"local\",\"score\":" + String(score, 2) + "}";
+    webSocket.sendTXT(wakeMsg);
+    Serial.println("[Voice] Sent voice.wake");
+}
+
+void interruptVoicePlayback() {
+    if (currentVoiceState != VOICE_SPEAKING) {
+        return;
+    }
+    Serial.println("[Voice] Local barge-in - stopping playback");
+    downlinkMuted = true;
+    stopPlayback();
+}
+
 void disconnectVoice() {
     Serial.println("[Voice] Disconnecting...");
-    webSocket.disconnect();
-    wsConnected = false;
+    movingGateway = true;  // Not the gateway's fault
+    closeGatewaySocket();
+    movingGateway = false;
+    gateways.configure(nullptr, 0, nullptr);  // Stay down until reconnectVoiceClient()
+    gatewayGeneration++;
     setVoiceState(VOICE_DISCONNECTED);
 }
 
+void reconnectVoiceClient(const char* server, uint16_t port, const char* gatewayList, const char* token) {
+    Serial.println("[Voice] Gateway changed - reconnecting");
+    disconnectVoice();
+    configureGateways(server, port, gatewayList, token);
+}
+
+AudioCodec getUplinkCodec() {
+    return uplinkCodec;
+}
+
+uint32_t getUplinkBytesSent() {
+    return uplinkBytesSent;
+}
+
+uint32_t getUplinkFramesSent() {
+    return metricGet(METRIC_UPLINK_FRAMES);
+}
+
+void setUplinkBatchInterval(VoiceState state, uint16_t ms) {
+    if (state <= VOICE_SPEAKING) {
+        batchIntervalMs[state] = ms;
+    }
+}
+
+AudioCodec getDownlinkCodec() {
+    return downlinkCodec;
+}
+
+uint32_t getDownlinkBytesReceived() {
+    return downlinkBytesReceived;
+}
+
+uint32_t getDownlinkErrors() {
+    return metricGet(METRIC_DOWNLINK_ERRORS);
+}
+
+void getVoiceJitterStats(JitterBufferStats* stats) {
+    jitterBuffer.getStats(stats);
+}
+
 void setVoiceStateCallback(VoiceStateCallback callback) {
     stateCallback = callback;
 }
@@ -0,0 +1,178 @@
+#include "voice_protocol.h"
+#include <Arduino.h>
+#include <string.h>
+
+#define ARENA_ALIGN   8   // Slots hold doubles/int64
+
+/**
+ * Bump allocator over a fixed buffer for ArduinoJson
+ *
+ * Every block carries its size in a header so the newest block can grow or
+ * shrink in place (the string builder and the slot pool both reallocate as
+ * they fill). Freeing is a no-op except for the newest block; the whole
+ * arena is rewound with reset() once the document is cleared.
+ */
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    JsonArena(uint8_t* buffer, size_t size) : buffer(buffer), size(size), used(0), last(nullptr), peak(0) {}
+
+    void* allocate(size_t n) override {
+        size_t total = HEADER + align(n);
+        if (total > size - used) return nullptr;  // Document reports NoMemory
+
+        uint8_t* block = buffer + used;
+        *(size_t*)block = n;
+        used += total;
+        last = block + HEADER;
+        if (used > peak) peak = used;
+        return last;
+    }
+
+    void deallocate(void* ptr) override {
+        if (ptr != nullptr && ptr == last) {
+            used = (uint8_t*)ptr - HEADER - buffer;
+            last = nullptr;
+        }
+    }
+
+    void* reallocate(void* ptr, size_t n) override {
+        if (ptr == nullptr) return allocate(n);
+
+        uint8_t* data = (uint8_t*)ptr;
+        size_t* header = (size_t*)(data - HEADER);
+
+        if (ptr == last) {
+            size_t start = data - buffer;
+            if (align(n) > size - start) return nullptr;
+            used = start + align(n);
+            *header = n;
+            if (used > peak) peak = used;
+            return ptr;
+        }
+
+        if (n <= *header) return ptr;  // Shrinking an older block - keep it where it is
+
+        void* moved = allocate(n);
+        if (moved != nullptr) memcpy(moved, ptr, *header);
+        return moved;
+    }
+
+    void reset() {
+        used = 0;
+        last = nullptr;
+    }
+
+    size_t peakUsed() const { return peak; }
+
+private:
+    static const size_t HEADER = ARENA_ALIGN;
+
+    static size_t align(size_t n) {
+        return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    }
+
+    uint8_t* buffer;
+    size_t size;
+    size_t used;
+    uint8_t* last;   // Data of the newest block
+    size_t peak;
+};
+
+alignas(ARENA_ALIGN) static uint8_t messageStorage[VOICE_JSON_ARENA_SIZE];
+alignas(ARENA_ALIGN) static uint8_t filterStorage[1024];
+static JsonArena messageArena(messageStorage, sizeof(messageStorage));
+static JsonArena filterArena(filterStorage, sizeof(filterStorage));
+static JsonDocument messageDoc(&messageArena);
+static JsonDocument filterDoc(&filterArena);
+static bool filterReady = false;
+
+struct MessageName {
+    const char* name;
+    VoiceMessageType type;
+};
+
+static const MessageName messageNames[] = {
+    {"voice.listening", VOICE_MSG_LISTENING},
+    {"voice.transcription", VOICE_MSG_TRANSCRIPTION},
+    {"voice.processing", VOICE_MSG_PROCESSING},
+    {"voice.response", VOICE_MSG_RESPONSE},
+    {"voice.done", VOICE_MSG_DONE},
+    {"voice.interrupt", VOICE_MSG_INTERRUPT},
+    {"voice.error", VOICE_MSG_ERROR},
+    {"voice.config", VOICE_MSG_CONFIG},
+    {"iot.request", VOICE_MSG_IOT_REQUEST},
+    {"iot.cancel", VOICE_MSG_IOT_CANCEL},
+    {"ota.offer", VOICE_MSG_OTA_OFFER},
+    {"ota.chunk", VOICE_MSG_OTA_CHUNK},
+    {"ota.cancel", VOICE_MSG_OTA_CANCEL},
+};
+
+VoiceMessageType voiceMessageTypeFromName(const char* name) {
+    if (name == nullptr) return VOICE_MSG_UNKNOWN;
+
+    for (size_t i = 0; i < sizeof(messageNames) / sizeof(messageNames[0]); i++) {
+        if (strcmp(name, messageNames[i].name) == 0) {
+            return messageNames[i].type;
+        }
+    }
+    return VOICE_MSG_UNKNOWN;
+}
+
+const char* voiceMessageTypeName(VoiceMessageType type) {
+    for (size_t i = 0; i < sizeof(messageNames) / sizeof(messageNames[0]); i++) {
+        if (messageNames[i].type == type) {
+            return messageNames[i].name;
+        }
+    }
+    return "unknown";
+}
+
+/**
+ * Fields any handler reads - everything else is skipped while parsing
+ */
+static void buildFilter() {
+    filterDoc["type"] = true;
+    filterDoc["text"] = true;
+    filterDoc["error"] = true;
+    filterDoc["uplinkCodec"] = true;
+    filterDoc["downlinkCodec"] = true;
+    filterDoc["uplinkFraming"] = true;
+    filterDoc["requestId"] = true;
+    filterDoc["command"] = true;
+    filterDoc["params"] = true;
+    filterDoc["target"] = true;
+    filterDoc["version"] = true;
+    filterDoc["size"] = true;
+    filterDoc["sha256"] = true;
+    filterDoc["offset"] = true;
+    filterDoc["data"] = true;
+    filterReady = true;
+}
+
+JsonVariantConst voiceProtocolParse(const uint8_t* payload, size_t length, VoiceMessageType* type) {
+    *type = VOICE_MSG_UNKNOWN;
+    if (!filterReady) buildFilter();
+
+    // Previous message is done with - give its arena back
+    messageDoc.clear();
+    messageArena.reset();
+
+    DeserializationError err = deserializeJson(messageDoc, (const char*)payload, length,
+                                               DeserializationOption::Filter(filterDoc),
+                                               DeserializationOption::NestingLimit(VOICE_JSON_NESTING_LIMIT));
+    if (err) {
+        if (err.code() == DeserializationError::NoMemory) {
+            Serial.printf("[Voice] Message too large for parse arena (%u bytes)\n", (unsigned)length);
+        } else {
+            Serial.printf("[Voice] Failed to parse message: %s\n", err.c_str());
+        }
+        return JsonVariantConst();
+    }
+
+    *type = voiceMessageTypeFromName(messageDoc["type"].as<const char*>());
+    return messageDoc.as<JsonVariantConst>();
+}
+
+size_t voiceProtocolArenaPeak() {
+    return messageArena.peakUsed();
+}
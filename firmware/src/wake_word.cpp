@@ -0,0 +1,310 @@
+#include "wake_word.h"
+#include "kws.h"
+#include "block_ring.h"
+#include "power_manager.h"
+#include <esp_partition.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static KwsFrontend frontend;
+static KwsModel model;
+static KwsDetector detector(WAKE_THRESHOLD, WAKE_SMOOTHING, WAKE_REFRACTORY);
+static int8_t* arena = nullptr;
+static size_t arenaSize = 0;
+
+static WakeMode wakeMode = WAKE_MODE_SERVER;
+static volatile bool modelReady = false;
+static volatile bool resetRequested = false;
+static volatile bool triggerPending = false;
+static volatile float triggerScore = 0.0f;
+
+static BlockRing<int16_t> wakeRing;
+static TaskHandle_t wakeTaskHandle = nullptr;
+
+static volatile uint32_t inferences = 0;
+static volatile uint32_t detections = 0;
+static volatile uint32_t lastInferenceUs = 0;
+static volatile uint32_t maxInferenceUs = 0;
+static volatile uint32_t droppedSamples = 0;
+static volatile float lastScore = 0.0f;
+
+// A/B model slots - the bound model's weights live in the mapping below
+static const char* const modelSlots[2] = {WAKE_MODEL_PARTITION, WAKE_MODEL_PARTITION_B};
+static uint8_t activeSlot = 0;
+static spi_flash_mmap_handle_t modelMapping;
+static bool modelMapped = false;
+
+/**
+ * KWS task - MFCC frontend every 20ms, network every WAKE_INFERENCE_STRIDE frames
+ */
+static void wakeWordTask(void* parameter) {
+    int16_t hop[KWS_FRAME_HOP];
+    int8_t input[KWS_WINDOW_FRAMES * KWS_MFCC_COEFFS];
+    uint32_t framesSinceInference = 0;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+        if (resetRequested) {
+            wakeRing.discardAll();
+            frontend.reset();
+            detector.reset();
+            framesSinceInference = 0;
+            resetRequested = false;
+        }
+
+        while (wakeRing.available() >= KWS_FRAME_HOP) {
+            wakeRing.read(hop, KWS_FRAME_HOP);
+            framesSinceInference += frontend.push(hop, KWS_FRAME_HOP);
+
+            // Wait for a full window so startup silence can't look like speech
+            if (!modelReady || frontend.frameCount() < KWS_WINDOW_FRAMES ||
+                framesSinceInference < WAKE_INFERENCE_STRIDE) {
+                continue;
+            }
+            framesSinceInference = 0;
+
+            int64_t start = esp_timer_get_time();
+            frontend.window(input, model.inputScale(), model.inputZeroPoint());
+            float score = model.run(input, arena);
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+            lastInferenceUs = elapsed;
+            if (elapsed > maxInferenceUs) maxInferenceUs = elapsed;
+            inferences++;
+
+            if (detector.update(score)) {
+                detections++;
+                triggerScore = detector.smoothedScore();
+                triggerPending = true;
+                powerWake();  // loop() may be asleep for a while
+                Serial.printf("[Wake] Keyword detected (score=%.2f, %uus/inference)\n",
+                              detector.smoothedScore(), elapsed);
+            }
+            lastScore = detector.smoothedScore();
+        }
+    }
+}
+
+bool loadWakeWordModel(const uint8_t* blob, size_t length) {
+    modelReady = false;
+
+    KwsModel candidate;
+    if (!candidate.load(blob, length)) {
+        Serial.println("[Wake] Invalid KWS model");
+        return false;
+    }
+
+    // Activations are touched on every MAC - keep them in internal RAM
+    size_t needed = candidate.arenaBytes();
+    if (needed > arenaSize) {
+        if (arena != nullptr) heap_caps_free(arena);
+        arena = (int8_t*)heap_caps_malloc(needed, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        arenaSize = arena ? needed : 0;
+        if (arena == nullptr) {
+            Serial.printf("[Wake] Failed to allocate %d byte KWS arena\n", needed);
+            return false;
+        }
+    }
+
+    model.load(blob, length);
+    resetRequested = true;
+    modelReady = true;
+    Serial.printf("[Wake] KWS model loaded (%d bytes, arena %d bytes)\n", length, needed);
+    return true;
+}
+
+static uint8_t loadModelSlot() {
+    Preferences prefs;
+    prefs.begin("mote", true);
+    uint8_t slot = prefs.getUChar("kws_slot", 0);
+    prefs.end();
+    return slot > 1 ? 0 : slot;
+}
+
+static void saveModelSlot(uint8_t slot) {
+    Preferences prefs;
+    prefs.begin("mote", false);
+    prefs.putUChar("kws_slot", slot);
+    prefs.end();
+}
+
+/**
+ * Map a model slot so the weights are read straight from flash cache
+ */
+static bool mapModelSlot(uint8_t slot, const uint8_t** blob, size_t* length, spi_flash_mmap_handle_t* handle) {
+    const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, modelSlots[slot]);
+    if (partition == nullptr) {
+        return false;
+    }
+
+    const void* mapped = nullptr;
+    if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &mapped, handle) != ESP_OK) {
+        Serial.printf("[Wake] Failed to map KWS model partition %s\n", modelSlots[slot]);
+        return false;
+    }
+    *blob = (const uint8_t*)mapped;
+    *length = partition->size;
+    return true;
+}
+
+/**
+ * Map a slot and bind its model (boot only - the task isn't running inference)
+ */
+static bool bindModelSlot(uint8_t slot) {
+    const uint8_t* blob;
+    size_t length;
+    spi_flash_mmap_handle_t handle;
+    if (!mapModelSlot(slot, &blob, &length, &handle)) {
+        return false;
+    }
+
+    if (!loadWakeWordModel(blob, length)) {
+        spi_flash_munmap(handle);
+        return false;
+    }
+    if (modelMapped) spi_flash_munmap(modelMapping);
+    modelMapping = handle;
+    modelMapped = true;
+    activeSlot = slot;
+    return true;
+}
+
+bool setupWakeWord() {
+    if (wakeTaskHandle == nullptr) {
+        if (!wakeRing.init(AUDIO_POOL_INTERNAL, WAKE_RING_SIZE)) {
+            Serial.println("[Wake] Failed to allocate KWS ring");
+            return false;
+        }
+
+        xTaskCreatePinnedToCore(
+            wakeWordTask,
+            "WakeWord",
+            WAKE_TASK_STACK,
+            nullptr,
+            WAKE_TASK_PRIORITY,
+            &wakeTaskHandle,
+            WAKE_TASK_CORE
+        );
+    }
+
+    activeSlot = loadModelSlot();
+    if (bindModelSlot(activeSlot)) {
+        return true;
+    }
+
+    // Active slot empty or bad (e.g. flashed over USB) - the other may still hold one
+    if (bindModelSlot(activeSlot ^ 1)) {
+        Serial.printf("[Wake] Using KWS model from %s\n", modelSlots[activeSlot]);
+        return true;
+    }
+
+    if (esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, WAKE_MODEL_PARTITION) == nullptr) {
+        Serial.println("[Wake] No KWS model partition - using server wake word");
+    }
+    return false;
+}
+
+const char* getWakeModelStandbyPartition() {
+    return modelSlots[activeSlot ^ 1];
+}
+
+const char* getWakeModelActivePartition() {
+    return modelSlots[activeSlot];
+}
+
+bool activateWakeWordModel(const char* label, bool* deferred) {
+    *deferred = false;
+    uint8_t slot = strcmp(label, modelSlots[1]) == 0 ? 1 : 0;
+
+    const uint8_t* blob;
+    size_t length;
+    spi_flash_mmap_handle_t handle;
+    if (!mapModelSlot(slot, &blob, &length, &handle)) {
+        return false;
+    }
+
+    // Check the blob before the running model is touched
+    KwsModel candidate;
+    if (!candidate.load(blob, length)) {
+        Serial.printf("[Wake] Invalid KWS model in %s\n", label);
+        spi_flash_munmap(handle);
+        return false;
+    }
+
+    saveModelSlot(slot);
+
+    // The KWS task may be mid-inference on the old weights; they stay the
+    // active slot (never an OTA target) until the reboot
+    if (isLocalWakeActive()) {
+        spi_flash_munmap(handle);
+        *deferred = true;
+        Serial.printf("[Wake] KWS model in %s loads at next boot\n", label);
+        return true;
+    }
+
+    if (!loadWakeWordModel(blob, length)) {
+        spi_flash_munmap(handle);
+        return false;
+    }
+    if (modelMapped) spi_flash_munmap(modelMapping);
+    modelMapping = handle;
+    modelMapped = true;
+    activeSlot = slot;
+    return true;
+}
+
+void setWakeMode(WakeMode mode) {
+    if (mode != wakeMode) {
+        wakeMode = mode;
+        resetWakeWord();
+        Serial.printf("[Wake] Mode: %s%s\n", mode == WAKE_MODE_LOCAL ? "local" : "server",
+                      mode == WAKE_MODE_LOCAL && !modelReady ? " (no model, server fallback)" : "");
+    }
+}
+
+WakeMode getWakeMode() {
+    return wakeMode;
+}
+
+bool isLocalWakeActive() {
+    return wakeMode == WAKE_MODE_LOCAL && modelReady && wakeTaskHandle != nullptr;
+}
+
+void feedWakeWord(const int16_t* samples, size_t count) {
+    if (wakeTaskHandle == nullptr) return;
+
+    size_t written = wakeRing.write(samples, count);
+    if (written < count) {
+        droppedSamples += count - written;
+    }
+    xTaskNotifyGive(wakeTaskHandle);
+}
+
+bool takeWakeWordTrigger(float* score) {
+    if (!triggerPending) return false;
+    triggerPending = false;
+    if (score) *score = triggerScore;
+    return true;
+}
+
+void resetWakeWord() {
+    triggerPending = false;
+    if (wakeTaskHandle != nullptr) {
+        resetRequested = true;
+        xTaskNotifyGive(wakeTaskHandle);
+    }
+}
+
+void getWakeWordStats(WakeWordStats* stats) {
+    stats->inferences = inferences;
+    stats->detections = detections;
+    stats->lastInferenceUs = lastInferenceUs;
+    stats->maxInferenceUs = maxInferenceUs;
+    stats->droppedSamples = droppedSamples;
+    stats->lastScore = lastScore;
+}
@@ -0,0 +1,57 @@
+#ifndef MOTE_HOST_ARDUINO_H
+#define MOTE_HOST_ARDUINO_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Host stand-in for the Arduino calls the portable modules make
+ *
+ * Only on the include path of the native env (platformio.ini), so a module
+ * that includes <Arduino.h> for Serial or millis() builds unchanged on the
+ * host. Time is a virtual clock that the test or replay moves forward
+ * explicitly - nothing here reads the wall clock, so a run is repeatable to
+ * the microsecond.
+ */
+
+inline uint64_t hostClockUs = 0;
+
+inline void hostClockSetUs(uint64_t us) { hostClockUs = us; }
+inline void hostClockAdvanceUs(uint64_t us) { hostClockUs += us; }
+
+inline unsigned long micros() { return (unsigned long)hostClockUs; }
+inline unsigned long millis() { return (unsigned long)(hostClockUs / 1000); }
+inline void delay(unsigned long ms) { hostClockUs += (uint64_t)ms * 1000; }
+
+/**
+ * Serial goes to stdout; `quiet` drops it (expected errors in tests)
+ */
+class HostSerial {
+public:
+    bool quiet = false;
+
+    void begin(unsigned long) {}
+
+    int printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        if (quiet) return 0;
+        va_list args;
+        va_start(args, format);
+        int n = vprintf(format, args);
+        va_end(args);
+        return n;
+    }
+
+    void print(const char* text) {
+        if (!quiet) fputs(text, stdout);
+    }
+
+    void println(const char* text = "") {
+        if (!quiet) puts(text);
+    }
+};
+
+inline HostSerial Serial;
+
+#endif // MOTE_HOST_ARDUINO_H
@@ -0,0 +1,176 @@
+/**
+ * audio_i2s.h on the host virtual clock (Arduino.h shim)
+ *
+ * - Mic: plays a PCM buffer set with hostI2sMicSource() through the same
+ *   DMA frame geometry as the board. A read that has to wait for its frame
+ *   moves the clock to the frame's completion time and reports it in
+ *   doneUs, exactly like the on_recv stamp on the board; samples come back
+ *   in the INMP441's 32-bit left-justified layout
+ * - Speaker: a DMA queue of descCount * frameSamples that drains at the
+ *   sample rate as the clock moves. Unlike the board, writes never block -
+ *   they take what fits and the caller retries after advancing the clock,
+ *   which is what a discrete-event replay needs. Everything the amp would
+ *   have played, including silence while it starves, is kept
+ *
+ * Host only. Include this file once per program.
+ */
+#include "audio_i2s.h"
+#include <Arduino.h>
+#include <vector>
+
+#define HOST_I2S_SAMPLE_RATE 16000
+
+static const int16_t* hostMicPcm = nullptr;
+static size_t hostMicCount = 0;
+static size_t hostMicPos = 0;
+static uint64_t hostMicStartUs = 0;
+static uint16_t hostMicFrame = 0;
+
+static bool hostSpeakerRunning = false;
+static size_t hostSpeakerCapacity = 0;
+static std::vector<int16_t> hostSpeakerQueue;
+static size_t hostSpeakerQueueHead = 0;
+static std::vector<int16_t> hostSpeakerOutput;
+static uint64_t hostSpeakerSettledSamples = 0;  // Sample clock of the amp since start
+static uint64_t hostSpeakerStartUs = 0;
+static uint64_t hostSpeakerStarved = 0;
+
+static uint64_t hostSamplesToUs(uint64_t samples) {
+    return samples * 1000000ULL / HOST_I2S_SAMPLE_RATE;
+}
+
+/**
+ * Mic input for the next reads (not copied - must outlive them). Time zero
+ * of the stream is the clock at the next audioI2sMicBegin()
+ */
+void hostI2sMicSource(const int16_t* pcm, size_t count) {
+    hostMicPcm = pcm;
+    hostMicCount = count;
+    hostMicPos = 0;
+}
+
+bool audioI2sMicBegin(uint16_t descCount, uint16_t frameSamples) {
+    (void)descCount;
+    hostMicFrame = frameSamples;
+    hostMicStartUs = hostClockUs;
+    return frameSamples > 0;
+}
+
+bool audioI2sMicReconfigure(uint16_t descCount, uint16_t frameSamples) {
+    (void)descCount;
+    hostMicFrame = frameSamples;
+    return frameSamples > 0;
+}
+
+uint16_t audioI2sMicFrameSamples() {
+    return hostMicFrame;
+}
+
+size_t audioI2sMicRead(int32_t* out, size_t maxSamples, int64_t* doneUs) {
+    *doneUs = 0;
+    size_t n = hostMicFrame;
+    if (n > maxSamples) n = maxSamples;
+    if (n > hostMicCount - hostMicPos) n = hostMicCount - hostMicPos;
+    if (n == 0) return 0;
+
+    uint64_t readyUs = hostMicStartUs + hostSamplesToUs(hostMicPos + n);
+    if (readyUs > hostClockUs) {
+        hostClockUs = readyUs;      // Blocked until the frame completed
+        *doneUs = (int64_t)readyUs;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (int32_t)hostMicPcm[hostMicPos + i] * 65536;
+    }
+    hostMicPos += n;
+    return n;
+}
+
+void audioI2sMicDiscard() {
+    // Drop what has already "arrived" by now
+    uint64_t elapsed = (hostClockUs - hostMicStartUs) * HOST_I2S_SAMPLE_RATE / 1000000ULL;
+    if (elapsed > hostMicCount) elapsed = hostMicCount;
+    if (elapsed > hostMicPos) hostMicPos = (size_t)elapsed;
+}
+
+/**
+ * Play out the queue up to the current clock
+ */
+static void hostSpeakerSettle() {
+    if (!hostSpeakerRunning) return;
+
+    uint64_t due = (hostClockUs - hostSpeakerStartUs) * HOST_I2S_SAMPLE_RATE / 1000000ULL;
+    while (hostSpeakerSettledSamples < due) {
+        if (hostSpeakerQueueHead < hostSpeakerQueue.size()) {
+            hostSpeakerOutput.push_back(hostSpeakerQueue[hostSpeakerQueueHead++]);
+        } else {
+            hostSpeakerOutput.push_back(0);     // auto_clear silence
+            hostSpeakerStarved++;
+        }
+        hostSpeakerSettledSamples++;
+    }
+
+    if (hostSpeakerQueueHead == hostSpeakerQueue.size()) {
+        hostSpeakerQueue.clear();
+        hostSpeakerQueueHead = 0;
+    }
+}
+
+bool audioI2sSpeakerBegin(uint16_t descCount, uint16_t frameSamples) {
+    hostSpeakerCapacity = (size_t)descCount * frameSamples;
+    hostSpeakerRunning = false;
+    hostSpeakerQueue.clear();
+    hostSpeakerQueueHead = 0;
+    hostSpeakerOutput.clear();
+    hostSpeakerStarved = 0;
+    return hostSpeakerCapacity > 0;
+}
+
+void audioI2sSpeakerStart() {
+    if (hostSpeakerRunning) return;
+    hostSpeakerRunning = true;
+    hostSpeakerStartUs = hostClockUs;
+    hostSpeakerSettledSamples = 0;
+}
+
+void audioI2sSpeakerStop() {
+    hostSpeakerSettle();
+    hostSpeakerRunning = false;
+}
+
+void audioI2sSpeakerSilence() {
+    hostSpeakerSettle();
+    hostSpeakerQueue.clear();
+    hostSpeakerQueueHead = 0;
+}
+
+size_t audioI2sSpeakerWrite(const int16_t* samples, size_t count) {
+    hostSpeakerSettle();
+    size_t queued = hostSpeakerQueue.size() - hostSpeakerQueueHead;
+    size_t room = hostSpeakerCapacity > queued ? hostSpeakerCapacity - queued : 0;
+    if (count > room) count = room;
+    hostSpeakerQueue.insert(hostSpeakerQueue.end(), samples, samples + count);
+    return count;
+}
+
+const char* audioI2sDescribe() {
+    return "host/virtual";
+}
+
+/** Samples still queued for the amp at the current clock */
+size_t hostI2sSpeakerQueued() {
+    hostSpeakerSettle();
+    return hostSpeakerQueue.size() - hostSpeakerQueueHead;
+}
+
+/** Samples of silence the running amp played because its queue was empty */
+uint64_t hostI2sSpeakerStarvedSamples() {
+    hostSpeakerSettle();
+    return hostSpeakerStarved;
+}
+
+/** Everything the amp played since audioI2sSpeakerBegin() */
+const std::vector<int16_t>& hostI2sSpeakerOutput() {
+    hostSpeakerSettle();
+    return hostSpeakerOutput;
+}
@@ -0,0 +1,78 @@
+/**
+ * audio_pool.h on plain malloc, for tests that exercise BlockRing
+ *
+ * Same contract as src/audio_pool.cpp (fixed-size blocks, per-pool caps and
+ * stats, internal falls back to PSRAM) without heap_caps, spinlocks or the
+ * metrics registry. hostAudioPoolSetLimit() lowers a cap so exhaustion paths
+ * can be tested. Portable, so it also builds for the board.
+ *
+ * Include this file once per test program.
+ */
+#include "audio_pool.h"
+#include <stdlib.h>
+
+// Each block carries its pool in a header word ahead of the payload
+struct HostPoolBlock {
+    AudioPoolKind kind;
+    uint32_t pad;       // Keeps the payload 8-byte aligned
+};
+
+static uint32_t hostPoolLimit[AUDIO_POOL_KIND_COUNT] = {
+    AUDIO_POOL_INTERNAL_MAX, AUDIO_POOL_PSRAM_MAX
+};
+static AudioPoolStats hostPoolStats[AUDIO_POOL_KIND_COUNT];
+
+/**
+ * Cap a pool at `blocks` (and clear its stats) - the default is its
+ * AUDIO_POOL_*_MAX
+ */
+void hostAudioPoolSetLimit(AudioPoolKind kind, uint32_t blocks) {
+    hostPoolLimit[kind] = blocks;
+    hostPoolStats[kind].peakInUse = hostPoolStats[kind].inUse;
+    hostPoolStats[kind].allocFailures = 0;
+}
+
+const char* audioPoolName(AudioPoolKind kind) {
+    switch (kind) {
+        case AUDIO_POOL_INTERNAL: return "internal";
+        case AUDIO_POOL_PSRAM:    return "psram";
+        default:                  return "unknown";
+    }
+}
+
+static void* hostAllocFrom(AudioPoolKind kind) {
+    AudioPoolStats& stats = hostPoolStats[kind];
+    if (stats.inUse >= hostPoolLimit[kind]) return nullptr;
+
+    HostPoolBlock* block = (HostPoolBlock*)malloc(sizeof(HostPoolBlock) + AUDIO_POOL_BLOCK_BYTES);
+    if (block == nullptr) return nullptr;
+    block->kind = kind;
+
+    stats.inUse++;
+    if (stats.inUse > stats.peakInUse) stats.peakInUse = stats.inUse;
+    return block + 1;
+}
+
+void* audioPoolAlloc(AudioPoolKind kind) {
+    if (kind >= AUDIO_POOL_KIND_COUNT) return nullptr;
+
+    void* block = hostAllocFrom(kind);
+    if (block == nullptr && kind == AUDIO_POOL_INTERNAL) {
+        block = hostAllocFrom(AUDIO_POOL_PSRAM);
+    }
+    if (block == nullptr) hostPoolStats[kind].allocFailures++;
+    return block;
+}
+
+void audioPoolFree(void* block) {
+    if (block == nullptr) return;
+
+    HostPoolBlock* header = (HostPoolBlock*)block - 1;
+    hostPoolStats[header->kind].inUse--;
+    free(header);
+}
+
+void getAudioPoolStats(AudioPoolKind kind, AudioPoolStats* stats) {
+    if (kind >= AUDIO_POOL_KIND_COUNT || stats == nullptr) return;
+    *stats = hostPoolStats[kind];
+}
@@ -0,0 +1,95 @@
+#include "wav.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t readLe16(const uint8_t* p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static void putLe32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void putLe16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+bool wavLoad(const char* path, std::vector<int16_t>* samples, uint32_t* sampleRate) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    size_t pos = 12;
+    while (pos + 8 <= data.size()) {
+        const uint8_t* header = data.data() + pos;
+        uint32_t size = readLe32(header + 4);
+        const uint8_t* body = header + 8;
+        if (size > data.size() - pos - 8) size = (uint32_t)(data.size() - pos - 8);
+
+        if (memcmp(header, "fmt ", 4) == 0 && size >= 16) {
+            if (readLe16(body) != 1) return false;     // PCM only
+            channels = readLe16(body + 2);
+            *sampleRate = readLe32(body + 4);
+            bits = readLe16(body + 14);
+        } else if (memcmp(header, "data", 4) == 0) {
+            if (channels == 0 || bits != 16) return false;
+            size_t frames = size / (2 * channels);
+            samples->resize(frames);
+            for (size_t i = 0; i < frames; i++) {
+                (*samples)[i] = (int16_t)readLe16(body + i * 2 * channels);
+            }
+            return true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+bool wavSave(const char* path, const std::vector<int16_t>& samples, uint32_t sampleRate) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) return false;
+
+    uint32_t dataBytes = (uint32_t)(samples.size() * 2);
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    putLe32(header + 4, 36 + dataBytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe32(header + 16, 16);
+    putLe16(header + 20, 1);                // PCM
+    putLe16(header + 22, 1);                // Mono
+    putLe32(header + 24, sampleRate);
+    putLe32(header + 28, sampleRate * 2);
+    putLe16(header + 32, 2);
+    putLe16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    putLe32(header + 40, dataBytes);
+
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    for (size_t i = 0; ok && i < samples.size(); i++) {
+        uint8_t sample[2];
+        putLe16(sample, (uint16_t)samples[i]);
+        ok = fwrite(sample, 1, 2, file) == 2;
+    }
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,18 @@
+#ifndef MOTE_WAV_H
+#define MOTE_WAV_H
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * Minimal RIFF/WAVE reader and writer for replay input and output
+ *
+ * Reads 16-bit PCM (any channel count - the first channel is kept, which
+ * is what the mic's left slot carries). Writes 16-bit mono.
+ */
+
+bool wavLoad(const char* path, std::vector<int16_t>* samples, uint32_t* sampleRate);
+
+bool wavSave(const char* path, const std::vector<int16_t>& samples, uint32_t sampleRate);
+
+#endif // MOTE_WAV_H
@@ -0,0 +1,102 @@
+#include "ws_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WS_TRACE_PREFIX "[WsTrace] "
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void WsTrace::addText(uint64_t arrivalUs, const char* text) {
+    WsTraceFrame frame;
+    frame.arrivalUs = arrivalUs;
+    frame.binary = false;
+    frame.payload.assign((const uint8_t*)text, (const uint8_t*)text + strlen(text));
+    list.push_back(frame);
+}
+
+void WsTrace::addBinary(uint64_t arrivalUs, const uint8_t* payload, size_t length) {
+    WsTraceFrame frame;
+    frame.arrivalUs = arrivalUs;
+    frame.binary = true;
+    if (payload != nullptr) {
+        frame.payload.assign(payload, payload + length);
+    } else {
+        frame.payload.assign(length, 0);
+    }
+    list.push_back(frame);
+}
+
+bool WsTrace::parseLine(const char* line, size_t length) {
+    std::string text(line, length);
+    size_t pos = text.find(WS_TRACE_PREFIX);
+    if (pos != std::string::npos) {
+        text.erase(0, pos + strlen(WS_TRACE_PREFIX));
+    }
+    while (!text.empty() && (text.back() == '\r' || text.back() == '\n')) {
+        text.pop_back();
+    }
+
+    const char* p = text.c_str();
+    char* end;
+    unsigned long long arrivalUs = strtoull(p, &end, 10);
+    if (end == p || end[0] != ' ' || (end[1] != 'T' && end[1] != 'B') || end[2] != ' ') {
+        return false;
+    }
+    bool binary = end[1] == 'B';
+    p = end + 3;
+
+    if (!binary) {
+        addText(arrivalUs, p);
+        return true;
+    }
+
+    unsigned long bytes = strtoul(p, &end, 10);
+    if (end == p) return false;
+    p = end;
+    while (*p == ' ') p++;
+
+    std::vector<uint8_t> payload;
+    if (*p != '\0') {
+        // Payload present - it has to be complete
+        for (; hexValue(p[0]) >= 0 && hexValue(p[1]) >= 0; p += 2) {
+            payload.push_back((uint8_t)(hexValue(p[0]) << 4 | hexValue(p[1])));
+        }
+        if (payload.size() != bytes) return false;
+    }
+    addBinary(arrivalUs, payload.empty() ? nullptr : payload.data(), bytes);
+    return true;
+}
+
+void WsTrace::parse(const char* text) {
+    while (*text != '\0') {
+        const char* eol = strchr(text, '\n');
+        size_t length = eol != nullptr ? (size_t)(eol - text) : strlen(text);
+        if (length > 0 && text[0] != '#') {
+            parseLine(text, length);
+        }
+        text += length;
+        if (*text == '\n') text++;
+    }
+}
+
+bool WsTrace::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    std::string text;
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, n);
+    }
+    fclose(file);
+
+    parse(text.c_str());
+    return true;
+}
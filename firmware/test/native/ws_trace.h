@@ -0,0 +1,52 @@
+#ifndef MOTE_WS_TRACE_H
+#define MOTE_WS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Recorded gateway WebSocket traffic, stand-in for the WebSocket client
+ *
+ * One frame per line, in arrival order:
+ *
+ *   <arrival us> T <text frame>
+ *   <arrival us> B <bytes> [hex payload]
+ *
+ * A binary frame without a payload is replayed as that many zero bytes, so a
+ * timing-only trace (what the firmware logs with -DMOTE_WS_TRACE) is enough
+ * for jitter buffer work. Lines may carry the "[WsTrace] " prefix the
+ * firmware prints, and lines that aren't frames (blank, '#', the rest of a
+ * serial log) are skipped, so a raw serial capture loads as is.
+ */
+
+struct WsTraceFrame {
+    uint64_t arrivalUs;
+    bool binary;
+    std::vector<uint8_t> payload;
+};
+
+class WsTrace {
+public:
+    /** Parse trace text, appending to the frames already loaded */
+    void parse(const char* text);
+
+    /** Load a trace file. @return false if it can't be read */
+    bool load(const char* path);
+
+    /** Add one frame programmatically (synthetic traces) */
+    void addText(uint64_t arrivalUs, const char* text);
+    void addBinary(uint64_t arrivalUs, const uint8_t* payload, size_t length);
+
+    const std::vector<WsTraceFrame>& frames() const { return list; }
+
+    void clear() { list.clear(); }
+
+private:
+    bool parseLine(const char* line, size_t length);
+
+    std::vector<WsTraceFrame> list;
+};
+
+#endif // MOTE_WS_TRACE_H
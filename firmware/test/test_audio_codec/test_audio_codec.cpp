@@ -0,0 +1,185 @@
+/**
+ * Voice codecs: ADPCM quality and framing (blocks decode cold, lost blocks
+ * don't poison later ones), the encoder/decoder front ends, codec names,
+ * and that the arrival-time estimate tracks what actually decodes.
+ *
+ * Run on the host:  pio test -e native -f test_audio_codec
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_audio_codec
+ */
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "audio_codec.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/audio_codec.cpp"
+
+#define FRAME AUDIO_CODEC_FRAME_SAMPLES
+
+static int16_t pcm[AUDIO_CODEC_MAX_DECODED];
+static int16_t decoded[AUDIO_CODEC_MAX_DECODED];
+static uint8_t packet[AUDIO_CODEC_MAX_RX_PACKET];
+
+static void fillTone(int16_t* buf, size_t count, size_t start, float hz, float amplitude) {
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = (int16_t)(amplitude * sinf(2.0f * (float)M_PI * hz * (float)(start + i) / 16000.0f));
+    }
+}
+
+static float snrDb(const int16_t* ref, const int16_t* test, size_t count) {
+    double signal = 0, error = 0;
+    for (size_t i = 0; i < count; i++) {
+        double e = (double)ref[i] - test[i];
+        signal += (double)ref[i] * ref[i];
+        error += e * e;
+    }
+    return (float)(10.0 * log10(signal / (error + 1.0)));
+}
+
+static void test_names_round_trip() {
+    const AudioCodec codecs[] = {AUDIO_CODEC_PCM16, AUDIO_CODEC_ADPCM};
+    for (size_t i = 0; i < 2; i++) {
+        AudioCodec parsed;
+        TEST_ASSERT_TRUE(audioCodecFromName(audioCodecName(codecs[i]), &parsed));
+        TEST_ASSERT_EQUAL(codecs[i], parsed);
+    }
+
+    AudioCodec parsed = AUDIO_CODEC_ADPCM;
+    TEST_ASSERT_TRUE(audioCodecFromName("pcm_16000", &parsed));
+    TEST_ASSERT_EQUAL(AUDIO_CODEC_PCM16, parsed);
+    TEST_ASSERT_FALSE(audioCodecFromName("mp3", &parsed));
+    TEST_ASSERT_FALSE(audioCodecFromName(nullptr, &parsed));
+
+#ifdef MOTE_CODEC_OPUS
+    TEST_ASSERT_TRUE(audioCodecFromName("opus", &parsed));
+#else
+    // Not built in - never negotiate it
+    TEST_ASSERT_FALSE(audioCodecAvailable(AUDIO_CODEC_OPUS));
+    TEST_ASSERT_FALSE(audioCodecFromName("opus", &parsed));
+#endif
+}
+
+static void test_adpcm_tone_quality() {
+    AdpcmState state;
+    adpcmReset(&state);
+
+    // Speech-band tones at a few levels, many frames so the step adapts
+    const float tones[] = {200.0f, 1000.0f, 3000.0f};
+    for (size_t t = 0; t < 3; t++) {
+        float worst = 1000.0f;
+        for (size_t f = 0; f < 20; f++) {
+            fillTone(pcm, FRAME, f * FRAME, tones[t], 10000.0f);
+            size_t bytes = adpcmEncodeBlock(&state, pcm, FRAME, packet);
+            TEST_ASSERT_EQUAL_UINT32(ADPCM_BLOCK_BYTES(FRAME), bytes);
+            TEST_ASSERT_EQUAL_UINT32(FRAME, adpcmDecodeBlock(packet, bytes, decoded));
+            if (f >= 2) {
+                float snr = snrDb(pcm, decoded, FRAME);
+                if (snr < worst) worst = snr;
+            }
+        }
+        TEST_ASSERT_TRUE(worst > 20.0f);
+    }
+}
+
+static void test_adpcm_blocks_decode_cold() {
+    // Each block carries the state it starts from, so a block decodes the
+    // same whether or not the ones before it arrived
+    AdpcmState state;
+    adpcmReset(&state);
+    static uint8_t blocks[4][ADPCM_BLOCK_BYTES(FRAME)];
+    static int16_t source[4][FRAME];
+    for (size_t b = 0; b < 4; b++) {
+        fillTone(source[b], FRAME, b * FRAME, 700.0f, 12000.0f);
+        adpcmEncodeBlock(&state, source[b], FRAME, blocks[b]);
+    }
+
+    // Block 3 alone, as if 1 and 2 were lost
+    adpcmDecodeBlock(blocks[3], sizeof(blocks[3]), decoded);
+    TEST_ASSERT_TRUE(snrDb(source[3], decoded, FRAME) > 20.0f);
+}
+
+static void test_adpcm_odd_lengths_and_short_input() {
+    AdpcmState state;
+    adpcmReset(&state);
+    fillTone(pcm, 7, 0, 500.0f, 5000.0f);
+    size_t bytes = adpcmEncodeBlock(&state, pcm, 7, packet);
+    TEST_ASSERT_EQUAL_UINT32(ADPCM_HEADER_BYTES + 4, bytes);
+    // The pad nibble decodes as one extra sample
+    TEST_ASSERT_EQUAL_UINT32(8, adpcmDecodeBlock(packet, bytes, decoded));
+
+    TEST_ASSERT_EQUAL_UINT32(0, adpcmDecodeBlock(packet, ADPCM_HEADER_BYTES - 1, decoded));
+    TEST_ASSERT_EQUAL_UINT32(0, adpcmDecodeBlock(packet, ADPCM_HEADER_BYTES, decoded));
+
+    // A corrupt step index is clamped, not used to index past the table
+    packet[2] = 200;
+    TEST_ASSERT_EQUAL_UINT32(8, adpcmDecodeBlock(packet, bytes, decoded));
+}
+
+static void test_front_ends_round_trip() {
+    AudioEncoder encoder = {};
+    AudioDecoder decoder = {};
+    TEST_ASSERT_TRUE(audioEncoderInit(&encoder, AUDIO_CODEC_ADPCM));
+    TEST_ASSERT_TRUE(audioDecoderInit(&decoder, AUDIO_CODEC_ADPCM));
+
+    for (size_t f = 0; f < 10; f++) {
+        fillTone(pcm, FRAME, f * FRAME, 440.0f, 8000.0f);
+        size_t bytes = audioEncoderEncode(&encoder, pcm, packet, AUDIO_CODEC_MAX_PACKET);
+        TEST_ASSERT_TRUE(bytes > 0 && bytes <= AUDIO_CODEC_MAX_PACKET);
+
+        size_t samples = audioDecoderDecode(&decoder, packet, bytes, decoded, AUDIO_CODEC_MAX_DECODED);
+        TEST_ASSERT_EQUAL_UINT32(FRAME, samples);
+        // The jitter buffer's arrival estimate only overcounts the header
+        size_t estimate = audioCodecEstimateSamples(AUDIO_CODEC_ADPCM, bytes);
+        TEST_ASSERT_TRUE(estimate >= samples && estimate <= samples + 2 * ADPCM_HEADER_BYTES);
+        if (f >= 2) TEST_ASSERT_TRUE(snrDb(pcm, decoded, FRAME) > 20.0f);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, audioEncoderEncode(&encoder, pcm, packet, 16));    // No room
+
+    // PCM is a passthrough, capped at the caller's buffer
+    TEST_ASSERT_TRUE(audioDecoderInit(&decoder, AUDIO_CODEC_PCM16));
+    fillTone(pcm, FRAME, 0, 440.0f, 8000.0f);
+    TEST_ASSERT_EQUAL_UINT32(FRAME, audioDecoderDecode(&decoder, (const uint8_t*)pcm, FRAME * 2 + 1,
+                                                       decoded, AUDIO_CODEC_MAX_DECODED));
+    TEST_ASSERT_EQUAL_MEMORY(pcm, decoded, FRAME * sizeof(int16_t));
+    TEST_ASSERT_EQUAL_UINT32(FRAME, audioCodecEstimateSamples(AUDIO_CODEC_PCM16, FRAME * 2));
+    TEST_ASSERT_EQUAL_UINT32(100, audioDecoderDecode(&decoder, (const uint8_t*)pcm, FRAME * 2, decoded, 100));
+}
+
+static void test_decoder_refuses_oversized_blocks() {
+    AudioDecoder decoder;
+    audioDecoderInit(&decoder, AUDIO_CODEC_ADPCM);
+    memset(packet, 0, sizeof(packet));
+
+    // A block that would decode past the caller's buffer
+    TEST_ASSERT_EQUAL_UINT32(0, audioDecoderDecode(&decoder, packet, ADPCM_BLOCK_BYTES(2 * FRAME), decoded, FRAME));
+    TEST_ASSERT_EQUAL_UINT32(2 * FRAME, audioDecoderDecode(&decoder, packet, ADPCM_BLOCK_BYTES(2 * FRAME),
+                                                           decoded, AUDIO_CODEC_MAX_DECODED));
+    TEST_ASSERT_EQUAL_UINT32(0, audioDecoderDecode(&decoder, packet, 2, decoded, AUDIO_CODEC_MAX_DECODED));
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_names_round_trip);
+    RUN_TEST(test_adpcm_tone_quality);
+    RUN_TEST(test_adpcm_blocks_decode_cold);
+    RUN_TEST(test_adpcm_odd_lengths_and_short_input);
+    RUN_TEST(test_front_ends_round_trip);
+    RUN_TEST(test_decoder_refuses_oversized_blocks);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,175 @@
+/**
+ * Bit-exactness tests: every optimized audio_dsp kernel must match its
+ * scalar reference for all alignments, odd lengths and full-scale inputs.
+ *
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_audio_dsp
+ */
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_dsp.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/audio_dsp.cpp"
+
+#define TEST_MAX_SAMPLES 1027   // Odd, and not a multiple of the unroll
+
+static int32_t in32[TEST_MAX_SAMPLES + 4];
+static int16_t inA[TEST_MAX_SAMPLES + 4];
+static int16_t inB[TEST_MAX_SAMPLES + 4];
+static int16_t outRef[TEST_MAX_SAMPLES + 4];
+static int16_t outOpt[TEST_MAX_SAMPLES + 4];
+
+static uint32_t rngState = 0x12345678;
+
+static uint32_t nextRandom() {
+    // xorshift32 - deterministic across host and target
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+/**
+ * Random samples with the extremes mixed in
+ */
+static void fillSamples(int16_t* buf, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = nextRandom();
+        switch (r & 15) {
+            case 0:  buf[i] = -32768; break;
+            case 1:  buf[i] = 32767; break;
+            case 2:  buf[i] = 0; break;
+            default: buf[i] = (int16_t)(r >> 16); break;
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_s32_to_s16_matches_reference() {
+    for (size_t i = 0; i < TEST_MAX_SAMPLES + 4; i++) {
+        uint32_t r = nextRandom();
+        in32[i] = (i % 7 == 0) ? INT32_MIN : (int32_t)r;
+    }
+
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t count = 0; count <= 19; count++) {
+            memset(outRef, 0x55, sizeof(outRef));
+            memset(outOpt, 0x55, sizeof(outOpt));
+            audioDspS32ToS16Ref(in32, outRef + offset, count);
+            audioDspS32ToS16(in32, outOpt + offset, count);
+            TEST_ASSERT_EQUAL_MEMORY(outRef, outOpt, sizeof(outRef));
+        }
+
+        audioDspS32ToS16Ref(in32, outRef + offset, TEST_MAX_SAMPLES);
+        audioDspS32ToS16(in32, outOpt + offset, TEST_MAX_SAMPLES);
+        TEST_ASSERT_EQUAL_MEMORY(outRef + offset, outOpt + offset, TEST_MAX_SAMPLES * sizeof(int16_t));
+    }
+}
+
+static void test_gain_matches_reference() {
+    const int32_t gains[] = {0, 1, 2048, 4095, AUDIO_DSP_GAIN_UNITY, 4097, 8602, 12288, 16384,
+                             audioDspGainFromVolume(70, 300), audioDspGainFromVolume(100, 400)};
+
+    fillSamples(inA, TEST_MAX_SAMPLES + 4);
+
+    for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+        for (size_t offset = 0; offset < 3; offset++) {
+            audioDspGainRef(inA + offset, outRef, TEST_MAX_SAMPLES, gains[g]);
+            audioDspGain(inA + offset, outOpt, TEST_MAX_SAMPLES, gains[g]);
+            TEST_ASSERT_EQUAL_MEMORY(outRef, outOpt, TEST_MAX_SAMPLES * sizeof(int16_t));
+        }
+
+        // In place, as applyVolume() uses it
+        memcpy(outOpt, inA, TEST_MAX_SAMPLES * sizeof(int16_t));
+        audioDspGain(outOpt, outOpt, TEST_MAX_SAMPLES, gains[g]);
+        audioDspGainRef(inA, outRef, TEST_MAX_SAMPLES, gains[g]);
+        TEST_ASSERT_EQUAL_MEMORY(outRef, outOpt, TEST_MAX_SAMPLES * sizeof(int16_t));
+    }
+}
+
+static void test_gain_peak_matches_reference() {
+    const int32_t gains[] = {0, 2048, AUDIO_DSP_GAIN_UNITY, 8602, 16384};
+
+    fillSamples(inA, TEST_MAX_SAMPLES + 4);
+
+    for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+        for (size_t count = 0; count <= TEST_MAX_SAMPLES; count += (count < 16 ? 1 : 101)) {
+            for (size_t offset = 0; offset < 3; offset++) {
+                uint32_t peakRef = audioDspGainPeakRef(inA + offset, outRef, count, gains[g]);
+                uint32_t peakOpt = audioDspGainPeak(inA + offset, outOpt, count, gains[g]);
+                TEST_ASSERT_EQUAL_UINT32(peakRef, peakOpt);
+                TEST_ASSERT_EQUAL_MEMORY(outRef, outOpt, count * sizeof(int16_t));
+            }
+        }
+
+        // In place, as the playback task uses it
+        memcpy(outOpt, inA, TEST_MAX_SAMPLES * sizeof(int16_t));
+        uint32_t peakOpt = audioDspGainPeak(outOpt, outOpt, TEST_MAX_SAMPLES, gains[g]);
+        uint32_t peakRef = audioDspGainPeakRef(inA, outRef, TEST_MAX_SAMPLES, gains[g]);
+        TEST_ASSERT_EQUAL_UINT32(peakRef, peakOpt);
+        TEST_ASSERT_EQUAL_MEMORY(outRef, outOpt, TEST_MAX_SAMPLES * sizeof(int16_t));
+    }
+}
+
+static void test_energy_dot_peak_match_reference() {
+    fillSamples(inA, TEST_MAX_SAMPLES + 4);
+    fillSamples(inB, TEST_MAX_SAMPLES + 4);
+
+    for (size_t count = 0; count <= TEST_MAX_SAMPLES; count += (count < 16 ? 1 : 101)) {
+        for (size_t offset = 0; offset < 3; offset++) {
+            TEST_ASSERT_TRUE(audioDspEnergyRef(inA + offset, count) == audioDspEnergy(inA + offset, count));
+            TEST_ASSERT_TRUE(audioDspDotRef(inA + offset, inB, count) == audioDspDot(inA + offset, inB, count));
+            TEST_ASSERT_EQUAL_UINT32(audioDspPeakRef(inA + offset, count), audioDspPeak(inA + offset, count));
+        }
+    }
+}
+
+static void test_full_scale_extremes() {
+    for (size_t i = 0; i < TEST_MAX_SAMPLES; i++) {
+        inA[i] = -32768;
+    }
+    TEST_ASSERT_TRUE(audioDspEnergy(inA, TEST_MAX_SAMPLES) == (uint64_t)TEST_MAX_SAMPLES << 30);
+    TEST_ASSERT_TRUE(audioDspDot(inA, inA, TEST_MAX_SAMPLES) == (int64_t)TEST_MAX_SAMPLES << 30);
+    TEST_ASSERT_EQUAL_UINT32(32768, audioDspPeak(inA, TEST_MAX_SAMPLES));
+
+    audioDspGain(inA, outOpt, TEST_MAX_SAMPLES, 16384);
+    for (size_t i = 0; i < TEST_MAX_SAMPLES; i++) {
+        TEST_ASSERT_EQUAL_INT16(-32768, outOpt[i]);
+    }
+}
+
+static void test_gain_from_volume() {
+    TEST_ASSERT_EQUAL_INT32(AUDIO_DSP_GAIN_UNITY, audioDspGainFromVolume(100, 100));
+    TEST_ASSERT_EQUAL_INT32(0, audioDspGainFromVolume(0, 300));
+    TEST_ASSERT_EQUAL_INT32(8602, audioDspGainFromVolume(70, 300));  // 2.1x
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_s32_to_s16_matches_reference);
+    RUN_TEST(test_gain_matches_reference);
+    RUN_TEST(test_gain_peak_matches_reference);
+    RUN_TEST(test_energy_dot_peak_match_reference);
+    RUN_TEST(test_full_scale_extremes);
+    RUN_TEST(test_gain_from_volume);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
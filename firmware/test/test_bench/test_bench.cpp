@@ -0,0 +1,197 @@
+/**
+ * Audio and voice hot-path benchmarks: throughput (ns per sample and
+ * multiple of real time) and per-20ms-frame latency (mean and worst) for
+ * each stage, fed 16kHz speech-like input one frame at a time the way the
+ * tasks see it. Every stage must keep up with real time on both targets;
+ * the printed table is the number to compare across changes.
+ *
+ * Host figures are for spotting regressions between commits, not for
+ * predicting the board - run on the board for absolute numbers.
+ *
+ * Run on the host:  pio test -e native -f test_bench -v
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_bench -v
+ */
+#include <unity.h>
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include "audio_codec.h"
+#include "audio_dsp.h"
+#include "block_ring.h"
+#include "kws.h"
+#include "vad.h"
+#include "voice_protocol.h"
+
+// Tests build without src/ (test_build_src = no), so pull the modules in directly
+#include "../../src/audio_codec.cpp"
+#include "../../src/audio_dsp.cpp"
+#include "../../src/kws.cpp"
+#include "../../src/vad.cpp"
+#include "../../src/voice_protocol.cpp"
+#include "../native/audio_pool_shim.cpp"
+
+#ifndef ARDUINO
+#include <chrono>
+#endif
+
+#define RATE            16000
+#define FRAME           320                 // 20ms, as the uplink and KWS tasks run
+#define FRAME_US        (FRAME * 1000000ull / RATE)
+#define BENCH_FRAMES    500                 // 10s of audio per stage
+#define INPUT_FRAMES    50                  // 1s of input, looped
+
+static int16_t pcm[INPUT_FRAMES * FRAME];
+static int32_t mic[INPUT_FRAMES * FRAME];
+static int16_t out[AUDIO_CODEC_MAX_DECODED];
+static uint8_t packets[INPUT_FRAMES][AUDIO_CODEC_MAX_PACKET];
+static size_t packetBytes[INPUT_FRAMES];
+
+static uint64_t nowNs() {
+#ifdef ARDUINO
+    return (uint64_t)micros() * 1000;
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void fillInput() {
+    // Voiced harmonics with a slow syllable envelope plus a little noise
+    uint32_t rng = 0x2468ace;
+    for (size_t i = 0; i < INPUT_FRAMES * FRAME; i++) {
+        float t = (float)i / RATE;
+        float envelope = 0.5f + 0.5f * sinf(2.0f * (float)M_PI * 4.0f * t);
+        float s = envelope * (6000.0f * sinf(2.0f * (float)M_PI * 180.0f * t) +
+                              2500.0f * sinf(2.0f * (float)M_PI * 720.0f * t) +
+                              800.0f * sinf(2.0f * (float)M_PI * 2400.0f * t));
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        s += (float)(rng % 201) - 100.0f;
+        pcm[i] = (int16_t)s;
+        mic[i] = (int32_t)pcm[i] * 65536;
+    }
+}
+
+/**
+ * Time `stage(frame)` over BENCH_FRAMES frames, print a row and check it
+ * keeps up. `samplesPerCall` of 0 marks a per-message stage (no ns/sample).
+ */
+template <typename Stage>
+static void bench(const char* name, size_t samplesPerCall, Stage&& stage) {
+    for (int f = 0; f < 5; f++) stage(f % INPUT_FRAMES);    // Warm caches and lazy tables
+
+    uint64_t total = 0, worst = 0;
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        uint64_t start = nowNs();
+        stage(f % INPUT_FRAMES);
+        uint64_t elapsed = nowNs() - start;
+        total += elapsed;
+        if (elapsed > worst) worst = elapsed;
+    }
+
+    double meanUs = (double)total / BENCH_FRAMES / 1000.0;
+    if (samplesPerCall > 0) {
+        double nsPerSample = (double)total / ((double)BENCH_FRAMES * samplesPerCall);
+        double realtime = meanUs > 0.0 ? (double)FRAME_US / meanUs : 0.0;
+        Serial.printf("[Bench] %-16s %8.2f ns/sample %9.0fx real time   frame mean %8.2f us  max %8.2f us\n",
+                      name, nsPerSample, realtime, meanUs, worst / 1000.0);
+    } else {
+        Serial.printf("[Bench] %-16s %8s            %9s               call  mean %8.2f us  max %8.2f us\n",
+                      name, "-", "-", meanUs, worst / 1000.0);
+    }
+
+    // Falling behind real time anywhere means dropped or late audio
+    TEST_ASSERT_TRUE(total < (uint64_t)BENCH_FRAMES * FRAME_US * 1000);
+}
+
+static void test_bench_mic_conversion() {
+    bench("s32_to_s16", FRAME, [](int f) {
+        audioDspS32ToS16(mic + f * FRAME, out, FRAME);
+    });
+}
+
+static void test_bench_apply_volume() {
+    // The playback task's applyVolumeWithEnvelope(): gain in place plus peak
+    static int16_t chunk[FRAME];
+    const int32_t gain = audioDspGainFromVolume(70, 300);    // audio.cpp defaults
+    bench("apply_volume", FRAME, [&](int f) {
+        memcpy(chunk, pcm + f * FRAME, sizeof(chunk));
+        audioDspGainPeak(chunk, chunk, FRAME, gain);
+    });
+}
+
+static void test_bench_vad() {
+    static Vad vad(RATE);
+    bench("vad", FRAME, [](int f) {
+        vad.process(pcm + f * FRAME, FRAME);
+    });
+}
+
+static void test_bench_adpcm() {
+    AudioEncoder encoder = {};
+    TEST_ASSERT_TRUE(audioEncoderInit(&encoder, AUDIO_CODEC_ADPCM));
+    bench("adpcm_encode", FRAME, [&](int f) {
+        packetBytes[f] = audioEncoderEncode(&encoder, pcm + f * FRAME, packets[f], AUDIO_CODEC_MAX_PACKET);
+    });
+
+    AudioDecoder decoder = {};
+    TEST_ASSERT_TRUE(audioDecoderInit(&decoder, AUDIO_CODEC_ADPCM));
+    bench("adpcm_decode", FRAME, [&](int f) {
+        audioDecoderDecode(&decoder, packets[f], packetBytes[f], out, AUDIO_CODEC_MAX_DECODED);
+    });
+}
+
+static void test_bench_kws_frontend() {
+    // MFCCs only - the network's cost depends on the model blob flashed
+    static KwsFrontend frontend;
+    bench("kws_frontend", FRAME, [](int f) {
+        frontend.push(pcm + f * FRAME, FRAME);
+    });
+}
+
+static void test_bench_block_ring() {
+    static BlockRing<int16_t> ring;
+    TEST_ASSERT_TRUE(ring.init(AUDIO_POOL_PSRAM, 8 * BlockRing<int16_t>::BLOCK_ELEMENTS));
+    bench("block_ring", FRAME, [](int f) {
+        ring.write(pcm + f * FRAME, FRAME);
+        ring.read(out, FRAME);
+    });
+    ring.init(AUDIO_POOL_PSRAM, 8 * BlockRing<int16_t>::BLOCK_ELEMENTS);
+}
+
+static void test_bench_voice_protocol() {
+    static const char* frame = "{\"type\":\"voice.response\",\"text\":\"Turning on the kitchen lights now.\","
+                               "\"sessionId\":\"6f1c2a\",\"final\":true}";
+    bench("voice_protocol", 0, [](int) {
+        VoiceMessageType type;
+        voiceProtocolParse((const uint8_t*)frame, strlen(frame), &type);
+    });
+}
+
+static void runTests() {
+    fillInput();
+    UNITY_BEGIN();
+    RUN_TEST(test_bench_mic_conversion);
+    RUN_TEST(test_bench_apply_volume);
+    RUN_TEST(test_bench_vad);
+    RUN_TEST(test_bench_adpcm);
+    RUN_TEST(test_bench_kws_frontend);
+    RUN_TEST(test_bench_block_ring);
+    RUN_TEST(test_bench_voice_protocol);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,246 @@
+/**
+ * BLE TLV protocol: framing at small and large MTUs, delta encoding of
+ * status and metrics, and CONFIG decoding including refused writes.
+ *
+ * Run on the host:  pio test -e native -f test_ble_protocol
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_ble_protocol
+ */
+#include <unity.h>
+#include <string.h>
+#include "ble_protocol.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/ble_protocol.cpp"
+#include "../../src/gateway_select.cpp"
+
+#define MAX_FRAMES 32
+
+struct Captured {
+    uint8_t frames[MAX_FRAMES][BLE_VALUE_MAX];
+    size_t lengths[MAX_FRAMES];
+    size_t count;
+};
+
+static Captured sent;
+
+static void capture(const uint8_t* frame, size_t length, void* context) {
+    Captured* c = (Captured*)context;
+    TEST_ASSERT_TRUE(c->count < MAX_FRAMES);
+    memcpy(c->frames[c->count], frame, length);
+    c->lengths[c->count++] = length;
+}
+
+static void fillStatus(BleStatus* s) {
+    memset(s, 0, sizeof(*s));
+    const uint8_t mac[6] = {0xAA, 0xBB, 0xCC, 0x01, 0x02, 0x03};
+    memcpy(s->deviceId, mac, sizeof(mac));
+    strcpy(s->firmware, "1.0.0");
+    s->batteryPercent = 80;
+    s->batteryMv = 3960;
+    s->volume = 70;
+    s->wifiConfigured = true;
+    strcpy(s->wifiSsid, "Home");
+    s->gatewayConfigured = true;
+    strcpy(s->gatewayServer, "gateway.example.com");
+    s->gatewayPort = 3000;
+}
+
+/**
+ * Count TLVs across the captured frames, checking each parses on its own
+ */
+static size_t countTlvs(uint8_t wantTag, const uint8_t** found, uint8_t* foundLength) {
+    size_t total = 0;
+    for (size_t f = 0; f < sent.count; f++) {
+        BleFrameReader reader;
+        TEST_ASSERT_TRUE(reader.begin(sent.frames[f], sent.lengths[f]));
+        uint8_t tag, len;
+        const uint8_t* value;
+        while (reader.next(&tag, &value, &len)) {
+            total++;
+            if (tag == wantTag && found != nullptr) {
+                *found = value;
+                *foundLength = len;
+            }
+        }
+        TEST_ASSERT_FALSE(reader.malformed());
+    }
+    return total;
+}
+
+static void test_full_status_splits_on_tlv_boundaries() {
+    BleStatus status;
+    fillStatus(&status);
+
+    // Default MTU: 20-byte notifications, every one self-contained
+    memset(&sent, 0, sizeof(sent));
+    BleFrameWriter writer(BLE_MSG_STATUS, BLE_FLAG_FULL, BLE_MTU_DEFAULT - BLE_ATT_OVERHEAD, capture, &sent);
+    bleEncodeStatus(status, nullptr, &writer);
+    size_t frames = writer.finish();
+    TEST_ASSERT_EQUAL_UINT32(sent.count, frames);
+    TEST_ASSERT_TRUE(frames > 1);
+
+    for (size_t f = 0; f < sent.count; f++) {
+        TEST_ASSERT_TRUE(sent.lengths[f] <= BLE_MTU_DEFAULT - BLE_ATT_OVERHEAD);
+        TEST_ASSERT_EQUAL_UINT8(BLE_PROTOCOL_VERSION, sent.frames[f][0]);
+        TEST_ASSERT_EQUAL_UINT8(BLE_MSG_STATUS, sent.frames[f][1]);
+        bool last = f == sent.count - 1;
+        TEST_ASSERT_EQUAL_UINT8(BLE_FLAG_FULL | (last ? 0 : BLE_FLAG_MORE),
+                                sent.frames[f][2] & ~BLE_FLAG_READ_FULL);
+    }
+    TEST_ASSERT_TRUE(sent.frames[sent.count - 1][2] & BLE_FLAG_READ_FULL);
+
+    // The 19-byte server name can't fit a 20-byte notification - read instead
+    const uint8_t* value = nullptr;
+    uint8_t length = 0;
+    countTlvs(BLE_STATUS_GATEWAY_SERVER, &value, &length);
+    TEST_ASSERT_NULL(value);
+    TEST_ASSERT_TRUE(writer.dropped());
+
+    // Negotiated MTU: one notification with everything
+    memset(&sent, 0, sizeof(sent));
+    BleFrameWriter big(BLE_MSG_STATUS, BLE_FLAG_FULL, BLE_MTU_MAX - BLE_ATT_OVERHEAD, capture, &sent);
+    bleEncodeStatus(status, nullptr, &big);
+    TEST_ASSERT_EQUAL_UINT32(1, big.finish());
+    TEST_ASSERT_EQUAL_UINT8(BLE_FLAG_FULL, sent.frames[0][2]);
+    TEST_ASSERT_EQUAL_UINT32(16, countTlvs(BLE_STATUS_GATEWAY_SERVER, &value, &length));
+    TEST_ASSERT_EQUAL_UINT8(strlen("gateway.example.com"), length);
+    TEST_ASSERT_EQUAL_MEMORY("gateway.example.com", value, length);
+}
+
+static void test_status_delta_carries_only_changes() {
+    BleStatus before, after;
+    fillStatus(&before);
+    memcpy(&after, &before, sizeof(after));
+
+    memset(&sent, 0, sizeof(sent));
+    BleFrameWriter writer(BLE_MSG_STATUS, 0, 20, capture, &sent);
+    bleEncodeStatus(after, &before, &writer);
+    TEST_ASSERT_EQUAL_UINT32(0, writer.finish());       // Nothing changed - nothing on air
+
+    after.volume = 55;
+    after.gatewayConnected = true;
+    bleEncodeStatus(after, &before, &writer);
+    TEST_ASSERT_EQUAL_UINT32(1, writer.finish());
+    TEST_ASSERT_EQUAL_UINT32(BLE_FRAME_HEADER + 2 * (BLE_TLV_HEADER + 1), sent.lengths[0]);
+
+    const uint8_t* value = nullptr;
+    uint8_t length = 0;
+    TEST_ASSERT_EQUAL_UINT32(2, countTlvs(BLE_STATUS_VOLUME, &value, &length));
+    TEST_ASSERT_EQUAL_UINT8(1, length);
+    TEST_ASSERT_EQUAL_UINT8(55, value[0]);
+}
+
+static void test_metrics_tags_and_deltas() {
+    uint32_t previous[6] = {1, 2, 3, 100, 200, 300};
+    uint32_t values[6] = {1, 5, 3, 100, 70000, 300};
+
+    memset(&sent, 0, sizeof(sent));
+    BleFrameWriter writer(BLE_MSG_METRICS, 0, 20, capture, &sent);
+    bleEncodeMetrics(values, previous, 6, 3, &writer);
+    TEST_ASSERT_EQUAL_UINT32(1, writer.finish());
+
+    // Counter 1 keeps its id, gauge 4 is the second gauge
+    const uint8_t expected[] = {
+        BLE_PROTOCOL_VERSION, BLE_MSG_METRICS, 0,
+        1, 4, 5, 0, 0, 0,
+        BLE_METRIC_GAUGE_TAG + 1, 4, 0x70, 0x11, 0x01, 0x00,
+    };
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected), sent.lengths[0]);
+    TEST_ASSERT_EQUAL_MEMORY(expected, sent.frames[0], sizeof(expected));
+
+    // Full snapshot at the smallest MTU: two 6-byte TLVs per notification
+    memset(&sent, 0, sizeof(sent));
+    bleEncodeMetrics(values, nullptr, 6, 3, &writer);
+    TEST_ASSERT_EQUAL_UINT32(3, writer.finish());
+    TEST_ASSERT_EQUAL_UINT32(6, countTlvs(0xFF, nullptr, nullptr));
+}
+
+static void test_config_decodes_and_ignores_unknown_tags() {
+    const uint8_t frame[] = {
+        BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0,
+        BLE_CONFIG_WIFI_SSID, 4, 'H', 'o', 'm', 'e',
+        0x7E, 2, 0xDE, 0xAD,                            // From a newer app
+        BLE_CONFIG_GATEWAY_PORT, 2, 0xB8, 0x0B,         // 3000
+        BLE_CONFIG_VOLUME, 1, 40,
+    };
+    BleConfig config;
+    TEST_ASSERT_EQUAL(BLE_ACK_OK, bleDecodeConfig(frame, sizeof(frame), &config));
+    TEST_ASSERT_EQUAL_UINT32(BLE_CONFIG_HAS_WIFI_SSID | BLE_CONFIG_HAS_GATEWAY_PORT | BLE_CONFIG_HAS_VOLUME,
+                             config.present);
+    TEST_ASSERT_EQUAL_STRING("Home", config.wifiSsid);
+    TEST_ASSERT_EQUAL_UINT16(3000, config.gatewayPort);
+    TEST_ASSERT_EQUAL_UINT8(40, config.volume);
+    TEST_ASSERT_TRUE((config.present & BLE_CONFIG_NETWORK_MASK) != 0);
+
+    // Volume on its own doesn't touch the network settings
+    const uint8_t volumeOnly[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_VOLUME, 1, 100};
+    TEST_ASSERT_EQUAL(BLE_ACK_OK, bleDecodeConfig(volumeOnly, sizeof(volumeOnly), &config));
+    TEST_ASSERT_EQUAL_UINT32(0, config.present & BLE_CONFIG_NETWORK_MASK);
+
+    // A fallback gateway list is network config
+    const uint8_t list[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0,
+                            BLE_CONFIG_GATEWAY_LIST, 11, 'g', 'w', '2', ':', '4', '4', '3', ',', 'g', 'w', '3'};
+    TEST_ASSERT_EQUAL(BLE_ACK_OK, bleDecodeConfig(list, sizeof(list), &config));
+    TEST_ASSERT_EQUAL_UINT32(BLE_CONFIG_HAS_GATEWAY_LIST, config.present);
+    TEST_ASSERT_EQUAL_STRING("gw2:443,gw3", config.gatewayList);
+    TEST_ASSERT_TRUE((config.present & BLE_CONFIG_NETWORK_MASK) != 0);
+}
+
+static void test_config_refuses_bad_writes() {
+    BleConfig config;
+
+    const uint8_t wrongVersion[] = {BLE_PROTOCOL_VERSION + 1, BLE_MSG_CONFIG, 0};
+    TEST_ASSERT_EQUAL(BLE_ACK_MALFORMED, bleDecodeConfig(wrongVersion, sizeof(wrongVersion), &config));
+    const uint8_t hello[] = {BLE_PROTOCOL_VERSION, BLE_MSG_HELLO, 0};
+    TEST_ASSERT_EQUAL(BLE_ACK_MALFORMED, bleDecodeConfig(hello, sizeof(hello), &config));
+    TEST_ASSERT_EQUAL(BLE_ACK_MALFORMED, bleDecodeConfig(hello, 2, &config));
+
+    // TLV runs past the end of the write
+    const uint8_t overrun[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_WIFI_SSID, 9, 'a', 'b'};
+    TEST_ASSERT_EQUAL(BLE_ACK_MALFORMED, bleDecodeConfig(overrun, sizeof(overrun), &config));
+    const uint8_t dangling[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_VOLUME};
+    TEST_ASSERT_EQUAL(BLE_ACK_MALFORMED, bleDecodeConfig(dangling, sizeof(dangling), &config));
+
+    const uint8_t loud[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_VOLUME, 1, 101};
+    TEST_ASSERT_EQUAL(BLE_ACK_BAD_VALUE, bleDecodeConfig(loud, sizeof(loud), &config));
+    const uint8_t shortPort[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_GATEWAY_PORT, 1, 80};
+    TEST_ASSERT_EQUAL(BLE_ACK_BAD_VALUE, bleDecodeConfig(shortPort, sizeof(shortPort), &config));
+    const uint8_t wakeMode[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_WAKE_MODE, 1, 7};
+    TEST_ASSERT_EQUAL(BLE_ACK_BAD_VALUE, bleDecodeConfig(wakeMode, sizeof(wakeMode), &config));
+    const uint8_t badList[] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0, BLE_CONFIG_GATEWAY_LIST, 9,
+                               'g', 'w', '2', ',', 'g', 'w', ':', '9', 'x'};
+    TEST_ASSERT_EQUAL(BLE_ACK_BAD_VALUE, bleDecodeConfig(badList, sizeof(badList), &config));
+
+    // A 32-byte SSID doesn't fit the stored 31 + NUL - refused, not truncated
+    uint8_t longSsid[BLE_FRAME_HEADER + BLE_TLV_HEADER + 32] = {BLE_PROTOCOL_VERSION, BLE_MSG_CONFIG, 0,
+                                                               BLE_CONFIG_WIFI_SSID, 32};
+    memset(longSsid + 5, 'x', 32);
+    TEST_ASSERT_EQUAL(BLE_ACK_BAD_VALUE, bleDecodeConfig(longSsid, sizeof(longSsid), &config));
+    TEST_ASSERT_EQUAL_UINT32(0, config.present);
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_status_splits_on_tlv_boundaries);
+    RUN_TEST(test_status_delta_carries_only_changes);
+    RUN_TEST(test_metrics_tags_and_deltas);
+    RUN_TEST(test_config_decodes_and_ignores_unknown_tags);
+    RUN_TEST(test_config_refuses_bad_writes);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,206 @@
+/**
+ * Gateway selection: the RFC1918 check behind ws/wss, endpoint and list
+ * parsing, RTT ranking, per-endpoint backoff with jitter and the failover
+ * spread after a loss.
+ *
+ * Run on the host:  pio test -e native -f test_gateway_select
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_gateway_select
+ */
+#include <unity.h>
+#include <string.h>
+#include "gateway_select.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/gateway_select.cpp"
+
+static void test_local_network_is_rfc1918_loopback_and_link_local() {
+    TEST_ASSERT_TRUE(isLocalNetworkHost("10.0.0.2"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("172.16.0.1"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("172.31.255.254"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("192.168.1.20"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("127.0.0.1"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("169.254.3.4"));
+    TEST_ASSERT_TRUE(isLocalNetworkHost("LocalHost"));
+
+    // Public 172.x outside 172.16/12, and look-alikes
+    TEST_ASSERT_FALSE(isLocalNetworkHost("172.15.0.1"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("172.32.0.1"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("172.217.4.46"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("192.169.0.1"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("10.example.com"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("192.168.1"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("192.168.1.256"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("10.0.0.1.5"));
+    TEST_ASSERT_FALSE(isLocalNetworkHost("gateway.local"));
+}
+
+static void test_endpoint_parsing() {
+    GatewayEndpoint e;
+    const char* text = " wss://gw.example.com:8443/ ";
+    TEST_ASSERT_TRUE(parseGatewayEndpoint(text, strlen(text), 3000, &e));
+    TEST_ASSERT_EQUAL_STRING("gw.example.com", e.host);
+    TEST_ASSERT_EQUAL_UINT16(8443, e.port);
+    TEST_ASSERT_TRUE(e.tls);
+
+    text = "192.168.1.5";
+    TEST_ASSERT_TRUE(parseGatewayEndpoint(text, strlen(text), 3000, &e));
+    TEST_ASSERT_EQUAL_UINT16(3000, e.port);
+    TEST_ASSERT_FALSE(e.tls);
+
+    // No scheme: public addresses get TLS, an explicit ws:// doesn't
+    text = "172.217.4.46";
+    TEST_ASSERT_TRUE(parseGatewayEndpoint(text, strlen(text), 3000, &e));
+    TEST_ASSERT_TRUE(e.tls);
+    text = "ws://gw.example.com";
+    TEST_ASSERT_TRUE(parseGatewayEndpoint(text, strlen(text), 3000, &e));
+    TEST_ASSERT_FALSE(e.tls);
+
+    const char* bad[] = {"", "wss://", "gw:0", "gw:65536", "gw:", "gw:80x", "gw/path", "[::1]:80", "a b"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        TEST_ASSERT_FALSE_MESSAGE(parseGatewayEndpoint(bad[i], strlen(bad[i]), 3000, &e), bad[i]);
+    }
+}
+
+static void test_list_parsing_skips_duplicates_and_caps() {
+    TEST_ASSERT_TRUE(isValidGatewayList(""));
+    TEST_ASSERT_TRUE(isValidGatewayList("a:1, wss://b ,"));
+    TEST_ASSERT_FALSE(isValidGatewayList("a:1,gw/path"));
+
+    GatewaySelector selector;
+    size_t n = selector.configure("ws://10.0.0.2/", 3000, "10.0.0.2:3000,10.0.0.3,gw.example.com:443,d,e");
+    TEST_ASSERT_EQUAL(GATEWAY_MAX_ENDPOINTS, n);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.2", selector.endpoint(0).host);
+    TEST_ASSERT_EQUAL_STRING("10.0.0.3", selector.endpoint(1).host);
+    TEST_ASSERT_EQUAL_UINT16(3000, selector.endpoint(1).port);
+    TEST_ASSERT_EQUAL_STRING("gw.example.com", selector.endpoint(2).host);
+    TEST_ASSERT_TRUE(selector.endpoint(2).tls);
+    TEST_ASSERT_EQUAL_STRING("d", selector.endpoint(3).host);
+
+    TEST_ASSERT_EQUAL(0, selector.configure("", 3000, nullptr));
+    TEST_ASSERT_EQUAL(-1, selector.select(0));
+}
+
+static void test_lowest_rtt_wins() {
+    GatewaySelector selector;
+    selector.configure("a", 3000, "b,c,d");
+    TEST_ASSERT_EQUAL(0, selector.select(0));      // Nothing measured: list order
+
+    selector.setRtt(0, GATEWAY_RTT_FAILED);
+    selector.setRtt(1, 40);
+    selector.setRtt(3, 12);
+    TEST_ASSERT_EQUAL(3, selector.select(0));
+
+    // Measured beats unknown beats unreachable
+    selector.setRtt(1, GATEWAY_RTT_FAILED);
+    selector.setRtt(3, GATEWAY_RTT_FAILED);
+    TEST_ASSERT_EQUAL(2, selector.select(0));
+    selector.setRtt(2, GATEWAY_RTT_FAILED);
+    TEST_ASSERT_EQUAL(0, selector.select(0));
+}
+
+static void test_faster_gateway_needs_a_margin() {
+    GatewaySelector selector;
+    selector.configure("a", 3000, "b");
+    selector.setRtt(0, 30);
+    selector.setRtt(1, 15);
+    TEST_ASSERT_EQUAL(-1, selector.fasterThan(0, 0));   // 15ms better, margin is 20
+
+    selector.setRtt(1, 9);
+    TEST_ASSERT_EQUAL(1, selector.fasterThan(0, 0));
+    TEST_ASSERT_EQUAL(-1, selector.fasterThan(1, 0));
+
+    selector.setRtt(0, GATEWAY_RTT_FAILED);
+    selector.setRtt(1, 200);
+    TEST_ASSERT_EQUAL(1, selector.fasterThan(0, 0));
+}
+
+static void test_backoff_doubles_with_bounded_jitter() {
+    for (uint8_t failures = 1; failures < 12; failures++) {
+        uint32_t nominal = GATEWAY_BACKOFF_BASE_MS << (failures - 1);
+        if (nominal > GATEWAY_BACKOFF_MAX_MS) nominal = GATEWAY_BACKOFF_MAX_MS;
+
+        TEST_ASSERT_EQUAL_UINT32(nominal / 2, gatewayBackoffMs(failures, 0));
+        TEST_ASSERT_EQUAL_UINT32(nominal, gatewayBackoffMs(failures, nominal - nominal / 2));
+        for (uint32_t r = 1; r < 100000; r += 7919) {
+            uint32_t delay = gatewayBackoffMs(failures, r);
+            TEST_ASSERT_TRUE(delay >= nominal / 2 && delay <= nominal);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(GATEWAY_BACKOFF_MAX_MS, gatewayBackoffMs(255, GATEWAY_BACKOFF_MAX_MS / 2));
+}
+
+static void test_failover_waits_out_the_spread_then_skips_the_failed_gateway() {
+    GatewaySelector selector;
+    selector.configure("a", 3000, "b");
+    selector.setRtt(0, 5);
+    selector.setRtt(1, 50);
+
+    uint32_t now = 100000;
+    selector.onConnected(now);
+    now += 60000;
+
+    // Spread of 700ms (high half), backoff jitter 0 (low half)
+    selector.onDisconnected(0, now, 700u << 16);
+    TEST_ASSERT_EQUAL_UINT8(1, selector.failures(0));   // Long session: backoff starts over
+    TEST_ASSERT_EQUAL(-1, selector.select(now + 699));
+    TEST_ASSERT_EQUAL(1, selector.select(now + 700));   // Hot failover to the slower one
+
+    // Back on the fast one once its backoff runs out
+    TEST_ASSERT_EQUAL(0, selector.select(now + GATEWAY_BACKOFF_BASE_MS / 2));
+}
+
+static void test_flapping_gateway_keeps_backing_off() {
+    GatewaySelector selector;
+    selector.configure("a", 3000, nullptr);
+
+    uint32_t now = 5000;
+    uint32_t waits[4];
+    for (int i = 0; i < 4; i++) {
+        selector.onConnected(now);
+        now += 1000;                                // Drops well before GATEWAY_STABLE_MS
+        selector.onDisconnected(0, now, 0);
+        waits[i] = 0;
+        while (selector.select(now + waits[i]) < 0) waits[i] += 100;
+        now += waits[i];
+    }
+    TEST_ASSERT_EQUAL_UINT8(4, selector.failures(0));
+    for (int i = 1; i < 4; i++) {
+        TEST_ASSERT_EQUAL_UINT32(waits[i - 1] * 2, waits[i]);
+    }
+
+    // Failed attempts count the same way, and survive millis() wrapping
+    selector.configure("a", 3000, nullptr);
+    now = 0xFFFFFF00u;
+    selector.onFailure(0, now, 0);
+    TEST_ASSERT_EQUAL(-1, selector.select(now + 10));
+    TEST_ASSERT_EQUAL(0, selector.select(now + GATEWAY_BACKOFF_BASE_MS / 2));
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_local_network_is_rfc1918_loopback_and_link_local);
+    RUN_TEST(test_endpoint_parsing);
+    RUN_TEST(test_list_parsing_skips_duplicates_and_caps);
+    RUN_TEST(test_lowest_rtt_wins);
+    RUN_TEST(test_faster_gateway_needs_a_margin);
+    RUN_TEST(test_backoff_doubles_with_bounded_jitter);
+    RUN_TEST(test_failover_waits_out_the_spread_then_skips_the_failed_gateway);
+    RUN_TEST(test_flapping_gateway_keeps_backing_off);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
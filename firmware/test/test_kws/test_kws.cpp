@@ -0,0 +1,240 @@
+/**
+ * Keyword spotting: frontend framing and determinism, blob validation, the
+ * int8 interpreter on a hand-built model, and the detector's trigger logic.
+ *
+ * Run on the host:  pio test -e native -f test_kws
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_kws
+ */
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "kws.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/kws.cpp"
+
+#define WINDOW_VALUES (KWS_WINDOW_FRAMES * KWS_MFCC_COEFFS)
+
+static int16_t audio[KWS_SAMPLE_RATE];
+static int8_t windowA[WINDOW_VALUES];
+static int8_t windowB[WINDOW_VALUES];
+
+static void fillTone(int16_t* buf, size_t count, float hz, float amplitude) {
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = (int16_t)(amplitude * sinf(2.0f * (float)M_PI * hz * (float)i / KWS_SAMPLE_RATE));
+    }
+}
+
+// ============================================================================
+// A tiny model: 1x1 conv (identity) -> global average pool -> FC to two
+// logits, +mean for the keyword and -mean for the other class
+// ============================================================================
+
+struct TinyModel {
+    KwsModelHeader header;
+    KwsLayerHeader conv;
+    int8_t convWeight[1];
+    int32_t convBias[1];
+    KwsLayerHeader pool;
+    KwsLayerHeader fc;
+    int8_t fcWeight[2];
+    int32_t fcBias[2];
+} __attribute__((packed));
+
+static TinyModel tiny;
+
+static KwsLayerHeader identityLayer(KwsLayerType type, uint16_t outChannels) {
+    KwsLayerHeader l;
+    memset(&l, 0, sizeof(l));
+    l.type = type;
+    l.kernelH = l.kernelW = 1;
+    l.strideH = l.strideW = 1;
+    l.outChannels = outChannels;
+    l.outputMultiplier = 1 << 30;   // 0.5 * 2^1 = 1.0
+    l.outputShift = 1;
+    return l;
+}
+
+static void buildTinyModel() {
+    memset(&tiny, 0, sizeof(tiny));
+    tiny.header.magic = KWS_MODEL_MAGIC;
+    tiny.header.version = 1;
+    tiny.header.numLayers = 3;
+    tiny.header.numClasses = 2;
+    tiny.header.keywordClass = 1;
+    tiny.header.inputFrames = KWS_WINDOW_FRAMES;
+    tiny.header.inputCoeffs = KWS_MFCC_COEFFS;
+    tiny.header.inputScale = 1.0f;
+    tiny.header.outputScale = 0.1f;
+    tiny.header.arenaBytes = WINDOW_VALUES;
+
+    tiny.conv = identityLayer(KWS_LAYER_CONV, 1);
+    tiny.convWeight[0] = 1;
+    tiny.pool = identityLayer(KWS_LAYER_AVGPOOL, 0);
+    tiny.fc = identityLayer(KWS_LAYER_FC, 2);
+    tiny.fcWeight[0] = -1;
+    tiny.fcWeight[1] = 1;
+}
+
+static void test_frontend_frames_on_the_hop() {
+    KwsFrontend frontend;
+    memset(audio, 0, sizeof(audio));
+
+    // The first frame needs a full window, then one per hop
+    TEST_ASSERT_EQUAL_UINT32(0, frontend.push(audio, KWS_FRAME_LEN - 1));
+    TEST_ASSERT_EQUAL_UINT32(1, frontend.push(audio, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, frontend.push(audio, KWS_FRAME_HOP - 1));
+    TEST_ASSERT_EQUAL_UINT32(1, frontend.push(audio, 1));
+    TEST_ASSERT_EQUAL_UINT32(3, frontend.push(audio, 3 * KWS_FRAME_HOP));
+    TEST_ASSERT_EQUAL_UINT32(5, frontend.frameCount());
+
+    frontend.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, frontend.frameCount());
+    TEST_ASSERT_EQUAL_UINT32(1 + (KWS_SAMPLE_RATE - KWS_FRAME_LEN) / KWS_FRAME_HOP,
+                             frontend.push(audio, KWS_SAMPLE_RATE));
+}
+
+static void test_frontend_block_size_does_not_matter() {
+    for (size_t i = 0; i < KWS_SAMPLE_RATE; i++) {
+        // A chirp, so every window differs from its neighbours
+        float t = (float)i / KWS_SAMPLE_RATE;
+        audio[i] = (int16_t)(8000.0f * sinf(2.0f * (float)M_PI * (300.0f + 1500.0f * t) * t));
+    }
+
+    KwsFrontend reference;
+    reference.push(audio, KWS_SAMPLE_RATE);
+    reference.window(windowA, 0.25f, 0);
+
+    const size_t blocks[] = {1, 160, KWS_FRAME_HOP, 512, 1000};
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        KwsFrontend frontend;
+        for (size_t pos = 0; pos < KWS_SAMPLE_RATE; pos += blocks[b]) {
+            size_t n = KWS_SAMPLE_RATE - pos < blocks[b] ? KWS_SAMPLE_RATE - pos : blocks[b];
+            frontend.push(audio + pos, n);
+        }
+        TEST_ASSERT_EQUAL_UINT32(reference.frameCount(), frontend.frameCount());
+        frontend.window(windowB, 0.25f, 0);
+        TEST_ASSERT_EQUAL_MEMORY(windowA, windowB, sizeof(windowA));
+    }
+}
+
+static void test_frontend_separates_silence_from_a_tone() {
+    KwsFrontend frontend;
+    memset(audio, 0, sizeof(audio));
+    frontend.push(audio, KWS_SAMPLE_RATE);
+    frontend.window(windowA, 4.0f, 0);     // Coarse enough that C0 doesn't clip
+
+    // Steady input gives the same row every frame
+    for (size_t r = 1; r < KWS_WINDOW_FRAMES; r++) {
+        TEST_ASSERT_EQUAL_MEMORY(windowA, windowA + r * KWS_MFCC_COEFFS, KWS_MFCC_COEFFS);
+    }
+
+    fillTone(audio, KWS_SAMPLE_RATE, 1000.0f, 8000.0f);
+    frontend.reset();
+    frontend.push(audio, KWS_SAMPLE_RATE);
+    frontend.window(windowB, 4.0f, 0);
+    // C0 tracks log energy
+    TEST_ASSERT_TRUE(windowB[(KWS_WINDOW_FRAMES - 1) * KWS_MFCC_COEFFS] >
+                     windowA[(KWS_WINDOW_FRAMES - 1) * KWS_MFCC_COEFFS]);
+}
+
+static void test_model_rejects_malformed_blobs() {
+    KwsModel model;
+    buildTinyModel();
+    TEST_ASSERT_TRUE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+    TEST_ASSERT_EQUAL_UINT32(2 * WINDOW_VALUES, model.arenaBytes());
+
+    TEST_ASSERT_FALSE(model.load(nullptr, sizeof(tiny)));
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny) - 1));     // Truncated bias
+    TEST_ASSERT_FALSE(model.loaded());
+    TEST_ASSERT_EQUAL_UINT32(0, model.arenaBytes());
+
+    tiny.header.magic ^= 1;
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+
+    buildTinyModel();
+    tiny.header.inputFrames = KWS_WINDOW_FRAMES - 1;
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+
+    buildTinyModel();
+    tiny.header.keywordClass = 2;
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+
+    buildTinyModel();
+    tiny.header.numClasses = 3;     // Network only produces two logits
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+
+    buildTinyModel();
+    tiny.header.arenaBytes = WINDOW_VALUES - 1;
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+
+    buildTinyModel();
+    tiny.pool.type = 9;
+    TEST_ASSERT_FALSE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+}
+
+static void test_model_runs_the_tiny_network() {
+    KwsModel model;
+    buildTinyModel();
+    TEST_ASSERT_TRUE(model.load((const uint8_t*)&tiny, sizeof(tiny)));
+    static int8_t arena[2 * WINDOW_VALUES];
+
+    // Mean 10 -> logits (-1.0, +1.0) -> softmax 1 / (1 + e^-2)
+    memset(windowA, 10, sizeof(windowA));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1.0f / (1.0f + expf(-2.0f)), model.run(windowA, arena));
+
+    memset(windowA, 0, sizeof(windowA));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.5f, model.run(windowA, arena));
+
+    // Not loaded - never a detection
+    model.load(nullptr, 0);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, model.run(windowA, arena));
+}
+
+static void test_detector_smooths_and_holds_off() {
+    KwsDetector detector(0.9f, 3, 2);
+
+    // One spike averages to a third of itself from cold
+    TEST_ASSERT_FALSE(detector.update(1.0f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f / 3.0f, detector.smoothedScore());
+    TEST_ASSERT_FALSE(detector.update(0.0f));
+    TEST_ASSERT_FALSE(detector.update(0.0f));
+    detector.reset();
+
+    // A sustained keyword triggers once per smoothing window plus refractory
+    int triggers = 0;
+    for (int i = 1; i <= 9; i++) {
+        if (detector.update(1.0f)) {
+            triggers++;
+            TEST_ASSERT_EQUAL_INT(0, i % 3);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(3, triggers);
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_frontend_frames_on_the_hop);
+    RUN_TEST(test_frontend_block_size_does_not_matter);
+    RUN_TEST(test_frontend_separates_silence_from_a_tone);
+    RUN_TEST(test_model_rejects_malformed_blobs);
+    RUN_TEST(test_model_runs_the_tiny_network);
+    RUN_TEST(test_detector_smooths_and_holds_off);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,395 @@
+#include "replay.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <string.h>
+#include "audio.h"
+#include "audio_dsp.h"
+#include "audio_i2s.h"
+#include "block_ring.h"
+#include "jitter_buffer.h"
+#include "playback_control.h"
+#include "vad.h"
+#include "voice_protocol.h"
+
+// Tests build without src/ (test_build_src = no), so pull the modules in directly
+#include "../../src/audio_codec.cpp"
+#include "../../src/audio_dsp.cpp"
+#include "../../src/jitter_buffer.cpp"
+#include "../../src/playback_control.cpp"
+#include "../../src/vad.cpp"
+#include "../../src/voice_protocol.cpp"
+#include "../native/audio_i2s_shim.cpp"
+#include "../native/audio_pool_shim.cpp"
+#include "../native/wav.cpp"
+#include "../native/ws_trace.cpp"
+
+/**
+ * Everything the voice client and the playback task keep between events
+ */
+struct Downlink {
+    ReplayDownlinkReport* report;
+    JitterBuffer jitter;
+    BlockRing<int16_t> ring;
+    AudioDecoder decoder;
+
+    size_t startThreshold;
+    size_t targetLead;
+    bool responseFirstFrame;
+    uint64_t firstArrivalUs;
+    size_t receiving;           // Index of the response frames go to
+
+    // Playback task
+    PlaybackControl control;
+    bool streamFinished;
+    bool gapsRecorded;          // Draining - the rest is the amp playing out its queue
+    uint32_t responseUnderruns;
+    size_t playingIndex;
+    uint64_t starvedAtStart;
+    int16_t chunk[PLAYBACK_CHUNK_SAMPLES];
+    size_t chunkLen;
+    size_t chunkPos;
+
+    Downlink()
+        : jitter(REPLAY_SAMPLE_RATE),
+          control(REPLAY_SAMPLE_RATE, AUDIO_DMA_BUF_COUNT * AUDIO_DMA_BUF_LEN, AUDIO_DMA_BUF_LEN) {}
+};
+
+static ReplayResponse& currentResponse(Downlink& d) {
+    if (d.report->responses.empty()) {
+        d.report->responses.push_back(ReplayResponse());
+        d.receiving = 0;
+    }
+    return d.report->responses[d.receiving];
+}
+
+static void applyJitterPicks(Downlink& d) {
+    d.startThreshold = d.jitter.startThresholdSamples();
+    d.targetLead = d.jitter.targetLeadSamples();
+}
+
+/**
+ * finishJitterResponse() in voice_client.cpp
+ */
+static void finishJitterResponse(Downlink& d) {
+    d.jitter.endResponse(d.responseUnderruns);
+    applyJitterPicks(d);
+
+    JitterBufferStats stats;
+    d.jitter.getStats(&stats);
+    ReplayResponse& response = currentResponse(d);
+    response.jitterMs = stats.jitterMs;
+    response.peakLateMs = stats.peakLateMs;
+}
+
+static void recordGaps(Downlink& d) {
+    if (d.gapsRecorded) return;
+    ReplayResponse& response = d.report->responses[d.playingIndex];
+    response.gapMs = (uint32_t)((hostI2sSpeakerStarvedSamples() - d.starvedAtStart) * 1000 / REPLAY_SAMPLE_RATE);
+    d.gapsRecorded = true;
+}
+
+static void stopSpeaker(Downlink& d) {
+    recordGaps(d);      // Unless draining already did, before the tail
+    audioI2sSpeakerStop();
+    d.control.stop();
+    d.streamFinished = false;
+    d.report->endUs = hostClockUs;
+}
+
+static void pushSamples(Downlink& d, const int16_t* pcm, size_t samples) {
+    size_t written = d.ring.write(pcm, samples);
+    currentResponse(d).samples += (uint32_t)written;
+    d.report->droppedSamples += (uint32_t)(samples - written);
+}
+
+/**
+ * WStype_BIN: jitter bookkeeping, then decode into the playback ring
+ */
+static void receiveBinary(Downlink& d, const WsTraceFrame& frame) {
+    const uint8_t* payload = frame.payload.data();
+    size_t length = frame.payload.size();
+    AudioCodec codec = d.report->codec;
+
+    d.jitter.onFrame(frame.arrivalUs, audioCodecEstimateSamples(codec, length));
+    applyJitterPicks(d);
+    currentResponse(d).frames++;
+    if (d.responseFirstFrame) {
+        d.responseFirstFrame = false;
+        d.firstArrivalUs = frame.arrivalUs;
+    }
+
+    if (codec == AUDIO_CODEC_PCM16) {
+        int16_t pcm[AUDIO_CODEC_MAX_DECODED];
+        for (size_t offset = 0; offset + 1 < length;) {
+            size_t samples = (length - offset) / 2;
+            if (samples > AUDIO_CODEC_MAX_DECODED) samples = AUDIO_CODEC_MAX_DECODED;
+            memcpy(pcm, payload + offset, samples * 2);
+            pushSamples(d, pcm, samples);
+            offset += samples * 2;
+        }
+        return;
+    }
+
+    // Length-prefixed packets, as the decoder task splits them
+    int16_t pcm[AUDIO_CODEC_MAX_DECODED];
+    size_t pos = 0;
+    while (pos + 2 <= length) {
+        size_t len = payload[pos] | (size_t)payload[pos + 1] << 8;
+        pos += 2;
+        if (len > length - pos) {
+            d.report->decodeErrors++;
+            return;
+        }
+        size_t samples = audioDecoderDecode(&d.decoder, payload + pos, len, pcm, AUDIO_CODEC_MAX_DECODED);
+        if (samples == 0) {
+            d.report->decodeErrors++;
+        } else {
+            pushSamples(d, pcm, samples);
+        }
+        pos += len;
+    }
+}
+
+/**
+ * WStype_TEXT: the handleServerMessage() cases that touch the downlink
+ */
+static void receiveText(Downlink& d, const WsTraceFrame& frame) {
+    d.report->textFrames++;
+
+    VoiceMessageType type;
+    JsonVariantConst msg = voiceProtocolParse(frame.payload.data(), frame.payload.size(), &type);
+    if (msg.isNull()) {
+        d.report->parseErrors++;
+        return;
+    }
+
+    switch (type) {
+        case VOICE_MSG_RESPONSE:
+            d.jitter.beginResponse();
+            d.responseFirstFrame = true;
+            d.report->responses.push_back(ReplayResponse());
+            d.receiving = d.report->responses.size() - 1;
+            break;
+
+        case VOICE_MSG_DONE:
+            d.streamFinished = true;
+            finishJitterResponse(d);
+            break;
+
+        case VOICE_MSG_INTERRUPT:
+            d.ring.discardAll();
+            d.chunkLen = d.chunkPos = 0;
+            audioI2sSpeakerSilence();
+            if (d.control.playing()) stopSpeaker(d);
+            finishJitterResponse(d);
+            break;
+
+        case VOICE_MSG_CONFIG: {
+            AudioCodec codec;
+            const char* name = msg["downlinkCodec"];
+            if (name != nullptr && audioCodecFromName(name, &codec) && audioDecoderInit(&d.decoder, codec)) {
+                d.report->codec = codec;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * Hand the rest of the current chunk to the amp - it takes what fits, the
+ * rest waits for the next pass (audioI2sSpeakerWrite blocking on the board)
+ */
+static void writeChunk(Downlink& d) {
+    size_t want = d.chunkLen - d.chunkPos;
+    size_t written = audioI2sSpeakerWrite(d.chunk + d.chunkPos, want);
+    d.control.onSpeakerWrite(written, hostClockUs, written < want);
+    d.chunkPos += written;
+}
+
+/**
+ * One pass of audioPlaybackTask at the current clock
+ */
+static void playbackStep(Downlink& d) {
+    uint64_t now = hostClockUs;
+
+    // Still handing the last chunk to the amp (i2s write blocking)
+    if (d.chunkPos < d.chunkLen) {
+        writeChunk(d);
+        return;
+    }
+
+    PlaybackInput input;
+    input.buffered = d.ring.available();
+    input.streamFinished = d.streamFinished;
+    input.startThreshold = d.startThreshold;
+    input.targetLead = d.targetLead;
+    input.nowUs = now;
+
+    size_t samples = 0;
+    switch (d.control.step(input, &samples)) {
+        case PLAYBACK_START: {
+            d.responseUnderruns = 0;
+            d.playingIndex = d.receiving;
+            d.gapsRecorded = false;
+
+            ReplayResponse& response = currentResponse(d);
+            response.played = true;
+            response.startDelayMs = (uint32_t)((now - d.firstArrivalUs) / 1000);
+            response.startThresholdMs = (uint32_t)(d.startThreshold * 1000 / REPLAY_SAMPLE_RATE);
+            response.targetLeadMs = (uint32_t)(d.targetLead * 1000 / REPLAY_SAMPLE_RATE);
+            d.starvedAtStart = hostI2sSpeakerStarvedSamples();
+            audioI2sSpeakerStart();
+            break;
+        }
+
+        case PLAYBACK_WRITE:
+            break;
+
+        case PLAYBACK_UNDERRUN:
+            d.responseUnderruns++;
+            d.report->responses[d.playingIndex].underruns++;
+            return;
+
+        case PLAYBACK_FINISHED:
+        case PLAYBACK_TIMEOUT:
+            stopSpeaker(d);
+            return;
+
+        default:
+            // Nothing can starve the amp once the ring is done - the rest is its queue
+            if (d.control.draining()) recordGaps(d);
+            return;
+    }
+
+    d.chunkLen = d.ring.read(d.chunk, samples);
+    d.chunkPos = 0;
+    writeChunk(d);
+}
+
+void replayDownlink(const WsTrace& trace, ReplayDownlinkReport* report) {
+    *report = ReplayDownlinkReport();
+    report->codec = AUDIO_CODEC_PCM16;
+
+    Downlink d;
+    d.report = report;
+    d.ring.init(AUDIO_POOL_PSRAM, REPLAY_PLAYBACK_RING_SIZE);
+    audioDecoderInit(&d.decoder, AUDIO_CODEC_PCM16);
+    d.startThreshold = REPLAY_START_THRESHOLD;
+    d.targetLead = REPLAY_START_THRESHOLD;
+    d.responseFirstFrame = true;
+    d.firstArrivalUs = 0;
+    d.receiving = 0;
+    d.control.stop();
+    d.streamFinished = d.gapsRecorded = false;
+    d.responseUnderruns = 0;
+    d.playingIndex = 0;
+    d.chunkLen = d.chunkPos = 0;
+
+    // Recorded order is arrival order, but a hand-edited trace may not be
+    std::vector<const WsTraceFrame*> frames;
+    for (const WsTraceFrame& frame : trace.frames()) frames.push_back(&frame);
+    std::stable_sort(frames.begin(), frames.end(), [](const WsTraceFrame* a, const WsTraceFrame* b) {
+        return a->arrivalUs < b->arrivalUs;
+    });
+
+    uint64_t now = frames.empty() ? 0 : frames[0]->arrivalUs;
+    hostClockSetUs(now);
+    audioI2sSpeakerBegin(AUDIO_DMA_BUF_COUNT, AUDIO_DMA_BUF_LEN);
+
+    size_t next = 0;
+    while (true) {
+        while (next < frames.size() && frames[next]->arrivalUs <= now) {
+            const WsTraceFrame& frame = *frames[next++];
+            if (frame.binary) {
+                receiveBinary(d, frame);
+            } else {
+                receiveText(d, frame);
+            }
+        }
+
+        playbackStep(d);
+
+        bool busy = d.control.playing() || (d.streamFinished && d.ring.available() > 0);
+        if (!busy) {
+            if (next == frames.size()) break;
+            // Idle - skip straight to the next arrival (on the poll grid)
+            uint64_t arrival = frames[next]->arrivalUs;
+            if (arrival > now + REPLAY_TICK_US) {
+                now += (arrival - now) / REPLAY_TICK_US * REPLAY_TICK_US;
+            }
+        }
+        now += REPLAY_TICK_US;
+        hostClockSetUs(now);
+    }
+
+    report->output = hostI2sSpeakerOutput();
+    d.ring.init(AUDIO_POOL_PSRAM, REPLAY_PLAYBACK_RING_SIZE);  // Give the blocks back
+}
+
+void replayUplink(const int16_t* pcm, size_t count, bool lowLatency, ReplayUplinkReport* report) {
+    *report = ReplayUplinkReport();
+
+    hostClockSetUs(0);
+    hostI2sMicSource(pcm, count);
+    if (lowLatency) {
+        audioI2sMicBegin(AUDIO_RX_LOW_LATENCY_DESC, AUDIO_RX_LOW_LATENCY_FRAMES);
+    } else {
+        audioI2sMicBegin(AUDIO_RX_POWER_SAVE_DESC, AUDIO_RX_POWER_SAVE_FRAMES);
+    }
+
+    static Vad vad(REPLAY_SAMPLE_RATE);
+    vad.reset();
+    static int32_t raw[AUDIO_CAPTURE_CHUNK];
+    static int16_t frame[AUDIO_CAPTURE_CHUNK];
+    uint64_t samples = 0;
+    bool speech = false;
+    int64_t doneUs;
+
+    size_t n;
+    while ((n = audioI2sMicRead(raw, AUDIO_CAPTURE_CHUNK, &doneUs)) > 0) {
+        audioDspS32ToS16(raw, frame, n);
+        samples += n;
+        report->frames++;
+
+        bool active = vad.process(frame, n);
+        uint32_t ms = (uint32_t)(samples * 1000 / REPLAY_SAMPLE_RATE);
+        if (active && !speech) {
+            report->speech.push_back(ReplaySegment{ms, 0});
+        } else if (!active && speech) {
+            report->speech.back().endMs = ms;
+        }
+        speech = active;
+    }
+
+    report->durationMs = (uint32_t)(samples * 1000 / REPLAY_SAMPLE_RATE);
+    if (speech) report->speech.back().endMs = report->durationMs;
+}
+
+void replayPrintDownlink(FILE* out, const ReplayDownlinkReport& report) {
+    fprintf(out, "downlink: codec=%s text=%u parseErrors=%u decodeErrors=%u dropped=%u end=%llums\n",
+            audioCodecName(report.codec), report.textFrames, report.parseErrors, report.decodeErrors,
+            report.droppedSamples, (unsigned long long)(report.endUs / 1000));
+    for (size_t i = 0; i < report.responses.size(); i++) {
+        const ReplayResponse& r = report.responses[i];
+        fprintf(out, "  response %u: frames=%u audio=%ums", (unsigned)i, r.frames,
+                r.samples * 1000 / REPLAY_SAMPLE_RATE);
+        if (r.played) {
+            fprintf(out, " start=%ums (threshold %ums, lead %ums) underruns=%u gaps=%ums",
+                    r.startDelayMs, r.startThresholdMs, r.targetLeadMs, r.underruns, r.gapMs);
+        } else {
+            fprintf(out, " not played");
+        }
+        fprintf(out, " jitter=%ums late=%ums\n", r.jitterMs, r.peakLateMs);
+    }
+}
+
+void replayPrintUplink(FILE* out, const ReplayUplinkReport& report) {
+    fprintf(out, "uplink: %ums in %u mic frames, %u speech segments\n",
+            report.durationMs, report.frames, (unsigned)report.speech.size());
+    for (const ReplaySegment& segment : report.speech) {
+        fprintf(out, "  speech %u-%ums\n", segment.startMs, segment.endMs);
+    }
+}
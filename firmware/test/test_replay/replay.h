@@ -0,0 +1,84 @@
+#ifndef MOTE_REPLAY_H
+#define MOTE_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "audio_codec.h"
+#include "../native/ws_trace.h"
+
+/**
+ * Deterministic replay of the voice pipeline on the host
+ *
+ * Downlink: a WebSocket trace is delivered on its recorded arrival times to
+ * the same code the board runs - voice_protocol parsing and dispatch, the
+ * codec, BlockRing, JitterBuffer - and the playback task's PlaybackControl,
+ * polled every 5ms like audioPlaybackTask, against the I2S shim's speaker
+ * queue.
+ *
+ * Uplink: a mic recording is read through the I2S shim in the board's DMA
+ * frame geometry, converted like the capture task does, and run through
+ * the VAD; speech segments are reported at frame resolution.
+ *
+ * Nothing reads the wall clock, so the same input always gives the same
+ * report - diff the reports before and after a jitter buffer or VAD change.
+ */
+
+#define REPLAY_SAMPLE_RATE        16000  // AUDIO_SAMPLE_RATE
+#define REPLAY_TICK_US            5000   // Playback task poll (vTaskDelay(5))
+#define REPLAY_START_THRESHOLD    4000   // AUDIO_START_THRESHOLD in audio.cpp
+#define REPLAY_PLAYBACK_RING_SIZE (1u << 20)
+
+struct ReplayResponse {
+    uint32_t frames;            // Binary frames received
+    uint32_t samples;           // Samples decoded into the playback ring
+    bool played;                // Playback started
+    uint32_t startDelayMs;      // First frame's arrival to speaker start
+    uint32_t startThresholdMs;  // Picks in force when playback started
+    uint32_t targetLeadMs;
+    uint32_t underruns;         // Ring ran dry mid-stream (the firmware's count)
+    uint32_t gapMs;             // Silence the amp played while starved
+    uint32_t jitterMs;          // Jitter buffer state after the response
+    uint32_t peakLateMs;
+};
+
+struct ReplayDownlinkReport {
+    std::vector<ReplayResponse> responses;
+    uint32_t textFrames;
+    uint32_t parseErrors;
+    uint32_t decodeErrors;
+    uint32_t droppedSamples;    // Playback ring full or pool exhausted
+    AudioCodec codec;           // Downlink codec at the end of the trace
+    uint64_t endUs;             // Clock when the last audio finished
+    std::vector<int16_t> output;  // What the amp played, silence included
+};
+
+struct ReplaySegment {
+    uint32_t startMs;           // Media time of the frame that turned speech on
+    uint32_t endMs;             // ... and off (end of input if still on)
+};
+
+struct ReplayUplinkReport {
+    std::vector<ReplaySegment> speech;
+    uint32_t frames;            // Mic DMA frames read
+    uint32_t durationMs;
+};
+
+/**
+ * Play a trace through the downlink
+ */
+void replayDownlink(const WsTrace& trace, ReplayDownlinkReport* report);
+
+/**
+ * Run a mic recording (16kHz mono) through capture and the VAD
+ * @param lowLatency POWER_ACTIVE mic geometry (8ms frames) instead of the
+ *                   idle one (32ms)
+ */
+void replayUplink(const int16_t* pcm, size_t count, bool lowLatency, ReplayUplinkReport* report);
+
+void replayPrintDownlink(FILE* out, const ReplayDownlinkReport& report);
+
+void replayPrintUplink(FILE* out, const ReplayUplinkReport& report);
+
+#endif // MOTE_REPLAY_H
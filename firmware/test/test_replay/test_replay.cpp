@@ -0,0 +1,325 @@
+/**
+ * Replay harness: synthetic traces pin down the downlink and VAD behaviour,
+ * and recorded ones can be run through the same path.
+ *
+ * Run on the host: pio test -e native -f test_replay
+ *
+ * Replay recordings (reports go to stdout, use -v to see them):
+ *   MOTE_REPLAY_TRACE=session.trace   WebSocket trace (see test/native/ws_trace.h)
+ *   MOTE_REPLAY_WAV=mic.wav           16kHz mic recording for the VAD
+ *   MOTE_REPLAY_OUT=speaker.wav       Write what the amp played
+ */
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include "replay.h"
+#include "audio.h"
+#include "vad.h"
+#include "../native/wav.h"
+
+#define FRAME_SAMPLES 320       // 20ms downlink frames
+#define FRAME_US      20000
+
+static void addJson(WsTrace* trace, uint64_t us, const char* json) {
+    trace->addText(us, json);
+}
+
+/**
+ * One PCM response: `frames` frames every `intervalUs` from `startUs`, with
+ * an extra `stallUs` before frame `stallAt`
+ * @return Arrival time of the last frame
+ */
+static uint64_t addResponse(WsTrace* trace, uint64_t startUs, size_t frames, uint64_t intervalUs,
+                            size_t stallAt, uint64_t stallUs) {
+    addJson(trace, startUs, "{\"type\":\"voice.response\",\"text\":\"ok\"}");
+    uint64_t us = startUs + 1000;
+    for (size_t i = 0; i < frames; i++) {
+        if (i == stallAt) us += stallUs;
+        trace->addBinary(us, nullptr, FRAME_SAMPLES * sizeof(int16_t));
+        us += intervalUs;
+    }
+    addJson(trace, us, "{\"type\":\"voice.done\"}");
+    return us;
+}
+
+static void test_trace_parser() {
+    WsTrace trace;
+    trace.parse("# recorded by hand\n"
+                "[Voice] Connected\n"
+                "[WsTrace] 1000 T {\"type\":\"voice.response\"}\n"
+                "[WsTrace] 2000 B 640\r\n"
+                "3000 B 4 0102ff00\n"
+                "4000 B 4 01\n"                 // Truncated payload - skipped
+                "\n"
+                "5000 T {\"type\":\"voice.done\"}");
+
+    const std::vector<WsTraceFrame>& frames = trace.frames();
+    TEST_ASSERT_EQUAL_UINT32(4, frames.size());
+    TEST_ASSERT_FALSE(frames[0].binary);
+    TEST_ASSERT_EQUAL_UINT32(1000, frames[0].arrivalUs);
+    TEST_ASSERT_EQUAL_STRING("{\"type\":\"voice.response\"}",
+                             std::string(frames[0].payload.begin(), frames[0].payload.end()).c_str());
+    TEST_ASSERT_TRUE(frames[1].binary);
+    TEST_ASSERT_EQUAL_UINT32(640, frames[1].payload.size());
+    TEST_ASSERT_EQUAL_UINT32(4, frames[2].payload.size());
+    TEST_ASSERT_EQUAL_UINT32(0xff, frames[2].payload[2]);
+    TEST_ASSERT_EQUAL_UINT32(5000, frames[3].arrivalUs);
+}
+
+static void test_steady_stream_plays_clean() {
+    WsTrace trace;
+    addResponse(&trace, 0, 150, FRAME_US, 0, 0);
+
+    ReplayDownlinkReport report;
+    replayDownlink(trace, &report);
+
+    TEST_ASSERT_EQUAL_UINT32(1, report.responses.size());
+    const ReplayResponse& r = report.responses[0];
+    TEST_ASSERT_TRUE(r.played);
+    TEST_ASSERT_EQUAL_UINT32(150, r.frames);
+    TEST_ASSERT_EQUAL_UINT32(150 * FRAME_SAMPLES, r.samples);
+    // Real-time delivery after the start lead never starves the amp
+    TEST_ASSERT_EQUAL_UINT32(0, r.underruns);
+    TEST_ASSERT_EQUAL_UINT32(0, r.gapMs);
+    // Starts once the threshold in force has arrived, not before
+    TEST_ASSERT_TRUE(r.startDelayMs + 20 >= r.startThresholdMs);
+    TEST_ASSERT_TRUE(r.startDelayMs <= r.startThresholdMs + 30);
+    TEST_ASSERT_EQUAL_UINT32(0, report.parseErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, report.droppedSamples);
+
+    // A server running ahead of real time only builds the lead up
+    WsTrace ahead;
+    addResponse(&ahead, 0, 150, FRAME_US * 3 / 4, 0, 0);
+    replayDownlink(ahead, &report);
+    TEST_ASSERT_TRUE(report.responses[0].played);
+    TEST_ASSERT_EQUAL_UINT32(0, report.responses[0].underruns);
+    TEST_ASSERT_EQUAL_UINT32(0, report.responses[0].gapMs);
+}
+
+static void test_stall_underruns_then_adapts() {
+    WsTrace trace;
+    // A 700ms hole one second in, then the same network again
+    uint64_t end = addResponse(&trace, 0, 150, FRAME_US, 50, 700000);
+    addResponse(&trace, end + 2000000, 150, FRAME_US, 50, 700000);
+
+    ReplayDownlinkReport report;
+    replayDownlink(trace, &report);
+
+    TEST_ASSERT_EQUAL_UINT32(2, report.responses.size());
+    const ReplayResponse& first = report.responses[0];
+    const ReplayResponse& second = report.responses[1];
+    TEST_ASSERT_TRUE(first.underruns >= 1);
+    TEST_ASSERT_TRUE(first.gapMs > 0);
+    TEST_ASSERT_TRUE(first.peakLateMs > 0);
+
+    // The stall taught the jitter buffer to start later and ride it out
+    TEST_ASSERT_TRUE(second.startThresholdMs > first.startThresholdMs);
+    TEST_ASSERT_TRUE(second.gapMs < first.gapMs);
+}
+
+static void test_threshold_converges_on_steady_stream() {
+    WsTrace trace;
+    // One 400ms hiccup raises the start threshold, then a clean LAN
+    uint64_t end = addResponse(&trace, 0, 150, FRAME_US, 50, 400000);
+    for (int i = 0; i < 10; i++) {
+        end = addResponse(&trace, end + 1000000, 100, FRAME_US, 0, 0);
+    }
+
+    ReplayDownlinkReport report;
+    replayDownlink(trace, &report);
+
+    TEST_ASSERT_EQUAL_UINT32(11, report.responses.size());
+    TEST_ASSERT_TRUE(report.responses[1].startThresholdMs > 250);
+    for (size_t i = 1; i < report.responses.size(); i++) {
+        const ReplayResponse& r = report.responses[i];
+        // The ring empties between frames with the lead in DMA - not an underrun
+        TEST_ASSERT_EQUAL_UINT32(0, r.underruns);
+        TEST_ASSERT_EQUAL_UINT32(0, r.gapMs);
+        if (i > 1) TEST_ASSERT_TRUE(r.startThresholdMs <= report.responses[i - 1].startThresholdMs);
+    }
+    const ReplayResponse& last = report.responses.back();
+    TEST_ASSERT_TRUE(last.startThresholdMs >= 150);
+    TEST_ASSERT_TRUE(last.startThresholdMs <= 250);
+}
+
+static void test_adpcm_downlink_decodes() {
+    WsTrace trace;
+    addJson(&trace, 0, "{\"type\":\"voice.config\",\"downlinkCodec\":\"adpcm\"}");
+    addJson(&trace, 1000, "{\"type\":\"voice.response\"}");
+
+    // Two 20ms packets per frame, a 1kHz tone
+    AdpcmState state;
+    adpcmReset(&state);
+    int16_t pcm[FRAME_SAMPLES];
+    uint64_t us = 2000;
+    uint32_t phase = 0;
+    for (size_t i = 0; i < 50; i++) {
+        uint8_t frame[2 * (2 + ADPCM_BLOCK_BYTES(FRAME_SAMPLES))];
+        size_t len = 0;
+        for (int p = 0; p < 2; p++) {
+            for (size_t s = 0; s < FRAME_SAMPLES; s++) {
+                pcm[s] = (int16_t)(8000 * sinf(2.0f * (float)M_PI * 1000.0f * (float)phase++ / REPLAY_SAMPLE_RATE));
+            }
+            size_t bytes = adpcmEncodeBlock(&state, pcm, FRAME_SAMPLES, frame + len + 2);
+            frame[len] = (uint8_t)bytes;
+            frame[len + 1] = (uint8_t)(bytes >> 8);
+            len += 2 + bytes;
+        }
+        trace.addBinary(us, frame, len);
+        us += 2 * FRAME_US;
+    }
+    addJson(&trace, us, "{\"type\":\"voice.done\"}");
+
+    ReplayDownlinkReport report;
+    replayDownlink(trace, &report);
+
+    TEST_ASSERT_EQUAL_UINT32(AUDIO_CODEC_ADPCM, report.codec);
+    TEST_ASSERT_EQUAL_UINT32(0, report.decodeErrors);
+    TEST_ASSERT_EQUAL_UINT32(1, report.responses.size());
+    TEST_ASSERT_EQUAL_UINT32(100 * FRAME_SAMPLES, report.responses[0].samples);
+    TEST_ASSERT_EQUAL_UINT32(0, report.responses[0].underruns);    // Same as the PCM stream
+    TEST_ASSERT_EQUAL_UINT32(0, report.responses[0].gapMs);
+
+    uint32_t peak = 0;
+    for (int16_t s : report.output) {
+        uint32_t a = (uint32_t)abs(s);
+        if (a > peak) peak = a;
+    }
+    TEST_ASSERT_TRUE(peak > 6000);
+}
+
+static void test_interrupt_stops_playback() {
+    WsTrace trace;
+    addJson(&trace, 0, "{\"type\":\"voice.response\"}");
+    for (size_t i = 0; i < 100; i++) {
+        trace.addBinary(1000 + i * 5000, nullptr, FRAME_SAMPLES * sizeof(int16_t));  // Burst
+    }
+    addJson(&trace, 800000, "{\"type\":\"voice.interrupt\"}");
+
+    ReplayDownlinkReport report;
+    replayDownlink(trace, &report);
+
+    TEST_ASSERT_TRUE(report.responses[0].played);
+    // 2s of audio queued, cut off at the interrupt
+    TEST_ASSERT_TRUE(report.endUs <= 810000);
+    TEST_ASSERT_TRUE(report.output.size() < 16000);
+}
+
+static void test_replay_is_deterministic() {
+    WsTrace trace;
+    uint64_t end = addResponse(&trace, 0, 120, 23000, 40, 300000);
+    addResponse(&trace, end + 500000, 80, 17000, 60, 150000);
+
+    ReplayDownlinkReport a, b;
+    replayDownlink(trace, &a);
+    replayDownlink(trace, &b);
+
+    TEST_ASSERT_EQUAL_UINT32(a.responses.size(), b.responses.size());
+    for (size_t i = 0; i < a.responses.size(); i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&a.responses[i], &b.responses[i], sizeof(ReplayResponse));
+    }
+    TEST_ASSERT_EQUAL_UINT32(a.endUs, b.endUs);
+    TEST_ASSERT_EQUAL_UINT32(a.output.size(), b.output.size());
+}
+
+/**
+ * 1s of room noise, `speechMs` of voiced sound, 1s of room noise
+ */
+static std::vector<int16_t> makeUtterance(uint32_t speechMs) {
+    uint32_t rng = 0x2468ace1;
+    size_t quiet = REPLAY_SAMPLE_RATE;
+    size_t speech = speechMs * REPLAY_SAMPLE_RATE / 1000;
+    std::vector<int16_t> pcm(2 * quiet + speech);
+
+    for (size_t i = 0; i < pcm.size(); i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        float sample = (float)((int32_t)(rng & 0xff) - 128) / 16.0f;   // ~5 LSB RMS
+        if (i >= quiet && i < quiet + speech) {
+            float t = (float)i / REPLAY_SAMPLE_RATE;
+            sample += 2500.0f * sinf(2.0f * (float)M_PI * 220.0f * t)
+                    + 1500.0f * sinf(2.0f * (float)M_PI * 660.0f * t)
+                    + 800.0f * sinf(2.0f * (float)M_PI * 1300.0f * t);
+        }
+        pcm[i] = (int16_t)sample;
+    }
+    return pcm;
+}
+
+static void test_uplink_vad_segments() {
+    std::vector<int16_t> pcm = makeUtterance(800);
+
+    ReplayUplinkReport active, idle;
+    replayUplink(pcm.data(), pcm.size(), true, &active);
+    replayUplink(pcm.data(), pcm.size(), false, &idle);
+
+    TEST_ASSERT_EQUAL_UINT32(1, active.speech.size());
+    TEST_ASSERT_EQUAL_UINT32(1, idle.speech.size());
+    TEST_ASSERT_EQUAL_UINT32(2800, active.durationMs);
+
+    // Onset within the VAD's 30ms plus a frame; release after the hangover
+    TEST_ASSERT_TRUE(active.speech[0].startMs >= 1000);
+    TEST_ASSERT_TRUE(active.speech[0].startMs <= 1000 + 30 + 8 + 10);
+    TEST_ASSERT_TRUE(active.speech[0].endMs >= 1800 + VAD_HANGOVER_MS);
+    TEST_ASSERT_TRUE(active.speech[0].endMs <= 1800 + VAD_HANGOVER_MS + 8 + 20);
+
+    // The idle geometry sees the same speech, a frame later at most
+    TEST_ASSERT_TRUE(idle.speech[0].startMs >= active.speech[0].startMs);
+    TEST_ASSERT_TRUE(idle.speech[0].startMs <= active.speech[0].startMs + 32);
+    TEST_ASSERT_EQUAL_UINT32(2800 * 16 / AUDIO_RX_LOW_LATENCY_FRAMES, active.frames);
+}
+
+static void test_recorded_files() {
+    const char* tracePath = getenv("MOTE_REPLAY_TRACE");
+    const char* wavPath = getenv("MOTE_REPLAY_WAV");
+    const char* outPath = getenv("MOTE_REPLAY_OUT");
+    if (tracePath == nullptr && wavPath == nullptr) {
+        TEST_IGNORE_MESSAGE("set MOTE_REPLAY_TRACE and/or MOTE_REPLAY_WAV to replay recordings");
+    }
+
+    if (tracePath != nullptr) {
+        WsTrace trace;
+        TEST_ASSERT_TRUE_MESSAGE(trace.load(tracePath), "can't read MOTE_REPLAY_TRACE");
+        ReplayDownlinkReport report;
+        replayDownlink(trace, &report);
+        replayPrintDownlink(stdout, report);
+        if (outPath != nullptr) {
+            TEST_ASSERT_TRUE_MESSAGE(wavSave(outPath, report.output, REPLAY_SAMPLE_RATE),
+                                     "can't write MOTE_REPLAY_OUT");
+        }
+    }
+
+    if (wavPath != nullptr) {
+        std::vector<int16_t> pcm;
+        uint32_t rate = 0;
+        TEST_ASSERT_TRUE_MESSAGE(wavLoad(wavPath, &pcm, &rate), "can't read MOTE_REPLAY_WAV (16-bit PCM)");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(REPLAY_SAMPLE_RATE, rate, "MOTE_REPLAY_WAV must be 16kHz");
+        ReplayUplinkReport active, idle;
+        replayUplink(pcm.data(), pcm.size(), true, &active);
+        replayUplink(pcm.data(), pcm.size(), false, &idle);
+        printf("active geometry ");
+        replayPrintUplink(stdout, active);
+        printf("idle geometry ");
+        replayPrintUplink(stdout, idle);
+    }
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_trace_parser);
+    RUN_TEST(test_steady_stream_plays_clean);
+    RUN_TEST(test_stall_underruns_then_adapts);
+    RUN_TEST(test_threshold_converges_on_steady_stream);
+    RUN_TEST(test_adpcm_downlink_decodes);
+    RUN_TEST(test_interrupt_stops_playback);
+    RUN_TEST(test_replay_is_deterministic);
+    RUN_TEST(test_uplink_vad_segments);
+    RUN_TEST(test_recorded_files);
+    UNITY_END();
+}
+
+int main() {
+    runTests();
+    return 0;
+}
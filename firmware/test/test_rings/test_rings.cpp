@@ -0,0 +1,267 @@
+/**
+ * SpscRing and BlockRing: fill accounting, wraparound, flush marks, and the
+ * BlockRing's block lifetime against a pool that can run out.
+ *
+ * Run on the host:  pio test -e native -f test_rings
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_rings
+ */
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block_ring.h"
+#include "spsc_ring.h"
+
+// BlockRing logic only - the malloc pool stands in for heap_caps on both targets
+#include "../native/audio_pool_shim.cpp"
+
+#ifndef ARDUINO
+#include <thread>
+#endif
+
+#define BLOCK BlockRing<int16_t>::BLOCK_ELEMENTS
+
+static int16_t src[4 * 2048 + 7];
+static int16_t dst[4 * 2048 + 7];
+
+static void fillRamp(int16_t* buf, size_t count, int16_t start) {
+    for (size_t i = 0; i < count; i++) {
+        buf[i] = (int16_t)(start + i);
+    }
+}
+
+static uint32_t poolInUse(AudioPoolKind kind) {
+    AudioPoolStats stats;
+    getAudioPoolStats(kind, &stats);
+    return stats.inUse;
+}
+
+static void test_spsc_rejects_bad_sizes() {
+    static int16_t storage[64];
+    SpscRing<int16_t> ring;
+    TEST_ASSERT_FALSE(ring.init(storage, 48));
+    TEST_ASSERT_FALSE(ring.init(nullptr, 64));
+    TEST_ASSERT_TRUE(ring.init(storage, 64));
+    TEST_ASSERT_EQUAL_UINT32(64, ring.freeSpace());
+}
+
+static void test_spsc_wraps_and_fills_exactly() {
+    static int16_t storage[64];
+    SpscRing<int16_t> ring;
+    ring.init(storage, 64);
+
+    // Walk the indices round the buffer several times with odd-sized steps
+    int16_t next = 0, expect = 0;
+    for (int round = 0; round < 50; round++) {
+        fillRamp(src, 37, next);
+        TEST_ASSERT_EQUAL_UINT32(37, ring.write(src, 37));
+        next += 37;
+        TEST_ASSERT_EQUAL_UINT32(37, ring.read(dst, 37));
+        for (size_t i = 0; i < 37; i++) {
+            TEST_ASSERT_EQUAL_INT16(expect++, dst[i]);
+        }
+    }
+
+    // Full means full - no wasted slot, and an overlong write is cut short
+    fillRamp(src, 80, 0);
+    TEST_ASSERT_EQUAL_UINT32(64, ring.write(src, 80));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.freeSpace());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.write(src, 1));
+}
+
+static void test_spsc_peek_skip_discard_to() {
+    static int16_t storage[64];
+    SpscRing<int16_t> ring;
+    ring.init(storage, 64);
+
+    fillRamp(src, 20, 100);
+    ring.write(src, 20);
+    TEST_ASSERT_EQUAL_UINT32(5, ring.peek(dst, 5));
+    TEST_ASSERT_EQUAL_UINT32(20, ring.available());
+    TEST_ASSERT_EQUAL_INT16(100, dst[0]);
+
+    TEST_ASSERT_EQUAL_UINT32(5, ring.skip(5));
+    ring.read(dst, 1);
+    TEST_ASSERT_EQUAL_INT16(105, dst[0]);
+
+    // A flush mark keeps what was written after it
+    size_t mark = ring.writeIndex();
+    ring.write(src, 3);
+    ring.discardTo(mark);
+    TEST_ASSERT_EQUAL_UINT32(3, ring.available());
+    ring.discardTo(mark);           // Already past it - no effect
+    TEST_ASSERT_EQUAL_UINT32(3, ring.available());
+}
+
+static void test_block_ring_takes_blocks_lazily() {
+    BlockRing<int16_t> ring;
+    TEST_ASSERT_FALSE(ring.init(AUDIO_POOL_PSRAM, BLOCK / 2));    // Less than a block
+    TEST_ASSERT_FALSE(ring.init(AUDIO_POOL_PSRAM, 3 * BLOCK));    // Not a power of two
+    TEST_ASSERT_TRUE(ring.init(AUDIO_POOL_PSRAM, 4 * BLOCK));
+    TEST_ASSERT_EQUAL_UINT32(0, poolInUse(AUDIO_POOL_PSRAM));
+
+    fillRamp(src, BLOCK + 1, 0);
+    TEST_ASSERT_EQUAL_UINT32(BLOCK + 1, ring.write(src, BLOCK + 1));
+    TEST_ASSERT_EQUAL_UINT32(2, poolInUse(AUDIO_POOL_PSRAM));
+
+    // Finishing a block hands it back straight away
+    TEST_ASSERT_EQUAL_UINT32(BLOCK, ring.read(dst, BLOCK));
+    TEST_ASSERT_EQUAL_UINT32(1, poolInUse(AUDIO_POOL_PSRAM));
+    TEST_ASSERT_EQUAL_MEMORY(src, dst, BLOCK * sizeof(int16_t));
+
+    ring.discardAll();
+    TEST_ASSERT_EQUAL_UINT32(1, poolInUse(AUDIO_POOL_PSRAM));     // Tail sits inside the next block
+    ring.init(AUDIO_POOL_PSRAM, 4 * BLOCK);
+    TEST_ASSERT_EQUAL_UINT32(0, poolInUse(AUDIO_POOL_PSRAM));
+}
+
+static void test_block_ring_round_trips_across_blocks() {
+    BlockRing<int16_t> ring;
+    ring.init(AUDIO_POOL_PSRAM, 2 * BLOCK);
+
+    // Odd-sized writes and reads that straddle block edges, many laps round
+    int16_t next = 0, expect = 0;
+    size_t sizes[] = {1, 333, BLOCK - 1, BLOCK, BLOCK + 5, 7};
+    for (int lap = 0; lap < 40; lap++) {
+        size_t n = sizes[lap % 6];
+        fillRamp(src, n, next);
+        TEST_ASSERT_EQUAL_UINT32(n, ring.write(src, n));
+        next += (int16_t)n;
+
+        TEST_ASSERT_EQUAL_UINT32(n, ring.read(dst, n));
+        for (size_t i = 0; i < n; i++) {
+            if (dst[i] != expect) TEST_FAIL_MESSAGE("sample out of order");
+            expect++;
+        }
+    }
+    TEST_ASSERT_TRUE(poolInUse(AUDIO_POOL_PSRAM) <= 1);
+
+    // Capacity is a ceiling, as with SpscRing
+    fillRamp(src, 2 * BLOCK + 10, 0);
+    TEST_ASSERT_EQUAL_UINT32(2 * BLOCK, ring.write(src, 2 * BLOCK + 10));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.freeSpace());
+    ring.init(AUDIO_POOL_PSRAM, 2 * BLOCK);
+}
+
+static void test_block_ring_short_write_when_pool_runs_out() {
+    BlockRing<int16_t> ring;
+    ring.init(AUDIO_POOL_PSRAM, 4 * BLOCK);
+    hostAudioPoolSetLimit(AUDIO_POOL_PSRAM, 2);
+
+    fillRamp(src, 3 * BLOCK, 0);
+    TEST_ASSERT_EQUAL_UINT32(2 * BLOCK, ring.write(src, 3 * BLOCK));
+
+    AudioPoolStats stats;
+    getAudioPoolStats(AUDIO_POOL_PSRAM, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.allocFailures);
+
+    // Reading frees a block and the producer can carry on
+    ring.read(dst, BLOCK);
+    TEST_ASSERT_EQUAL_UINT32(BLOCK, ring.write(src, BLOCK));
+
+    ring.init(AUDIO_POOL_PSRAM, 4 * BLOCK);
+    hostAudioPoolSetLimit(AUDIO_POOL_PSRAM, AUDIO_POOL_PSRAM_MAX);
+}
+
+static void test_block_ring_write_all_is_all_or_nothing() {
+    BlockRing<uint8_t> ring;
+    const size_t block = BlockRing<uint8_t>::BLOCK_ELEMENTS;
+    ring.init(AUDIO_POOL_PSRAM, 4 * block);
+    hostAudioPoolSetLimit(AUDIO_POOL_PSRAM, 2);
+
+    static uint8_t packet[3 * 4096];
+    memset(packet, 0x5a, sizeof(packet));
+    TEST_ASSERT_TRUE(ring.writeAll(packet, block + 10));
+    TEST_ASSERT_FALSE(ring.writeAll(packet, block));        // Needs a third block
+    TEST_ASSERT_EQUAL_UINT32(block + 10, ring.available());  // Nothing partial went in
+    TEST_ASSERT_TRUE(ring.writeAll(packet, block - 10));     // Fits the blocks already held
+
+    ring.init(AUDIO_POOL_PSRAM, 4 * block);
+    hostAudioPoolSetLimit(AUDIO_POOL_PSRAM, AUDIO_POOL_PSRAM_MAX);
+}
+
+static void test_internal_pool_falls_back_to_psram() {
+    BlockRing<int16_t> ring;
+    ring.init(AUDIO_POOL_INTERNAL, 4 * BLOCK);
+    hostAudioPoolSetLimit(AUDIO_POOL_INTERNAL, 1);
+
+    fillRamp(src, 3 * BLOCK, 0);
+    TEST_ASSERT_EQUAL_UINT32(3 * BLOCK, ring.write(src, 3 * BLOCK));
+    TEST_ASSERT_EQUAL_UINT32(1, poolInUse(AUDIO_POOL_INTERNAL));
+    TEST_ASSERT_EQUAL_UINT32(2, poolInUse(AUDIO_POOL_PSRAM));
+
+    ring.init(AUDIO_POOL_INTERNAL, 4 * BLOCK);
+    TEST_ASSERT_EQUAL_UINT32(0, poolInUse(AUDIO_POOL_INTERNAL));
+    TEST_ASSERT_EQUAL_UINT32(0, poolInUse(AUDIO_POOL_PSRAM));
+    hostAudioPoolSetLimit(AUDIO_POOL_INTERNAL, AUDIO_POOL_INTERNAL_MAX);
+}
+
+#ifndef ARDUINO
+/**
+ * Producer and consumer on real threads, uneven chunk sizes, checked order
+ */
+static void test_block_ring_two_threads() {
+    static BlockRing<uint32_t> ring;
+    ring.init(AUDIO_POOL_PSRAM, 4 * BlockRing<uint32_t>::BLOCK_ELEMENTS);
+    const uint32_t total = 2000000;
+    bool ordered = true;
+
+    std::thread producer([&] {
+        uint32_t chunk[301];
+        uint32_t next = 0;
+        while (next < total) {
+            size_t n = 1 + next % 300;
+            if (n > total - next) n = total - next;
+            for (size_t i = 0; i < n; i++) chunk[i] = next + (uint32_t)i;
+            size_t done = 0;
+            while (done < n) done += ring.write(chunk + done, n - done);
+            next += (uint32_t)n;
+        }
+    });
+
+    uint32_t chunk[257];
+    uint32_t expect = 0;
+    while (expect < total) {
+        size_t n = ring.read(chunk, 1 + expect % 256);
+        for (size_t i = 0; i < n; i++) {
+            if (chunk[i] != expect++) ordered = false;
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_UINT32(0, ring.available());
+    ring.init(AUDIO_POOL_PSRAM, 4 * BlockRing<uint32_t>::BLOCK_ELEMENTS);
+}
+#endif
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_spsc_rejects_bad_sizes);
+    RUN_TEST(test_spsc_wraps_and_fills_exactly);
+    RUN_TEST(test_spsc_peek_skip_discard_to);
+    RUN_TEST(test_block_ring_takes_blocks_lazily);
+    RUN_TEST(test_block_ring_round_trips_across_blocks);
+    RUN_TEST(test_block_ring_short_write_when_pool_runs_out);
+    RUN_TEST(test_block_ring_write_all_is_all_or_nothing);
+    RUN_TEST(test_internal_pool_falls_back_to_psram);
+#ifndef ARDUINO
+    RUN_TEST(test_block_ring_two_threads);
+#endif
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,190 @@
+/**
+ * VAD decisions on synthetic rooms: onset and hangover timing, clicks,
+ * hiss, a room that gets louder, and independence from the block size.
+ *
+ * Run on the host:  pio test -e native -f test_vad
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_vad
+ */
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include "vad.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/vad.cpp"
+
+#define RATE        16000
+#define FRAME       (RATE * VAD_FRAME_MS / 1000)
+
+static uint32_t rngState;
+
+static int32_t noise(int32_t amplitude) {
+    // xorshift32 - deterministic across host and target
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return (int32_t)(rngState % (uint32_t)(2 * amplitude + 1)) - amplitude;
+}
+
+static int16_t voiced(size_t i, float amplitude) {
+    // A vowel-ish harmonic stack, inside the 300-3400Hz band
+    float t = (float)i / RATE;
+    return (int16_t)(amplitude * (0.6f * sinf(2.0f * (float)M_PI * 440.0f * t) +
+                                  0.3f * sinf(2.0f * (float)M_PI * 880.0f * t) +
+                                  0.1f * sinf(2.0f * (float)M_PI * 1760.0f * t)));
+}
+
+/**
+ * Feed `ms` of room noise plus an optional voiced signal, 10ms at a time
+ * @return Milliseconds (from the start of this call) at which the decision
+ *         first equals `watchFor`, or -1
+ */
+static int runFor(Vad* vad, uint32_t ms, int32_t noiseAmp, float voiceAmp, bool watchFor) {
+    static size_t sampleIndex = 0;
+    int16_t frame[FRAME];
+    int seen = -1;
+    for (uint32_t t = 0; t < ms; t += VAD_FRAME_MS) {
+        for (size_t i = 0; i < FRAME; i++) {
+            int32_t s = noise(noiseAmp);
+            if (voiceAmp > 0.0f) s += voiced(sampleIndex, voiceAmp);
+            sampleIndex++;
+            frame[i] = (int16_t)s;
+        }
+        if (vad->process(frame, FRAME) == watchFor && seen < 0) {
+            seen = (int)(t + VAD_FRAME_MS);
+        }
+    }
+    return seen;
+}
+
+static void test_quiet_room_is_never_speech() {
+    rngState = 0x1234567;
+    Vad silent(RATE);
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&silent, 3000, 0, 0.0f, true));     // Digital silence
+
+    Vad vad(RATE);
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&vad, 3000, 20, 0.0f, true));       // Room noise
+
+    VadStats stats;
+    vad.getStats(&stats);
+    TEST_ASSERT_FALSE(stats.speech);
+    TEST_ASSERT_TRUE(stats.noiseFloorDb > VAD_MIN_ENERGY_DB);
+}
+
+static void test_onset_and_hangover_timing() {
+    rngState = 0x1234567;
+    Vad vad(RATE);
+    runFor(&vad, 1000, 20, 0.0f, true);
+
+    // Speech needs VAD_ONSET_FRAMES in a row, then holds for the hangover
+    int onset = runFor(&vad, 500, 20, 3000.0f, true);
+    TEST_ASSERT_EQUAL_INT(VAD_ONSET_FRAMES * VAD_FRAME_MS, onset);
+
+    // The band filters ring into the first quiet frame, which still counts
+    int release = runFor(&vad, 1000, 20, 0.0f, false);
+    TEST_ASSERT_TRUE(release >= VAD_HANGOVER_MS + VAD_FRAME_MS);
+    TEST_ASSERT_TRUE(release <= VAD_HANGOVER_MS + 2 * VAD_FRAME_MS);
+}
+
+static void test_click_does_not_trigger() {
+    rngState = 0x1234567;
+    Vad vad(RATE);
+    runFor(&vad, 1000, 20, 0.0f, true);
+
+    // One loud frame (plus the filters' ring-down) is short of the onset
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&vad, VAD_FRAME_MS, 20, 8000.0f, true));
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&vad, 500, 20, 0.0f, true));
+}
+
+static void test_hiss_rejected_and_floor_follows_room() {
+    rngState = 0x1234567;
+    Vad vad(RATE);
+    runFor(&vad, 1000, 20, 0.0f, true);
+    VadStats before;
+    vad.getStats(&before);
+
+    // Fan switched on: broadband noise ~10dB louder in band. Crossing rate
+    // marks it as noise, and the floor climbs to it instead of staying
+    // "speech" for good.
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&vad, 4000, 64, 0.0f, true));
+    VadStats after;
+    vad.getStats(&after);
+    TEST_ASSERT_TRUE(after.zcr > VAD_ZCR_MAX);
+    TEST_ASSERT_TRUE(after.noiseFloorDb > before.noiseFloorDb + 6.0f);
+
+    // Speech still gets through over the louder room
+    TEST_ASSERT_TRUE(runFor(&vad, 500, 64, 4000.0f, true) > 0);
+}
+
+static void test_block_size_does_not_matter() {
+    static int16_t signal[RATE * 2];
+    rngState = 0xabcdef;
+    for (size_t i = 0; i < sizeof(signal) / sizeof(signal[0]); i++) {
+        int32_t s = noise(20);
+        if (i > RATE && i < RATE * 3 / 2) s += voiced(i, 3000.0f);
+        signal[i] = (int16_t)s;
+    }
+    const size_t total = sizeof(signal) / sizeof(signal[0]);
+
+    Vad reference(RATE);
+    reference.process(signal, total);
+    VadStats expected;
+    reference.getStats(&expected);
+
+    const size_t blocks[] = {1, 7, FRAME, 128, 512, 1000};
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        Vad vad(RATE);
+        for (size_t pos = 0; pos < total; pos += blocks[b]) {
+            size_t n = total - pos < blocks[b] ? total - pos : blocks[b];
+            vad.process(signal + pos, n);
+        }
+        VadStats stats;
+        vad.getStats(&stats);
+        TEST_ASSERT_EQUAL_FLOAT(expected.noiseFloorDb, stats.noiseFloorDb);
+        TEST_ASSERT_EQUAL_FLOAT(expected.energyDb, stats.energyDb);
+        TEST_ASSERT_TRUE(expected.speech == stats.speech);
+    }
+}
+
+static void test_reset_forgets_the_room() {
+    rngState = 0x1234567;
+    Vad vad(RATE);
+    runFor(&vad, 1000, 20, 0.0f, true);
+    runFor(&vad, 300, 20, 3000.0f, true);
+    vad.reset();
+
+    VadStats stats;
+    vad.getStats(&stats);
+    TEST_ASSERT_FALSE(stats.speech);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.noiseFloorDb);
+
+    // Re-seeding takes VAD_INIT_FRAMES before anything can trigger
+    TEST_ASSERT_EQUAL_INT(-1, runFor(&vad, VAD_INIT_FRAMES * VAD_FRAME_MS, 20, 3000.0f, true));
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_quiet_room_is_never_speech);
+    RUN_TEST(test_onset_and_hangover_timing);
+    RUN_TEST(test_click_does_not_trigger);
+    RUN_TEST(test_hiss_rejected_and_floor_follows_room);
+    RUN_TEST(test_block_size_does_not_matter);
+    RUN_TEST(test_reset_forgets_the_room);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif
@@ -0,0 +1,157 @@
+/**
+ * Control-plane parsing as handleServerMessage() sees it: message type
+ * interning for every case of its switch, the field filter, malformed and
+ * oversized frames, and that the arena really is rewound per frame.
+ *
+ * Run on the host:  pio test -e native -f test_voice_protocol
+ * Run on the board: pio test -e esp32-s3-devkitc-1 -f test_voice_protocol
+ */
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include "voice_protocol.h"
+#include "ota_update.h"
+
+// Tests build without src/ (test_build_src = no), so pull the module in directly
+#include "../../src/voice_protocol.cpp"
+
+static JsonVariantConst parse(const char* text, VoiceMessageType* type) {
+    return voiceProtocolParse((const uint8_t*)text, strlen(text), type);
+}
+
+static void test_every_message_type_interns() {
+    const VoiceMessageType types[] = {
+        VOICE_MSG_LISTENING, VOICE_MSG_TRANSCRIPTION, VOICE_MSG_PROCESSING, VOICE_MSG_RESPONSE,
+        VOICE_MSG_DONE, VOICE_MSG_INTERRUPT, VOICE_MSG_ERROR, VOICE_MSG_CONFIG,
+        VOICE_MSG_IOT_REQUEST, VOICE_MSG_IOT_CANCEL, VOICE_MSG_OTA_OFFER, VOICE_MSG_OTA_CHUNK,
+        VOICE_MSG_OTA_CANCEL,
+    };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        const char* name = voiceMessageTypeName(types[i]);
+        TEST_ASSERT_EQUAL(types[i], voiceMessageTypeFromName(name));
+
+        std::string frame = std::string("{\"type\":\"") + name + "\"}";
+        VoiceMessageType type;
+        TEST_ASSERT_FALSE(parse(frame.c_str(), &type).isNull());
+        TEST_ASSERT_EQUAL(types[i], type);
+    }
+
+    TEST_ASSERT_EQUAL(VOICE_MSG_UNKNOWN, voiceMessageTypeFromName("voice.future"));
+    TEST_ASSERT_EQUAL(VOICE_MSG_UNKNOWN, voiceMessageTypeFromName(nullptr));
+    TEST_ASSERT_EQUAL_STRING("unknown", voiceMessageTypeName(VOICE_MSG_UNKNOWN));
+}
+
+static void test_fields_handlers_read_survive_the_filter() {
+    VoiceMessageType type;
+    JsonVariantConst msg = parse("{\"type\":\"voice.config\",\"uplinkCodec\":\"adpcm\","
+                                 "\"downlinkCodec\":\"pcm\",\"uplinkFraming\":\"typed\","
+                                 "\"sessionId\":\"abc\",\"debug\":{\"a\":[1,2,3]}}", &type);
+    TEST_ASSERT_EQUAL(VOICE_MSG_CONFIG, type);
+    TEST_ASSERT_EQUAL_STRING("adpcm", msg["uplinkCodec"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING("pcm", msg["downlinkCodec"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING("typed", msg["uplinkFraming"].as<const char*>());
+
+    // Not read by any handler - never stored
+    TEST_ASSERT_TRUE(msg["sessionId"].isNull());
+    TEST_ASSERT_TRUE(msg["debug"].isNull());
+
+    msg = parse("{\"type\":\"iot.request\",\"requestId\":\"r1\",\"command\":\"iot.http\","
+                "\"params\":{\"url\":\"http://10.0.0.2/\",\"method\":\"GET\"}}", &type);
+    TEST_ASSERT_EQUAL(VOICE_MSG_IOT_REQUEST, type);
+    TEST_ASSERT_EQUAL_STRING("r1", msg["requestId"].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING("http://10.0.0.2/", msg["params"]["url"].as<const char*>());
+}
+
+static void test_full_ota_chunk_fits_the_arena() {
+    std::string data(4 * ((OTA_CHUNK_BYTES + 2) / 3), 'A');
+    std::string frame = "{\"type\":\"ota.chunk\",\"target\":\"firmware\",\"offset\":1048576,\"data\":\"" +
+                        data + "\"}";
+
+    VoiceMessageType type;
+    JsonVariantConst msg = parse(frame.c_str(), &type);
+    TEST_ASSERT_FALSE(msg.isNull());
+    TEST_ASSERT_EQUAL(VOICE_MSG_OTA_CHUNK, type);
+    TEST_ASSERT_EQUAL_UINT32(1048576, msg["offset"].as<uint32_t>());
+    TEST_ASSERT_EQUAL(data.size(), strlen(msg["data"].as<const char*>()));
+}
+
+static void test_frame_need_not_be_terminated() {
+    // WebSocket payloads aren't NUL-terminated - only `length` bytes count
+    const char buffer[] = "{\"type\":\"voice.done\"}{\"type\":\"voice.error\"}";
+    VoiceMessageType type;
+    JsonVariantConst msg = voiceProtocolParse((const uint8_t*)buffer, 21, &type);
+    TEST_ASSERT_FALSE(msg.isNull());
+    TEST_ASSERT_EQUAL(VOICE_MSG_DONE, type);
+}
+
+static void test_malformed_and_oversized_frames() {
+#ifndef ARDUINO
+    Serial.quiet = true;    // The parser logs these
+#endif
+    VoiceMessageType type = VOICE_MSG_DONE;
+    TEST_ASSERT_TRUE(parse("{\"type\":\"voice.done\"", &type).isNull());
+    TEST_ASSERT_EQUAL(VOICE_MSG_UNKNOWN, type);
+    TEST_ASSERT_TRUE(parse("not json", &type).isNull());
+
+    // A text field bigger than the arena is refused, not truncated
+    std::string big = "{\"type\":\"voice.transcription\",\"text\":\"";
+    big.append(VOICE_JSON_ARENA_SIZE + 16, 'a');
+    big += "\"}";
+    TEST_ASSERT_TRUE(parse(big.c_str(), &type).isNull());
+#ifndef ARDUINO
+    Serial.quiet = false;
+#endif
+
+    // The next good frame parses normally
+    JsonVariantConst msg = parse("{\"type\":\"voice.transcription\",\"text\":\"hello\"}", &type);
+    TEST_ASSERT_EQUAL(VOICE_MSG_TRANSCRIPTION, type);
+    TEST_ASSERT_EQUAL_STRING("hello", msg["text"].as<const char*>());
+}
+
+static void test_newer_server_types_parse_as_unknown() {
+    VoiceMessageType type;
+    JsonVariantConst msg = parse("{\"type\":\"voice.emotion\",\"text\":\"happy\"}", &type);
+    TEST_ASSERT_FALSE(msg.isNull());            // Valid frame, dispatch ignores it
+    TEST_ASSERT_EQUAL(VOICE_MSG_UNKNOWN, type);
+}
+
+static void test_arena_is_rewound_every_frame() {
+    const char* frame = "{\"type\":\"voice.response\",\"text\":\"Turning on the kitchen lights now.\"}";
+    VoiceMessageType type;
+    for (int i = 0; i < 10; i++) parse(frame, &type);
+    size_t peak = voiceProtocolArenaPeak();
+
+    for (int i = 0; i < 5000; i++) {
+        TEST_ASSERT_FALSE(parse(frame, &type).isNull());
+    }
+    TEST_ASSERT_EQUAL_UINT32(peak, voiceProtocolArenaPeak());
+    TEST_ASSERT_TRUE(peak < VOICE_JSON_ARENA_SIZE);
+}
+
+static void runTests() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_message_type_interns);
+    RUN_TEST(test_fields_handlers_read_survive_the_filter);
+    RUN_TEST(test_full_ota_chunk_fits_the_arena);
+    RUN_TEST(test_frame_need_not_be_terminated);
+    RUN_TEST(test_arena_is_rewound_every_frame);
+    RUN_TEST(test_malformed_and_oversized_frames);
+    RUN_TEST(test_newer_server_types_parse_as_unknown);
+    UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup() {
+    delay(2000);  // Let the USB CDC console attach
+    runTests();
+}
+
+void loop() {}
+#else
+int main() {
+    runTests();
+    return 0;
+}
+#endif